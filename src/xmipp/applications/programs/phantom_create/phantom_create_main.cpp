@@ -33,11 +33,13 @@ protected:
     FileName          fn_vol;
     Phantom           phantom;
     Image<double>     vol;
+    int               Nthreads;
 
     void defineParams()
     {
     	addParamsLine("-i <description_file> : Input file with the mathematical features");
     	addParamsLine("-o <output_file>      : Output volume in voxels");
+    	addParamsLine("[--thr <N=1>]         : Number of threads");
         addUsageLine("Create phantom volume from a feature description file with two Metadatas.");
         addUsageLine("+You may define a mathematical phantom from its geometrical features");
         addUsageLine("+(cubes, cylinders, ...) and translate it into a voxel volume with this program.");
@@ -52,12 +54,14 @@ protected:
     {
         fn_phantom = getParam("-i");
         fn_vol = getParam("-o");
+        Nthreads = getIntParam("--thr");
     }
 
 public:
     void run()
     {
         phantom.read(fn_phantom);
+        phantom.Nthreads = Nthreads;
         phantom.draw_in(vol());
         vol.write(fn_vol);
     }
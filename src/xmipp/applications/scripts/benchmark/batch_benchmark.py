@@ -0,0 +1,385 @@
+#!/usr/bin/env python
+"""/***************************************************************************
+ *
+ * Authors:     Carlos Oscar Sorzano
+ *
+ * Universidad Autonoma de Madrid
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+"""
+
+import json
+import os
+import platform
+import random
+import shlex
+import shutil
+import subprocess
+import sys
+import time
+
+from xmipp_base import XmippScript
+
+STAGES = ['movie_alignment', 'ctf', 'picking', 'cl2d',
+          'reconstruct_fourier', 'reconstruct_significant', 'monores']
+
+
+def runTimed(cmd, fnLog):
+    """ Run a command and return (returncode, wall, cpu, peakRSS in kB).
+    CPU time and peak RSS are taken from the rusage of the child process
+    (os.wait4), so they include every process the child waited for, e.g.
+    local MPI ranks started by mpirun. """
+    with open(fnLog, 'a') as fhLog:
+        fhLog.write('### %s\n' % cmd)
+        fhLog.flush()
+        t0 = time.time()
+        p = subprocess.Popen(shlex.split(cmd), stdout=fhLog,
+                             stderr=subprocess.STDOUT)
+        _, status, ru = os.wait4(p.pid, 0)
+        wall = time.time() - t0
+    p.returncode = os.WEXITSTATUS(status) if os.WIFEXITED(status) else -1
+    # ru_maxrss is in kilobytes on Linux and in bytes on macOS
+    peakRSS = ru.ru_maxrss
+    if sys.platform == 'darwin':
+        peakRSS /= 1024
+    return p.returncode, wall, ru.ru_utime + ru.ru_stime, peakRSS
+
+
+class ScriptBenchmark(XmippScript):
+    def __init__(self):
+        XmippScript.__init__(self)
+
+    def defineParams(self):
+        self.addUsageLine('Time the main processing stages of Xmipp on synthetic workloads.')
+        self.addUsageLine('+Workloads are generated with phantom_create, phantom_project, '
+                          'phantom_simulate_microscope and phantom_movie from fixed descriptions '
+                          'and a fixed random seed, so that two runs of the benchmark process '
+                          'the same data. For every stage, box size and thread/rank count the '
+                          'wall time, CPU time, peak resident memory and throughput (images/s) '
+                          'are written to a JSON file.')
+        ## params
+        self.addParamsLine(' -o <jsonFile>               : Output JSON file with the timings')
+        self.addParamsLine('[--odir <dir="benchmark">]   : Working directory for the workloads and stage outputs')
+        self.addParamsLine('[--boxSizes <...>]           : Box sizes of the particles and volumes, by default 64 128')
+        self.addParamsLine('[--threads <...>]            : Thread counts to try, by default 1 and the number of cores')
+        self.addParamsLine('[--ranks <...>]              : MPI rank counts to try, by default 2')
+        self.addParamsLine('[--stages <...>]             : Stages to run, by default all of them')
+        self.addParamsLine('                             :+Valid stages are %s' % ', '.join(STAGES))
+        self.addParamsLine('[--Nimgs <N=1000>]           : Number of particle images')
+        self.addParamsLine('[--movieSize <x=2048> <y=2048> <n=20>] : Size of the synthetic movie')
+        self.addParamsLine('[--sampling <Ts=2>]          : Sampling rate (A/px) of the synthetic data')
+        self.addParamsLine('[--repeat <N=1>]             : Number of times each measurement is repeated')
+        self.addParamsLine('[--seed <s=1>]               : Seed for the projection directions')
+        self.addParamsLine('[--mpirun <cmd="mpirun -np">] : MPI launcher, the number of ranks is appended')
+        self.addParamsLine('[--pickingModel <root="">]   : Trained picking model, the picking stage is skipped without it')
+        self.addParamsLine('[--keepWorkloads]            : Do not delete the working directory at the end')
+        ## examples
+        self.addExampleLine('Benchmark all stages with 1, 4 and 8 threads and 2 and 4 MPI ranks', False)
+        self.addExampleLine('xmipp_benchmark -o bench.json --threads 1 4 8 --ranks 2 4')
+        self.addExampleLine('Benchmark only the reconstruction at box size 256', False)
+        self.addExampleLine('xmipp_benchmark -o bench.json --boxSizes 256 --stages reconstruct_fourier')
+
+    def getIntList(self, param, default):
+        if self.checkParam(param):
+            return [int(x) for x in self.getListParam(param)]
+        return default
+
+    def run(self):
+        self.fnJson = os.path.abspath(self.getParam('-o'))
+        self.odir = os.path.abspath(self.getParam('--odir'))
+        self.boxSizes = self.getIntList('--boxSizes', [64, 128])
+        ncores = 1
+        try:
+            import multiprocessing
+            ncores = multiprocessing.cpu_count()
+        except (ImportError, NotImplementedError):
+            pass
+        self.threads = self.getIntList('--threads', sorted(set([1, ncores])))
+        self.ranks = self.getIntList('--ranks', [2])
+        if self.checkParam('--stages'):
+            self.stages = self.getListParam('--stages')
+            for stage in self.stages:
+                if stage not in STAGES:
+                    raise Exception('Unknown stage %s, valid stages are %s'
+                                    % (stage, ', '.join(STAGES)))
+        else:
+            self.stages = STAGES
+        self.Nimgs = self.getIntParam('--Nimgs')
+        self.movieSize = [self.getIntParam('--movieSize', i) for i in range(3)]
+        self.Ts = self.getDoubleParam('--sampling')
+        self.repeat = self.getIntParam('--repeat')
+        self.seed = self.getIntParam('--seed')
+        self.mpirun = self.getParam('--mpirun')
+        self.pickingModel = self.getParam('--pickingModel')
+
+        if not os.path.exists(self.odir):
+            os.makedirs(self.odir)
+        self.fnLog = os.path.join(self.odir, 'benchmark.log')
+
+        self.results = []
+        self.report = {'host': platform.node(),
+                       'platform': platform.platform(),
+                       'cpu_count': ncores,
+                       'date': time.strftime('%Y-%m-%d %H:%M:%S'),
+                       'config': {'boxSizes': self.boxSizes,
+                                  'threads': self.threads,
+                                  'ranks': self.ranks,
+                                  'stages': self.stages,
+                                  'Nimgs': self.Nimgs,
+                                  'movieSize': self.movieSize,
+                                  'sampling': self.Ts,
+                                  'repeat': self.repeat,
+                                  'seed': self.seed},
+                       'results': self.results}
+
+        micStages = [s for s in ['movie_alignment', 'ctf', 'picking'] if s in self.stages]
+        if micStages:
+            self.benchmarkMicrographs(micStages)
+        for box in self.boxSizes:
+            self.benchmarkBox(box)
+
+        self.writeReport()
+        if not self.checkParam('--keepWorkloads'):
+            shutil.rmtree(self.odir, ignore_errors=True)
+
+    # Measurements ----------------------------------------------------------
+    def measure(self, stage, cmd, images, box=None, threads=1, ranks=1):
+        """ Run cmd repeat times and append one record per run """
+        ok = True
+        for r in range(self.repeat):
+            rc, wall, cpu, rss = runTimed(cmd, self.fnLog)
+            self.results.append({'stage': stage,
+                                 'box': box,
+                                 'threads': threads,
+                                 'ranks': ranks,
+                                 'repetition': r,
+                                 'command': cmd,
+                                 'returncode': rc,
+                                 'wall_s': wall,
+                                 'cpu_s': cpu,
+                                 'peak_rss_kb': rss,
+                                 'images': images,
+                                 'images_per_s': images / wall if wall > 0 else 0.0})
+            print('%-24s box=%-5s thr=%-3d ranks=%-3d wall=%8.2fs cpu=%8.2fs rss=%8d kB%s'
+                  % (stage, box, threads, ranks, wall, cpu, rss,
+                     '' if rc == 0 else '  FAILED (see %s)' % self.fnLog))
+            sys.stdout.flush()
+            ok = ok and rc == 0
+        # Partial results are kept even if a later stage crashes
+        self.writeReport()
+        return ok
+
+    def skip(self, stage, reason, box=None):
+        self.results.append({'stage': stage, 'box': box, 'skipped': reason})
+        print('%-24s box=%-5s skipped: %s' % (stage, box, reason))
+
+    def synthesize(self, name, cmd):
+        """ Workload generation is also timed, it exercises the phantom programs """
+        if not self.measure('synth_' + name, cmd, 0):
+            raise Exception('Cannot generate the workload, see %s' % self.fnLog)
+
+    def mpi(self, ranks, cmd):
+        return '%s %d %s' % (self.mpirun, ranks, cmd)
+
+    def writeReport(self):
+        with open(self.fnJson, 'w') as fh:
+            json.dump(self.report, fh, indent=2, sort_keys=True)
+
+    # Workloads -------------------------------------------------------------
+    def writeCTF(self, fnCTF, defocus):
+        with open(fnCTF, 'w') as fh:
+            fh.write('# XMIPP_STAR_1 *\n#\ndata_fullMicrograph\n'
+                     ' _ctfSamplingRate %f\n _ctfVoltage 300\n'
+                     ' _ctfDefocusU %f\n _ctfDefocusV %f\n _ctfDefocusAngle 45\n'
+                     ' _ctfSphericalAberration 2.7\n _ctfQ0 -0.1\n'
+                     % (self.Ts, defocus, defocus * 0.95))
+
+    def writeDescription(self, fnDescr, box, features):
+        """ Phantom description in the metadata format of Phantom::write,
+        the one required by phantom_project. Every feature is a tuple
+        (type, operation, density, center, specific parameters) """
+        with open(fnDescr, 'w') as fh:
+            fh.write('# XMIPP_STAR_1 *\n#\ndata_block1\n'
+                     ' _dimensions3D \'%d %d %d\'\n _phantomBGDensity 0\n _scale 1\n'
+                     % (box, box, box))
+            fh.write('data_block2\nloop_\n _featureType\n _featureOperation\n'
+                     ' _featureDensity\n _featureCenter\n _featureSpecificVector\n')
+            for featType, operation, density, center, specific in features:
+                fh.write('%s %s %f \'%s\' \'%s\'\n'
+                         % (featType, operation, density,
+                            ' '.join(['%f' % x for x in center]),
+                            ' '.join(['%f' % x for x in specific])))
+
+    def writePhantom(self, fnDescr, box):
+        """ A compact asymmetric particle made of ellipsoids and cylinders,
+        scaled with the box so that it always occupies the same fraction """
+        s = box / 64.0
+        self.writeDescription(fnDescr, box, [
+            ('ell', '+', 1, (0, 0, 0), (14 * s, 10 * s, 8 * s, 0, 0, 0)),
+            ('ell', '+', 1, (8 * s, 6 * s, 4 * s), (6 * s, 4 * s, 3 * s, 30, 60, 0)),
+            ('cyl', '+', 1, (-6 * s, 0, 2 * s), (2 * s, 2 * s, 12 * s, 0, 90, 0)),
+            ('sph', '-', 1, (-4 * s, 4 * s, 2 * s), (3 * s,)),
+            ('sph', '+', 2, (2 * s, -7 * s, 5 * s), (2 * s,))])
+
+    def writeMask(self, fnDescr, box):
+        self.writeDescription(fnDescr, box, [('sph', '=', 1, (0, 0, 0), (0.4 * box,))])
+
+    def writeProjectionParams(self, fnParams, fnAngles, box):
+        rnd = random.Random(self.seed)
+        with open(fnAngles, 'w') as fh:
+            fh.write('# XMIPP_STAR_1 *\n#\ndata_\nloop_\n'
+                     ' _angleRot\n _angleTilt\n _anglePsi\n')
+            for _ in range(self.Nimgs):
+                fh.write('%f %f %f\n' % (rnd.uniform(0, 360), rnd.uniform(0, 180),
+                                         rnd.uniform(0, 360)))
+        with open(fnParams, 'w') as fh:
+            fh.write('# XMIPP_STAR_1 *\n#\ndata_block1\n'
+                     '_dimensions2D \'%d %d\'\n_projAngleFile %s\n'
+                     '_noisePixelLevel \'0 0\'\n' % (box, box, fnAngles))
+
+    # Micrograph stages -----------------------------------------------------
+    def benchmarkMicrographs(self, stages):
+        d = os.path.join(self.odir, 'micrographs')
+        if not os.path.exists(d):
+            os.makedirs(d)
+        xdim, ydim, n = self.movieSize
+        fnMovie = os.path.join(d, 'movie.mrcs')
+        fnAvg = os.path.join(d, 'movie_aligned.mrc')
+        fnMic = os.path.join(d, 'micrograph.mrc')
+        fnCTF = os.path.join(d, 'micrograph.ctfparam')
+        self.synthesize('movie', 'xmipp_phantom_movie -size %d %d %d -step 50 50 -o %s'
+                        % (xdim, ydim, n, fnMovie))
+
+        cmd = ('xmipp_movie_alignment_correlation -i %s -o %s --sampling %f --max_shift 40 --oavg %s'
+               % (fnMovie, os.path.join(d, 'movie_shifts.xmd'), self.Ts, fnAvg))
+        if 'movie_alignment' in stages:
+            self.measure('movie_alignment', cmd, n)
+        if 'ctf' not in stages and 'picking' not in stages:
+            return
+        if not os.path.exists(fnAvg):
+            self.synthesize('movie_average', cmd)
+
+        # The grid of the movie is turned into a micrograph with CTF and noise
+        self.writeCTF(fnCTF, 20000)
+        self.synthesize('micrograph', 'xmipp_phantom_simulate_microscope -i %s -o %s --ctf %s --targetSNR 0.5'
+                        % (fnAvg, fnMic, fnCTF))
+        if 'ctf' in stages:
+            self.measure('ctf', 'xmipp_ctf_estimate_from_micrograph --micrograph %s --oroot %s '
+                         '--sampling_rate %f --voltage 300 --spherical_aberration 2.7 '
+                         '--pieceDim 256 --skipBorders 1 --defocusU 20000'
+                         % (fnMic, os.path.join(d, 'ctf_estimated'), self.Ts), 1)
+        if 'picking' in stages:
+            if not self.pickingModel:
+                self.skip('picking', 'no --pickingModel given')
+                return
+            for thr in self.threads:
+                self.measure('picking', 'xmipp_micrograph_automatic_picking -i %s --outputRoot %s '
+                             '--mode autoselect --model %s --particleSize %d --thr %d'
+                             % (fnMic, os.path.join(d, 'picking'), self.pickingModel,
+                                self.boxSizes[0], thr), 1, threads=thr)
+
+    # Particle and volume stages --------------------------------------------
+    def benchmarkBox(self, box):
+        particleStages = [s for s in ['cl2d', 'reconstruct_fourier',
+                                      'reconstruct_significant', 'monores']
+                          if s in self.stages]
+        if not particleStages:
+            return
+        d = os.path.join(self.odir, 'box%d' % box)
+        if not os.path.exists(d):
+            os.makedirs(d)
+        fnDescr = os.path.join(d, 'phantom.xmd')
+        fnVol = os.path.join(d, 'phantom.vol')
+        fnMaskDescr = os.path.join(d, 'mask.xmd')
+        fnMask = os.path.join(d, 'mask.vol')
+        fnParams = os.path.join(d, 'projection.param')
+        fnAngles = os.path.join(d, 'angles.xmd')
+        fnProj = os.path.join(d, 'projections.stk')
+        fnCTF = os.path.join(d, 'particles.ctfparam')
+        fnParticles = os.path.join(d, 'particles.stk')
+        fnParticlesMd = os.path.join(d, 'particles.xmd')
+        Nthr = max(self.threads)
+
+        self.writePhantom(fnDescr, box)
+        self.synthesize('volume_%d' % box, 'xmipp_phantom_create -i %s -o %s' % (fnDescr, fnVol))
+        self.writeProjectionParams(fnParams, fnAngles, box)
+        self.synthesize('projections_%d' % box, 'xmipp_phantom_project -i %s -o %s --params %s --thr %d'
+                        % (fnDescr, fnProj, fnParams, Nthr))
+        self.writeCTF(fnCTF, 15000)
+        self.synthesize('particles_%d' % box, 'xmipp_phantom_simulate_microscope -i %s -o %s '
+                        '--save_metadata_stack %s --keep_input_columns --ctf %s --targetSNR 0.3'
+                        % (fnProj.replace('.stk', '.xmd'), fnParticles, fnParticlesMd, fnCTF))
+
+        if 'cl2d' in self.stages:
+            for ranks in self.ranks:
+                self.measure('cl2d', self.mpi(ranks, 'xmipp_mpi_classify_CL2D -i %s --odir %s '
+                                              '--oroot class --iter 5 --nref0 2 --nref 8'
+                                              % (fnParticlesMd, os.path.join(d, 'cl2d_%d' % ranks))),
+                             self.Nimgs, box, ranks=ranks)
+                shutil.rmtree(os.path.join(d, 'cl2d_%d' % ranks), ignore_errors=True)
+
+        fnRec = os.path.join(d, 'reconstruction.vol')
+        if 'reconstruct_fourier' in self.stages:
+            for thr in self.threads:
+                self.measure('reconstruct_fourier', 'xmipp_reconstruct_fourier -i %s -o %s --thr %d'
+                             % (fnParticlesMd, fnRec, thr), self.Nimgs, box, threads=thr)
+            for ranks in self.ranks:
+                self.measure('reconstruct_fourier', self.mpi(ranks, 'xmipp_mpi_reconstruct_fourier '
+                                                             '-i %s -o %s --thr %d'
+                                                             % (fnParticlesMd, fnRec, Nthr)),
+                             self.Nimgs, box, threads=Nthr, ranks=ranks)
+
+        if 'reconstruct_significant' in self.stages:
+            fnInit = os.path.join(d, 'initial.xmd')
+            with open(fnInit, 'w') as fh:
+                fh.write('# XMIPP_STAR_1 *\n#\ndata_\nloop_\n _image\n%s\n' % fnVol)
+            fnDir = os.path.join(d, 'significant_serial')
+            if not os.path.exists(fnDir):
+                os.makedirs(fnDir)
+            self.measure('reconstruct_significant', 'xmipp_reconstruct_significant -i %s --odir %s '
+                         '--iter 1 --angularSampling 15 --initvolumes %s'
+                         % (fnParticlesMd, fnDir, fnInit), self.Nimgs, box)
+            for ranks in self.ranks:
+                fnDir = os.path.join(d, 'significant_%d' % ranks)
+                if not os.path.exists(fnDir):
+                    os.makedirs(fnDir)
+                self.measure('reconstruct_significant', self.mpi(ranks, 'xmipp_mpi_reconstruct_significant '
+                                                                 '-i %s --odir %s --iter 1 --angularSampling 15 '
+                                                                 '--initvolumes %s'
+                                                                 % (fnParticlesMd, fnDir, fnInit)),
+                             self.Nimgs, box, ranks=ranks)
+
+        if 'monores' in self.stages:
+            if not os.path.exists(fnRec):
+                self.synthesize('reconstruction_%d' % box, 'xmipp_reconstruct_fourier -i %s -o %s --thr %d'
+                                % (fnParticlesMd, fnRec, Nthr))
+            self.writeMask(fnMaskDescr, box)
+            self.synthesize('mask_%d' % box, 'xmipp_phantom_create -i %s -o %s' % (fnMaskDescr, fnMask))
+            for thr in self.threads:
+                self.measure('monores', 'xmipp_resolution_monogenic_signal --vol %s --mask %s --sym c1 '
+                             '--sampling_rate %f --minRes %f --maxRes %f --threads %d -o %s '
+                             '--chimera_volume %s'
+                             % (fnRec, fnMask, self.Ts, 30 * self.Ts, 2.5 * self.Ts, thr,
+                                os.path.join(d, 'monores.vol'), os.path.join(d, 'monores_chimera.vol')),
+                             1, box, threads=thr)
+
+
+if __name__ == '__main__':
+    ScriptBenchmark().tryRun()
@@ -0,0 +1,102 @@
+#include <core/multidim_array.h>
+#include <core/transformations.h>
+#include <data/bspline_interpolation.h>
+#include <iostream>
+#include <gtest/gtest.h>
+// MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
+class BSplineInterpolationTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        V.resize(12, 13, 14);
+        V.initRandom(0, 1);
+        V.setXmippOrigin();
+        produceSplineCoefficients(BSPLINE3, Vcoeffs, V);
+        Vcoeffs.setXmippOrigin();
+
+        // Points inside the volume and close to (or beyond) its borders
+        size_t N = 500;
+        x.resize(N);
+        y.resize(N);
+        z.resize(N);
+        for (size_t n = 0; n < N; ++n)
+        {
+            x[n] = rnd_unif(-9, 9);
+            y[n] = rnd_unif(-8, 8);
+            z[n] = rnd_unif(-8, 8);
+        }
+        x[0] = y[0] = z[0] = 0;
+        x[1] = 2; y[1] = -3; z[1] = 1;
+    }
+    MultidimArray<double> V, Vcoeffs;
+    std::vector<double> x, y, z;
+};
+
+TEST_F( BSplineInterpolationTest, cubic3D)
+{
+    size_t N = x.size();
+    std::vector<double> values(N);
+    interpolateBSpline3D<3>(Vcoeffs, N, &x[0], &y[0], &z[0], &values[0]);
+    for (size_t n = 0; n < N; ++n)
+        EXPECT_NEAR(values[n], Vcoeffs.interpolatedElementBSpline3D(x[n], y[n], z[n]), 1e-10);
+}
+
+TEST_F( BSplineInterpolationTest, cubic3DTwoVolumes)
+{
+    size_t N = x.size();
+    MultidimArray<double> Vcoeffs2 = Vcoeffs;
+    Vcoeffs2 *= -2;
+    std::vector<double> values1(N), values2(N);
+    interpolateBSpline3D<3>(Vcoeffs, Vcoeffs2, N, &x[0], &y[0], &z[0], &values1[0], &values2[0]);
+    for (size_t n = 0; n < N; ++n)
+        EXPECT_NEAR(values2[n], -2 * values1[n], 1e-10);
+}
+
+TEST_F( BSplineInterpolationTest, linear3D)
+{
+    size_t N = x.size();
+    std::vector<double> values(N);
+    interpolateBSpline3D<1>(V, N, &x[0], &y[0], &z[0], &values[0], BSPLINE_BOUNDARY_ZERO);
+    for (size_t n = 0; n < N; ++n)
+        EXPECT_NEAR(values[n], V.interpolatedElement3D(x[n], y[n], z[n]), 1e-10);
+}
+
+TEST_F( BSplineInterpolationTest, cubic2D)
+{
+    MultidimArray<double> I, Icoeffs;
+    I.resize(15, 16);
+    I.initRandom(0, 1);
+    I.setXmippOrigin();
+    produceSplineCoefficients(BSPLINE3, Icoeffs, I);
+    Icoeffs.setXmippOrigin();
+    size_t N = x.size();
+    std::vector<double> values(N);
+    interpolateBSpline2D<3>(Icoeffs, N, &x[0], &y[0], &values[0]);
+    for (size_t n = 0; n < N; ++n)
+        EXPECT_NEAR(values[n], Icoeffs.interpolatedElementBSpline2D(x[n], y[n]), 1e-10);
+}
+
+TEST_F( BSplineInterpolationTest, applyGeometry)
+{
+    Matrix2D<double> A;
+    rotation3DMatrix(23, 'Z', A);
+    MAT_ELEM(A, 0, 3) = 1.5;
+    MAT_ELEM(A, 2, 3) = -0.7;
+    MultidimArray<double> Vout, VoutBatch;
+    Vout.resize(V);
+    VoutBatch.resize(V);
+    for (int wrap = 0; wrap < 2; ++wrap)
+    {
+        applyGeometry(BSPLINE3, Vout, V, A, IS_NOT_INV, wrap == 1, 0.);
+        applyGeometryBSpline(VoutBatch, V, A, IS_NOT_INV, wrap == 1, 0.);
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(Vout)
+        EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(Vout, n), DIRECT_MULTIDIM_ELEM(VoutBatch, n), 1e-8);
+    }
+}
+
+GTEST_API_ int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
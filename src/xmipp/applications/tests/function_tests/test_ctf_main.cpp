@@ -5,6 +5,7 @@
 #include <data/transform_downsample.h>
 #include <gtest/gtest.h>
 #include <data/ctf.h>
+#include <data/ctf_image_cache.h>
 
 // MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
 // This test is named "Size", and belongs to the "MetadataTest"
@@ -143,6 +144,79 @@ TEST_F( CtfTest, errorMaxFreqCTFs2D)
     XMIPP_CATCH
 }
 
+TEST_F( CtfTest, ctfImageGenerator)
+{
+    XMIPP_TRY
+    CTFDescription ctf;
+    ctf.enable_CTF=true;
+    ctf.enable_CTFnoise=false;
+    ctf.Tm=1.5;
+    ctf.kV=300;
+    ctf.DeltafU=21000;
+    ctf.DeltafV=18500;
+    ctf.azimuthal_angle=37;
+    ctf.Cs=2.7;
+    ctf.Q0=0.1;
+    ctf.Ca=2;
+    ctf.espr=1;
+    ctf.ispr=1;
+    ctf.alpha=0.5;
+    ctf.DeltaR=3;
+    ctf.produceSideInfo();
+
+    CTFImageGenerator generator;
+    MultidimArray<double> expected, fast;
+    MultidimArray<float> fastFloat;
+    for (int damping=0; damping<2; ++damping)
+    {
+        // Odd sizes exercise the scalar tail of the vectorized loop
+        if (damping)
+            ctf.generateCTF(63, 70, expected);
+        else
+            ctf.generateCTFWithoutDamping(63, 70, expected);
+        generator.generateCTF(ctf, 63, 70, fast, -1, damping==1);
+        generator.generateCTF(ctf, 63, 70, fastFloat, -1, damping==1);
+        ASSERT_EQ(YSIZE(fast), (size_t)63);
+        ASSERT_EQ(XSIZE(fast), (size_t)70);
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(expected)
+        {
+            EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(fast,n), DIRECT_MULTIDIM_ELEM(expected,n), 1e-9);
+            EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(fastFloat,n), DIRECT_MULTIDIM_ELEM(expected,n), 1e-6);
+        }
+    }
+
+    // Images of the same micrograph come from the cache
+    CTFImageCache cache(2);
+    std::vector<CTFDescription> ctfs(4, ctf);
+    ctfs[2].DeltafU=15000;
+    ctfs[2].produceSideInfo();
+    MultidimArray<double> stack, Iaux;
+    cache.getCTFs(ctfs, 64, 64, stack);
+    EXPECT_EQ(cache.misses, (size_t)2);
+    EXPECT_EQ(cache.hits, (size_t)2);
+    for (size_t k=0; k<ctfs.size(); ++k)
+    {
+        ctfs[k].generateCTF(64, 64, expected);
+        Iaux.aliasImageInStack(stack, k);
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(expected)
+        EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(Iaux,n), DIRECT_MULTIDIM_ELEM(expected,n), 1e-9);
+    }
+
+    // The image depends on the side info, not on the defocus parameters
+    // (ctf_correct_wiener2d --isIsotropic changes the defocus)
+    CTFDescription isotropic=ctf;
+    isotropic.DeltafU=isotropic.DeltafV=0.5*(ctf.DeltafU+ctf.DeltafV);
+    cache.getCTF(isotropic, 64, 64, Iaux);
+    EXPECT_EQ(cache.misses, (size_t)2);
+    isotropic.produceSideInfo();
+    cache.getCTF(isotropic, 64, 64, Iaux);
+    EXPECT_EQ(cache.misses, (size_t)3);
+    isotropic.generateCTF(64, 64, expected);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(expected)
+    EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(Iaux,n), DIRECT_MULTIDIM_ELEM(expected,n), 1e-9);
+    XMIPP_CATCH
+}
+
 GTEST_API_ int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
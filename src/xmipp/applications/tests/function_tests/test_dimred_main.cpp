@@ -10,6 +10,7 @@
 #include <dimred/diffusionMaps.h>
 #include <dimred/probabilisticPCA.h>
 #include <dimred/laplacianEigenmaps.h>
+#include <classification/pca.h>
 #include <iostream>
 #include <stdlib.h>     /* getenv */
 #include <gtest/gtest.h>
@@ -89,6 +90,28 @@ TEST_F( DimRedTest, intrinsic_dimensionality)
 	EXPECT_NEAR(dimCorrDim, expectedDim, 5e-2);
 }
 
+// The sign of the eigenvectors is arbitrary. Make positive the largest
+// component of each column, the first one among those within 1% of the largest
+// (the helix is symmetric, so its largest components are tied). It is applied
+// to the output and to the reference, so the reference files keep any sign
+void normalizeColumnSigns(Matrix2D<double> &Y)
+{
+	for (size_t j=0; j<MAT_XSIZE(Y); ++j)
+	{
+		double maxAbs=0;
+		for (size_t i=0; i<MAT_YSIZE(Y); ++i)
+			maxAbs=XMIPP_MAX(maxAbs,fabs(MAT_ELEM(Y,i,j)));
+		for (size_t i=0; i<MAT_YSIZE(Y); ++i)
+			if (fabs(MAT_ELEM(Y,i,j))>=0.99*maxAbs)
+			{
+				if (MAT_ELEM(Y,i,j)<0)
+					for (size_t ii=0; ii<MAT_YSIZE(Y); ++ii)
+						MAT_ELEM(Y,ii,j)*=-1;
+				break;
+			}
+	}
+}
+
 #define INCOMPLETE_TEST(method,DimredClass,dataset,Npoints,file) \
 	TEST_F( DimRedTest, method) \
 { \
@@ -120,11 +143,13 @@ TEST_F( DimRedTest, intrinsic_dimensionality)
 	dimred.setOutputDimensionality(2); \
 	dimred.setSpecificParameters(); \
 	dimred.reduceDimensionality(); \
-	const Matrix2D<double> &Y=dimred.getReducedData();\
+	Matrix2D<double> Y=dimred.getReducedData();\
+	normalizeColumnSigns(Y); \
 	/* Y.write(file); */ \
 	Matrix2D<double> expectedY; \
 	expectedY.resizeNoCopy(Y); \
 	expectedY.read(file); \
+	normalizeColumnSigns(expectedY); \
 	ASSERT_TRUE(expectedY.equalAbs(Y,1e-4));\
 }
 
@@ -161,6 +186,190 @@ TEST_F( DimRedTest, nca)
 	ASSERT_TRUE(expectedY.equal(Y,1e-4));
 }
 
+// Samples of a 3D subspace of R^50 with decreasing variance along each direction
+class LowRankSource: public PCASampleSource
+{
+public:
+	Matrix2D<double> basis;
+	size_t getSampleDimension() { return 50; }
+	size_t getNumberOfItems() { return 200; }
+	void getSamples(size_t item, int thread, Matrix2D<double> &samples)
+	{
+		// The signs of the coefficients are the bits of the sample number,
+		// so that they are uncorrelated and the covariance is diag(9,4,1)
+		samples.initZeros(2,50);
+		for (size_t r=0; r<2; r++)
+			for (size_t k=0; k<3; k++)
+			{
+				size_t n=2*item+r;
+				double c=(3.0-k)*(((n>>k)&1) ? 1.0 : -1.0);
+				for (size_t i=0; i<50; i++)
+					MAT_ELEM(samples,r,i)+=c*MAT_ELEM(basis,i,k);
+			}
+		for (size_t r=0; r<2; r++)
+			for (size_t i=0; i<50; i++)
+				MAT_ELEM(samples,r,i)+=1.0;
+	}
+};
+
+TEST_F( DimRedTest, streaming_pca)
+{
+	LowRankSource source;
+	source.basis.initZeros(50,3);
+	for (size_t i=0; i<50; i++)
+	{
+		MAT_ELEM(source.basis,i,0)=(i<25) ? 1/5.0 : 0.0;
+		MAT_ELEM(source.basis,i,1)=(i<25) ? 0.0 : 1/5.0;
+		MAT_ELEM(source.basis,i,2)=((i%2)==0 ? 1.0 : -1.0)/sqrt(50.0);
+	}
+	for (int Nthreads=1; Nthreads<=3; Nthreads+=2)
+	{
+		StreamingPCA pca(2);
+		pca.Nthreads=Nthreads;
+		pca.learn(source);
+		ASSERT_EQ(pca.N,400);
+		ASSERT_GT(VEC_ELEM(pca.eigenvalues,0),VEC_ELEM(pca.eigenvalues,1));
+		for (int k=0; k<2; k++)
+		{
+			double dot=0;
+			for (size_t i=0; i<50; i++)
+				dot+=MAT_ELEM(pca.eigenvectors,i,k)*MAT_ELEM(source.basis,i,k);
+			ASSERT_NEAR(fabs(dot),1,1e-3);
+		}
+	}
+}
+
+TEST_F( DimRedTest, lanczos_eigs)
+{
+	// Laplacian of a path graph, its eigenvalues are 2-2*cos(pi*k/N)
+	const int N=200;
+	std::vector<SparseElement> elements;
+	SparseElement e;
+	for (int i=0; i<N; i++)
+	{
+		e.i=e.j=i;
+		e.value=(i==0 || i==N-1) ? 1 : 2;
+		elements.push_back(e);
+		if (i>0)
+		{
+			e.j=i-1;
+			e.value=-1;
+			elements.push_back(e);
+			e.i=i-1;
+			e.j=i;
+			elements.push_back(e);
+		}
+	}
+	SparseMatrix2D L;
+	sparseMatrixFromElements(elements,N,L);
+
+	Matrix1D<double> D, Lp(N);
+	Matrix2D<double> P;
+	for (int Nthreads=1; Nthreads<=3; Nthreads+=2)
+	{
+		SparseSymmetricOperator op(L,Nthreads);
+		lanczosEigs(op,1,3,D,P);
+		ASSERT_EQ(VEC_XSIZE(D),3);
+		for (int k=0; k<3; k++)
+		{
+			EXPECT_NEAR(VEC_ELEM(D,k),2-2*cos(PI*(k+1)/N),1e-10);
+			// Check that it is an eigenvector
+			Matrix1D<double> p;
+			P.getCol(k,p);
+			op.multiply(MATRIX1D_ARRAY(p),MATRIX1D_ARRAY(Lp));
+			EXPECT_NEAR(p.module(),1,1e-10);
+			for (int i=0; i<N; i++)
+				EXPECT_NEAR(VEC_ELEM(Lp,i),VEC_ELEM(D,k)*VEC_ELEM(p,i),1e-8);
+		}
+
+		lanczosEigs(op,0,1,D,P,true);
+		EXPECT_NEAR(VEC_ELEM(D,0),2-2*cos(PI*(N-1)/N),1e-10);
+		EXPECT_NEAR(VEC_ELEM(D,1),2-2*cos(PI*(N-2)/N),1e-10);
+	}
+}
+
+TEST_F( DimRedTest, lanczos_eigs_repeated)
+{
+	// Laplacian of 3 disconnected path graphs, all its eigenvalues are triple
+	const int Npath=50, Ncomponents=3, N=Npath*Ncomponents;
+	std::vector<SparseElement> elements;
+	SparseElement e;
+	for (int c=0; c<Ncomponents; c++)
+		for (int i=c*Npath; i<(c+1)*Npath; i++)
+		{
+			e.i=e.j=i;
+			e.value=(i==c*Npath || i==(c+1)*Npath-1) ? 1 : 2;
+			elements.push_back(e);
+			if (i>c*Npath)
+			{
+				e.j=i-1;
+				e.value=-1;
+				elements.push_back(e);
+				e.i=i-1;
+				e.j=i;
+				elements.push_back(e);
+			}
+		}
+	SparseMatrix2D L;
+	sparseMatrixFromElements(elements,N,L);
+
+	Matrix1D<double> D, Lp(N);
+	Matrix2D<double> P;
+	SparseSymmetricOperator op(L);
+	lanczosEigs(op,0,5,D,P);
+	ASSERT_EQ(VEC_XSIZE(D),6);
+	for (int k=0; k<6; k++)
+	{
+		EXPECT_NEAR(VEC_ELEM(D,k),2-2*cos(PI*(k/Ncomponents)/Npath),1e-10);
+		Matrix1D<double> p;
+		P.getCol(k,p);
+		op.multiply(MATRIX1D_ARRAY(p),MATRIX1D_ARRAY(Lp));
+		for (int i=0; i<N; i++)
+			EXPECT_NEAR(VEC_ELEM(Lp,i),VEC_ELEM(D,k)*VEC_ELEM(p,i),1e-8);
+		// The eigenvectors of the same eigenvalue are orthonormal
+		for (int k2=0; k2<=k; k2++)
+		{
+			Matrix1D<double> p2;
+			P.getCol(k2,p2);
+			EXPECT_NEAR(dotProduct(p,p2),k==k2 ? 1:0,1e-10);
+		}
+	}
+}
+
+TEST_F( DimRedTest, sparse_XtAX)
+{
+	// NPE and LPP compute X^t*A*X with the observations in the rows of X
+	const int N=30, dim=3;
+	Matrix2D<double> X, Adense(N,N);
+	X.initRandom(N,dim,0,1,RND_GAUSSIAN);
+	std::vector<SparseElement> elements;
+	SparseElement e;
+	for (int i=0; i<N; i++)
+		for (int j=i; j<N; j+=7)
+		{
+			e.i=i;
+			e.j=j;
+			e.value=1.0+i+0.5*j;
+			MAT_ELEM(Adense,i,j)=MAT_ELEM(Adense,j,i)=e.value;
+			elements.push_back(e);
+			if (j!=i)
+			{
+				e.i=j;
+				e.j=i;
+				elements.push_back(e);
+			}
+		}
+	SparseMatrix2D A;
+	sparseMatrixFromElements(elements,N,A);
+
+	Matrix2D<double> XtAX, expectedXtAX;
+	sparseMatrixOperation_XtAX(X,A,XtAX);
+	matrixOperation_XtAX_symmetric(X,Adense,expectedXtAX);
+	ASSERT_EQ(MAT_YSIZE(XtAX),dim);
+	ASSERT_EQ(MAT_XSIZE(XtAX),dim);
+	ASSERT_TRUE(expectedXtAX.equal(XtAX,1e-10));
+}
+
 GTEST_API_ int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
@@ -1,5 +1,7 @@
 #include <core/xmipp_image.h>
 #include <data/filters.h>
+#include <data/local_statistics.h>
+#include <data/connected_components.h>
 #include <core/xmipp_fftw.h>
 #include <iostream>
 #include <gtest/gtest.h>
@@ -170,6 +172,191 @@ TEST_F( FiltersTest, alignImages)
 
     fileTemp.deleteFile();
 }
+TEST_F( FiltersTest, alignImagesToReferences)
+{
+    Image<double> I;
+    I.read("filters/test2.spi");
+    I().setXmippOrigin();
+
+    // References: rotated and shifted versions of the image
+    size_t Nrefs=4;
+    MultidimArray<double> Irefs(Nrefs, 1, YSIZE(I()), XSIZE(I())), Iref, Iaux;
+    Matrix2D<double> A;
+    for (size_t n=0; n<Nrefs; ++n)
+    {
+        rotation2DMatrix(20.0*n-10,A,true);
+        MAT_ELEM(A,0,2)=n-1.5;
+        MAT_ELEM(A,1,2)=3-2.0*n;
+        applyGeometry(BSPLINE3, Iaux, I(), A, IS_NOT_INV, DONT_WRAP);
+        Iref.aliasImageInStack(Irefs, n);
+        Iref=Iaux;
+    }
+
+    AlignmentAux aux;
+    CorrelationAux aux2;
+    RotationalCorrelationAux aux3;
+    std::vector<AlignmentTransforms> IrefsTransforms(Nrefs);
+    for (size_t n=0; n<Nrefs; ++n)
+    {
+        Iref.aliasImageInStack(Irefs, n);
+        Iref.setXmippOrigin();
+        aux2.transformer1.FourierTransform(Iref, IrefsTransforms[n].FFTI, true);
+        polarFourierTransform<true>(Iref, IrefsTransforms[n].polarFourierI, false,
+                                    XSIZE(Iref) / 5, XSIZE(Iref) / 2, aux.plans, 1);
+    }
+
+    for (int mirrors=0; mirrors<2; ++mirrors)
+    {
+        MultidimArray<double> Ialigned;
+        std::vector< Matrix2D<double> > M;
+        std::vector<double> corr;
+        alignImagesToReferences(Irefs, &IrefsTransforms[0], I(), Ialigned, M, corr,
+                                aux, aux2, aux3, DONT_WRAP, mirrors==1);
+        ASSERT_EQ(NSIZE(Ialigned), Nrefs);
+        for (size_t n=0; n<Nrefs; ++n)
+        {
+            Iref.aliasImageInStack(Irefs, n);
+            Iref.setXmippOrigin();
+            MultidimArray<double> Iexpected=I();
+            Matrix2D<double> Mexpected;
+            double corrExpected;
+            if (mirrors==1)
+                corrExpected=alignImagesConsideringMirrors(Iref, IrefsTransforms[n], Iexpected, Mexpected,
+                                                           aux, aux2, aux3, DONT_WRAP);
+            else
+                corrExpected=alignImages(Iref, Iexpected, Mexpected, DONT_WRAP);
+            EXPECT_NEAR(corr[n], corrExpected, 1e-10);
+            for (int i=0; i<3; ++i)
+                for (int j=0; j<3; ++j)
+                    EXPECT_NEAR(MAT_ELEM(M[n],i,j), MAT_ELEM(Mexpected,i,j), 1e-8);
+            Iaux.aliasImageInStack(Ialigned, n);
+            FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(Iaux)
+            EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(Iaux,n), DIRECT_MULTIDIM_ELEM(Iexpected,n), 1e-8);
+        }
+    }
+}
+TEST_F( FiltersTest, localStatistics)
+{
+    MultidimArray<double> I(37, 45), window;
+    I.initRandom(-1, 5);
+    I.setXmippOrigin();
+    LocalStatistics stats;
+    stats.compute(I);
+
+    // Windows partially outside the image
+    for (int n=0; n<200; ++n)
+    {
+        int y0=(int)rnd_unif(STARTINGY(I)-5, FINISHINGY(I));
+        int x0=(int)rnd_unif(STARTINGX(I)-5, FINISHINGX(I));
+        int yF=y0+(int)rnd_unif(0, 12);
+        int xF=x0+(int)rnd_unif(0, 12);
+        I.window(window, y0, x0, yF, xF);
+        double avg, stddev, minVal, maxVal, avgFast, stddevFast;
+        window.computeStats(avg, stddev, minVal, maxVal);
+        stats.windowStats(y0, x0, yF, xF, avgFast, stddevFast, true);
+        EXPECT_NEAR(avgFast, avg, 1e-10);
+        EXPECT_NEAR(stddevFast, stddev, 1e-8);
+
+        double sum=0, N=0;
+        for (int i=XMIPP_MAX(y0,STARTINGY(I)); i<=XMIPP_MIN(yF,FINISHINGY(I)); ++i)
+            for (int j=XMIPP_MAX(x0,STARTINGX(I)); j<=XMIPP_MIN(xF,FINISHINGX(I)); ++j)
+            {
+                sum+=A2D_ELEM(I,i,j);
+                N++;
+            }
+        if (N>0)
+            EXPECT_NEAR(stats.windowMean(y0, x0, yF, xF), sum/N, 1e-10);
+    }
+
+    MultidimArray<double> minI, maxI;
+    localMinMax(I, 2, 3, minI, maxI);
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(I)
+    {
+        double minVal=1e30, maxVal=-1e30;
+        for (int ii=XMIPP_MAX(i-2,STARTINGY(I)); ii<=XMIPP_MIN(i+2,FINISHINGY(I)); ++ii)
+            for (int jj=XMIPP_MAX(j-3,STARTINGX(I)); jj<=XMIPP_MIN(j+3,FINISHINGX(I)); ++jj)
+            {
+                minVal=XMIPP_MIN(minVal,A2D_ELEM(I,ii,jj));
+                maxVal=XMIPP_MAX(maxVal,A2D_ELEM(I,ii,jj));
+            }
+        EXPECT_DOUBLE_EQ(A2D_ELEM(minI,i,j), minVal);
+        EXPECT_DOUBLE_EQ(A2D_ELEM(maxI,i,j), maxVal);
+    }
+}
+TEST_F( FiltersTest, connectedComponents)
+{
+    // Labelling by region growing, as labelImage2D did
+    MultidimArray<double> I(41, 53), label, labelRef;
+    I.initRandom(0, 1);
+    I.binarize(0.45);
+    I.setXmippOrigin();
+    labelRef = I;
+    int Nref = 0;
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(labelRef)
+    if (A2D_ELEM(labelRef, i, j) == 1)
+    {
+        regionGrowing2D(labelRef, labelRef, i, j, 0, 32000 + Nref, false, 8);
+        Nref++;
+    }
+    FOR_ALL_ELEMENTS_IN_ARRAY2D(labelRef)
+    if (A2D_ELEM(labelRef, i, j) != 0)
+        A2D_ELEM(labelRef, i, j) -= 31999;
+    for (int nThreads=1; nThreads<=4; nThreads+=3)
+    {
+        EXPECT_EQ(labelConnectedComponents(I, label, 8, nThreads), Nref);
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(I)
+        EXPECT_DOUBLE_EQ(DIRECT_MULTIDIM_ELEM(label, n), DIRECT_MULTIDIM_ELEM(labelRef, n));
+    }
+
+    // Two components touching only through a corner
+    MultidimArray<double> V;
+    V.initZeros(6, 7, 8);
+    A3D_ELEM(V, 1, 1, 1) = A3D_ELEM(V, 1, 2, 1) = 1;
+    A3D_ELEM(V, 2, 3, 2) = A3D_ELEM(V, 3, 3, 2) = 1;
+    EXPECT_EQ(labelConnectedComponents(V, label, 26, 3), 1);
+    EXPECT_EQ(labelConnectedComponents(V, label, 18, 3), 2);
+    EXPECT_DOUBLE_EQ(A3D_ELEM(label, 3, 3, 2), 2);
+
+    // Distance transforms against brute force
+    MultidimArray<int> mask(9, 13, 11), maskImg(23, 17), distL1;
+    MultidimArray<double> distEuclidean;
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(mask)
+    DIRECT_MULTIDIM_ELEM(mask, n) = rnd_unif() < 0.03;
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(maskImg)
+    DIRECT_MULTIDIM_ELEM(maskImg, n) = rnd_unif() < 0.03;
+    distanceTransformEuclidean(mask, distEuclidean, 2);
+    FOR_ALL_ELEMENTS_IN_ARRAY3D(mask)
+    {
+        double best = XSIZE(mask) + YSIZE(mask) + ZSIZE(mask);
+        for (int kk=0; kk<(int)ZSIZE(mask); ++kk)
+            for (int ii=0; ii<(int)YSIZE(mask); ++ii)
+                for (int jj=0; jj<(int)XSIZE(mask); ++jj)
+                    if (A3D_ELEM(mask, kk, ii, jj))
+                        best = XMIPP_MIN(best, sqrt((double)((k-kk)*(k-kk)+(i-ii)*(i-ii)+(j-jj)*(j-jj))));
+        EXPECT_NEAR(A3D_ELEM(distEuclidean, k, i, j), best, 1e-10);
+    }
+    for (int wrap=0; wrap<2; ++wrap)
+    {
+        distanceTransform(maskImg, distL1, wrap, 2);
+        FOR_ALL_ELEMENTS_IN_ARRAY2D(maskImg)
+        {
+            int best = XSIZE(maskImg) + YSIZE(maskImg);
+            for (int ii=0; ii<(int)YSIZE(maskImg); ++ii)
+                for (int jj=0; jj<(int)XSIZE(maskImg); ++jj)
+                    if (A2D_ELEM(maskImg, ii, jj))
+                    {
+                        int di = ABS(i-ii), dj = ABS(j-jj);
+                        if (wrap)
+                        {
+                            di = XMIPP_MIN(di, (int)YSIZE(maskImg)-di);
+                            dj = XMIPP_MIN(dj, (int)XSIZE(maskImg)-dj);
+                        }
+                        best = XMIPP_MIN(best, di+dj);
+                    }
+            EXPECT_EQ(A2D_ELEM(distL1, i, j), best);
+        }
+    }
+}
 TEST_F( FiltersTest, regionGrowing3DEqualValue)
 {
     Image<double> img;
@@ -0,0 +1,106 @@
+#include <data/fourier_shift.h>
+#include <core/transformations.h>
+#include <core/xmipp_fftw.h>
+#include <core/matrix1d.h>
+#include <data/filters.h>
+#include <iostream>
+#include <gtest/gtest.h>
+// MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
+class FourierShiftTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Odd sizes have no Nyquist frequency, so subpixel shifts are invertible
+        I.initZeros(15,17);
+        I.initRandom(0,1);
+        I.setXmippOrigin();
+    }
+
+    MultidimArray<double> I;
+};
+
+TEST_F( FourierShiftTest, integerShift)
+{
+    FourierShifter shifter;
+    FourierTransformer transformer;
+    MultidimArray<double> Iout;
+    shifter.shift(I,Iout,3,-2,transformer);
+    double maxError=0;
+    for (int i=0; i<(int)YSIZE(I); ++i)
+        for (int j=0; j<(int)XSIZE(I); ++j)
+        {
+            int i0=intWRAP(i+2,0,(int)YSIZE(I)-1);
+            int j0=intWRAP(j-3,0,(int)XSIZE(I)-1);
+            maxError=XMIPP_MAX(maxError,fabs(DIRECT_A2D_ELEM(Iout,i,j)-DIRECT_A2D_ELEM(I,i0,j0)));
+        }
+    EXPECT_NEAR(0,maxError,1e-10);
+}
+
+TEST_F( FourierShiftTest, subpixelShift)
+{
+    FourierShifter shifter;
+    FourierTransformer transformer;
+    MultidimArray<double> Iout, Iback;
+    shifter.shift(I,Iout,1.3,-0.6,transformer);
+    shifter.shift(Iout,Iback,-1.3,0.6,transformer);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(I)
+    EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(I,n),DIRECT_MULTIDIM_ELEM(Iback,n),1e-10);
+}
+
+TEST_F( FourierShiftTest, correlation)
+{
+    MultidimArray<double> I2(I), Iaux;
+    Iaux.initZeros(I);
+    Iaux.initRandom(0,0.5);
+    I2+=Iaux;
+
+    MultidimArray< std::complex<double> > F1, F2;
+    FourierTransformer transformer1, transformer2;
+    transformer1.FourierTransform(I,F1,true);
+    transformer2.FourierTransform(I2,F2,true);
+
+    // The linear interpolation of an integer shift is exact
+    FourierShifter shifter;
+    shifter.initialize(YSIZE(I),XSIZE(I));
+    shifter.setShift(2,-4);
+    MultidimArray<double> I2t;
+    translate(LINEAR,I2t,I2,vectorR2(2,-4),WRAP);
+    EXPECT_NEAR(correlationIndex(I,I2t),shifter.correlationIndex(F1,F2),1e-6);
+
+    // Subpixel shifts are compared with the shifted image
+    shifter.setShift(0.4,1.7);
+    FourierTransformer transformer;
+    shifter.shift(I2,I2t,0.4,1.7,transformer);
+    EXPECT_NEAR(correlationIndex(I,I2t),shifter.correlationIndex(F1,F2),1e-6);
+}
+
+TEST_F( FourierShiftTest, stack)
+{
+    MultidimArray<double> stack(3,1,YSIZE(I),XSIZE(I));
+    Matrix2D<double> shifts(3,2);
+    MAT_ELEM(shifts,0,0)=3;   MAT_ELEM(shifts,0,1)=-2;
+    MAT_ELEM(shifts,1,0)=1.3; MAT_ELEM(shifts,1,1)=0.7;
+    MAT_ELEM(shifts,2,0)=0;   MAT_ELEM(shifts,2,1)=0;
+    size_t imageSize=YXSIZE(I);
+    for (size_t n=0; n<3; ++n)
+        memcpy(MULTIDIM_ARRAY(stack)+n*imageSize,MULTIDIM_ARRAY(I),imageSize*sizeof(double));
+    fourierShiftStack(stack,shifts,2);
+
+    FourierShifter shifter;
+    FourierTransformer transformer;
+    MultidimArray<double> Iout;
+    for (size_t n=0; n<3; ++n)
+    {
+        shifter.shift(I,Iout,MAT_ELEM(shifts,n,0),MAT_ELEM(shifts,n,1),transformer);
+        const double *ptr=MULTIDIM_ARRAY(stack)+n*imageSize;
+        for (size_t k=0; k<imageSize; ++k)
+            EXPECT_NEAR(DIRECT_MULTIDIM_ELEM(Iout,k),ptr[k],1e-10);
+    }
+}
+
+GTEST_API_ int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -3,6 +3,7 @@
 #include <gtest/gtest.h>
 #include <core/geometry.h>
 #include <data/normalize.h>
+#include <reconstruction/frm_rotational_search.h>
 
 // MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
 class GeometryTest : public ::testing::Test
@@ -168,6 +169,64 @@ TEST_F( GeometryTest, normalize_ramp)
     XMIPP_CATCH
 }
 
+TEST_F( GeometryTest, frmRotationalSearch)
+{
+    XMIPP_TRY
+    // Anisotropic reference made of Gaussian blobs and a shifted particle
+    // such that particle(x) = reference(E (x-s))
+    const int Xdim=32;
+    double centers[5][3]={{4,-3,2},{-5,1,-2},{2,6,-4},{-1,-5,5},{6,2,6}};
+    Matrix2D<double> E;
+    Euler_angles2matrix(30,50,-70,E);
+    Matrix1D<double> r(3), Er(3), s=vectorR3(2.,-1.,3.);
+    MultidimArray<double> reference, particle;
+    reference.initZeros(Xdim,Xdim,Xdim);
+    particle.initZeros(Xdim,Xdim,Xdim);
+    reference.setXmippOrigin();
+    particle.setXmippOrigin();
+    FOR_ALL_ELEMENTS_IN_ARRAY3D(reference)
+    {
+        VECTOR_R3(r,j,i,k);
+        Er=E*(r-s);
+        for (int n=0; n<5; n++)
+        {
+            double d2r=0, d2p=0;
+            for (int c=0; c<3; c++)
+            {
+                double w=(c==0) ? 1:0.5;
+                d2r+=w*(r(c)-centers[n][c])*(r(c)-centers[n][c]);
+                d2p+=w*(Er(c)-centers[n][c])*(Er(c)-centers[n][c]);
+            }
+            A3D_ELEM(reference,k,i,j)+=(n+1)*exp(-d2r/4);
+            A3D_ELEM(particle,k,i,j)+=(n+1)*exp(-d2p/4);
+        }
+    }
+
+    FRMRotationalSearch frm;
+    frm.setup(Xdim,0.4);
+    FRMReference frmRef;
+    frm.computeReference(reference,frmRef);
+
+    // Without and with a missing wedge of +-60 degrees around Y
+    std::vector<FRMRotation> rotations;
+    MultidimArray<double> measured(Xdim,Xdim,Xdim/2+1);
+    FOR_ALL_ELEMENTS_IN_ARRAY3D(measured)
+    {
+        int fz=(k<Xdim/2) ? k:k-Xdim;
+        A3D_ELEM(measured,k,i,j)=(ABS(fz)<=j*tan(DEG2RAD(60))) ? 1:0;
+    }
+    for (int withWedge=0; withWedge<2; withWedge++)
+    {
+        frm.search(frmRef,particle,withWedge ? &measured:NULL,3,rotations);
+        ASSERT_FALSE(rotations.empty());
+        Matrix2D<double> Efound;
+        Euler_angles2matrix(rotations[0].rot,rotations[0].tilt,rotations[0].psi,Efound);
+        EXPECT_LT(FRMRotationalSearch::rotationDistance(Efound,E),8);
+        EXPECT_GT(rotations[0].score,0.9);
+    }
+    XMIPP_CATCH
+}
+
 GTEST_API_ int main(int argc, char **argv)
 {
     testing::InitGoogleTest(&argc, argv);
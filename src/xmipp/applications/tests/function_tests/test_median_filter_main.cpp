@@ -0,0 +1,183 @@
+#include <data/median_filter.h>
+#include <data/filters.h>
+#include <algorithm>
+#include <iostream>
+#include <gtest/gtest.h>
+// MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
+class MedianFilterTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Odd width so that the last pixels of each row are not a full SIMD register
+        I.initZeros(37,45);
+        I.initRandom(0,100);
+        I.setXmippOrigin();
+    }
+
+    // Median of the window of size (2*r+1)x(2*r+1) centered at (i,j)
+    template <typename T>
+    T bruteForceMedian(const MultidimArray<T> &m, size_t i, size_t j, int r)
+    {
+        std::vector<T> v;
+        for (int ii=-r; ii<=r; ii++)
+            for (int jj=-r; jj<=r; jj++)
+                v.push_back(DIRECT_A2D_ELEM(m,i+ii,j+jj));
+        std::nth_element(v.begin(),v.begin()+v.size()/2,v.end());
+        return v[v.size()/2];
+    }
+
+    template <typename T>
+    void checkMedian(const MultidimArray<T> &m, const MultidimArray<T> &out, int r)
+    {
+        EXPECT_EQ(STARTINGX(m),STARTINGX(out));
+        EXPECT_EQ(STARTINGY(m),STARTINGY(out));
+        for (size_t i=0; i<YSIZE(m); i++)
+            for (size_t j=0; j<XSIZE(m); j++)
+            {
+                T expected=0;
+                if (i>=(size_t)r && j>=(size_t)r && i+r<YSIZE(m) && j+r<XSIZE(m))
+                    expected=bruteForceMedian(m,i,j,r);
+                ASSERT_EQ(expected,DIRECT_A2D_ELEM(out,i,j));
+            }
+    }
+
+    // boundMedianFilter as it was before the vectorized filters
+    template <typename T>
+    void baselineBoundMedianFilter(MultidimArray< T > &V, MultidimArray<char> &mask)
+    {
+        bool badRemaining;
+        T neighbours[125];
+        T aux;
+        int N = 0, index;
+
+        do
+        {
+            badRemaining=false;
+
+            FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY3D(V)
+            if (DIRECT_A3D_ELEM(mask, k, i, j) != 0)
+            {
+                N = 0;
+                for (int kk=-2; kk<=2; kk++)
+                {
+                    size_t kkk=k+kk;
+                    if (kkk<0 || kkk>=ZSIZE(V))
+                        continue;
+                    for (int ii=-2; ii<=2; ii++)
+                    {
+                        size_t iii=i+ii;
+                        if (iii<0 || iii>=YSIZE(V))
+                            continue;
+                        for (int jj=-2; jj<=2; jj++)
+                        {
+                            size_t jjj=j+jj;
+                            if (jjj<0 || jjj>=XSIZE(V))
+                                continue;
+
+                            if (DIRECT_A3D_ELEM(mask, kkk, iii, jjj) == 0)
+                            {
+                                index = N++;
+                                neighbours[index] = DIRECT_A3D_ELEM(V, kkk,iii,jjj);
+                                //insertion sort
+                                while (index > 0 && neighbours[index-1] > neighbours[index])
+                                {
+                                    SWAP(neighbours[index-1], neighbours[index], aux);
+                                    --index;
+                                }
+                            }
+                        }
+                    }
+                    if (N == 0)
+                        badRemaining = true;
+                    else
+                    {
+                        if (N % 2 == 0)
+                            DIRECT_A3D_ELEM(V, k, i, j) = (T)(0.5*(neighbours[N/2-1]+ neighbours[N/2]));
+                        else
+                            DIRECT_A3D_ELEM(V, k, i, j) = neighbours[N/2];
+                        DIRECT_A3D_ELEM(mask, k, i, j) = false;
+                    }
+                }
+            }
+        }
+        while (badRemaining);
+    }
+
+    MultidimArray<double> I;
+};
+
+TEST_F( MedianFilterTest, median3x3)
+{
+    MultidimArray<double> out;
+    fastMedianFilter3x3(I,out,3);
+    checkMedian(I,out,1);
+    medianFilter3x3(I,out);
+    checkMedian(I,out,1);
+
+    MultidimArray<unsigned char> Iuchar, outUchar;
+    typeCast(I,Iuchar);
+    fastMedianFilter3x3(Iuchar,outUchar,2);
+    checkMedian(Iuchar,outUchar,1);
+}
+
+TEST_F( MedianFilterTest, median5x5)
+{
+    MultidimArray<double> out;
+    fastMedianFilter5x5(I,out,4);
+    checkMedian(I,out,2);
+
+    MultidimArray<float> Ifloat, outFloat;
+    typeCast(I,Ifloat);
+    fastMedianFilter5x5(Ifloat,outFloat);
+    checkMedian(Ifloat,outFloat,2);
+}
+
+TEST_F( MedianFilterTest, badPixels)
+{
+    // Isolated hot pixels and a cluster of dead pixels
+    MultidimArray<double> V(I);
+    for (size_t n=0; n<MULTIDIM_SIZE(V); n+=29)
+        DIRECT_MULTIDIM_ELEM(V,n)=1000;
+    for (size_t i=10; i<15; i++)
+        for (size_t j=20; j<26; j++)
+            DIRECT_A2D_ELEM(V,i,j)=-1000;
+
+    // Raster scan of all the pixels
+    MultidimArray<double> Vref(V);
+    double avg, stddev, dummy;
+    Vref.computeStats(avg,stddev,dummy,dummy);
+    MultidimArray<char> mask(YSIZE(V),XSIZE(V));
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(Vref)
+    {
+        double x=DIRECT_MULTIDIM_ELEM(Vref,n);
+        DIRECT_MULTIDIM_ELEM(mask,n)=(x<avg-2*stddev || x>avg+2*stddev);
+    }
+    MultidimArray<char> maskCopy(mask);
+    baselineBoundMedianFilter(Vref,mask);
+
+    // The same pixels given by a mask
+    MultidimArray<double> Vmask(V);
+    boundMedianFilter(Vmask,maskCopy,0,3);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(Vmask)
+    ASSERT_EQ(DIRECT_MULTIDIM_ELEM(Vref,n),DIRECT_MULTIDIM_ELEM(Vmask,n));
+
+    fastPixelDesvFilter(V,2,3);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(V)
+    ASSERT_EQ(DIRECT_MULTIDIM_ELEM(Vref,n),DIRECT_MULTIDIM_ELEM(V,n));
+    EXPECT_LT(V.computeMax(),100.0);
+    EXPECT_GE(V.computeMin(),0.0);
+
+    // Negative values
+    V=I;
+    DIRECT_A2D_ELEM(V,5,5)=-1;
+    DIRECT_A2D_ELEM(V,5,6)=0;
+    forcePositive(V);
+    EXPECT_GT(V.computeMin(),0.0);
+}
+
+GTEST_API_ int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,93 @@
+#include <core/xmipp_image.h>
+#include <data/micrograph_reader.h>
+#include <iostream>
+#include <gtest/gtest.h>
+// MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
+class MicrographReaderTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        fnMic.initUniqueName("/tmp/micrograph_reader_XXXXXX");
+        fnMic = fnMic + ".mrc";
+        I().resize(70, 90);
+        I().initRandom(0, 1);
+        I.write(fnMic);
+    }
+
+    virtual void TearDown()
+    {
+        fnMic.deleteFile();
+    }
+
+    // Expected value of a window pixel
+    double expected(int y, int x, bool fillBorders)
+    {
+        if (y < 0 || y >= (int)YSIZE(I()) || x < 0 || x >= (int)XSIZE(I()))
+        {
+            if (!fillBorders)
+                return 0;
+            y = std::min(std::max(y, 0), (int)YSIZE(I()) - 1);
+            x = std::min(std::max(x, 0), (int)XSIZE(I()) - 1);
+        }
+        return DIRECT_A2D_ELEM(I(), y, x);
+    }
+
+    FileName fnMic;
+    Image<float> I;
+};
+
+TEST_F( MicrographReaderTest, readWindow)
+{
+    ASSERT_TRUE(MicrographReader::supports(fnMic));
+    MicrographReader reader;
+    reader.open(fnMic);
+    EXPECT_EQ(reader.Xdim, XSIZE(I()));
+    EXPECT_EQ(reader.Ydim, YSIZE(I()));
+
+    MultidimArray<double> window(16, 20);
+    EXPECT_TRUE(reader.readWindow(10, 5, window));
+    FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(window)
+    EXPECT_DOUBLE_EQ(DIRECT_A2D_ELEM(window, i, j), expected(5 + i, 10 + j, false));
+
+    for (int fill = 0; fill < 2; ++fill)
+    {
+        EXPECT_FALSE(reader.readWindow(-4, 60, window, fill == 1));
+        FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(window)
+        EXPECT_DOUBLE_EQ(DIRECT_A2D_ELEM(window, i, j), expected(60 + i, -4 + j, fill == 1));
+    }
+}
+
+TEST_F( MicrographReaderTest, readWindows)
+{
+    MicrographReader reader;
+    reader.tileSize = 32;
+    reader.open(fnMic);
+
+    std::vector<int> x0, y0;
+    for (int n = 0; n < 40; ++n)
+    {
+        x0.push_back((int)rnd_unif(-10, 85));
+        y0.push_back((int)rnd_unif(-10, 65));
+    }
+    MultidimArray<double> stack(x0.size(), 1, 12, 14), window;
+    std::vector<bool> valid;
+    for (int fill = 0; fill < 2; ++fill)
+    {
+        reader.readWindows(x0, y0, stack, valid, fill == 1);
+        for (size_t n = 0; n < x0.size(); ++n)
+        {
+            window.aliasImageInStack(stack, n);
+            bool inside = x0[n] >= 0 && y0[n] >= 0 && x0[n] + 14 <= 90 && y0[n] + 12 <= 70;
+            EXPECT_EQ(valid[n], inside);
+            FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(window)
+            EXPECT_DOUBLE_EQ(DIRECT_A2D_ELEM(window, i, j), expected(y0[n] + i, x0[n] + j, fill == 1));
+        }
+    }
+}
+
+GTEST_API_ int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
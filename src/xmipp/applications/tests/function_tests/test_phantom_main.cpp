@@ -0,0 +1,112 @@
+#include <data/phantom.h>
+#include <iostream>
+#include <gtest/gtest.h>
+// MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
+class PhantomTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Overlapping features, some of them crossing the volume border, so
+        // that the grid cells and the slabs have several candidates
+        P.xdim=P.ydim=P.zdim=40;
+        P.Background_Density=0;
+        for (int n=0; n<12; n++)
+        {
+            Sphere *sph=new Sphere;
+            sph->Type="sph";
+            sph->Add_Assign=(n%3==0) ? '=' : '+';
+            sph->Density=1+0.25*n;
+            sph->Center.resize(3);
+            XX(sph->Center)=-18+3.5*n;
+            YY(sph->Center)=12-2.5*n;
+            ZZ(sph->Center)=(n%2==0) ? -5+n : 9-n;
+            sph->radius=3+n%4;
+            sph->prepare();
+            P.add(sph);
+        }
+        Cylinder *cyl=new Cylinder;
+        cyl->Type="cyl";
+        cyl->Add_Assign='+';
+        cyl->Density=2.5;
+        cyl->Center.initZeros(3);
+        cyl->xradius=4;
+        cyl->yradius=6;
+        cyl->height=30;
+        cyl->rot=30;
+        cyl->tilt=60;
+        cyl->psi=0;
+        cyl->prepare();
+        P.add(cyl);
+    }
+
+    Phantom P;
+};
+
+TEST_F( PhantomTest, labelWithGrid)
+{
+    MultidimArray<double> Vgrid;
+    P.Nthreads=3;
+    P.label(Vgrid);
+
+    // Every voxel checked against every feature
+    MultidimArray<double> V;
+    V.resize(P.zdim,P.ydim,P.xdim);
+    V.setXmippOrigin();
+    Matrix1D<double> r(3), aux1(3), aux2(3);
+    FOR_ALL_ELEMENTS_IN_ARRAY3D(V)
+    {
+        VECTOR_R3(r,j,i,k);
+        int sel_feat=P.voxel_inside_any_feat(r,aux1,aux2);
+        if (sel_feat!=0)
+            if (P.VF[sel_feat-1]->voxel_inside(r,aux1,aux2)!=8)
+                sel_feat=-sel_feat;
+        A3D_ELEM(V,k,i,j)=sel_feat;
+    }
+
+    ASSERT_TRUE(V.sameShape(Vgrid));
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(V)
+    ASSERT_EQ(DIRECT_MULTIDIM_ELEM(V,n),DIRECT_MULTIDIM_ELEM(Vgrid,n));
+}
+
+TEST_F( PhantomTest, drawThreads)
+{
+    MultidimArray<double> V1, V4;
+    P.Nthreads=1;
+    P.draw_in(V1);
+    P.Nthreads=4;
+    P.draw_in(V4);
+    ASSERT_TRUE(V1.sameShape(V4));
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(V1)
+    ASSERT_EQ(DIRECT_MULTIDIM_ELEM(V1,n),DIRECT_MULTIDIM_ELEM(V4,n));
+}
+
+TEST_F( PhantomTest, projectThreads)
+{
+    Projection P1, P4;
+    P.Nthreads=1;
+    P.project_to(P1,40,40,20,35,-10);
+    P.Nthreads=4;
+    P.project_to(P4,40,40,20,35,-10);
+    ASSERT_TRUE(P1().sameShape(P4()));
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(P1())
+    ASSERT_EQ(DIRECT_MULTIDIM_ELEM(P1(),n),DIRECT_MULTIDIM_ELEM(P4(),n));
+
+    // Every feature projected on the whole image
+    Projection Pref;
+    Pref().initZeros(40,40);
+    Pref().setXmippOrigin();
+    Pref.setAngles(20,35,-10);
+    Matrix2D<double> VP=Pref.euler;
+    Matrix2D<double> PV=VP.inv();
+    for (size_t i=0; i<P.VF.size(); i++)
+        P.VF[i]->project_to(Pref,VP,PV);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(Pref())
+    ASSERT_EQ(DIRECT_MULTIDIM_ELEM(Pref(),n),DIRECT_MULTIDIM_ELEM(P4(),n));
+}
+
+GTEST_API_ int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
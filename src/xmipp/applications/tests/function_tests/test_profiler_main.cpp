@@ -0,0 +1,113 @@
+#include <data/profiler.h>
+#include <core/xmipp_filename.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <gtest/gtest.h>
+// MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
+class ProfilerTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        fnOut.initUniqueName("test_profiler_XXXXXX");
+        Profiler::instance().start(fnOut);
+    }
+
+    virtual void TearDown()
+    {
+        Profiler::instance().stop();
+        fnOut.deleteFile();
+    }
+
+    const ProfileRecord *find(const std::vector<ProfileRecord> &records, const String &path)
+    {
+        for (size_t n=0; n<records.size(); ++n)
+            if (records[n].path==path)
+                return &records[n];
+        return NULL;
+    }
+
+    FileName fnOut;
+};
+
+static void work(int n)
+{
+    XMIPP_PROFILE_SCOPE("work", PROFILE_COMPUTE);
+    for (int i=0; i<n; ++i)
+    {
+        XMIPP_PROFILE_SCOPE("step", PROFILE_FFT);
+        XMIPP_PROFILE_COUNT("steps", 1);
+    }
+}
+
+TEST_F( ProfilerTest, nestedRegions)
+{
+    {
+        XMIPP_PROFILE_SCOPE("outer", PROFILE_IO);
+        work(10);
+    }
+    work(5);
+
+    std::vector<ProfileRecord> records;
+    Profiler::instance().collect(records);
+    const ProfileRecord *outer=find(records,"outer");
+    const ProfileRecord *inner=find(records,"outer/work/step");
+    const ProfileRecord *top=find(records,"work");
+    ASSERT_TRUE(outer!=NULL);
+    ASSERT_TRUE(inner!=NULL);
+    ASSERT_TRUE(top!=NULL);
+    EXPECT_EQ(1u, outer->calls);
+    EXPECT_EQ(10u, inner->calls);
+    EXPECT_EQ(1u, top->calls);
+    EXPECT_EQ((int)PROFILE_FFT, inner->phase);
+    EXPECT_LE(inner->total, outer->total);
+    EXPECT_LE(outer->self, outer->total);
+}
+
+TEST_F( ProfilerTest, threadsAndRanks)
+{
+    std::thread th(work, 100);
+    work(50);
+    th.join();
+
+    std::vector<ProfileRecord> records;
+    Profiler::instance().collect(records);
+    const ProfileRecord *step=find(records,"work/step");
+    ASSERT_TRUE(step!=NULL);
+    EXPECT_EQ(150u, step->calls);
+    EXPECT_EQ(2u, step->threads);
+
+    std::map<String,double> counters;
+    Profiler::instance().collectCounters(counters);
+    EXPECT_DOUBLE_EQ(150, counters["steps"]);
+
+    // Two identical ranks double calls and counters
+    String data=Profiler::instance().serialize();
+    Profiler::instance().addRank(0,data);
+    Profiler::instance().addRank(1,data);
+    Profiler::instance().write();
+    std::ifstream fh(fnOut.c_str());
+    std::stringstream buffer;
+    buffer << fh.rdbuf();
+    String json=buffer.str();
+    EXPECT_NE(String::npos, json.find("\"ranks\": 2"));
+    EXPECT_NE(String::npos, json.find("{\"path\": \"work/step\", \"phase\": \"fft\", \"calls\": 300"));
+    EXPECT_NE(String::npos, json.find("\"steps\": 300"));
+}
+
+TEST_F( ProfilerTest, disabled)
+{
+    Profiler::instance().stop();
+    work(10);
+    std::vector<ProfileRecord> records;
+    Profiler::instance().collect(records);
+    EXPECT_TRUE(records.empty());
+}
+
+GTEST_API_ int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,82 @@
+#include <reconstruction/reconstruct_significant.h>
+#include <core/transformations.h>
+#include <algorithm>
+#include <iostream>
+#include <gtest/gtest.h>
+// MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
+class ReconstructSignificantTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Gallery of smooth, centered images made of a few Gaussian blobs
+        init_random_generator(17);
+        gallery.initZeros(Ndirs,1,64,64);
+        MultidimArray<double> Iref;
+        for (size_t n=0; n<Ndirs; ++n)
+        {
+            Iref.aliasImageInStack(gallery,n);
+            Iref.setXmippOrigin();
+            for (int b=0; b<4; ++b)
+            {
+                double x0=rnd_unif(-12,12), y0=rnd_unif(-12,12);
+                double sigma2=2*rnd_unif(2,5)*rnd_unif(2,5), A=rnd_unif(0.5,1);
+                FOR_ALL_ELEMENTS_IN_ARRAY2D(Iref)
+                A2D_ELEM(Iref,i,j)+=A*exp(-((i-y0)*(i-y0)+(j-x0)*(j-x0))/sigma2);
+            }
+        }
+    }
+
+    static const size_t Ndirs=30;
+    MultidimArray<double> gallery;
+    RotationalInvariantAux aux;
+};
+
+TEST_F( ReconstructSignificantTest, prescreenKeepsTrueDirection)
+{
+    std::vector< MultidimArray<double> > galleryInvariants(Ndirs);
+    MultidimArray<double> Iref;
+    for (size_t n=0; n<Ndirs; ++n)
+    {
+        Iref.aliasImageInStack(gallery,n);
+        Iref.setXmippOrigin();
+        rotationalInvariant(Iref,galleryInvariants[n],aux);
+    }
+
+    // Shifted, rotated, sometimes mirrored and noisy copies of some gallery images.
+    // Their direction must be among the best ranked ones kept by
+    // --keepDirections 0.2
+    size_t Nkeep=(size_t)ceil(0.2*Ndirs);
+    MultidimArray<double> I, invariantI;
+    for (size_t trueDir=0; trueDir<Ndirs; trueDir+=3)
+    {
+        Iref.aliasImageInStack(gallery,trueDir);
+        Iref.setXmippOrigin();
+        rotate(BSPLINE3, I, Iref, 17.0+11*trueDir, 'Z', DONT_WRAP);
+        if (trueDir%2==1)
+            I.selfReverseX();
+        I.setXmippOrigin();
+        selfTranslate(BSPLINE3, I, vectorR2(5.0-trueDir%7, trueDir%5-2.5), DONT_WRAP);
+        I.addNoise(0,0.05*Iref.computeMax(),"gaussian");
+        rotationalInvariant(I,invariantI,aux);
+
+        std::vector<double> score(Ndirs);
+        for (size_t k=0; k<Ndirs; ++k)
+        {
+            score[k]=0;
+            FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(invariantI)
+            score[k]+=DIRECT_MULTIDIM_ELEM(invariantI,n)*DIRECT_MULTIDIM_ELEM(galleryInvariants[k],n);
+        }
+        size_t rank=0;
+        for (size_t k=0; k<Ndirs; ++k)
+            if (score[k]>score[trueDir])
+                rank++;
+        EXPECT_LT(rank,Nkeep) << "Direction " << trueDir << " ranked " << rank;
+    }
+}
+
+GTEST_API_ int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,90 @@
+#include <classification/svm_classifier.h>
+#include <stdlib.h>
+#include <iostream>
+#include <gtest/gtest.h>
+// MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
+class SVMTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Two overlapping Gaussian classes, so that there are many support
+        // vectors and the probabilities are not 0 or 1
+        randomize_random_generator();
+        trainSet.initZeros(80,12);
+        label.initZeros(80);
+        for (size_t i=0; i<YSIZE(trainSet); i++)
+        {
+            DIRECT_A1D_ELEM(label,i)=(i%2==0) ? 1 : 2;
+            for (size_t j=0; j<XSIZE(trainSet); j++)
+                DIRECT_A2D_ELEM(trainSet,i,j)=rnd_gaus(i%2==0 ? 0.0 : 0.4,1.0);
+        }
+        testSet.initZeros(33,12);
+        testSet.initRandom(-1,1.5);
+        // Some zeros, that are not stored in the sparse vectors
+        for (size_t i=0; i<YSIZE(testSet); i+=3)
+            DIRECT_A2D_ELEM(testSet,i,i%12)=0;
+    }
+
+    MultidimArray<double> trainSet, label, testSet;
+};
+
+TEST_F( SVMTest, batchedPrediction)
+{
+    SVMClassifier svm;
+    svm.setParameters(1,0.1);
+    svm.SVMTrain(trainSet,label,2);
+
+    MultidimArray<double> labels, scores;
+    svm.predict(testSet,labels,scores,3);
+    ASSERT_EQ(YSIZE(testSet),XSIZE(labels));
+    ASSERT_EQ(YSIZE(testSet),XSIZE(scores));
+    MultidimArray<double> featVec(XSIZE(testSet));
+    for (size_t i=0; i<YSIZE(testSet); i++)
+    {
+        for (size_t j=0; j<XSIZE(testSet); j++)
+            DIRECT_A1D_ELEM(featVec,j)=DIRECT_A2D_ELEM(testSet,i,j);
+        double score;
+        double predicted=svm.predict(featVec,score);
+        EXPECT_EQ(predicted,DIRECT_A1D_ELEM(labels,i));
+        // The batched kernel values are computed with dense dot products
+        EXPECT_NEAR(score,DIRECT_A1D_ELEM(scores,i),1e-10);
+    }
+}
+
+TEST_F( SVMTest, sharedKernelMatrix)
+{
+    // The shared kernel matrix is not computed if it does not fit in the cache.
+    // With a polynomial kernel the diagonal of the kernel matrix is not 1, so
+    // it must be kept in double precision as in the solver.
+    int kernels[2]={RBF, POLY};
+    for (int n=0; n<2; n++)
+    {
+        SVMClassifier svmShared, svmAlone;
+        svmShared.setParameters(1,0.1);
+        svmAlone.setParameters(1,0.1);
+        svmShared.param.kernel_type=svmAlone.param.kernel_type=kernels[n];
+        svmShared.param.degree=svmAlone.param.degree=3;
+        svmAlone.param.cache_size=0.01;
+        // The cross-validation of the probability estimates shuffles with rand()
+        srand(1);
+        svmShared.SVMTrain(trainSet,label,4);
+        srand(1);
+        svmAlone.SVMTrain(trainSet,label,1);
+
+        const svm_model *ms=svmShared.model, *ma=svmAlone.model;
+        ASSERT_EQ(ma->l,ms->l);
+        ASSERT_EQ(ma->nr_class,ms->nr_class);
+        EXPECT_EQ(ma->rho[0],ms->rho[0]);
+        EXPECT_EQ(ma->probA[0],ms->probA[0]);
+        EXPECT_EQ(ma->probB[0],ms->probB[0]);
+        for (int k=0; k<ma->l; k++)
+            EXPECT_EQ(ma->sv_coef[0][k],ms->sv_coef[0][k]);
+    }
+}
+
+GTEST_API_ int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,94 @@
+#include <data/wavelet_lifting.h>
+#include <iostream>
+#include <gtest/gtest.h>
+// MORE INFO HERE: http://code.google.com/p/googletest/wiki/AdvancedGuide
+class WaveletLiftingTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Not a power of 2: 2 levels in Z, Y and X
+        V.initZeros(12,16,24);
+        V.initRandom(0,1,RND_GAUSSIAN);
+    }
+
+    MultidimArray<double> V;
+};
+
+TEST_F( WaveletLiftingTest, maxLevels)
+{
+    EXPECT_EQ(5, liftingMaxLevels(64,1,1));
+    EXPECT_EQ(4, liftingMaxLevels(64,32,1));
+    EXPECT_EQ(2, liftingMaxLevels(24,16,12));
+    EXPECT_EQ(0, liftingMaxLevels(7,8,1));
+}
+
+TEST_F( WaveletLiftingTest, orthonormal)
+{
+    // The transform keeps the energy and is inverted exactly
+    MultidimArray<double> W(V);
+    liftingDWT(W,-1,3);
+    EXPECT_NEAR(V.sum2(),W.sum2(),1e-9*V.sum2());
+    liftingIDWT(W,-1,2);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(V)
+    ASSERT_NEAR(DIRECT_MULTIDIM_ELEM(V,n),DIRECT_MULTIDIM_ELEM(W,n),1e-12);
+
+    // The result does not depend on the number of threads
+    MultidimArray<double> W1(V), W4(V);
+    liftingDWT(W1,-1,1);
+    liftingDWT(W4,-1,4);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(W1)
+    ASSERT_EQ(DIRECT_MULTIDIM_ELEM(W1,n),DIRECT_MULTIDIM_ELEM(W4,n));
+}
+
+TEST_F( WaveletLiftingTest, vanishingMoments)
+{
+    // The detail coefficients of a line are 0, except the first one, where
+    // the periodic extension breaks the line
+    MultidimArray<double> I(32,32);
+    FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(I)
+    DIRECT_A2D_ELEM(I,i,j)=2+0.5*i;
+    liftingDWT(I,1);
+    for (size_t i=0; i<16; ++i)
+        for (size_t j=16; j<32; ++j)
+            EXPECT_NEAR(0,DIRECT_A2D_ELEM(I,i,j),1e-10);
+    for (size_t i=17; i<32; ++i)
+        for (size_t j=0; j<32; ++j)
+            EXPECT_NEAR(0,DIRECT_A2D_ELEM(I,i,j),1e-10);
+}
+
+TEST_F( WaveletLiftingTest, singlePrecision)
+{
+    MultidimArray<float> Vf;
+    typeCast(V,Vf);
+    liftingDWT(Vf,-1,2);
+    MultidimArray<double> W(V);
+    liftingDWT(W,-1,2);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(W)
+    ASSERT_NEAR(DIRECT_MULTIDIM_ELEM(W,n),DIRECT_MULTIDIM_ELEM(Vf,n),1e-4);
+}
+
+TEST_F( WaveletLiftingTest, bayesian)
+{
+    MultidimArray<double> W1(V), W4(V);
+    liftingDWT(W1);
+    liftingDWT(W4);
+    Matrix1D<double> estimatedS1=bayesianWienerFiltering(W1,1,0.1,0.2,false,0,true,1);
+    Matrix1D<double> estimatedS4=bayesianWienerFiltering(W4,1,0.1,0.2,false,0,true,4);
+    ASSERT_EQ(4u,VEC_XSIZE(estimatedS1));
+    for (size_t i=0; i<VEC_XSIZE(estimatedS1); ++i)
+        EXPECT_DOUBLE_EQ(VEC_ELEM(estimatedS1,i),VEC_ELEM(estimatedS4,i));
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(W1)
+    ASSERT_EQ(DIRECT_MULTIDIM_ELEM(W1,n),DIRECT_MULTIDIM_ELEM(W4,n));
+
+    // Wiener filtering only reduces the coefficients
+    MultidimArray<double> W(V);
+    liftingDWT(W);
+    EXPECT_LE(W1.sum2(),W.sum2());
+}
+
+GTEST_API_ int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
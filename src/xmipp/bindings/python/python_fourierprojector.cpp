@@ -25,6 +25,23 @@
 
 #include "xmippmodule.h"
 #include "python_image.h"
+#include <thread>
+
+/** Import the NumPy C-API for the batch projections of this file
+ * (see NumpyStaticImport in python_image.cpp)
+ */
+namespace
+{
+class FourierProjectorNumpyImport
+{
+public:
+    FourierProjectorNumpyImport()
+    {
+        import_array();
+    }
+}
+_fpNpyImport;
+}
 
 /***************************************************************/
 /*                            FourierProjector                         */
@@ -35,6 +52,11 @@
  {
     { "projectVolume", (PyCFunction) FourierProjector_projectVolume,
       METH_VARARGS, "projects Volume" },
+    { "projectVolumes", (PyCFunction) FourierProjector_projectVolumes,
+      METH_VARARGS | METH_KEYWORDS,
+      "projects the volume along a N x 3 array of Euler angles, optionally "
+      "shifted (N x 2 array in pixels) and with a CTF (N x 3 array of defocusU, "
+      "defocusV and defocusAngle). Returns a N x Y x X float32 array" },
     { NULL } /* Sentinel */
  };//FourierProjector_methods
 
@@ -93,6 +115,8 @@
 
      if (self != NULL)
      {
+         self->fourier_projector = NULL;
+         self->mutex = new std::mutex();
          PyObject *image = NULL;
          double padding_factor, max_freq, spline_degree;
          padding_factor = 2;
@@ -117,6 +141,7 @@
   void FourierProjector_dealloc(FourierProjectorObject* self)
  {
      delete self->fourier_projector;
+     delete self->mutex;
      //delete self->dims;
      self->ob_type->tp_free((PyObject*) self);
  }
@@ -133,7 +158,11 @@ PyObject * FourierProjector_projectVolume(PyObject * obj, PyObject *args, PyObje
           try
           {
         	  Projection P;
-              projectVolume(FourierProjector_Value(self), P, self->dims.xdim, self->dims.ydim, rot, tilt, psi);
+              {
+                  GILReleaser releaser;
+                  std::lock_guard<std::mutex> lock(*self->mutex);
+                  projectVolume(FourierProjector_Value(self), P, self->dims.xdim, self->dims.ydim, rot, tilt, psi);
+              }
               Image_Value(projection_image).data->setImage(MULTIDIM_ARRAY(P));
           }
           catch (XmippError &xe)
@@ -144,8 +173,107 @@ PyObject * FourierProjector_projectVolume(PyObject * obj, PyObject *args, PyObje
       Py_RETURN_NONE;
 }
 
+/* Copy a NumPy array (or sequence) of Ncols columns into a matrix */
+static bool
+matrixFromPyArray(PyObject *input, size_t Ncols, const char *name, Matrix2D<double> &M)
+{
+    PyArrayObject *arr = (PyArrayObject*) PyArray_FROM_OTF(input, NPY_DOUBLE,
+                         NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (arr == NULL)
+        return false;
+    if (PyArray_NDIM(arr) != 2 || (size_t)PyArray_DIM(arr, 1) != Ncols)
+    {
+        Py_DECREF(arr);
+        PyErr_SetString(PyExc_ValueError,
+                        formatString("%s must be a N x %d array", name, (int)Ncols).c_str());
+        return false;
+    }
+    M.resizeNoCopy(PyArray_DIM(arr, 0), Ncols);
+    memcpy(MATRIX2D_ARRAY(M), PyArray_DATA(arr), MAT_SIZE(M) * sizeof(double));
+    Py_DECREF(arr);
+    return true;
+}
 
+/* projectVolumes */
+PyObject * FourierProjector_projectVolumes(PyObject * obj, PyObject *args, PyObject *kwargs)
+{
+    FourierProjectorObject *self = (FourierProjectorObject*) obj;
+    PyObject *pyAngles = NULL, *pyShifts = Py_None, *pyDefocus = Py_None;
+    double Ts = 1, kV = 300, Cs = 2.7, Q0 = 0.1;
+    int numThreads = 0;
+    static const char *kwlist[] = {"angles", "shifts", "defocus", "samplingRate", "voltage",
+                                   "sphericalAberration", "Q0", "numThreads", NULL};
+    if (self == NULL || !PyArg_ParseTupleAndKeywords(args, kwargs, "O|OOddddi", (char **)kwlist,
+            &pyAngles, &pyShifts, &pyDefocus, &Ts, &kV, &Cs, &Q0, &numThreads))
+        return NULL;
+    try
+    {
+        Matrix2D<double> angles, shifts, defocus;
+        if (!matrixFromPyArray(pyAngles, 3, "angles", angles))
+            return NULL;
+        size_t N = MAT_YSIZE(angles);
+        if (pyShifts != Py_None &&
+            (!matrixFromPyArray(pyShifts, 2, "shifts", shifts) || MAT_YSIZE(shifts) != N))
+        {
+            if (!PyErr_Occurred())
+                PyErr_SetString(PyExc_ValueError, "There must be one shift per projection");
+            return NULL;
+        }
+        std::vector<CTFDescription> ctfs;
+        if (pyDefocus != Py_None)
+        {
+            if (!matrixFromPyArray(pyDefocus, 3, "defocus", defocus) || MAT_YSIZE(defocus) != N)
+            {
+                if (!PyErr_Occurred())
+                    PyErr_SetString(PyExc_ValueError, "There must be one defocus per projection");
+                return NULL;
+            }
+            ctfs.resize(N);
+            for (size_t n = 0; n < N; ++n)
+            {
+                CTFDescription &ctf = ctfs[n];
+                ctf.clear();
+                ctf.enable_CTF = true;
+                ctf.enable_CTFnoise = false;
+                ctf.Tm = Ts;
+                ctf.kV = kV;
+                ctf.Cs = Cs;
+                ctf.Q0 = Q0;
+                ctf.DeltafU = MAT_ELEM(defocus, n, 0);
+                ctf.DeltafV = MAT_ELEM(defocus, n, 1);
+                ctf.azimuthal_angle = MAT_ELEM(defocus, n, 2);
+                ctf.produceSideInfo();
+            }
+        }
+        if (numThreads <= 0)
+            numThreads = std::max(std::thread::hardware_concurrency(), 1u);
 
-
-
-
+        FourierProjector &projector = FourierProjector_Value(self);
+        npy_intp dims[3];
+        dims[0] = N;
+        dims[1] = dims[2] = projector.volumeSize;
+        PyArrayObject *arr = (PyArrayObject*) PyArray_SimpleNew(3, dims, NPY_FLOAT32);
+        if (arr == NULL)
+            return NULL;
+        try
+        {
+            // The batch does not use the buffers of the projector, so it
+            // does not need its mutex
+            GILReleaser releaser;
+            projector.projectBatch(angles, pyShifts != Py_None ? &shifts : NULL,
+                                   pyDefocus != Py_None ? &ctfs : NULL,
+                                   (float *) PyArray_DATA(arr), numThreads);
+        }
+        catch (XmippError &xe)
+        {
+            Py_DECREF(arr);
+            throw;
+        }
+        return (PyObject*) arr;
+    }
+    catch (XmippError &xe)
+    {
+        PyErr_SetString(PyXmippError, xe.msg.c_str());
+    }
+    return NULL;
+}
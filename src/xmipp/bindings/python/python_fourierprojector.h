@@ -28,6 +28,7 @@
 #define _FOURIER_PROJECTOR_H
 
 #include "Python.h"
+#include <mutex>
 
 /***************************************************************/
 /*                            Fourier Projector                */
@@ -43,6 +44,8 @@ typedef struct
     PyObject_HEAD
     ArrayDim dims;
     FourierProjector* fourier_projector;
+    // The projector keeps work buffers, so only one thread projects at a time
+    std::mutex* mutex;
 }
 FourierProjectorObject;
 
@@ -57,6 +60,10 @@ void FourierProjector_dealloc(FourierProjectorObject* self);
 
 PyObject * FourierProjector_projectVolume(PyObject * obj, PyObject *args, PyObject *kwargs);
 
+/* Project a volume along a batch of orientations into a NumPy stack.
+ */
+PyObject * FourierProjector_projectVolumes(PyObject * obj, PyObject *args, PyObject *kwargs);
+
 /* FourierProjector methods */
 extern PyMethodDef FourierProjector_methods[];
 /*FourierProjectorType Type */
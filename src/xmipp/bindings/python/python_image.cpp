@@ -355,17 +355,24 @@ Image_write(PyObject *obj, PyObject *args, PyObject *kwargs)
               {
                 // Get the index and filename from the Python tuple object
                 size_t index = PyInt_AsSsize_t(PyTuple_GetItem(input, 0));
-                const char * filename = PyString_AsString(PyTuple_GetItem(input, 1));
+                FileName filename = PyString_AsString(PyTuple_GetItem(input, 1));
                 // Now read using both of index and filename
                 bool isStack = (index > 0);
                 WriteMode writeMode = isStack ? WRITE_REPLACE : WRITE_OVERWRITE;
-                self->image->write(filename, index, isStack, writeMode);
+                {
+                    GILReleaser releaser(threadSafeImageFile(filename));
+                    self->image->write(filename, index, isStack, writeMode);
+                }
 
                 Py_RETURN_NONE;
               }
               if ((pyStr = PyObject_Str(input)) != NULL)
               {
-                  self->image->write(PyString_AsString(input));
+                  FileName filename = PyString_AsString(input);
+                  {
+                      GILReleaser releaser(threadSafeImageFile(filename));
+                      self->image->write(filename);
+                  }
                   Py_RETURN_NONE;
               }
               else
@@ -404,14 +411,21 @@ Image_read(PyObject *obj, PyObject *args, PyObject *kwargs)
               {
                 // Get the index and filename from the Python tuple object
                 size_t index = PyInt_AsSsize_t(PyTuple_GetItem(input, 0));
-                const char * filename = PyString_AsString(PyTuple_GetItem(input, 1));
+                FileName filename = PyString_AsString(PyTuple_GetItem(input, 1));
                 // Now read using both of index and filename
-                self->image->read(filename,(DataMode)datamode, index);
+                {
+                    GILReleaser releaser(threadSafeImageFile(filename));
+                    self->image->read(filename,(DataMode)datamode, index);
+                }
                 Py_RETURN_NONE;
               }
               else if ((pyStr = PyObject_Str(input)) != NULL)
               {
-                  self->image->read(PyString_AsString(pyStr),(DataMode)datamode);
+                  FileName filename = PyString_AsString(pyStr);
+                  {
+                      GILReleaser releaser(threadSafeImageFile(filename));
+                      self->image->read(filename,(DataMode)datamode);
+                  }
                   Py_RETURN_NONE;
               }
               else
@@ -25,6 +25,22 @@
 
 #include "xmippmodule.h"
 
+/** Import the NumPy C-API for the columnar access of this file
+ * (see NumpyStaticImport in python_image.cpp)
+ */
+namespace
+{
+class MetaDataNumpyImport
+{
+public:
+    MetaDataNumpyImport()
+    {
+        import_array();
+    }
+}
+_mdNpyImport;
+}
+
 /***************************************************************/
 /*                            MDQuery                          */
 /***************************************************************/
@@ -305,6 +321,14 @@ PyMethodDef MetaData_methods[] =
           METH_VARARGS, "Get all values value from column(label)" },
         { "setColumnValues", (PyCFunction) MetaData_setColumnValues,
           METH_VARARGS, "Set all values value from column(label)" },
+        { "getColumnArray", (PyCFunction) MetaData_getColumnArray,
+          METH_VARARGS, "Get the values of a numeric column(label) as a NumPy array" },
+        { "getColumnsArray", (PyCFunction) MetaData_getColumnsArray,
+          METH_VARARGS, "Get the values of several numeric columns(labels) as a NumPy record array" },
+        { "setColumnArray", (PyCFunction) MetaData_setColumnArray,
+          METH_VARARGS, "Set all values of a numeric column(label) from a NumPy array" },
+        { "setColumnsArray", (PyCFunction) MetaData_setColumnsArray,
+          METH_VARARGS, "Set several numeric columns from a NumPy record array whose fields are label names" },
         { "getActiveLabels",
           (PyCFunction) MetaData_getActiveLabels,
           METH_VARARGS,
@@ -1076,6 +1100,311 @@ MetaData_setColumnValues(PyObject *obj, PyObject *args, PyObject *kwargs)
     Py_RETURN_NONE;
 }
 
+/* NumPy type used for the values of a label, -1 if the label is not numeric */
+static int
+labelNpyType(MDLabel label)
+{
+    switch (MDL::labelType(label))
+    {
+    case LABEL_BOOL:
+        return NPY_BOOL;
+    case LABEL_INT:
+        return NPY_INT;
+    case LABEL_SIZET:
+        return NPY_UINTP;
+    case LABEL_DOUBLE:
+        return NPY_DOUBLE;
+    default:
+        return -1;
+    }
+}
+
+/* Check that a label can be exported as a NumPy column */
+static bool
+validateColumnLabel(MetaData &md, MDLabel label, bool mustExist)
+{
+    if (labelNpyType(label) < 0)
+    {
+        PyErr_SetString(PyExc_TypeError,
+                        formatString("Label %s is not numeric", MDL::label2Str(label).c_str()).c_str());
+        return false;
+    }
+    if (mustExist && !md.containsLabel(label))
+    {
+        PyErr_SetString(PyXmippError,
+                        formatString("Label %s is not in the metadata", MDL::label2Str(label).c_str()).c_str());
+        return false;
+    }
+    return true;
+}
+
+/* Copy the values of a column into a (possibly strided) NumPy buffer */
+static void
+copyColumnToArray(const std::vector<MDObject> &values, char *data, npy_intp stride)
+{
+    size_t size = values.size();
+    if (size == 0)
+        return;
+    switch (MDL::labelType(values[0].label))
+    {
+    case LABEL_BOOL:
+        for (size_t i = 0; i < size; ++i, data += stride)
+            *((npy_bool *) data) = values[i].data.boolValue;
+        break;
+    case LABEL_INT:
+        for (size_t i = 0; i < size; ++i, data += stride)
+            *((int *) data) = values[i].data.intValue;
+        break;
+    case LABEL_SIZET:
+        for (size_t i = 0; i < size; ++i, data += stride)
+            *((size_t *) data) = values[i].data.longintValue;
+        break;
+    case LABEL_DOUBLE:
+        for (size_t i = 0; i < size; ++i, data += stride)
+            *((double *) data) = values[i].data.doubleValue;
+        break;
+    default:
+        break;
+    }
+}
+
+/* Read the values of several columns */
+static void
+readColumns(MetaData &md, const std::vector<MDLabel> &labels,
+            std::vector< std::vector<MDObject> > &values)
+{
+    values.resize(labels.size());
+    for (size_t l = 0; l < labels.size(); ++l)
+        md.getColumnValues(labels[l], values[l]);
+}
+
+/* Set a column from any object convertible to a NumPy array.
+ * If the metadata is empty, one object is added per element. */
+static bool
+setColumnFromArray(MetaData &md, MDLabel label, PyObject *input)
+{
+    int type = labelNpyType(label);
+    PyArrayObject *arr = (PyArrayObject*) PyArray_FROM_OTF(input, type,
+                         NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+    if (arr == NULL)
+        return false;
+    if (PyArray_NDIM(arr) != 1)
+    {
+        Py_DECREF(arr);
+        PyErr_SetString(PyExc_ValueError, "Expected a one-dimensional array");
+        return false;
+    }
+    size_t size = PyArray_DIM(arr, 0);
+    if (md.size() != 0 && md.size() != size)
+    {
+        Py_DECREF(arr);
+        PyErr_SetString(PyXmippError, "Metadata size different from array size");
+        return false;
+    }
+    std::vector<MDObject> values(size, MDObject(label));
+    char *data = (char *) PyArray_DATA(arr);
+    switch (type)
+    {
+    case NPY_BOOL:
+        for (size_t i = 0; i < size; ++i)
+            values[i].data.boolValue = ((npy_bool *) data)[i];
+        break;
+    case NPY_INT:
+        for (size_t i = 0; i < size; ++i)
+            values[i].data.intValue = ((int *) data)[i];
+        break;
+    case NPY_DOUBLE:
+        for (size_t i = 0; i < size; ++i)
+            values[i].data.doubleValue = ((double *) data)[i];
+        break;
+    default:
+        for (size_t i = 0; i < size; ++i)
+            values[i].data.longintValue = ((size_t *) data)[i];
+        break;
+    }
+    Py_DECREF(arr);
+    md.setColumnValues(values);
+    return true;
+}
+
+/* getColumnArray */
+PyObject *
+MetaData_getColumnArray(PyObject *obj, PyObject *args, PyObject *kwargs)
+{
+    int label;
+    if (PyArg_ParseTuple(args, "i", &label))
+    {
+        try
+        {
+            MetaDataObject *self = (MetaDataObject*) obj;
+            MetaData &md = MetaData_Value(self);
+            if (!validateColumnLabel(md, (MDLabel) label, true))
+                return NULL;
+
+            std::vector<MDLabel> labels(1, (MDLabel) label);
+            std::vector< std::vector<MDObject> > values;
+            readColumns(md, labels, values);
+
+            npy_intp dims = values[0].size();
+            PyArrayObject * arr = (PyArrayObject*) PyArray_SimpleNew(1, &dims,
+                                  labelNpyType((MDLabel) label));
+            if (arr != NULL)
+                copyColumnToArray(values[0], (char *) PyArray_DATA(arr), PyArray_STRIDE(arr, 0));
+            return (PyObject*) arr;
+        }
+        catch (XmippError &xe)
+        {
+            PyErr_SetString(PyXmippError, xe.msg.c_str());
+        }
+    }
+    return NULL;
+}
+
+/* getColumnsArray */
+PyObject *
+MetaData_getColumnsArray(PyObject *obj, PyObject *args, PyObject *kwargs)
+{
+    PyObject *pyLabels = NULL;
+    if (PyArg_ParseTuple(args, "O", &pyLabels))
+    {
+        try
+        {
+            MetaDataObject *self = (MetaDataObject*) obj;
+            MetaData &md = MetaData_Value(self);
+            if (!PyList_Check(pyLabels) || PyList_Size(pyLabels) == 0)
+            {
+                PyErr_SetString(PyExc_TypeError, "Expected a non empty list of labels (MDLABEL)");
+                return NULL;
+            }
+            size_t nLabels = PyList_Size(pyLabels);
+            std::vector<MDLabel> labels(nLabels);
+            for (size_t l = 0; l < nLabels; ++l)
+            {
+                PyObject *item = PyList_GetItem(pyLabels, l);
+                if (!PyInt_Check(item))
+                {
+                    PyErr_SetString(PyExc_TypeError, "MDL labels must be integers (MDLABEL)");
+                    return NULL;
+                }
+                labels[l] = (MDLabel) PyInt_AsLong(item);
+                if (!validateColumnLabel(md, labels[l], true))
+                    return NULL;
+            }
+
+            // Record type with one field per label, named as the label
+            PyObject *fields = PyList_New(nLabels);
+            for (size_t l = 0; l < nLabels; ++l)
+                PyList_SetItem(fields, l, Py_BuildValue("(sN)", MDL::label2Str(labels[l]).c_str(),
+                                                        PyArray_DescrFromType(labelNpyType(labels[l]))));
+            PyArray_Descr *descr = NULL;
+            int ok = PyArray_DescrConverter(fields, &descr);
+            Py_DECREF(fields);
+            if (!ok)
+                return NULL;
+
+            std::vector< std::vector<MDObject> > values;
+            readColumns(md, labels, values);
+
+            npy_intp dims = values[0].size();
+            PyArrayObject *arr = (PyArrayObject*) PyArray_Zeros(1, &dims, descr, 0);
+            if (arr == NULL)
+                return NULL;
+            // The fields of a record are interleaved, its stride is the record size
+            char *data = (char *) PyArray_DATA(arr);
+            npy_intp stride = PyArray_STRIDE(arr, 0);
+            for (size_t l = 0; l < nLabels; ++l)
+            {
+                PyObject *field = PyDict_GetItemString(PyArray_DESCR(arr)->fields,
+                                                       MDL::label2Str(labels[l]).c_str());
+                size_t offset = PyInt_AsLong(PyTuple_GetItem(field, 1));
+                copyColumnToArray(values[l], data + offset, stride);
+            }
+            return (PyObject*) arr;
+        }
+        catch (XmippError &xe)
+        {
+            PyErr_SetString(PyXmippError, xe.msg.c_str());
+        }
+    }
+    return NULL;
+}
+
+/* setColumnArray */
+PyObject *
+MetaData_setColumnArray(PyObject *obj, PyObject *args, PyObject *kwargs)
+{
+    int label;
+    PyObject *input = NULL;
+    if (PyArg_ParseTuple(args, "iO", &label, &input))
+    {
+        try
+        {
+            MetaDataObject *self = (MetaDataObject*) obj;
+            MetaData &md = MetaData_Value(self);
+            if (validateColumnLabel(md, (MDLabel) label, false) &&
+                setColumnFromArray(md, (MDLabel) label, input))
+                Py_RETURN_NONE;
+        }
+        catch (XmippError &xe)
+        {
+            PyErr_SetString(PyXmippError, xe.msg.c_str());
+        }
+    }
+    return NULL;
+}
+
+/* setColumnsArray */
+PyObject *
+MetaData_setColumnsArray(PyObject *obj, PyObject *args, PyObject *kwargs)
+{
+    PyObject *input = NULL;
+    if (PyArg_ParseTuple(args, "O", &input))
+    {
+        try
+        {
+            MetaDataObject *self = (MetaDataObject*) obj;
+            MetaData &md = MetaData_Value(self);
+            if (!PyArray_Check(input) || !PyDataType_HASFIELDS(PyArray_DESCR((PyArrayObject*) input)))
+            {
+                PyErr_SetString(PyExc_TypeError, "Expected a record array with label names as fields");
+                return NULL;
+            }
+            PyObject *names = PyArray_DESCR((PyArrayObject*) input)->names;
+            size_t nLabels = PyTuple_Size(names);
+            std::vector<MDLabel> labels(nLabels);
+            for (size_t l = 0; l < nLabels; ++l)
+            {
+                labels[l] = MDL::str2Label(PyString_AsString(PyTuple_GetItem(names, l)));
+                if (labels[l] == MDL_UNDEFINED)
+                {
+                    PyErr_SetString(PyXmippError,
+                                    formatString("Field %s is not a metadata label",
+                                                 PyString_AsString(PyTuple_GetItem(names, l))).c_str());
+                    return NULL;
+                }
+                if (!validateColumnLabel(md, labels[l], false))
+                    return NULL;
+            }
+            for (size_t l = 0; l < nLabels; ++l)
+            {
+                PyObject *field = PyObject_GetItem(input, PyTuple_GetItem(names, l));
+                if (field == NULL)
+                    return NULL;
+                bool ok = setColumnFromArray(md, labels[l], field);
+                Py_DECREF(field);
+                if (!ok)
+                    return NULL;
+            }
+            Py_RETURN_NONE;
+        }
+        catch (XmippError &xe)
+        {
+            PyErr_SetString(PyXmippError, xe.msg.c_str());
+        }
+    }
+    return NULL;
+}
+
 /* containsLabel */
 PyObject *
 MetaData_getActiveLabels(PyObject *obj, PyObject *args, PyObject *kwargs)
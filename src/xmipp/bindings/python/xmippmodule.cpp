@@ -665,13 +665,16 @@ xmipp_compareTwoMetadataFiles(PyObject *obj, PyObject *args, PyObject *kwargs)
     return NULL;
 }
 
-/** Some helper macros repeated in filter functions*/
+/** Some helper macros repeated in filter functions.
+ * The image is read, filtered and scaled without the GIL */
 #define FILTER_TRY()\
 try {\
 if (validateInputImageString(pyImage, pyStrFn, fn)) {\
 Image<double> img;\
-img.read(fn);\
 MultidimArray<double> &data = MULTIDIM_ARRAY(img);\
+{\
+GILReleaser releaser(threadSafeImageFile(fn));\
+img.read(fn);\
 ArrayDim idim;\
 data.getDimensions(idim);
 
@@ -681,8 +684,9 @@ if (x > y) h = y * (dim/x);\
 else if (y > x)\
   w = x * (dim/y);\
 selfScaleToSize(LINEAR, data, w, h);\
-Image_Value(pyImage).setDatatype(DT_Double);\
 data.resetOrigin();\
+}\
+Image_Value(pyImage).setDatatype(DT_Double);\
 MULTIDIM_ARRAY_GENERIC(Image_Value(pyImage)).setImage(data);\
 Py_RETURN_NONE;\
 }} catch (XmippError &xe)\
@@ -817,8 +821,11 @@ xmipp_fastEstimateEnhancedPSD(PyObject *obj, PyObject *args, PyObject *kwargs)
             if (validateInputImageString(pyImage, pyStrFn, fn))
             {
                 MultidimArray<double> data;
-                fastEstimateEnhancedPSD(fn, downsampling, data, Nthreads);
-                selfScaleToSize(LINEAR, data, dim, dim);
+                {
+                    GILReleaser releaser(threadSafeImageFile(fn));
+                    fastEstimateEnhancedPSD(fn, downsampling, data, Nthreads);
+                    selfScaleToSize(LINEAR, data, dim, dim);
+                }
                 Image_Value(pyImage).setDatatype(DT_Double);
                 Image_Value(pyImage).data->setImage(data);
                 Py_RETURN_NONE;
@@ -832,13 +839,16 @@ xmipp_fastEstimateEnhancedPSD(PyObject *obj, PyObject *args, PyObject *kwargs)
     return NULL;
 }
 
-/** Some helper macros repeated in filter functions*/
+/** Some helper macros repeated in filter functions.
+ * The image is read, filtered and scaled without the GIL */
 #define FILTER_TRY()\
 try {\
 if (validateInputImageString(pyImage, pyStrFn, fn)) {\
 Image<double> img;\
-img.read(fn);\
 MultidimArray<double> &data = MULTIDIM_ARRAY(img);\
+{\
+GILReleaser releaser(threadSafeImageFile(fn));\
+img.read(fn);\
 ArrayDim idim;\
 data.getDimensions(idim);
 
@@ -848,8 +858,9 @@ if (x > y) h = y * (dim/x);\
 else if (y > x)\
   w = x * (dim/y);\
 selfScaleToSize(LINEAR, data, w, h);\
-Image_Value(pyImage).setDatatype(DT_Double);\
 data.resetOrigin();\
+}\
+Image_Value(pyImage).setDatatype(DT_Double);\
 MULTIDIM_ARRAY_GENERIC(Image_Value(pyImage)).setImage(data);\
 Py_RETURN_NONE;\
 }} catch (XmippError &xe)\
@@ -1091,6 +1102,7 @@ Image_align(PyObject *obj, PyObject *args, PyObject *kwargs)
 			//END AJ
 
 			Matrix2D<double> M;
+			GILReleaser releaser;
 			alignImagesConsideringMirrors(*mimg1, *mimgResult, M, true);
 		}
 	}
@@ -1142,8 +1154,11 @@ Image_applyCTF(PyObject *obj, PyObject *args, PyObject *kwargs)
 				   FileName fnCTF = PyString_AsString(pyStr);
 				   ctf.read(fnCTF);
 			   }
-				ctf.produceSideInfo();
-				ctf.applyCTF(*mImage,Ts,absPhase);
+				{
+					GILReleaser releaser;
+					ctf.produceSideInfo();
+					ctf.applyCTF(*mImage,Ts,absPhase);
+				}
 				Py_RETURN_NONE;
 			}
 		}
@@ -1167,24 +1182,35 @@ Image_projectVolumeDouble(PyObject *obj, PyObject *args, PyObject *kwargs)
     {
         try
         {
-            // We use the following macro to release the Python Interpreter Lock (GIL)
-            // while running this C extension code and allows threads to run concurrently.
-            // See: https://docs.python.org/2.7/c-api/init.html for details.
-            Py_BEGIN_ALLOW_THREADS
-            Projection P;
-			ImageObject *vol = (ImageObject*) pvol;
-            MultidimArray<double> * mVolume;
-            vol->image->data->getMultidimArrayPointer(mVolume);
-            ArrayDim aDim;
-            mVolume->getDimensions(aDim);
-            mVolume->setXmippOrigin();
-            projectVolume(*mVolume, P, aDim.xdim, aDim.ydim,rot, tilt, psi);
+            ImageObject *vol = (ImageObject*) pvol;
+            ImageGeneric *projection = new ImageGeneric();
+            try
+            {
+                // The projection runs without the Python Interpreter Lock (GIL)
+                // so that several threads can project concurrently. No Python
+                // object is touched until the lock is taken back.
+                // The volume may be projected by other threads at the same
+                // time, its origin is set on an alias
+                GILReleaser releaser;
+                Projection P;
+                MultidimArray<double> * mVolume;
+                vol->image->data->getMultidimArrayPointer(mVolume);
+                MultidimArray<double> V;
+                V.alias(*mVolume);
+                ArrayDim aDim;
+                V.getDimensions(aDim);
+                V.setXmippOrigin();
+                projectVolume(V, P, aDim.xdim, aDim.ydim,rot, tilt, psi);
+                projection->setDatatype(DT_Double);
+                projection->data->setImage(MULTIDIM_ARRAY(P));
+            }
+            catch (XmippError &xe)
+            {
+                delete projection;
+                throw;
+            }
             result = PyObject_New(ImageObject, &ImageType);
-            Image <double> I;
-            result->image = new ImageGeneric();
-            result->image->setDatatype(DT_Double);
-            result->image->data->setImage(MULTIDIM_ARRAY(P));
-            Py_END_ALLOW_THREADS
+            result->image = projection;
             return (PyObject *)result;
         }
         catch (XmippError &xe)
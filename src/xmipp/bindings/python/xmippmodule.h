@@ -45,6 +45,54 @@
 
 extern PyObject * PyXmippError;
 
+/** Release the Python Interpreter Lock (GIL) while in scope.
+ * Use it around C++ work that does not touch Python objects, so that
+ * other Python threads can run meanwhile. The GIL is acquired again when
+ * the scope is left, also through an exception, so that XmippErrors can
+ * be caught outside the scope and set as Python errors as usual. If release
+ * is false the GIL is kept.
+ *
+ * Thread safety of the entry points that release the GIL:
+ * - Image.read/write, projectVolumeDouble, image_align, applyCTF and the
+ *   preview filters (bandPassFilter, gaussianFilter, ...) only work on
+ *   the C++ objects of their arguments and on local data. FFTW plans are
+ *   created under the lock of FourierTransformer. As for numpy arrays, the
+ *   same Image object must not be modified by two threads at a time.
+ * - The HDF5 and TIFF libraries are not thread-safe, the entry points that
+ *   read or write files keep the GIL for them (see threadSafeImageFile).
+ * - fastEstimateEnhancedPSD reads its micrograph into local memory and
+ *   runs its own threads.
+ * - FourierProjector.projectVolume writes into buffers of the projector,
+ *   calls on the same projector are serialized by its own mutex.
+ * - MetaData methods keep the GIL: all metadata share the same SQLite
+ *   connection, so they cannot run while another thread uses any metadata.
+ */
+class GILReleaser
+{
+public:
+    GILReleaser(bool release=true)
+    {
+        state = release ? PyEval_SaveThread() : NULL;
+    }
+    ~GILReleaser()
+    {
+        if (state != NULL)
+            PyEval_RestoreThread(state);
+    }
+private:
+    PyThreadState *state;
+};
+
+/** True if the image file can be read or written without the GIL.
+ * This is false for the HDF5 and TIFF formats.
+ */
+inline bool threadSafeImageFile(const FileName &fn)
+{
+    String format = fn.getFileFormat();
+    return format.find("tif") == String::npos && format.find("hdf") == String::npos &&
+           format.find("h5") == String::npos;
+}
+
 #define SymList_Check(v) (((v)->ob_type == &SymListType))
 #define SymList_Value(v)  ((*((SymListObject*)(v))->symlist))
 
@@ -17,6 +17,7 @@
   ************************************************************************/
 
 #include "situs.h"
+#include "frm.h"
 #include <fftw3.h>
 #define SQT2 sqrt(2.0)
 
@@ -26,14 +27,12 @@
 /* external general library funtions */
 #include "lib_eul.h"
 #include "lib_vec.h"
+#include "lib_err.h"
 
 /* functions defined in this file */
-static void wigner(int, double, double *);
 static int prime(int, int);
 static double distance_eulers(unsigned long, unsigned long, double *[]);
 
-static void fourier_corr(int, double *, double *, double *, double *, double *, double *);
-
 /* Given two spherical function f and g, return the best correlation values and Euler angles. */
 int frm(double *f, int dim1, double *g, int dim2, double *res, int dim3)
 {
@@ -100,7 +99,7 @@ int frm(double *f, int dim1, double *g, int dim2, double *res, int dim3)
                             workspace);
   
   do_vect(&ddd, bw*(4*bw*bw-1)/3);
-  wigner(bw, 0.5*M_PI, ddd);    
+  sh_alignment::wigner(bw, 0.5*M_PI, ddd);    
 
  /* ==================== FRM COMPUTATIONS =======================*/  
 
@@ -139,7 +138,7 @@ int frm(double *f, int dim1, double *g, int dim2, double *res, int dim3)
   /* compute FT of correlation function */
 //  fprintf(stderr, "frmr> Computing Fourier coefficients of the correlation function...\n");
   do_vect(&coef_corr,2*size*size2);
-  fourier_corr(bw, coeffr_hi, coeffi_hi, coeffr_lo, coeffi_lo, ddd, coef_corr);  /* compute T(p,q,r) */
+  sh_alignment::fourier_corr(bw, coeffr_hi, coeffi_hi, coeffr_lo, coeffi_lo, ddd, coef_corr);  /* compute T(p,q,r) */
 
   /* free space */
   free(coeffr_hi); free(coeffi_hi);
@@ -338,7 +337,7 @@ int frm_corr(double *f, int dim1, double *g, int dim2, double *coef_corr, int di
                             workspace);
   
   do_vect(&ddd, bw*(4*bw*bw-1)/3);
-  wigner(bw, 0.5*M_PI, ddd);    
+  sh_alignment::wigner(bw, 0.5*M_PI, ddd);    
 
  /* ==================== FRM COMPUTATIONS =======================*/  
 
@@ -377,7 +376,7 @@ int frm_corr(double *f, int dim1, double *g, int dim2, double *coef_corr, int di
   /* compute FT of correlation function */
 //  fprintf(stderr, "frmr> Computing Fourier coefficients of the correlation function...\n");
 //  do_vect(&coef_corr,2*size*size2);
-  fourier_corr(bw, coeffr_hi, coeffi_hi, coeffr_lo, coeffi_lo, ddd, coef_corr);  /* compute T(p,q,r) */
+  sh_alignment::fourier_corr(bw, coeffr_hi, coeffi_hi, coeffr_lo, coeffi_lo, ddd, coef_corr);  /* compute T(p,q,r) */
 
   /* free space */
   free(coeffr_hi); free(coeffi_hi);
@@ -446,7 +445,7 @@ int frm_fourier_corr(double *fr, int dim1, double *fi, int dim2, double *gr, int
                             workspace);
   
   do_vect(&ddd, bw*(4*bw*bw-1)/3);
-  wigner(bw, 0.5*M_PI, ddd);    
+  sh_alignment::wigner(bw, 0.5*M_PI, ddd);    
 
  /* ==================== FRM COMPUTATIONS =======================*/  
 
@@ -484,7 +483,7 @@ int frm_fourier_corr(double *fr, int dim1, double *fi, int dim2, double *gr, int
   /* compute FT of correlation function */
 //  fprintf(stderr, "frmr> Computing Fourier coefficients of the correlation function...\n");
 //  do_vect(&coef_corr,2*size*size2);
-  fourier_corr(bw, coeffr_hi, coeffi_hi, coeffr_lo, coeffi_lo, ddd, coef_corr);  /* compute T(p,q,r) */
+  sh_alignment::fourier_corr(bw, coeffr_hi, coeffi_hi, coeffr_lo, coeffi_lo, ddd, coef_corr);  /* compute T(p,q,r) */
 
   /* free space */
   free(coeffr_hi); free(coeffi_hi);
@@ -505,8 +504,10 @@ int frm_fourier_corr(double *fr, int dim1, double *fi, int dim2, double *gr, int
   return 0;
 }
 
+namespace sh_alignment {
+
 /* Do the element-wise multiplication of FST coefficients from two function. */
-static void fourier_corr(int bw, double *coeffr_hi, double *coeffi_hi,
+void fourier_corr(int bw, double *coeffr_hi, double *coeffi_hi,
                   double *coeffr_lo, double *coeffi_lo, double *ddd, double *coef_corr){
 /* computes the Fourier coefficients of the correlation function */
 /* transposing the blocks of data */
@@ -603,7 +604,7 @@ static void fourier_corr(int bw, double *coeffr_hi, double *coeffi_hi,
 
 
 /*====================================================================*/
-static void wigner(int bw, double theta, double *ddd){
+void wigner(int bw, double theta, double *ddd){
   /* computes the d-functions for argument theta, for degrees 0 through bw-1 */
   /* the matrices are returned in the (3D) piramid ddd */
   /* Reference: T. Risbo, Journal of Geodesy (1996) 70:383-396 */
@@ -618,10 +619,8 @@ static void wigner(int bw, double theta, double *ddd){
   d  = (double *) malloc(size*size*sizeof(double));
   dd = (double *) malloc(size*size*sizeof(double));
 
-  if( (d == NULL) || (dd == NULL) ){
-      perror("Error in allocating memory");
-      exit(1);
-  }
+  if( (d == NULL) || (dd == NULL) )
+      error_memory_allocation(1, "frm");
 
   p=sin(theta/2); q=cos(theta/2);   /* Cayley-Klein parameters */
   pc=p; qc=q;
@@ -668,6 +667,8 @@ static void wigner(int bw, double theta, double *ddd){
   free(d); free(dd);
 }
 
+} // namespace sh_alignment
+
 
 /*====================================================================*/
 static int prime(int n, int s){
@@ -0,0 +1,51 @@
+/***************************************************************************
+  **************************************************************************
+
+                     C++ interface of Fast Rotational Matching
+
+   The functions of frm.cpp that are not only used through the Python
+   wrapper (swig_frm), so that the rotational search can be called from
+   C++ with precomputed tables.
+
+  ************************************************************************
+  ************************************************************************/
+
+#ifndef FRM_H
+#define FRM_H
+
+/* Given two spherical function f and g, return the best correlation values and Euler angles. */
+int frm(double *f, int dim1, double *g, int dim2, double *res, int dim3);
+
+/* Correlation of two real spherical functions sampled on a 2bw x 2bw grid.
+   coef_corr is a complex (2bw)^3 array (16 bw^3 doubles). */
+int frm_corr(double *f, int dim1, double *g, int dim2, double *coef_corr, int dim3);
+
+/* Correlation of two complex spherical functions */
+int frm_fourier_corr(double *fr, int dim1, double *fi, int dim2, double *gr, int dim3, double *gi, int dim4, double *coef_corr, int dim5);
+
+/* Top n local maxima of a real (2bw)^3 correlation volume. res holds n
+   quadruplets (correlation, psi, theta, phi), angles in degrees
+   (Goldstein convention, see get_rot_matrix). */
+int find_topn_angles(double *coef_corr, int dim1, int bw, double *res, int dim2, double dist_cut);
+
+/* Kept in a namespace, as their names are too generic for libXmipp */
+namespace sh_alignment {
+
+/* Wigner d-functions of argument theta for degrees 0 through bw-1.
+   ddd must hold bw*(4*bw*bw-1)/3 doubles. */
+void wigner(int bw, double theta, double *ddd);
+
+/* Add the Fourier coefficients of the correlation function of two functions
+   given by their spherical harmonic coefficients (as computed by
+   FST_semi_memo) to coef_corr, a complex (2bw)^3 array. ddd are the Wigner
+   d-functions at pi/2. Calling it several times on the same array adds
+   the correlations of all the pairs. */
+void fourier_corr(int bw, double *coeffr_hi, double *coeffi_hi,
+                  double *coeffr_lo, double *coeffi_lo, double *ddd, double *coef_corr);
+
+} // namespace sh_alignment
+
+/* Euler angles (psi, theta, phi) of the grid point (i,j,k) of the correlation volume */
+void idx2angle(int bw, int i, int j, int k, double *angle);
+
+#endif
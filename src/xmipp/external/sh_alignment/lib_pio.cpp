@@ -19,6 +19,7 @@
 #include "lib_pio.h"
 #include "lib_err.h"
 #include "lib_vec.h"
+#include <core/xmipp_error.h>
 
 /* reads atomic entries from PDB file and assigns atom mass, no stdout */
 void read_pdb_silent(char *file_name, unsigned *num_atoms, PDB **in_pdb)
@@ -188,8 +189,7 @@ int coord_precision(double fcoord)
   else if (fcoord < 999999.95 && fcoord >= -99999.95) return 1;
   else if (fcoord < 99999999.5 && fcoord >= -9999999.5) return 0;
   else {
-    fprintf(stderr, "lib_pio> Error: PDB coordinate out of range, PDB output aborted.\n");
-    exit(0);
+    REPORT_ERROR(ERR_VALUE_INCORRECT, "lib_pio> Error: PDB coordinate out of range, PDB output aborted.");
   }
 }
 
@@ -16,6 +16,7 @@
 #include "lib_vec.h"
 #include "lib_err.h"
 #include "lib_std.h"
+#include <core/xmipp_error.h>
 
 #define BARL 70  /* available space for histogram bars */
 
@@ -787,8 +788,7 @@ void relax_laplacian(double **phi, unsigned extx, unsigned exty,
     } else if (*(mask + indv) == 0) ++maskcount;
   }
   if (0 == threscount) {
-    printf("threscount was 0 (zero)\n");
-    exit(-1);
+    REPORT_ERROR(ERR_NUMERICAL, "lib_vwk> threscount was 0 (zero)");
   }
   norm /= (double)threscount; /* average density for thresholded volume, assuming threscount>0 */
   norm *= maskcount;/* density total one would get if mask=0 was filled with average */
@@ -26,6 +26,9 @@
  ***************************************************************************/
 
 #include <sstream>
+#include <thread>
+#include <random>
+#include <algorithm>
 
 #ifdef __sun
 #include <ieeefp.h>
@@ -265,6 +268,31 @@ void PCAAnalyzer::reset(ClassicTrainingVectors const &ts, std::vector<unsigned>
     REPORT_ERROR(ERR_NUMERICAL, "too many Jacobi iterations");
 }
 
+/* Streaming eigenvectors -------------------------------------------------- */
+void PCAAnalyzer::reset(PCASampleSource &source, int Neigen, int Nthreads)
+{
+    StreamingPCA pca(Neigen);
+    pca.Nthreads = Nthreads;
+    pca.learn(source);
+
+    clear();
+    int n = pca.d;
+    mean.resize(n);
+    for (int i = 0; i < n; i++)
+        mean[i] = VEC_ELEM(pca.mean, i);
+    eigenvec.resize(Neigen);
+    eigenval.resize(Neigen);
+    for (int j = 0; j < Neigen; j++)
+    {
+        eigenval[j] = VEC_ELEM(pca.eigenvalues, j);
+        FeatureVector &v = eigenvec[j];
+        v.resize(n);
+        for (int i = 0; i < n; i++)
+            v[i] = MAT_ELEM(pca.eigenvectors, i, j);
+    }
+    set_Dimension(Neigen);
+}
+
 #ifdef UNUSED // detected as unused 29.6.2018
 /* Prepare for correlation ------------------------------------------------- */
 void PCAAnalyzer::prepare_for_correlation()
@@ -558,3 +586,242 @@ void Running_PCA::project(const Matrix1D<double> &input,
         for (int i = 0; i < d; i++)
             output(j) += (input(i) - current_sample_mean(i)) * eigenvectors(i, j);
 }
+
+/* Streaming PCA ----------------------------------------------------------- */
+StreamingPCA::StreamingPCA(int _K, int _Niter, int _oversampling)
+{
+    K = _K;
+    Niter = _Niter;
+    oversampling = _oversampling;
+    Nthreads = 1;
+    center = true;
+    seed = 1;
+    verbose = 0;
+    d = 0;
+    N = 0;
+}
+
+// Orthonormalize the columns of Q (modified Gram-Schmidt, twice)
+// Columns that are linearly dependent on the previous ones are set to 0
+static void orthonormalizeColumns(Matrix2D<double> &Q)
+{
+    size_t d = MAT_YSIZE(Q), l = MAT_XSIZE(Q);
+    for (size_t j = 0; j < l; j++)
+    {
+        double norm0 = 0;
+        for (size_t i = 0; i < d; i++)
+            norm0 += MAT_ELEM(Q, i, j) * MAT_ELEM(Q, i, j);
+        for (int it = 0; it < 2; it++)
+            for (size_t jj = 0; jj < j; jj++)
+            {
+                double dot = 0;
+                for (size_t i = 0; i < d; i++)
+                    dot += MAT_ELEM(Q, i, j) * MAT_ELEM(Q, i, jj);
+                for (size_t i = 0; i < d; i++)
+                    MAT_ELEM(Q, i, j) -= dot * MAT_ELEM(Q, i, jj);
+            }
+        double norm = 0;
+        for (size_t i = 0; i < d; i++)
+            norm += MAT_ELEM(Q, i, j) * MAT_ELEM(Q, i, j);
+        norm = sqrt(norm);
+        double iNorm = (norm > 1e-10 * sqrt(norm0) && norm > 1e-300) ? 1.0 / norm : 0.0;
+        for (size_t i = 0; i < d; i++)
+            MAT_ELEM(Q, i, j) *= iNorm;
+    }
+}
+
+void StreamingPCA::accumulateThread(PCASampleSource *source, int thread, size_t first, size_t last,
+                                    const Matrix2D<double> *Q, Matrix2D<double> *Z,
+                                    Matrix1D<double> *sum, double *Nthr)
+{
+    size_t l = MAT_XSIZE(*Q);
+    Z->initZeros(d, l);
+    sum->initZeros(d);
+    *Nthr = 0;
+    Matrix2D<double> X;
+    std::vector<double> p(l);
+    for (size_t item = first; item < last; ++item)
+    {
+        source->getSamples(item, thread, X);
+        if (MAT_XSIZE(X) != d)
+            REPORT_ERROR(ERR_MATRIX_SIZE, "StreamingPCA: samples do not have the expected dimension");
+        for (size_t r = 0; r < MAT_YSIZE(X); ++r)
+        {
+            const double *x = &MAT_ELEM(X, r, 0);
+
+            // p=Q^t x
+            std::fill(p.begin(), p.end(), 0.0);
+            for (size_t i = 0; i < d; ++i)
+            {
+                double xi = x[i];
+                if (xi == 0)
+                    continue;
+                const double *ptrQ = &MAT_ELEM(*Q, i, 0);
+                for (size_t j = 0; j < l; ++j)
+                    p[j] += xi * ptrQ[j];
+            }
+
+            // Z+=x p^t
+            for (size_t i = 0; i < d; ++i)
+            {
+                double xi = x[i];
+                VEC_ELEM(*sum, i) += xi;
+                if (xi == 0)
+                    continue;
+                double *ptrZ = &MAT_ELEM(*Z, i, 0);
+                for (size_t j = 0; j < l; ++j)
+                    ptrZ[j] += xi * p[j];
+            }
+        }
+        *Nthr += MAT_YSIZE(X);
+        if (verbose && thread == 0)
+            progress_bar(item - first);
+    }
+}
+
+void StreamingPCA::accumulate(PCASampleSource &source, const Matrix2D<double> &Q,
+                              Matrix2D<double> &Z, Matrix1D<double> &sum)
+{
+    size_t Nitems = source.getNumberOfItems();
+    int Nthr = XMIPP_MAX(1, Nthreads);
+    std::vector< Matrix2D<double> > Zthr(Nthr);
+    std::vector< Matrix1D<double> > sumThr(Nthr);
+    std::vector<double> NThr(Nthr);
+    if (verbose)
+        init_progress_bar(Nitems / Nthr);
+    // The first error of any thread is reported once all of them finish
+    std::vector<std::string> errors(Nthr);
+    auto accumulateRange = [&](int t)
+    {
+        try
+        {
+            accumulateThread(&source, t, Nitems * t / Nthr, Nitems * (t + 1) / Nthr,
+                             &Q, &Zthr[t], &sumThr[t], &NThr[t]);
+        }
+        catch (XmippError &xe)
+        {
+            errors[t] = xe.msg;
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < Nthr; ++t)
+        threads.push_back(std::thread(accumulateRange, t));
+    accumulateRange(0);
+    for (size_t t = 0; t < threads.size(); ++t)
+        threads[t].join();
+    for (int t = 0; t < Nthr; ++t)
+        if (!errors[t].empty())
+            REPORT_ERROR(ERR_UNCLASSIFIED, errors[t]);
+    if (verbose)
+        progress_bar(Nitems / Nthr);
+
+    // Merge the partial sketches
+    Z = Zthr[0];
+    sum = sumThr[0];
+    N = NThr[0];
+    for (int t = 1; t < Nthr; ++t)
+    {
+        Z += Zthr[t];
+        sum += sumThr[t];
+        N += NThr[t];
+    }
+    source.reduceSums(Z, sum, N);
+    if (N == 0)
+        REPORT_ERROR(ERR_VALUE_INCORRECT, "StreamingPCA: there are no samples");
+
+    // Center: sum (x-mu)(x-mu)^t Q = sum x x^t Q - N mu mu^t Q
+    if (center)
+    {
+        std::vector<double> muQ(MAT_XSIZE(Q), 0.0);
+        for (size_t i = 0; i < d; ++i)
+            for (size_t j = 0; j < MAT_XSIZE(Q); ++j)
+                muQ[j] += VEC_ELEM(sum, i) * MAT_ELEM(Q, i, j);
+        double iN = 1.0 / N;
+        for (size_t i = 0; i < d; ++i)
+        {
+            double mui = VEC_ELEM(sum, i) * iN;
+            for (size_t j = 0; j < MAT_XSIZE(Q); ++j)
+                MAT_ELEM(Z, i, j) -= mui * muQ[j];
+        }
+    }
+}
+
+void StreamingPCA::learn(PCASampleSource &source)
+{
+    d = source.getSampleDimension();
+    if (K < 1 || (size_t)K > d)
+        REPORT_ERROR(ERR_VALUE_INCORRECT, "StreamingPCA: incorrect number of components");
+    size_t l = XMIPP_MIN(d, (size_t)(K + XMIPP_MAX(0, oversampling)));
+
+    // Random initial subspace. All MPI nodes generate the same one.
+    Matrix2D<double> Q(d, l), Z;
+    Matrix1D<double> sum;
+    std::mt19937 generator(seed);
+    std::normal_distribution<double> gaussian(0.0, 1.0);
+    FOR_ALL_ELEMENTS_IN_MATRIX2D(Q)
+        MAT_ELEM(Q, i, j) = gaussian(generator);
+    orthonormalizeColumns(Q);
+
+    // Subspace iteration: Q=orth(C Q)
+    for (int it = 0; it <= Niter; ++it)
+    {
+        if (verbose)
+            std::cout << "Streaming PCA: pass " << it + 1 << " of " << Niter + 1 << std::endl;
+        accumulate(source, Q, Z, sum);
+        if (it < Niter)
+        {
+            Q = Z;
+            orthonormalizeColumns(Q);
+        }
+    }
+
+    // Rayleigh-Ritz: eigenvectors of the covariance restricted to span(Q)
+    Matrix2D<double> B(l, l);
+    for (size_t j1 = 0; j1 < l; ++j1)
+        for (size_t j2 = j1; j2 < l; ++j2)
+        {
+            double b12 = 0, b21 = 0;
+            for (size_t i = 0; i < d; ++i)
+            {
+                b12 += MAT_ELEM(Q, i, j1) * MAT_ELEM(Z, i, j2);
+                b21 += MAT_ELEM(Q, i, j2) * MAT_ELEM(Z, i, j1);
+            }
+            MAT_ELEM(B, j1, j2) = MAT_ELEM(B, j2, j1) = 0.5 * (b12 + b21) / N;
+        }
+    // B is symmetric and positive semidefinite, its SVD is its eigendecomposition
+    Matrix2D<double> U, V;
+    Matrix1D<double> S;
+    svdcmp(B, U, S, V);
+    std::vector<size_t> order(l);
+    for (size_t j = 0; j < l; ++j)
+        order[j] = j;
+    std::sort(order.begin(), order.end(),
+              [&S](size_t a, size_t b) { return VEC_ELEM(S, a) > VEC_ELEM(S, b); });
+
+    eigenvectors.initZeros(d, K);
+    eigenvalues.initZeros(K);
+    for (int k = 0; k < K; ++k)
+    {
+        size_t jk = order[k];
+        VEC_ELEM(eigenvalues, k) = VEC_ELEM(S, jk);
+        for (size_t i = 0; i < d; ++i)
+        {
+            double v = 0;
+            for (size_t j = 0; j < l; ++j)
+                v += MAT_ELEM(Q, i, j) * MAT_ELEM(U, j, jk);
+            MAT_ELEM(eigenvectors, i, k) = v;
+        }
+    }
+    if (center)
+        mean = sum / N;
+    else
+        mean.initZeros(d);
+}
+
+void StreamingPCA::project(const Matrix1D<double> &input, Matrix1D<double> &output) const
+{
+    output.initZeros(K);
+    for (int k = 0; k < K; k++)
+        for (size_t i = 0; i < d; i++)
+            VEC_ELEM(output, k) += (VEC_ELEM(input, i) - VEC_ELEM(mean, i)) * MAT_ELEM(eigenvectors, i, k);
+}
@@ -32,6 +32,8 @@
 /**@defgroup PCA Principal Component Analysis
    @ingroup ClassificationLibrary */
 //@{
+class PCASampleSource;
+
 /** Basic PCA class */
 class PCAAnalyzer
 {
@@ -115,6 +117,16 @@ public:
     void setIdentity(int n);
 #endif
 
+    /**
+    * Calculate the eigenval/vecs with the streaming PCA.
+    * The vectors are read from source (see StreamingPCA), so that
+    * they need not be in memory.
+    * Parameter: source The vectors.
+    * Parameter: Neigen Number of eigenvectors to compute.
+    * Parameter: Nthreads Number of threads.
+    */
+    void reset(PCASampleSource &source, int Neigen, int Nthreads=1);
+
     /** Clear.
     Clean the eigenvector, eigenvalues and D */
     void clear();
@@ -286,6 +298,116 @@ public:
     Matrix1D<double> sum_proj2;
 };
 
+/** Source of samples for the streaming PCA.
+    The samples are grouped in items (typically, one image or volume)
+    that are requested one at a time, so that the whole data matrix
+    is never in memory. */
+class PCASampleSource
+{
+public:
+    /// Destructor
+    virtual ~PCASampleSource() {}
+
+    /// Dimension of the sample vectors
+    virtual size_t getSampleDimension()=0;
+
+    /// Number of items
+    virtual size_t getNumberOfItems()=0;
+
+    /** Samples of an item.
+        Each row of samples is a sample vector (an item may produce several
+        samples, e.g., rotated copies of an image). This function is called
+        concurrently from several threads; thread (0<=thread<Nthreads) can be
+        used to select thread private readers and buffers. */
+    virtual void getSamples(size_t item, int thread, Matrix2D<double> &samples)=0;
+
+    /** Combine the sums of several processes.
+        It is called once per pass over the data with the partial sums of this
+        process. MPI programs in which each node reads a part of the items must
+        add them over all nodes. */
+    virtual void reduceSums(Matrix2D<double> &sketch, Matrix1D<double> &sum, double &N)
+    {}
+};
+
+/** Streaming PCA.
+    Randomized subspace iteration (N. Halko, P.G. Martinsson, J.A. Tropp.
+    Finding structure with randomness: probabilistic algorithms for
+    constructing approximate matrix decompositions. SIAM Review, 53: 217-288
+    (2011)). Each pass over the data accumulates the product of the
+    covariance matrix by the current subspace, a d x (K+oversampling) matrix,
+    so that the memory needed does not depend on the number of samples. The
+    items are distributed among threads that accumulate their own partial
+    sketches, which are added at the end of the pass.
+
+    @code
+    StreamingPCA pca(10);
+    pca.Nthreads=4;
+    pca.learn(source);
+    pca.project(x,proj);
+    @endcode
+*/
+class StreamingPCA
+{
+public:
+    /// Number of principal components
+    int K;
+
+    /// Number of extra vectors of the subspace
+    int oversampling;
+
+    /// Number of power iterations (passes over the data are Niter+1)
+    int Niter;
+
+    /// Number of threads
+    int Nthreads;
+
+    /** Subtract the mean.
+        If false, the eigenvectors are those of the second order moment
+        matrix, i.e., the left singular vectors of the data matrix. */
+    bool center;
+
+    /// Seed of the initial random subspace
+    unsigned int seed;
+
+    /// Show progress
+    int verbose;
+
+    /// Dimension of the sample vectors
+    size_t d;
+
+    /// Number of samples seen
+    double N;
+
+    /// Mean of the samples (zero if not centered)
+    Matrix1D<double> mean;
+
+    /** Principal components.
+        Each column is an eigenvector. They are sorted by decreasing
+        eigenvalue. */
+    Matrix2D<double> eigenvectors;
+
+    /// Variance along each principal component
+    Matrix1D<double> eigenvalues;
+public:
+    /// Constructor
+    StreamingPCA(int _K, int _Niter=2, int _oversampling=10);
+
+    /// Compute the principal components of the samples in source
+    void learn(PCASampleSource &source);
+
+    /// Project a sample vector on the PCA space
+    void project(const Matrix1D<double> &input, Matrix1D<double> &output) const;
+protected:
+    // Z=sum x x^t Q and sum=sum x over all samples
+    void accumulate(PCASampleSource &source, const Matrix2D<double> &Q,
+                    Matrix2D<double> &Z, Matrix1D<double> &sum);
+
+    // Accumulate the samples of items [first, last) of this thread
+    void accumulateThread(PCASampleSource *source, int thread, size_t first, size_t last,
+                          const Matrix2D<double> *Q, Matrix2D<double> *Z,
+                          Matrix1D<double> *sum, double *Nthr);
+};
+
 //@}
 #endif
 
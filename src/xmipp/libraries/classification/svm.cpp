@@ -11,6 +11,9 @@
 #include <stdarg.h>
 #include <limits.h>
 #include <locale.h>
+#include <thread>
+#include <vector>
+#include <unordered_map>
 #include "svm.h"
 int libsvm_version = LIBSVM_VERSION;
 typedef float Qfloat;
@@ -203,6 +206,8 @@ public:
 	virtual ~QMatrix() {}
 };
 
+class KernelMatrix;
+
 class Kernel: public QMatrix {
 public:
 	Kernel(int l, svm_node * const * x, const svm_parameter& param);
@@ -216,6 +221,7 @@ public:
 	{
 		swap(x[i],x[j]);
 		if(x_square) swap(x_square[i],x_square[j]);
+		if(shared_idx) swap(shared_idx[i],shared_idx[j]);
 	}
 protected:
 
@@ -225,6 +231,10 @@ private:
 	const svm_node **x;
 	double *x_square;
 
+	// Index of each vector in the shared kernel matrix
+	const KernelMatrix *shared;
+	int *shared_idx;
+
 	// svm_parameter
 	const int kernel_type;
 	const int degree;
@@ -252,8 +262,121 @@ private:
 	{
 		return x[i][(int)(x[j][0].value)].value;
 	}
+	double kernel_shared(int i, int j) const;
+};
+
+//
+// Kernel matrix of all the training vectors.
+// With probability estimates, several models are trained on subsets of
+// the same vectors (cross-validation and final model). The kernel matrix
+// is computed once, with several threads, and shared by all of them.
+// The values are the double precision ones of the solver kernel, so that
+// the trained models do not change.
+//
+class KernelRows;
+class KernelMatrix
+{
+public:
+	KernelMatrix(const svm_problem *prob, const svm_parameter *param);
+
+	// Whether the matrix is worth computing and fits in the cache size
+	static bool useful(const svm_problem *prob, const svm_parameter *param);
+
+	// Index of a vector in the matrix, -1 if it is not there
+	int find(const svm_node *x) const
+	{
+		std::unordered_map<const svm_node *,int>::const_iterator it = index.find(x);
+		return it == index.end() ? -1 : it->second;
+	}
+
+	double get(int i, int j) const
+	{
+		return K[(size_t)i*l+j];
+	}
+
+	// Whether the kernel is the same
+	bool sameKernel(const svm_parameter& param) const
+	{
+		return param.kernel_type == kernel.kernel_type && param.degree == kernel.degree &&
+		       param.gamma == kernel.gamma && param.coef0 == kernel.coef0;
+	}
+private:
+	int l;
+	svm_parameter kernel;
+	std::vector<double> K;
+	std::unordered_map<const svm_node *,int> index;
+
+	void computeRows(const KernelRows *rows, int thread, int nr_thread);
+};
+
+// Kernel matrix of the svm_train in progress in this thread
+static thread_local const KernelMatrix *shared_kernel_matrix = NULL;
+
+bool KernelMatrix::useful(const svm_problem *prob, const svm_parameter *param)
+{
+	if(param->kernel_type == PRECOMPUTED || (!param->probability && param->nr_thread <= 1))
+		return false;
+	double size = (double)prob->l*prob->l*sizeof(double);
+	return size <= param->cache_size*(1<<20);
+}
+
+// Kernel values of a set of vectors as computed by the solver kernel
+class KernelRows: public Kernel
+{
+public:
+	KernelRows(const svm_problem *prob, const svm_parameter& param)
+	:Kernel(prob->l, prob->x, param)
+	{
+	}
+
+	double value(int i, int j) const
+	{
+		return (this->*kernel_function)(i,j);
+	}
+
+	Qfloat *get_Q(int column, int len) const
+	{
+		return NULL;
+	}
+
+	double *get_QD() const
+	{
+		return NULL;
+	}
 };
 
+KernelMatrix::KernelMatrix(const svm_problem *prob, const svm_parameter *param)
+{
+	l = prob->l;
+	kernel = *param;
+	K.resize((size_t)l*l);
+	for(int i=0;i<l;i++)
+		index[prob->x[i]] = i;
+
+	// Built before the matrix is shared, so it computes the values
+	KernelRows rows(prob,*param);
+	int nr_thread = max(1,param->nr_thread);
+	std::vector<std::thread> threads;
+	for(int t=1;t<nr_thread;t++)
+		threads.push_back(std::thread(&KernelMatrix::computeRows,this,&rows,t,nr_thread));
+	computeRows(&rows,0,nr_thread);
+	for(size_t t=0;t<threads.size();t++)
+		threads[t].join();
+}
+
+void KernelMatrix::computeRows(const KernelRows *rows, int thread, int nr_thread)
+{
+	// Rows are interleaved among threads to balance the triangular workload
+	for(int i=thread;i<l;i+=nr_thread)
+		for(int j=0;j<=i;j++)
+			K[(size_t)i*l+j] = K[(size_t)j*l+i] = rows->value(i,j);
+}
+
+double Kernel::kernel_shared(int i, int j) const
+{
+	return shared->get(shared_idx[i],shared_idx[j]);
+}
+
 Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param)
 :kernel_type(param.kernel_type), degree(param.degree),
  gamma(param.gamma), coef0(param.coef0)
@@ -287,12 +410,35 @@ Kernel::Kernel(int l, svm_node * const * x_, const svm_parameter& param)
 	}
 	else
 		x_square = 0;
+
+	// Look up the kernel values in the shared matrix if all the vectors are there
+	shared = NULL;
+	shared_idx = NULL;
+	if(shared_kernel_matrix != NULL && shared_kernel_matrix->sameKernel(param))
+	{
+		shared_idx = new int[l];
+		int i;
+		for(i=0;i<l;i++)
+			if((shared_idx[i] = shared_kernel_matrix->find(x[i])) < 0)
+				break;
+		if(i == l)
+		{
+			shared = shared_kernel_matrix;
+			kernel_function = &Kernel::kernel_shared;
+		}
+		else
+		{
+			delete[] shared_idx;
+			shared_idx = NULL;
+		}
+	}
 }
 
 Kernel::~Kernel()
 {
 	delete[] x;
 	delete[] x_square;
+	delete[] shared_idx;
 }
 
 double Kernel::dot(const svm_node *px, const svm_node *py)
@@ -2077,6 +2223,14 @@ static void svm_group_classes(const svm_problem *prob, int *nr_class_ret, int **
 //
 svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 {
+	// The models trained inside this one (probability estimates) share the kernel matrix
+	KernelMatrix *kernel_matrix = NULL;
+	if(shared_kernel_matrix == NULL && KernelMatrix::useful(prob,param))
+	{
+		kernel_matrix = new KernelMatrix(prob,param);
+		shared_kernel_matrix = kernel_matrix;
+	}
+
 	svm_model *model = Malloc(svm_model,1);
 	model->param = *param;
 	model->free_sv = 0;	// XXX
@@ -2311,6 +2465,11 @@ svm_model *svm_train(const svm_problem *prob, const svm_parameter *param)
 		free(nz_count);
 		free(nz_start);
 	}
+	if(kernel_matrix != NULL)
+	{
+		shared_kernel_matrix = NULL;
+		delete kernel_matrix;
+	}
 	return model;
 }
 
@@ -2463,7 +2622,7 @@ double svm_get_svr_probability(const svm_model *model)
 }
 #endif
 
-double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values)
+double svm_predict_values_from_kernel(const svm_model *model, const double *kvalue, double* dec_values)
 {
 	int i;
 	if(model->param.svm_type == ONE_CLASS ||
@@ -2473,7 +2632,7 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 		double *sv_coef = model->sv_coef[0];
 		double sum = 0;
 		for(i=0;i<model->l;i++)
-			sum += sv_coef[i] * Kernel::k_function(x,model->SV[i],model->param);
+			sum += sv_coef[i] * kvalue[i];
 		sum -= model->rho[0];
 		*dec_values = sum;
 
@@ -2485,11 +2644,6 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 	else
 	{
 		int nr_class = model->nr_class;
-		int l = model->l;
-		
-		double *kvalue = Malloc(double,l);
-		for(i=0;i<l;i++)
-			kvalue[i] = Kernel::k_function(x,model->SV[i],model->param);
 
 		int *start = Malloc(int,nr_class);
 		start[0] = 0;
@@ -2532,13 +2686,23 @@ double svm_predict_values(const svm_model *model, const svm_node *x, double* dec
 			if(vote[i] > vote[vote_max_idx])
 				vote_max_idx = i;
 
-		free(kvalue);
 		free(start);
 		free(vote);
 		return model->label[vote_max_idx];
 	}
 }
 
+double svm_predict_values(const svm_model *model, const svm_node *x, double* dec_values)
+{
+	int l = model->l;
+	double *kvalue = Malloc(double,l);
+	for(int i=0;i<l;i++)
+		kvalue[i] = Kernel::k_function(x,model->SV[i],model->param);
+	double pred_result = svm_predict_values_from_kernel(model, kvalue, dec_values);
+	free(kvalue);
+	return pred_result;
+}
+
 double svm_predict(const svm_model *model, const svm_node *x)
 {
 	int nr_class = model->nr_class;
@@ -2554,17 +2718,23 @@ double svm_predict(const svm_model *model, const svm_node *x)
 	return pred_result;
 }
 
-double svm_predict_probability(
-	const svm_model *model, const svm_node *x, double *prob_estimates)
+double svm_predict_probability_from_kernel(
+	const svm_model *model, const double *kvalue, double *prob_estimates)
 {
+	int nr_class = model->nr_class;
+	double *dec_values;
+	if(model->param.svm_type == ONE_CLASS ||
+	   model->param.svm_type == EPSILON_SVR ||
+	   model->param.svm_type == NU_SVR)
+		dec_values = Malloc(double, 1);
+	else 
+		dec_values = Malloc(double, nr_class*(nr_class-1)/2);
+	double pred_result = svm_predict_values_from_kernel(model, kvalue, dec_values);
+
 	if ((model->param.svm_type == C_SVC || model->param.svm_type == NU_SVC) &&
 	    model->probA!=NULL && model->probB!=NULL)
 	{
 		int i;
-		int nr_class = model->nr_class;
-		double *dec_values = Malloc(double, nr_class*(nr_class-1)/2);
-		svm_predict_values(model, x, dec_values);
-
 		double min_prob=1e-7;
 		double **pairwise_prob=Malloc(double *,nr_class);
 		for(i=0;i<nr_class;i++)
@@ -2585,12 +2755,23 @@ double svm_predict_probability(
 				prob_max_idx = i;
 		for(i=0;i<nr_class;i++)
 			free(pairwise_prob[i]);
-		free(dec_values);
-		free(pairwise_prob);	     
-		return model->label[prob_max_idx];
+		free(pairwise_prob);
+		pred_result = model->label[prob_max_idx];
 	}
-	else 
-		return svm_predict(model, x);
+	free(dec_values);
+	return pred_result;
+}
+
+double svm_predict_probability(
+	const svm_model *model, const svm_node *x, double *prob_estimates)
+{
+	int l = model->l;
+	double *kvalue = Malloc(double,l);
+	for(int i=0;i<l;i++)
+		kvalue[i] = Kernel::k_function(x,model->SV[i],model->param);
+	double pred_result = svm_predict_probability_from_kernel(model, kvalue, prob_estimates);
+	free(kvalue);
+	return pred_result;
 }
 
 static const char *svm_type_table[] =
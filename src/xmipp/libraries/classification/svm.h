@@ -48,6 +48,7 @@ struct svm_parameter
 	double p;	/* for EPSILON_SVR */
 	int shrinking;	/* use the shrinking heuristics */
 	int probability; /* do probability estimates */
+	int nr_thread;	/* threads for the kernel matrix */
 };
 
 //
@@ -95,6 +96,10 @@ double svm_predict_values(const struct svm_model *model, const struct svm_node *
 double svm_predict(const struct svm_model *model, const struct svm_node *x);
 double svm_predict_probability(const struct svm_model *model, const struct svm_node *x, double* prob_estimates);
 
+/* Same as above, but from the kernel values kvalue[i]=K(x,SV[i]) of the sample */
+double svm_predict_values_from_kernel(const struct svm_model *model, const double *kvalue, double* dec_values);
+double svm_predict_probability_from_kernel(const struct svm_model *model, const double *kvalue, double* prob_estimates);
+
 void svm_free_model_content(struct svm_model *model_ptr);
 void svm_free_and_destroy_model(struct svm_model **model_ptr_ptr);
 void svm_destroy_param(struct svm_parameter *param);
@@ -23,6 +23,8 @@
  *  e-mail address 'xmipp@cnb.csic.es'                                  
  ***************************************************************************/
 #include "svm_classifier.h"
+#include <thread>
+#include <algorithm>
 
 #ifdef UNUSED // detected as unused 29.6.2018
 bool findElementIn1DArray(MultidimArray<double> &inputArray,double element)
@@ -48,6 +50,7 @@ void SVMClassifier::setParameters(double c,double gamma)
     param.p = 0.1;
     param.shrinking = 1;
     param.probability = 1;
+    param.nr_thread = 1;
     param.nr_weight = 0;
     param.weight_label = NULL;
     param.weight = NULL;
@@ -68,8 +71,9 @@ SVMClassifier::~SVMClassifier()
         delete [] prob.x;
     }
 }
-void SVMClassifier::SVMTrain(MultidimArray<double> &trainSet,MultidimArray<double> &label)
+void SVMClassifier::SVMTrain(MultidimArray<double> &trainSet,MultidimArray<double> &label,int Nthreads)
 {
+    param.nr_thread = Nthreads;
 
     prob.l = YSIZE(trainSet);
     prob.y = new double[prob.l];
@@ -101,6 +105,7 @@ void SVMClassifier::SVMTrain(MultidimArray<double> &trainSet,MultidimArray<doubl
         exit(1);
     }
     model=svm_train(&prob,&param);
+    denseSV.clear();
 }
 double SVMClassifier::predict(MultidimArray<double> &featVec,double &score)
 {
@@ -132,6 +137,94 @@ double SVMClassifier::predict(MultidimArray<double> &featVec,double &score)
     delete [] x_space;
     return label;
 }
+void SVMClassifier::prepareDenseSV(size_t Nfeatures)
+{
+    if (YSIZE(denseSV)==(size_t)model->l && XSIZE(denseSV)==Nfeatures)
+        return;
+    denseSV.initZeros(model->l,Nfeatures);
+    normSV2.initZeros(model->l);
+    for (int k=0;k<model->l;k++)
+    {
+        double norm2=0;
+        for (const svm_node *node=model->SV[k];node->index!=-1;++node)
+        {
+            if (node->index<=(int)Nfeatures)
+                DIRECT_A2D_ELEM(denseSV,k,node->index-1)=node->value;
+            norm2+=node->value*node->value;
+        }
+        DIRECT_A1D_ELEM(normSV2,k)=norm2;
+    }
+}
+
+void SVMClassifier::predictRows(const MultidimArray<double> *featMatrix, MultidimArray<double> *labels,
+                                MultidimArray<double> *scores, size_t first, size_t last) const
+{
+    const svm_parameter &mparam=model->param;
+    int nr_class=svm_get_nr_class(model);
+    size_t Nfeatures=XSIZE(*featMatrix);
+    std::vector<double> kvalue(model->l), prob_estimates(nr_class);
+    for (size_t i=first;i<last;i++)
+    {
+        const double *x=&DIRECT_A2D_ELEM(*featMatrix,i,0);
+        double norm2=0;
+        for (size_t j=0;j<Nfeatures;j++)
+            norm2+=x[j]*x[j];
+        for (int k=0;k<model->l;k++)
+        {
+            const double *sv=&DIRECT_A2D_ELEM(denseSV,k,0);
+            double dot=0;
+            for (size_t j=0;j<Nfeatures;j++)
+                dot+=x[j]*sv[j];
+            switch (mparam.kernel_type)
+            {
+            case LINEAR1:
+                kvalue[k]=dot;
+                break;
+            case POLY:
+                kvalue[k]=pow(mparam.gamma*dot+mparam.coef0,mparam.degree);
+                break;
+            case RBF:
+                kvalue[k]=exp(-mparam.gamma*(norm2+DIRECT_A1D_ELEM(normSV2,k)-2*dot));
+                break;
+            case SIGMOID:
+                kvalue[k]=tanh(mparam.gamma*dot+mparam.coef0);
+                break;
+            }
+        }
+        std::fill(prob_estimates.begin(),prob_estimates.end(),0.0);
+        double label=svm_predict_probability_from_kernel(model,&kvalue[0],&prob_estimates[0]);
+        // Extracting the probability of the selected class
+        double score=prob_estimates[0];
+        for (int c=1;c<nr_class;++c)
+            if (prob_estimates[c]>score)
+                score=prob_estimates[c];
+        DIRECT_A1D_ELEM(*labels,i)=label;
+        DIRECT_A1D_ELEM(*scores,i)=score;
+    }
+}
+
+void SVMClassifier::predict(const MultidimArray<double> &featMatrix, MultidimArray<double> &labels,
+                            MultidimArray<double> &scores, int Nthreads)
+{
+    if (model->param.kernel_type==PRECOMPUTED)
+        REPORT_ERROR(ERR_NOT_IMPLEMENTED,"Batched prediction is not implemented for precomputed kernels");
+    size_t N=YSIZE(featMatrix);
+    labels.initZeros(N);
+    scores.initZeros(N);
+    if (N==0)
+        return;
+    prepareDenseSV(XSIZE(featMatrix));
+
+    int Nthr=XMIPP_MAX(1,XMIPP_MIN(Nthreads,(int)N));
+    std::vector<std::thread> threads;
+    for (int t=1;t<Nthr;t++)
+        threads.push_back(std::thread(&SVMClassifier::predictRows,this,&featMatrix,&labels,&scores,
+                                      N*t/Nthr,N*(t+1)/Nthr));
+    predictRows(&featMatrix,&labels,&scores,0,N/Nthr);
+    for (size_t t=0;t<threads.size();t++)
+        threads[t].join();
+}
+
 void SVMClassifier::SaveModel(const FileName &fnModel)
 {
     if (model->l!=0)
@@ -140,6 +233,7 @@ void SVMClassifier::SaveModel(const FileName &fnModel)
 void SVMClassifier::LoadModel(const FileName &fnModel)
 {
     model=svm_load_model(fnModel.c_str());
+    denseSV.clear();
 }
 
 #ifdef UNUSED // detected as unused 29.6.2018
@@ -49,11 +49,33 @@ public:
 
     //SVMClassifier(double c,double gamma);
     ~SVMClassifier();
-    void SVMTrain(MultidimArray<double> &trainSet,MultidimArray<double> &lable);
+    /** Train.
+     * Each row of trainSet is a feature vector. The kernel matrix is
+     * computed with Nthreads threads and shared by the cross-validation
+     * models of the probability estimates.
+     */
+    void SVMTrain(MultidimArray<double> &trainSet,MultidimArray<double> &lable,int Nthreads=1);
     double  predict(MultidimArray<double> &featVec,double &score);
+    /** Predict a set of feature vectors.
+     * Each row of featMatrix is a feature vector. The label and the score
+     * (probability of the predicted class) of each row are returned in
+     * labels and scores. The rows are distributed among Nthreads threads.
+     */
+    void predict(const MultidimArray<double> &featMatrix, MultidimArray<double> &labels,
+                 MultidimArray<double> &scores, int Nthreads=1);
     void SaveModel(const FileName &fnModel);
     void LoadModel(const FileName &fnModel);
     void setParameters(double c,double gamma);
+protected:
+    // Support vectors as dense rows and their squared norms
+    MultidimArray<double> denseSV, normSV2;
+
+    // Fill denseSV from the model
+    void prepareDenseSV(size_t Nfeatures);
+
+    // Predict the rows [first,last) of featMatrix
+    void predictRows(const MultidimArray<double> *featMatrix, MultidimArray<double> *labels,
+                     MultidimArray<double> *scores, size_t first, size_t last) const;
 #ifdef UNUSED // detected as unused 29.6.2018
     int getNumClasses();
 #endif
@@ -0,0 +1,561 @@
+/***************************************************************************
+ *
+ * Authors:     Carlos Oscar S. Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef BSPLINE_INTERPOLATION_H
+#define BSPLINE_INTERPOLATION_H
+
+#include <cmath>
+#include <vector>
+#include <core/multidim_array.h>
+#include <core/transformations.h>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+/**@defgroup BSplineInterpolation Batched B-spline interpolation
+   @ingroup DataLibrary
+
+   Tensor-product B-spline evaluation of many sample points per call.
+   The weights of each point are computed once per axis (instead of once
+   per tap as in interpolatedElementBSpline3D), and the inner product
+   of the coefficients and the weights is vectorized when the code is
+   compiled with AVX2 or AVX-512 support. Other instruction sets use the
+   scalar path, which gives the same result up to rounding.
+
+   Coordinates are logical (the origin of the array is taken into account),
+   and the coefficients must have been computed with produceSplineCoefficients
+   for degree 3. For degree 1 the coefficients are the samples themselves.
+   @{
+*/
+
+/** Boundary conditions.
+ * MIRROR is the convention of interpolatedElementBSpline2D/3D.
+ * ZERO considers that the samples outside the array are 0, as
+ * interpolatedElement3D and interpolatedElement2DOutsideZero.
+ */
+enum BSplineBoundary { BSPLINE_BOUNDARY_MIRROR, BSPLINE_BOUNDARY_ZERO };
+
+/** Number of points processed together in the batched functions */
+#define BSPLINE_BATCH 64
+
+/** Weights of a B-spline of a given degree.
+ * weights(x,w) fills the support+1 weights of the taps l1, l1+1, ... and
+ * returns l1.
+ */
+template<int Degree> struct BSplineKernel;
+
+template<> struct BSplineKernel<1>
+{
+    static const int support = 2;
+    static inline int weights(double x, double *w)
+    {
+        int l1 = (int)floor(x);
+        double t = x - l1;
+        w[0] = 1.0 - t;
+        w[1] = t;
+        return l1;
+    }
+};
+
+template<> struct BSplineKernel<3>
+{
+    static const int support = 4;
+    static inline int weights(double x, double *w)
+    {
+        int l1 = (int)ceil(x - 2);
+        double t = x - l1 - 1; // Distance to the second tap, in (0,1]
+        double t1 = 1.0 - t;
+        double t2 = t * t;
+        w[0] = t1 * t1 * t1 * (1.0 / 6.0);
+        w[1] = 2.0 / 3.0 - t2 + 0.5 * t2 * t;
+        w[2] = 2.0 / 3.0 - t1 * t1 + 0.5 * t1 * t1 * t1;
+        w[3] = t2 * t * (1.0 / 6.0);
+        return l1;
+    }
+};
+
+/** Weights of N points.
+ * w is of size N*support, the weights of point n start at w+n*support.
+ */
+template<int Degree>
+void bsplineWeights(const double *x, size_t N, int *l, double *w)
+{
+    const int S = BSplineKernel<Degree>::support;
+    size_t n = 0;
+#if defined(__AVX2__)
+    if (Degree == 3)
+    {
+        const __m256d two = _mm256_set1_pd(2.0);
+        const __m256d one = _mm256_set1_pd(1.0);
+        const __m256d half = _mm256_set1_pd(0.5);
+        const __m256d twoThirds = _mm256_set1_pd(2.0 / 3.0);
+        const __m256d sixth = _mm256_set1_pd(1.0 / 6.0);
+        for (; n + 4 <= N; n += 4)
+        {
+            __m256d vx = _mm256_loadu_pd(x + n);
+            __m256d vl = _mm256_ceil_pd(_mm256_sub_pd(vx, two));
+            __m256d t = _mm256_sub_pd(_mm256_sub_pd(vx, vl), one);
+            __m256d t1 = _mm256_sub_pd(one, t);
+            __m256d t2 = _mm256_mul_pd(t, t);
+            __m256d t12 = _mm256_mul_pd(t1, t1);
+            __m256d w0 = _mm256_mul_pd(_mm256_mul_pd(t12, t1), sixth);
+            __m256d w1 = _mm256_add_pd(_mm256_sub_pd(twoThirds, t2),
+                                       _mm256_mul_pd(half, _mm256_mul_pd(t2, t)));
+            __m256d w2 = _mm256_add_pd(_mm256_sub_pd(twoThirds, t12),
+                                       _mm256_mul_pd(half, _mm256_mul_pd(t12, t1)));
+            __m256d w3 = _mm256_mul_pd(_mm256_mul_pd(t2, t), sixth);
+            _mm_storeu_si128((__m128i *)(l + n), _mm256_cvttpd_epi32(vl));
+            // Transpose so that the weights of each point are contiguous
+            __m256d a0 = _mm256_unpacklo_pd(w0, w1);
+            __m256d a1 = _mm256_unpackhi_pd(w0, w1);
+            __m256d a2 = _mm256_unpacklo_pd(w2, w3);
+            __m256d a3 = _mm256_unpackhi_pd(w2, w3);
+            double *ptrW = w + n * S;
+            _mm256_storeu_pd(ptrW,      _mm256_permute2f128_pd(a0, a2, 0x20));
+            _mm256_storeu_pd(ptrW + 4,  _mm256_permute2f128_pd(a1, a3, 0x20));
+            _mm256_storeu_pd(ptrW + 8,  _mm256_permute2f128_pd(a0, a2, 0x31));
+            _mm256_storeu_pd(ptrW + 12, _mm256_permute2f128_pd(a1, a3, 0x31));
+        }
+    }
+#endif
+    for (; n < N; ++n)
+        l[n] = BSplineKernel<Degree>::weights(x[n], w + n * S);
+}
+
+/** Index of a tap according to the boundary condition, -1 if it is 0 */
+inline int bsplineBoundaryIndex(int l, int size, BSplineBoundary boundary)
+{
+    if (l >= 0 && l < size)
+        return l;
+    if (boundary == BSPLINE_BOUNDARY_ZERO)
+        return -1;
+    return (l < 0) ? -l - 1 : 2 * size - l - 1;
+}
+
+#if defined(__AVX2__)
+/// Load 4 consecutive coefficients as doubles
+template<typename T>
+inline __m256d bsplineLoad4(const T *ptr)
+{
+    return _mm256_set_pd((double)ptr[3], (double)ptr[2], (double)ptr[1], (double)ptr[0]);
+}
+inline __m256d bsplineLoad4(const double *ptr)
+{
+    return _mm256_loadu_pd(ptr);
+}
+inline __m256d bsplineLoad4(const float *ptr)
+{
+    return _mm256_cvtps_pd(_mm_loadu_ps(ptr));
+}
+/// Multiply and accumulate
+inline __m256d bsplineMadd(__m256d a, __m256d b, __m256d c)
+{
+#if defined(__FMA__)
+    return _mm256_fmadd_pd(a, b, c);
+#else
+    return _mm256_add_pd(_mm256_mul_pd(a, b), c);
+#endif
+}
+/// Horizontal sum
+inline double bsplineHsum(__m256d v)
+{
+    __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+}
+#endif
+
+#if defined(__AVX512F__)
+/// Load two rows of 4 coefficients, the second one starting Xdim elements after the first
+template<typename T>
+inline __m512d bsplineLoad2x4(const T *ptr, int Xdim)
+{
+    const T *ptr2 = ptr + Xdim;
+    return _mm512_set_pd((double)ptr2[3], (double)ptr2[2], (double)ptr2[1], (double)ptr2[0],
+                         (double)ptr[3], (double)ptr[2], (double)ptr[1], (double)ptr[0]);
+}
+/// Horizontal sum
+inline double bsplineHsum(__m512d v)
+{
+    double aux[8];
+    _mm512_storeu_pd(aux, v);
+    return ((aux[0] + aux[1]) + (aux[2] + aux[3])) + ((aux[4] + aux[5]) + (aux[6] + aux[7]));
+}
+#endif
+
+/** Evaluate one 3D point in NVol coefficient volumes of the same size.
+ * The cubic interior case is vectorized along X.
+ */
+template<int Degree, typename T, int NVol>
+inline void bsplineEvaluate3D(const T * const *data, int Xdim, int Ydim, int Zdim,
+                              int l1, int m1, int n1,
+                              const double *wx, const double *wy, const double *wz,
+                              BSplineBoundary boundary, double *out)
+{
+    const int S = BSplineKernel<Degree>::support;
+    size_t YXdim = (size_t)Xdim * Ydim;
+    bool interior = l1 >= 0 && l1 + S <= Xdim && m1 >= 0 && m1 + S <= Ydim &&
+                    n1 >= 0 && n1 + S <= Zdim;
+#if defined(__AVX2__)
+    if (Degree == 3 && interior)
+    {
+#if defined(__AVX512F__)
+        // Two rows of 4 coefficients per register
+        __m512d vwx2 = _mm512_set_pd(wx[3], wx[2], wx[1], wx[0], wx[3], wx[2], wx[1], wx[0]);
+        __m512d acc512[NVol];
+        for (int v = 0; v < NVol; ++v)
+            acc512[v] = _mm512_setzero_pd();
+        for (int nn = 0; nn < S; ++nn)
+            for (int m = 0; m < S; m += 2)
+            {
+                double wyz0 = wz[nn] * wy[m], wyz1 = wz[nn] * wy[m + 1];
+                __m512d w = _mm512_mul_pd(vwx2, _mm512_set_pd(wyz1, wyz1, wyz1, wyz1,
+                                          wyz0, wyz0, wyz0, wyz0));
+                size_t offset = (n1 + nn) * YXdim + (size_t)(m1 + m) * Xdim + l1;
+                for (int v = 0; v < NVol; ++v)
+                    acc512[v] = _mm512_fmadd_pd(bsplineLoad2x4(data[v] + offset, Xdim), w, acc512[v]);
+            }
+        for (int v = 0; v < NVol; ++v)
+            out[v] = bsplineHsum(acc512[v]);
+#else
+        __m256d vwx = _mm256_loadu_pd(wx);
+        __m256d acc[NVol];
+        for (int v = 0; v < NVol; ++v)
+            acc[v] = _mm256_setzero_pd();
+        for (int nn = 0; nn < S; ++nn)
+            for (int m = 0; m < S; ++m)
+            {
+                __m256d w = _mm256_mul_pd(vwx, _mm256_set1_pd(wz[nn] * wy[m]));
+                size_t offset = (n1 + nn) * YXdim + (size_t)(m1 + m) * Xdim + l1;
+                for (int v = 0; v < NVol; ++v)
+                    acc[v] = bsplineMadd(bsplineLoad4(data[v] + offset), w, acc[v]);
+            }
+        for (int v = 0; v < NVol; ++v)
+            out[v] = bsplineHsum(acc[v]);
+#endif
+        return;
+    }
+#endif
+    int idxX[S], idxY[S], idxZ[S];
+    for (int s = 0; s < S; ++s)
+    {
+        if (interior)
+        {
+            idxX[s] = l1 + s;
+            idxY[s] = m1 + s;
+            idxZ[s] = n1 + s;
+        }
+        else
+        {
+            idxX[s] = bsplineBoundaryIndex(l1 + s, Xdim, boundary);
+            idxY[s] = bsplineBoundaryIndex(m1 + s, Ydim, boundary);
+            idxZ[s] = bsplineBoundaryIndex(n1 + s, Zdim, boundary);
+        }
+    }
+    for (int v = 0; v < NVol; ++v)
+        out[v] = 0.0;
+    for (int nn = 0; nn < S; ++nn)
+    {
+        if (idxZ[nn] < 0)
+            continue;
+        double yxsum[NVol];
+        for (int v = 0; v < NVol; ++v)
+            yxsum[v] = 0.0;
+        for (int m = 0; m < S; ++m)
+        {
+            if (idxY[m] < 0)
+                continue;
+            size_t offset = idxZ[nn] * YXdim + (size_t)idxY[m] * Xdim;
+            for (int v = 0; v < NVol; ++v)
+            {
+                const T *ptr = data[v] + offset;
+                double xsum = 0.0;
+                for (int l = 0; l < S; ++l)
+                    if (idxX[l] >= 0)
+                        xsum += (double)ptr[idxX[l]] * wx[l];
+                yxsum[v] += xsum * wy[m];
+            }
+        }
+        for (int v = 0; v < NVol; ++v)
+            out[v] += yxsum[v] * wz[nn];
+    }
+}
+
+/** Evaluate one 2D point in a coefficient image */
+template<int Degree, typename T>
+inline double bsplineEvaluate2D(const T *data, int Xdim, int Ydim, int l1, int m1,
+                                const double *wx, const double *wy, BSplineBoundary boundary)
+{
+    const int S = BSplineKernel<Degree>::support;
+    bool interior = l1 >= 0 && l1 + S <= Xdim && m1 >= 0 && m1 + S <= Ydim;
+#if defined(__AVX2__)
+    if (Degree == 3 && interior)
+    {
+        __m256d vwx = _mm256_loadu_pd(wx);
+        __m256d acc = _mm256_setzero_pd();
+        const T *ptr = data + (size_t)m1 * Xdim + l1;
+        for (int m = 0; m < S; ++m, ptr += Xdim)
+            acc = bsplineMadd(bsplineLoad4(ptr), _mm256_mul_pd(vwx, _mm256_set1_pd(wy[m])), acc);
+        return bsplineHsum(acc);
+    }
+#endif
+    double columns = 0.0;
+    for (int m = 0; m < S; ++m)
+    {
+        int equivalent_m = interior ? m1 + m : bsplineBoundaryIndex(m1 + m, Ydim, boundary);
+        if (equivalent_m < 0)
+            continue;
+        const T *ptr = data + (size_t)equivalent_m * Xdim;
+        double rows = 0.0;
+        for (int l = 0; l < S; ++l)
+        {
+            int equivalent_l = interior ? l1 + l : bsplineBoundaryIndex(l1 + l, Xdim, boundary);
+            if (equivalent_l >= 0)
+                rows += (double)ptr[equivalent_l] * wx[l];
+        }
+        columns += rows * wy[m];
+    }
+    return columns;
+}
+
+/** Batched 3D interpolation in NVol coefficient volumes of the same shape.
+ * x, y and z are the logical coordinates of the N points, out[v] is the
+ * output of the volume v.
+ */
+template<int Degree, typename T, int NVol>
+void interpolateBSpline3D(const MultidimArray<T> * const *coeffs, size_t N,
+                          const double *x, const double *y, const double *z,
+                          double * const *out,
+                          BSplineBoundary boundary = BSPLINE_BOUNDARY_MIRROR)
+{
+    const int S = BSplineKernel<Degree>::support;
+    const MultidimArray<T> &C = *coeffs[0];
+    int Xdim = (int)XSIZE(C), Ydim = (int)YSIZE(C), Zdim = (int)ZSIZE(C);
+    const T *data[NVol];
+    for (int v = 0; v < NVol; ++v)
+        data[v] = MULTIDIM_ARRAY(*coeffs[v]);
+
+    double px[BSPLINE_BATCH], py[BSPLINE_BATCH], pz[BSPLINE_BATCH];
+    double wx[BSPLINE_BATCH * S], wy[BSPLINE_BATCH * S], wz[BSPLINE_BATCH * S];
+    int lx[BSPLINE_BATCH], ly[BSPLINE_BATCH], lz[BSPLINE_BATCH];
+    double result[NVol];
+    for (size_t n0 = 0; n0 < N; n0 += BSPLINE_BATCH)
+    {
+        size_t nb = std::min((size_t)BSPLINE_BATCH, N - n0);
+        // Logical to physical
+        for (size_t n = 0; n < nb; ++n)
+        {
+            px[n] = x[n0 + n] - STARTINGX(C);
+            py[n] = y[n0 + n] - STARTINGY(C);
+            pz[n] = z[n0 + n] - STARTINGZ(C);
+        }
+        bsplineWeights<Degree>(px, nb, lx, wx);
+        bsplineWeights<Degree>(py, nb, ly, wy);
+        bsplineWeights<Degree>(pz, nb, lz, wz);
+        for (size_t n = 0; n < nb; ++n)
+        {
+            bsplineEvaluate3D<Degree, T, NVol>(data, Xdim, Ydim, Zdim, lx[n], ly[n], lz[n],
+                                               wx + n * S, wy + n * S, wz + n * S, boundary, result);
+            for (int v = 0; v < NVol; ++v)
+                out[v][n0 + n] = result[v];
+        }
+    }
+}
+
+/** Batched 3D interpolation in a single coefficient volume.
+ * @code
+ * MultidimArray<double> coeffs;
+ * produceSplineCoefficients(BSPLINE3, coeffs, V);
+ * interpolateBSpline3D<3>(coeffs, N, x, y, z, values);
+ * @endcode
+ */
+template<int Degree, typename T>
+void interpolateBSpline3D(const MultidimArray<T> &coeffs, size_t N,
+                          const double *x, const double *y, const double *z, double *out,
+                          BSplineBoundary boundary = BSPLINE_BOUNDARY_MIRROR)
+{
+    const MultidimArray<T> *ptrCoeffs = &coeffs;
+    interpolateBSpline3D<Degree, T, 1>(&ptrCoeffs, N, x, y, z, &out, boundary);
+}
+
+/** Batched 3D interpolation in two coefficient volumes of the same shape
+ * (for instance, the real and imaginary parts of a Fourier transform).
+ */
+template<int Degree, typename T>
+void interpolateBSpline3D(const MultidimArray<T> &coeffs1, const MultidimArray<T> &coeffs2,
+                          size_t N, const double *x, const double *y, const double *z,
+                          double *out1, double *out2,
+                          BSplineBoundary boundary = BSPLINE_BOUNDARY_MIRROR)
+{
+    const MultidimArray<T> *ptrCoeffs[2] = { &coeffs1, &coeffs2 };
+    double *ptrOut[2] = { out1, out2 };
+    interpolateBSpline3D<Degree, T, 2>(ptrCoeffs, N, x, y, z, ptrOut, boundary);
+}
+
+/** Batched 2D interpolation.
+ * x and y are the logical coordinates of the N points.
+ */
+template<int Degree, typename T>
+void interpolateBSpline2D(const MultidimArray<T> &coeffs, size_t N,
+                          const double *x, const double *y, double *out,
+                          BSplineBoundary boundary = BSPLINE_BOUNDARY_MIRROR)
+{
+    const int S = BSplineKernel<Degree>::support;
+    int Xdim = (int)XSIZE(coeffs), Ydim = (int)YSIZE(coeffs);
+    const T *data = MULTIDIM_ARRAY(coeffs);
+
+    double px[BSPLINE_BATCH], py[BSPLINE_BATCH];
+    double wx[BSPLINE_BATCH * S], wy[BSPLINE_BATCH * S];
+    int lx[BSPLINE_BATCH], ly[BSPLINE_BATCH];
+    for (size_t n0 = 0; n0 < N; n0 += BSPLINE_BATCH)
+    {
+        size_t nb = std::min((size_t)BSPLINE_BATCH, N - n0);
+        for (size_t n = 0; n < nb; ++n)
+        {
+            px[n] = x[n0 + n] - STARTINGX(coeffs);
+            py[n] = y[n0 + n] - STARTINGY(coeffs);
+        }
+        bsplineWeights<Degree>(px, nb, lx, wx);
+        bsplineWeights<Degree>(py, nb, ly, wy);
+        for (size_t n = 0; n < nb; ++n)
+            out[n0 + n] = bsplineEvaluate2D<Degree, T>(data, Xdim, Ydim, lx[n], ly[n],
+                          wx + n * S, wy + n * S, boundary);
+    }
+}
+/** Apply a geometrical transformation with cubic B-spline interpolation.
+ * Same conventions as applyGeometry(BSPLINE3, V2, V1, A, inv, wrap, outside):
+ * V2 must have been resized to the output size, and A is 3x3 for images and
+ * 4x4 for volumes. The points of each output row are interpolated together.
+ */
+template<typename T>
+void applyGeometryBSpline(MultidimArray<T> &V2, const MultidimArray<T> &V1,
+                          const Matrix2D<double> &A, bool inv, bool wrap, T outside = 0)
+{
+    bool is3D = ZSIZE(V1) > 1;
+    Matrix2D<double> Aref;
+    if (inv == IS_NOT_INV)
+        A.inv(Aref);
+    else
+        Aref = A;
+    int dim = is3D ? 3 : 2;
+    if (MAT_XSIZE(Aref) != dim + 1 || MAT_YSIZE(Aref) != dim + 1)
+        REPORT_ERROR(ERR_MATRIX_SIZE, "applyGeometryBSpline: transformation matrix is not of the right size");
+
+    MultidimArray<double> Bcoeffs;
+    produceSplineCoefficients(BSPLINE3, Bcoeffs, V1);
+
+    // Centers of the input and output arrays
+    double cen_z = (int)(ZSIZE(V2) / 2);
+    double cen_y = (int)(YSIZE(V2) / 2);
+    double cen_x = (int)(XSIZE(V2) / 2);
+    double cen_zp = (int)(ZSIZE(V1) / 2);
+    double cen_yp = (int)(YSIZE(V1) / 2);
+    double cen_xp = (int)(XSIZE(V1) / 2);
+    double minxp = -cen_xp, minyp = -cen_yp, minzp = -cen_zp;
+    double maxxp = XSIZE(V1) - cen_xp - 1;
+    double maxyp = YSIZE(V1) - cen_yp - 1;
+    double maxzp = ZSIZE(V1) - cen_zp - 1;
+    STARTINGX(Bcoeffs) = (int)minxp;
+    STARTINGY(Bcoeffs) = (int)minyp;
+    STARTINGZ(Bcoeffs) = (int)minzp;
+
+    size_t Xdim = XSIZE(V2);
+    std::vector<double> xs(Xdim), ys(Xdim), zs(Xdim, 0.), values(Xdim);
+    std::vector<size_t> js(Xdim);
+    for (size_t k = 0; k < ZSIZE(V2); k++)
+        for (size_t i = 0; i < YSIZE(V2); i++)
+        {
+            // Position of the beginning of the row in the input array,
+            // coords_output = A * coords_input
+            double x = -cen_x;
+            double y = i - cen_y;
+            double z = k - cen_z;
+            double xp0, yp0, zp0 = 0;
+            if (is3D)
+            {
+                xp0 = x * MAT_ELEM(Aref, 0, 0) + y * MAT_ELEM(Aref, 0, 1) + z * MAT_ELEM(Aref, 0, 2) + MAT_ELEM(Aref, 0, 3);
+                yp0 = x * MAT_ELEM(Aref, 1, 0) + y * MAT_ELEM(Aref, 1, 1) + z * MAT_ELEM(Aref, 1, 2) + MAT_ELEM(Aref, 1, 3);
+                zp0 = x * MAT_ELEM(Aref, 2, 0) + y * MAT_ELEM(Aref, 2, 1) + z * MAT_ELEM(Aref, 2, 2) + MAT_ELEM(Aref, 2, 3);
+            }
+            else
+            {
+                xp0 = x * MAT_ELEM(Aref, 0, 0) + y * MAT_ELEM(Aref, 0, 1) + MAT_ELEM(Aref, 0, 2);
+                yp0 = x * MAT_ELEM(Aref, 1, 0) + y * MAT_ELEM(Aref, 1, 1) + MAT_ELEM(Aref, 1, 2);
+            }
+
+            size_t N = 0;
+            for (size_t j = 0; j < Xdim; j++)
+            {
+                double xp = xp0 + j * MAT_ELEM(Aref, 0, 0);
+                double yp = yp0 + j * MAT_ELEM(Aref, 1, 0);
+                double zp = is3D ? zp0 + j * MAT_ELEM(Aref, 2, 0) : 0.;
+                bool interp = true;
+                // Points outside the array either enter by the opposite side
+                // (periodic extension) or take the outside value
+                if (xp < minxp - XMIPP_EQUAL_ACCURACY || xp > maxxp + XMIPP_EQUAL_ACCURACY)
+                {
+                    if (wrap)
+                        xp = realWRAP(xp, minxp - 0.5, maxxp + 0.5);
+                    else
+                        interp = false;
+                }
+                if (yp < minyp - XMIPP_EQUAL_ACCURACY || yp > maxyp + XMIPP_EQUAL_ACCURACY)
+                {
+                    if (wrap)
+                        yp = realWRAP(yp, minyp - 0.5, maxyp + 0.5);
+                    else
+                        interp = false;
+                }
+                if (is3D && (zp < minzp - XMIPP_EQUAL_ACCURACY || zp > maxzp + XMIPP_EQUAL_ACCURACY))
+                {
+                    if (wrap)
+                        zp = realWRAP(zp, minzp - 0.5, maxzp + 0.5);
+                    else
+                        interp = false;
+                }
+                if (interp)
+                {
+                    js[N] = j;
+                    xs[N] = xp;
+                    ys[N] = yp;
+                    zs[N] = zp;
+                    ++N;
+                }
+                else
+                    dAkij(V2, k, i, j) = outside;
+            }
+
+            if (N == 0)
+                continue;
+            if (is3D)
+                interpolateBSpline3D<3>(Bcoeffs, N, &xs[0], &ys[0], &zs[0], &values[0]);
+            else
+                interpolateBSpline2D<3>(Bcoeffs, N, &xs[0], &ys[0], &values[0]);
+            for (size_t n = 0; n < N; ++n)
+                dAkij(V2, k, i, js[n]) = (T) values[n];
+        }
+}
+//@}
+#endif
@@ -0,0 +1,440 @@
+/***************************************************************************
+ *
+ * Authors:     Carlos Oscar S. Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include "connected_components.h"
+#include <core/xmipp_error.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+/* Threads ----------------------------------------------------------------- */
+// Split [0,N) in nThreads consecutive ranges and call
+// obj->*method(first,last) for each of them in a different thread
+template <class T>
+static void ccParallelFor(int nThreads, size_t N, T *obj, void (T::*method)(size_t, size_t))
+{
+    size_t Nthr=XMIPP_MAX(1,XMIPP_MIN((size_t)nThreads,N));
+    if (Nthr<=1)
+    {
+        (obj->*method)(0,N);
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (size_t t=0; t<Nthr; ++t)
+        threads.push_back(std::thread(method,obj,N*t/Nthr,N*(t+1)/Nthr));
+    for (size_t t=0; t<Nthr; ++t)
+        threads[t].join();
+}
+
+/* Labelling --------------------------------------------------------------- */
+struct CCOffset
+{
+    int dk, di, dj;
+};
+
+// Neighbours that come before a voxel in the scanning order
+static void ccBackwardNeighbours(bool is3D, int neighbourhood, std::vector<CCOffset> &offsets)
+{
+    offsets.clear();
+    int maxNonZero;
+    if (is3D)
+    {
+        if (neighbourhood==6)
+            maxNonZero=1;
+        else if (neighbourhood==18)
+            maxNonZero=2;
+        else if (neighbourhood==26)
+            maxNonZero=3;
+        else
+            REPORT_ERROR(ERR_ARG_INCORRECT,"The neighbourhood of a volume must be 6, 18 or 26");
+    }
+    else
+    {
+        if (neighbourhood==4)
+            maxNonZero=1;
+        else if (neighbourhood==8)
+            maxNonZero=2;
+        else
+            REPORT_ERROR(ERR_ARG_INCORRECT,"The neighbourhood of an image must be 4 or 8");
+    }
+    int k0=is3D ? -1:0;
+    for (int dk=k0; dk<=0; ++dk)
+        for (int di=-1; di<=1; ++di)
+            for (int dj=-1; dj<=1; ++dj)
+            {
+                bool backward=dk<0 || (dk==0 && di<0) || (dk==0 && di==0 && dj<0);
+                int nonZero=(dk!=0)+(di!=0)+(dj!=0);
+                if (backward && nonZero<=maxNonZero)
+                {
+                    CCOffset offset;
+                    offset.dk=dk;
+                    offset.di=di;
+                    offset.dj=dj;
+                    offsets.push_back(offset);
+                }
+            }
+}
+
+// Union-find forest in which the root of a tree is its smallest index, so
+// that parent[n]<=n
+template <typename Index>
+class CCLabeller
+{
+public:
+    const double *ptrI;
+    int Zdim, Ydim, Xdim;
+    bool is3D;
+    std::vector<CCOffset> offsets;
+    std::vector<Index> parent;
+    double *ptrLabel;
+
+    Index find(Index n)
+    {
+        Index *p=&parent[0];
+        while (p[n]!=n)
+        {
+            p[n]=p[p[n]];
+            n=p[n];
+        }
+        return n;
+    }
+
+    void join(Index a, Index b)
+    {
+        a=find(a);
+        b=find(b);
+        if (a<b)
+            parent[b]=a;
+        else if (b<a)
+            parent[a]=b;
+    }
+
+    // Join a voxel with its foreground backward neighbours whose plane
+    // (slice in 3D, row in 2D) is not before firstPlane
+    void joinVoxel(int k, int i, int j, int firstPlane)
+    {
+        Index n=((Index)k*Ydim+i)*Xdim+j;
+        for (size_t o=0; o<offsets.size(); ++o)
+        {
+            const CCOffset &offset=offsets[o];
+            int kk=k+offset.dk, ii=i+offset.di, jj=j+offset.dj;
+            if (kk<0 || ii<0 || ii>=Ydim || jj<0 || jj>=Xdim)
+                continue;
+            if ((is3D ? kk:ii)<firstPlane)
+                continue;
+            Index m=((Index)kk*Ydim+ii)*Xdim+jj;
+            if (ptrI[m]>0)
+                join(n,m);
+        }
+    }
+
+    // Join the voxels of the planes [plane0,planeF)
+    void joinSlab(size_t plane0, size_t planeF)
+    {
+        int k0=is3D ? plane0:0, kF=is3D ? planeF:1;
+        int i0=is3D ? 0:plane0, iF=is3D ? Ydim:planeF;
+        for (int k=k0; k<kF; ++k)
+            for (int i=i0; i<iF; ++i)
+                for (int j=0; j<Xdim; ++j)
+                    if (ptrI[((Index)k*Ydim+i)*Xdim+j]>0)
+                        joinVoxel(k,i,j,is3D ? k0:i0);
+    }
+
+    // Join the first plane of a slab with the previous plane
+    void joinPlane(int plane)
+    {
+        int k0=is3D ? plane:0, kF=is3D ? plane+1:1;
+        int i0=is3D ? 0:plane, iF=is3D ? Ydim:plane+1;
+        for (int k=k0; k<kF; ++k)
+            for (int i=i0; i<iF; ++i)
+                for (int j=0; j<Xdim; ++j)
+                    if (ptrI[((Index)k*Ydim+i)*Xdim+j]>0)
+                        joinVoxel(k,i,j,plane-1);
+    }
+
+    // Non-root voxels take the label of their root
+    void labelVoxels(size_t n0, size_t nF)
+    {
+        for (size_t n=n0; n<nF; ++n)
+        {
+            double val=ptrI[n];
+            if (val>0)
+            {
+                if (parent[n]!=n)
+                {
+                    double l=ptrLabel[parent[n]];
+                    ptrLabel[n]=(l>0) ? l:val-31999;
+                }
+            }
+            else if (val!=0)
+                ptrLabel[n]=val-31999;
+        }
+    }
+
+    int label(const MultidimArray<double> &I, MultidimArray<double> &label, int neighbourhood,
+              int nThreads)
+    {
+        Zdim=ZSIZE(I);
+        Ydim=YSIZE(I);
+        Xdim=XSIZE(I);
+        is3D=Zdim>1;
+        ccBackwardNeighbours(is3D,neighbourhood,offsets);
+
+        // The label may overwrite the input
+        MultidimArray<double> Icopy;
+        if (&I==&label)
+            Icopy=I;
+        const MultidimArray<double> &Iin=(&I==&label) ? Icopy:I;
+        ptrI=MULTIDIM_ARRAY(Iin);
+        size_t N=MULTIDIM_SIZE(Iin);
+
+        parent.resize(N);
+        for (size_t n=0; n<N; ++n)
+            parent[n]=n;
+
+        // Components inside each slab, then across slabs
+        size_t Nplanes=is3D ? Zdim:Ydim;
+        size_t Nthr=XMIPP_MAX(1,XMIPP_MIN((size_t)nThreads,Nplanes));
+        if (Nthr<=1)
+            joinSlab(0,Nplanes);
+        else
+        {
+            std::vector<std::thread> threads;
+            for (size_t t=0; t<Nthr; ++t)
+                threads.push_back(std::thread(&CCLabeller<Index>::joinSlab,this,
+                                              Nplanes*t/Nthr,Nplanes*(t+1)/Nthr));
+            for (size_t t=0; t<Nthr; ++t)
+                threads[t].join();
+            for (size_t t=1; t<Nthr; ++t)
+                joinPlane(Nplanes*t/Nthr);
+        }
+
+        // Point every voxel to its root. parent[n]<=n, so the parent is
+        // already pointing to its root
+        for (size_t n=0; n<N; ++n)
+            parent[n]=parent[parent[n]];
+
+        // Number the roots in the order of the first voxel equal to 1
+        label.initZeros(Iin);
+        ptrLabel=MULTIDIM_ARRAY(label);
+        int Ncomponents=0;
+        for (size_t n=0; n<N; ++n)
+            if (ptrI[n]==1 && ptrLabel[parent[n]]==0)
+                ptrLabel[parent[n]]=++Ncomponents;
+
+        ccParallelFor(nThreads,N,this,&CCLabeller<Index>::labelVoxels);
+        // Roots of components without any voxel equal to 1
+        for (size_t n=0; n<N; ++n)
+            if (ptrI[n]>0 && parent[n]==n && ptrLabel[n]==0)
+                ptrLabel[n]=ptrI[n]-31999;
+        return Ncomponents;
+    }
+};
+
+int labelConnectedComponents(const MultidimArray<double> &I, MultidimArray<double> &label,
+                             int neighbourhood, int nThreads)
+{
+    if (NSIZE(I)>1)
+        REPORT_ERROR(ERR_MULTIDIM_DIM,"labelConnectedComponents: stacks are not supported");
+    if (MULTIDIM_SIZE(I)<0xFFFFFFFFUL)
+    {
+        CCLabeller<uint32_t> labeller;
+        return labeller.label(I,label,neighbourhood,nThreads);
+    }
+    CCLabeller<size_t> labeller;
+    return labeller.label(I,label,neighbourhood,nThreads);
+}
+
+void componentSizes(const MultidimArray<double> &label, int Ncomponents,
+                    MultidimArray<int> &size)
+{
+    size.initZeros(Ncomponents+1);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(label)
+    {
+        int l=(int)DIRECT_MULTIDIM_ELEM(label,n);
+        if (l>=0 && l<=Ncomponents)
+            DIRECT_A1D_ELEM(size,l)++;
+    }
+}
+
+/* Distance transforms ----------------------------------------------------- */
+// Lines along one axis of a volume
+class DTLines
+{
+public:
+    int Zdim, Ydim, Xdim;
+    // 0=X, 1=Y, 2=Z
+    int axis;
+
+    size_t numberOfLines() const
+    {
+        return (axis==0) ? (size_t)Zdim*Ydim:((axis==1) ? (size_t)Zdim*Xdim:(size_t)Ydim*Xdim);
+    }
+
+    int length() const
+    {
+        return (axis==0) ? Xdim:((axis==1) ? Ydim:Zdim);
+    }
+
+    size_t stride() const
+    {
+        return (axis==0) ? 1:((axis==1) ? (size_t)Xdim:(size_t)Ydim*Xdim);
+    }
+
+    size_t start(size_t line) const
+    {
+        if (axis==0)
+            return line*Xdim;
+        if (axis==1)
+            return (line/Xdim)*(size_t)Ydim*Xdim+line%Xdim;
+        return line;
+    }
+};
+
+// L1 distance transform along one axis: g(i)=min_i' f(i')+|i-i'|
+class DTL1: public DTLines
+{
+public:
+    int *ptr;
+    bool wrap;
+
+    void transformLines(size_t line0, size_t lineF)
+    {
+        int L=length();
+        size_t s=stride();
+        // With wrapping, two laps propagate the distances all around
+        int laps=wrap ? 2:1;
+        for (size_t line=line0; line<lineF; ++line)
+        {
+            int *f=ptr+start(line);
+            for (int q=1; q<laps*L; ++q)
+            {
+                int cur=q%L, prev=(q-1)%L;
+                f[cur*s]=XMIPP_MIN(f[cur*s],f[prev*s]+1);
+            }
+            for (int q=laps*L-2; q>=0; --q)
+            {
+                int cur=q%L, next=(q+1)%L;
+                f[cur*s]=XMIPP_MIN(f[cur*s],f[next*s]+1);
+            }
+        }
+    }
+};
+
+void distanceTransformL1(const MultidimArray<int> &in, MultidimArray<int> &out,
+                         bool wrap, int nThreads)
+{
+    in.checkDimension(2);
+    int maxDistance=XSIZE(in)+YSIZE(in);
+    out.resize(in);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(in)
+    DIRECT_MULTIDIM_ELEM(out,n)=DIRECT_MULTIDIM_ELEM(in,n) ? 0:maxDistance;
+
+    DTL1 dt;
+    dt.Zdim=1;
+    dt.Ydim=YSIZE(in);
+    dt.Xdim=XSIZE(in);
+    dt.ptr=MULTIDIM_ARRAY(out);
+    dt.wrap=wrap;
+    for (dt.axis=0; dt.axis<2; ++dt.axis)
+        ccParallelFor(nThreads,dt.numberOfLines(),(DTL1*)&dt,&DTL1::transformLines);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(out)
+    DIRECT_MULTIDIM_ELEM(out,n)=XMIPP_MIN(DIRECT_MULTIDIM_ELEM(out,n),maxDistance);
+}
+
+// Squared Euclidean distance transform along one axis:
+// g(i)=min_i' f(i')+(i-i')^2 (lower envelope of parabolas)
+#define DT_INF 1e20
+class DTEuclidean: public DTLines
+{
+public:
+    double *ptr;
+
+    void transformLines(size_t line0, size_t lineF)
+    {
+        int L=length();
+        size_t s=stride();
+        std::vector<double> f(L), z(L+1);
+        std::vector<int> v(L);
+        for (size_t line=line0; line<lineF; ++line)
+        {
+            double *ptrLine=ptr+start(line);
+            for (int q=0; q<L; ++q)
+                f[q]=ptrLine[q*s];
+            int k=0;
+            v[0]=0;
+            z[0]=-DT_INF;
+            z[1]=DT_INF;
+            for (int q=1; q<L; ++q)
+            {
+                double sq=(f[q]+(double)q*q-(f[v[k]]+(double)v[k]*v[k]))/(2.0*(q-v[k]));
+                while (sq<=z[k])
+                {
+                    --k;
+                    sq=(f[q]+(double)q*q-(f[v[k]]+(double)v[k]*v[k]))/(2.0*(q-v[k]));
+                }
+                ++k;
+                v[k]=q;
+                z[k]=sq;
+                z[k+1]=DT_INF;
+            }
+            k=0;
+            for (int q=0; q<L; ++q)
+            {
+                while (z[k+1]<q)
+                    ++k;
+                double d=q-v[k];
+                ptrLine[q*s]=d*d+f[v[k]];
+            }
+        }
+    }
+};
+
+void distanceTransformEuclidean(const MultidimArray<int> &in, MultidimArray<double> &out,
+                                int nThreads)
+{
+    if (NSIZE(in)>1)
+        REPORT_ERROR(ERR_MULTIDIM_DIM,"distanceTransformEuclidean: stacks are not supported");
+    out.resize(in);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(in)
+    DIRECT_MULTIDIM_ELEM(out,n)=DIRECT_MULTIDIM_ELEM(in,n) ? 0:DT_INF;
+
+    DTEuclidean dt;
+    dt.Zdim=ZSIZE(in);
+    dt.Ydim=YSIZE(in);
+    dt.Xdim=XSIZE(in);
+    dt.ptr=MULTIDIM_ARRAY(out);
+    int Naxes=(dt.Zdim>1) ? 3:2;
+    for (dt.axis=0; dt.axis<Naxes; ++dt.axis)
+        ccParallelFor(nThreads,dt.numberOfLines(),(DTEuclidean*)&dt,&DTEuclidean::transformLines);
+
+    double maxDistance=XSIZE(in)+YSIZE(in)+ZSIZE(in);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(out)
+    {
+        double &d=DIRECT_MULTIDIM_ELEM(out,n);
+        d=(d>=DT_INF/2) ? maxDistance:sqrt(d);
+    }
+}
+#undef DT_INF
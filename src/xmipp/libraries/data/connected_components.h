@@ -0,0 +1,78 @@
+/***************************************************************************
+ *
+ * Authors:     Carlos Oscar S. Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef _CONNECTED_COMPONENTS_HH
+#define _CONNECTED_COMPONENTS_HH
+
+#include <core/multidim_array.h>
+
+/**@defgroup ConnectedComponents Connected components and distance transforms
+   @ingroup DataLibrary
+
+   The image is split in slabs of planes (rows in 2D) that are processed by
+   different threads. Connected components are found with a union-find
+   forest: each thread joins the voxels of its slab and the slabs are then
+   joined along their common planes. Distance transforms are separable: a
+   1D transform along each axis, with the lines of each axis distributed
+   among the threads.
+*/
+//@{
+
+/** Label the connected components of a binary image or volume.
+ * The voxels with a value greater than 0 are foreground. Every foreground
+ * component that contains at least one voxel equal to 1 is labelled
+ * 1, 2, 3, ... in the order in which its first voxel equal to 1 is found
+ * when scanning the volume (slices, rows, columns). The background is 0.
+ * This is the labelling of labelImage2D and labelImage3D.
+ *
+ * The neighbourhood is 4 or 8 for images and 6, 18 or 26 for volumes.
+ * label may be the same array as I. Returns the number of components.
+ */
+int labelConnectedComponents(const MultidimArray<double> &I, MultidimArray<double> &label,
+                             int neighbourhood, int nThreads=1);
+
+/** Size of each connected component.
+ * size(l) is the number of voxels with label l (size(0) is the background).
+ */
+void componentSizes(const MultidimArray<double> &label, int Ncomponents,
+                    MultidimArray<int> &size);
+
+/** L1 distance transform.
+ * out is the city-block distance of each pixel to the closest nonzero pixel
+ * of in, or XSIZE+YSIZE if there is none. If wrap is set, the image borders
+ * are wrapped around. Same output as distanceTransform.
+ */
+void distanceTransformL1(const MultidimArray<int> &in, MultidimArray<int> &out,
+                         bool wrap=false, int nThreads=1);
+
+/** Exact Euclidean distance transform of an image or a volume.
+ * out is the Euclidean distance of each voxel to the closest nonzero voxel
+ * of in, or XSIZE+YSIZE+ZSIZE if there is none
+ * (Felzenszwalb and Huttenlocher, Theory of Computing, 8: 415-428 (2012)).
+ */
+void distanceTransformEuclidean(const MultidimArray<int> &in, MultidimArray<double> &out,
+                                int nThreads=1);
+//@}
+#endif
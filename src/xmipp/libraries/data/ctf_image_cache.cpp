@@ -0,0 +1,356 @@
+/***************************************************************************
+ *
+ * Authors:     Carlos Oscar S. Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include "ctf_image_cache.h"
+#include <math.h>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+
+/* Vectorized sincos ------------------------------------------------------- */
+// Cephes sin and cos: reduction to [-pi/4,pi/4] with pi/4 split in three
+// parts, accurate to 1 ulp for |x|<1e9, and polynomials on the reduced
+// argument
+static inline void ctfSincos4(__m256d x, __m256d &s, __m256d &c)
+{
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    __m256d ax = _mm256_andnot_pd(signMask, x);
+    __m256d xSign = _mm256_and_pd(signMask, x);
+
+    // Octant rounded to the next even one, and quadrant (0,1,2,3)
+    __m256d y = _mm256_floor_pd(_mm256_mul_pd(ax, _mm256_set1_pd(1.27323954473516268615)));
+    __m256d half = _mm256_floor_pd(_mm256_mul_pd(y, _mm256_set1_pd(0.5)));
+    y = _mm256_add_pd(y, _mm256_sub_pd(y, _mm256_add_pd(half, half)));
+    __m256d quadrant = _mm256_mul_pd(y, _mm256_set1_pd(0.5));
+    quadrant = _mm256_sub_pd(quadrant,
+                             _mm256_mul_pd(_mm256_floor_pd(_mm256_mul_pd(quadrant, _mm256_set1_pd(0.25))),
+                                           _mm256_set1_pd(4.0)));
+
+    // Extended precision reduction
+    __m256d z = _mm256_sub_pd(ax, _mm256_mul_pd(y, _mm256_set1_pd(7.85398125648498535156E-1)));
+    z = _mm256_sub_pd(z, _mm256_mul_pd(y, _mm256_set1_pd(3.77489470793079817668E-8)));
+    z = _mm256_sub_pd(z, _mm256_mul_pd(y, _mm256_set1_pd(2.69515142907905952645E-15)));
+    __m256d zz = _mm256_mul_pd(z, z);
+
+    __m256d ps = _mm256_set1_pd(1.58962301576546568060E-10);
+    ps = _mm256_fmadd_pd(ps, zz, _mm256_set1_pd(-2.50507477628578072866E-8));
+    ps = _mm256_fmadd_pd(ps, zz, _mm256_set1_pd(2.75573136213857245213E-6));
+    ps = _mm256_fmadd_pd(ps, zz, _mm256_set1_pd(-1.98412698295895385996E-4));
+    ps = _mm256_fmadd_pd(ps, zz, _mm256_set1_pd(8.33333333332211858878E-3));
+    ps = _mm256_fmadd_pd(ps, zz, _mm256_set1_pd(-1.66666666666666307295E-1));
+    __m256d sz = _mm256_fmadd_pd(_mm256_mul_pd(z, zz), ps, z);
+
+    __m256d pc = _mm256_set1_pd(-1.13585365213876817300E-11);
+    pc = _mm256_fmadd_pd(pc, zz, _mm256_set1_pd(2.08757008419747316778E-9));
+    pc = _mm256_fmadd_pd(pc, zz, _mm256_set1_pd(-2.75573141792967388112E-7));
+    pc = _mm256_fmadd_pd(pc, zz, _mm256_set1_pd(2.48015872888517045348E-5));
+    pc = _mm256_fmadd_pd(pc, zz, _mm256_set1_pd(-1.38888888888730564116E-3));
+    pc = _mm256_fmadd_pd(pc, zz, _mm256_set1_pd(4.16666666666665929218E-2));
+    __m256d cz = _mm256_fmadd_pd(_mm256_mul_pd(zz, zz), pc,
+                                 _mm256_fnmadd_pd(_mm256_set1_pd(0.5), zz, _mm256_set1_pd(1.0)));
+
+    // Quadrants 1 and 3 swap sine and cosine, 2 and 3 change the sign of
+    // the sine, 1 and 2 change the sign of the cosine
+    __m256d q1 = _mm256_cmp_pd(quadrant, _mm256_set1_pd(1.0), _CMP_EQ_OQ);
+    __m256d q2 = _mm256_cmp_pd(quadrant, _mm256_set1_pd(2.0), _CMP_EQ_OQ);
+    __m256d q3 = _mm256_cmp_pd(quadrant, _mm256_set1_pd(3.0), _CMP_EQ_OQ);
+    __m256d swap = _mm256_or_pd(q1, q3);
+    s = _mm256_blendv_pd(sz, cz, swap);
+    c = _mm256_blendv_pd(cz, sz, swap);
+    s = _mm256_xor_pd(s, _mm256_and_pd(_mm256_or_pd(q2, q3), signMask));
+    c = _mm256_xor_pd(c, _mm256_and_pd(_mm256_or_pd(q1, q2), signMask));
+    s = _mm256_xor_pd(s, xSign);
+}
+#endif
+
+/* Generator --------------------------------------------------------------- */
+CTFImageGenerator::CTFImageGenerator()
+{
+    geometryYdim=geometryXdim=0;
+    geometryTs=0;
+}
+
+void CTFImageGenerator::prepareGeometry(int Ydim, int Xdim, double Ts)
+{
+    if (Ydim==geometryYdim && Xdim==geometryXdim && Ts==geometryTs)
+        return;
+    size_t N=(size_t)Ydim*Xdim;
+    u2.resize(N);
+    u.resize(N);
+    cos2ang.resize(N);
+    sin2ang.resize(N);
+    centerIdx.clear();
+
+    // Same frequencies as CTFDescription::generateCTF
+    double iTs=1.0/Ts;
+    size_t n=0;
+    for (int i=0; i<Ydim; ++i)
+    {
+        double wy;
+        FFT_IDX2DIGFREQ(i, Ydim, wy);
+        double fy=wy*iTs;
+        for (int j=0; j<Xdim; ++j, ++n)
+        {
+            double wx;
+            FFT_IDX2DIGFREQ(j, Xdim, wx);
+            double fx=wx*iTs;
+            u2[n]=fx*fx+fy*fy;
+            u[n]=sqrt(u2[n]);
+            if (fabs(fx) < XMIPP_EQUAL_ACCURACY && fabs(fy) < XMIPP_EQUAL_ACCURACY)
+            {
+                cos2ang[n]=sin2ang[n]=0;
+                centerIdx.push_back(n);
+            }
+            else
+            {
+                // cos(2*atan2(fy,fx)) and sin(2*atan2(fy,fx))
+                double iu2=1.0/u2[n];
+                cos2ang[n]=(fx*fx-fy*fy)*iu2;
+                sin2ang[n]=2*fx*fy*iu2;
+            }
+        }
+    }
+    geometryYdim=Ydim;
+    geometryXdim=Xdim;
+    geometryTs=Ts;
+    radialKey.clear();
+}
+
+void CTFImageGenerator::prepareRadial(const CTFDescription &ctf)
+{
+    std::vector<double> key(8);
+    key[0]=ctf.K3;
+    key[1]=ctf.K5;
+    key[2]=ctf.DeltaR;
+    key[3]=ctf.envR0;
+    key[4]=ctf.envR1;
+    key[5]=ctf.envR2;
+    key[6]=ctf.phase_shift;
+    key[7]=ctf.VPP_radius;
+    if (key==radialKey)
+        return;
+
+    // Same terms as CTFDescription1D::getValuePureAt
+    size_t N=u2.size();
+    envelope.resize(N);
+    envelopePoly.resize(N);
+    for (size_t n=0; n<N; ++n)
+    {
+        double u4=u2[n]*u2[n];
+        double Eespr = exp(-ctf.K3 * u4);
+        double EdeltaF = bessj0(ctf.K5 * u2[n]);
+        double EdeltaR = SINC(u[n] * ctf.DeltaR);
+        envelope[n]=Eespr * EdeltaF * EdeltaR;
+        envelopePoly[n]=ctf.envR0+ctf.envR1*u[n]+ctf.envR2*u2[n];
+    }
+    vpp.clear();
+    if (round(ctf.VPP_radius*1000)!=0)
+    {
+        vpp.resize(N);
+        double K=1.0/(2*pow(ctf.VPP_radius,2.0));
+        for (size_t n=0; n<N; ++n)
+            vpp[n]=-ctf.phase_shift*(1-exp(-u2[n]*K));
+    }
+    radialKey=key;
+}
+
+void CTFImageGenerator::generateCTF(CTFDescription &ctf, int Ydim, int Xdim, MultidimArray<double> &CTF,
+                                    double Ts, bool damping)
+{
+    if (damping && (ctf.enable_CTFnoise || !ctf.enable_CTF))
+    {
+        ctf.generateCTF(Ydim, Xdim, CTF, Ts);
+        return;
+    }
+    if (Ts<0)
+        Ts=ctf.Tm;
+    prepareGeometry(Ydim, Xdim, Ts);
+    prepareRadial(ctf);
+    CTF.resizeNoCopy(Ydim, Xdim);
+
+    double *ptr=MULTIDIM_ARRAY(CTF);
+    size_t N=u2.size();
+    const double defocusAvg=ctf.defocus_average;
+    const double defocusDev=ctf.defocus_deviation;
+    const double cos2az=cos(2*ctf.rad_azimuth);
+    const double sin2az=sin(2*ctf.rad_azimuth);
+    const double K1=ctf.K1, K2=ctf.K2, Ksin=ctf.Ksin, Kcos=ctf.Kcos;
+    const double gain=damping ? -ctf.K:-1.0;
+    const double *ptrVpp=vpp.empty() ? NULL:&vpp[0];
+
+    // Aberration phase, deltaf=avg+dev*cos(2*(ang-azimuth))
+    size_t n=0;
+#if defined(__AVX2__) && defined(__FMA__)
+    const __m256d vAvg=_mm256_set1_pd(defocusAvg), vDev=_mm256_set1_pd(defocusDev);
+    const __m256d vCos2az=_mm256_set1_pd(cos2az), vSin2az=_mm256_set1_pd(sin2az);
+    const __m256d vK1=_mm256_set1_pd(K1), vK2=_mm256_set1_pd(K2);
+    const __m256d vKsin=_mm256_set1_pd(Ksin), vKcos=_mm256_set1_pd(Kcos);
+    const __m256d vGain=_mm256_set1_pd(gain);
+    for (; n+4<=N; n+=4)
+    {
+        __m256d vu2=_mm256_loadu_pd(&u2[n]);
+        __m256d ellipse=_mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&cos2ang[n]),vCos2az),
+                                      _mm256_mul_pd(_mm256_loadu_pd(&sin2ang[n]),vSin2az));
+        __m256d deltaf=_mm256_add_pd(vAvg,_mm256_mul_pd(vDev,ellipse));
+        __m256d argument=_mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(vK1,deltaf),vu2),
+                                       _mm256_mul_pd(vK2,_mm256_mul_pd(vu2,vu2)));
+        if (ptrVpp!=NULL)
+            argument=_mm256_add_pd(_mm256_loadu_pd(ptrVpp+n),argument);
+        __m256d s, c;
+        ctfSincos4(argument,s,c);
+        _mm256_storeu_pd(ptr+n,_mm256_mul_pd(vGain,_mm256_sub_pd(_mm256_mul_pd(vKsin,s),
+                                                                _mm256_mul_pd(vKcos,c))));
+    }
+#endif
+    for (; n<N; ++n)
+    {
+        double deltaf=defocusAvg+defocusDev*(cos2ang[n]*cos2az+sin2ang[n]*sin2az);
+        double argument=K1*deltaf*u2[n]+K2*u2[n]*u2[n];
+        if (ptrVpp!=NULL)
+            argument+=ptrVpp[n];
+        double sine_part, cosine_part;
+        sincos(argument,&sine_part,&cosine_part);
+        ptr[n]=gain*(Ksin*sine_part-Kcos*cosine_part);
+    }
+
+    // Envelope, only the spatial coherence term depends on the defocus
+    if (damping)
+    {
+        const double K6=ctf.K6, K7=ctf.K7;
+        if (K6==0)
+            for (n=0; n<N; ++n)
+            {
+                double E=envelope[n]+envelopePoly[n];
+                ptr[n]*=(E<0) ? 0:E;
+            }
+        else
+            for (n=0; n<N; ++n)
+            {
+                double deltaf=defocusAvg+defocusDev*(cos2ang[n]*cos2az+sin2ang[n]*sin2az);
+                double aux=K7*u2[n]*u[n]+deltaf*u[n];
+                double E=envelope[n]*exp(-K6*aux*aux)+envelopePoly[n];
+                ptr[n]*=(E<0) ? 0:E;
+            }
+    }
+
+    // The defocus is 0 at the origin
+    for (size_t k=0; k<centerIdx.size(); ++k)
+    {
+        n=centerIdx[k];
+        double argument=K2*u2[n]*u2[n];
+        if (ptrVpp!=NULL)
+            argument+=ptrVpp[n];
+        double sine_part, cosine_part;
+        sincos(argument,&sine_part,&cosine_part);
+        ptr[n]=gain*(Ksin*sine_part-Kcos*cosine_part);
+        if (damping)
+        {
+            double aux=ctf.K7*u2[n]*u[n];
+            double E=envelope[n]*exp(-ctf.K6*aux*aux)+envelopePoly[n];
+            ptr[n]*=(E<0) ? 0:E;
+        }
+    }
+}
+
+/* Cache ------------------------------------------------------------------- */
+CTFImageCache::CTFImageCache(size_t _capacity)
+{
+    capacity=_capacity;
+    hits=misses=0;
+}
+
+void CTFImageCache::clear()
+{
+    entries.clear();
+    index.clear();
+    hits=misses=0;
+}
+
+const MultidimArray<double> & CTFImageCache::lookup(CTFDescription &ctf, int Ydim, int Xdim,
+        double Ts, bool damping)
+{
+    if (damping && ctf.enable_CTFnoise)
+    {
+        generator.generateCTF(ctf, Ydim, Xdim, uncached, Ts, damping);
+        return uncached;
+    }
+    if (Ts<0)
+        Ts=ctf.Tm;
+
+    // The key is made of the side info read by the generator (and not of the
+    // defocus parameters it comes from), so that the image always corresponds
+    // to the last produceSideInfo
+    CTFImageKey key(23);
+    key[0]=ctf.defocus_average;
+    key[1]=ctf.defocus_deviation;
+    key[2]=ctf.rad_azimuth;
+    key[3]=ctf.K;
+    key[4]=ctf.K1;
+    key[5]=ctf.K2;
+    key[6]=ctf.K3;
+    key[7]=ctf.K5;
+    key[8]=ctf.K6;
+    key[9]=ctf.K7;
+    key[10]=ctf.Ksin;
+    key[11]=ctf.Kcos;
+    key[12]=Ydim;
+    key[13]=Xdim;
+    key[14]=Ts;
+    key[15]=damping;
+    key[16]=ctf.DeltaR;
+    key[17]=ctf.phase_shift;
+    key[18]=ctf.VPP_radius;
+    key[19]=ctf.envR0;
+    key[20]=ctf.envR1;
+    key[21]=ctf.envR2;
+    key[22]=ctf.enable_CTF;
+
+    std::map<CTFImageKey, CTFImageList::iterator>::iterator it=index.find(key);
+    if (it!=index.end())
+    {
+        hits++;
+        entries.splice(entries.begin(), entries, it->second);
+        return entries.front().second;
+    }
+
+    misses++;
+    if (capacity==0)
+    {
+        generator.generateCTF(ctf, Ydim, Xdim, uncached, Ts, damping);
+        return uncached;
+    }
+    if (entries.size()>=capacity)
+    {
+        // Reuse the memory of the least recently used image
+        entries.splice(entries.begin(), entries, --entries.end());
+        index.erase(entries.front().first);
+    }
+    else
+        entries.push_front(std::make_pair(CTFImageKey(), MultidimArray<double>()));
+    entries.front().first=key;
+    index[key]=entries.begin();
+    generator.generateCTF(ctf, Ydim, Xdim, entries.front().second, Ts, damping);
+    return entries.front().second;
+}
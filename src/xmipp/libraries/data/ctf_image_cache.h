@@ -0,0 +1,201 @@
+/***************************************************************************
+ *
+ * Authors:     Carlos Oscar S. Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef _CTF_IMAGE_CACHE_HH
+#define _CTF_IMAGE_CACHE_HH
+
+#include <list>
+#include <map>
+#include <vector>
+#include "ctf.h"
+
+/**@defgroup CTFImageCache Fast CTF image generation
+   @ingroup DataLibrary
+
+   CTFDescription::generateCTF evaluates the whole model at every pixel
+   (an atan2, a cosine, a sincos, a Bessel function, a sinc and two
+   exponentials). CTFImageGenerator produces the same image with:
+   - the frequency geometry (u^2, cos(2*angle), sin(2*angle)) computed once
+     per image size and sampling rate,
+   - the radial part of the envelope and of the phase plate computed once
+     per set of microscope parameters,
+   - a vectorized sincos of the aberration phase when the code is compiled
+     with AVX2 (scalar otherwise).
+
+   CTFImageCache keeps the last CTF images generated, so that particles
+   coming from the same micrograph reuse the same image. Neither class is
+   thread-safe: each thread should have its own object.
+*/
+//@{
+
+/** Fast generation of CTF images.
+ * The images are those of CTFDescription::generateCTF and
+ * CTFDescription::generateCTFWithoutDamping (same size, layout and values).
+ * produceSideInfo must have been called on the CTF. Models with the noise
+ * part enabled are delegated to CTFDescription::generateCTF.
+ */
+class CTFImageGenerator
+{
+public:
+    /// Empty constructor
+    CTFImageGenerator();
+
+    /** Generate the CTF image.
+     * If Ts<0, the sampling rate of the CTF is used. If damping is false,
+     * the image is that of generateCTFWithoutDamping.
+     */
+    void generateCTF(CTFDescription &ctf, int Ydim, int Xdim, MultidimArray<double> &CTF,
+                     double Ts=-1, bool damping=true);
+
+    /** Generate the CTF image in any other type (float, complex, ...). */
+    template <class T>
+    void generateCTF(CTFDescription &ctf, int Ydim, int Xdim, MultidimArray<T> &CTF,
+                     double Ts=-1, bool damping=true)
+    {
+        generateCTF(ctf, Ydim, Xdim, values, Ts, damping);
+        CTF.resizeNoCopy(Ydim, Xdim);
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(values)
+        DIRECT_MULTIDIM_ELEM(CTF,n)=(T)DIRECT_MULTIDIM_ELEM(values,n);
+    }
+
+protected:
+    // Compute the frequency geometry for this size
+    void prepareGeometry(int Ydim, int Xdim, double Ts);
+
+    // Compute the radial terms for this CTF
+    void prepareRadial(const CTFDescription &ctf);
+
+public:
+    // Size and sampling rate of the geometry
+    int geometryYdim, geometryXdim;
+    double geometryTs;
+    // Squared frequency, frequency, cos(2*angle) and sin(2*angle) of each pixel
+    std::vector<double> u2, u, cos2ang, sin2ang;
+    // Pixels at the origin of frequencies (their defocus is 0)
+    std::vector<size_t> centerIdx;
+    // Parameters of the radial terms
+    std::vector<double> radialKey;
+    // Envelope without the spatial coherence term, polynomial envelope and phase plate shift
+    std::vector<double> envelope, envelopePoly, vpp;
+    // Auxiliary image for other types
+    MultidimArray<double> values;
+};
+
+/** Bounded cache of CTF images.
+ * The images are indexed by the CTF parameters (defocus, astigmatism
+ * angle, Cs, voltage, Q0, envelope and phase plate parameters), the image
+ * size and the sampling rate. When the cache is full, the least recently
+ * used image is discarded. Models with the noise part enabled are not
+ * cached.
+ */
+class CTFImageCache
+{
+public:
+    /// Maximum number of images kept
+    size_t capacity;
+    /// Number of images found in the cache
+    size_t hits;
+    /// Number of images generated
+    size_t misses;
+
+public:
+    /// Constructor
+    CTFImageCache(size_t _capacity=16);
+
+    /// Remove all images
+    void clear();
+
+    /** Get the CTF image.
+     * The meaning of the parameters is the same as in
+     * CTFImageGenerator::generateCTF.
+     */
+    template <class T>
+    void getCTF(CTFDescription &ctf, int Ydim, int Xdim, MultidimArray<T> &CTF,
+                double Ts=-1, bool damping=true)
+    {
+        CTF.resizeNoCopy(Ydim, Xdim);
+        copyCTF(lookup(ctf, Ydim, Xdim, Ts, damping), MULTIDIM_ARRAY(CTF));
+    }
+
+    /** Get the CTF images of a list of particles as a stack.
+     * Image k of the stack is the CTF of ctfs[k].
+     */
+    template <class T>
+    void getCTFs(std::vector<CTFDescription> &ctfs, int Ydim, int Xdim, MultidimArray<T> &stack,
+                 double Ts=-1, bool damping=true)
+    {
+        stack.resizeNoCopy(ctfs.size(), 1, Ydim, Xdim);
+        size_t imgSize=(size_t)Ydim*Xdim;
+        for (size_t k=0; k<ctfs.size(); ++k)
+            copyCTF(lookup(ctfs[k], Ydim, Xdim, Ts, damping), MULTIDIM_ARRAY(stack)+k*imgSize);
+    }
+
+    /** Get the CTF images of the particles of a metadata as a stack.
+     * The CTF of each row is read with CTFDescription::readFromMdRow.
+     */
+    template <class T>
+    void getCTFs(const MetaData &md, int Ydim, int Xdim, MultidimArray<T> &stack,
+                 double Ts=-1, bool damping=true)
+    {
+        std::vector<CTFDescription> ctfs(md.size());
+        MDRow row;
+        size_t k=0;
+        FOR_ALL_OBJECTS_IN_METADATA(md)
+        {
+            md.getRow(row, __iter.objId);
+            ctfs[k].readFromMdRow(row);
+            ctfs[k].produceSideInfo();
+            ++k;
+        }
+        getCTFs(ctfs, Ydim, Xdim, stack, Ts, damping);
+    }
+
+protected:
+    typedef std::vector<double> CTFImageKey;
+    typedef std::list< std::pair<CTFImageKey, MultidimArray<double> > > CTFImageList;
+
+    // Find the image in the cache or generate it
+    const MultidimArray<double> & lookup(CTFDescription &ctf, int Ydim, int Xdim,
+                                         double Ts, bool damping);
+
+    // Copy an image converting its type
+    template <class T>
+    static void copyCTF(const MultidimArray<double> &CTF, T *ptr)
+    {
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(CTF)
+        ptr[n]=(T)DIRECT_MULTIDIM_ELEM(CTF,n);
+    }
+
+    // Images, the most recently used first
+    CTFImageList entries;
+    // Position of each key in the list
+    std::map<CTFImageKey, CTFImageList::iterator> index;
+    // Generator of the missing images
+    CTFImageGenerator generator;
+    // Last image of a model that is not cached
+    MultidimArray<double> uncached;
+};
+//@}
+#endif
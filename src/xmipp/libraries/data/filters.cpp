@@ -25,8 +25,11 @@
 
 #include "filters.h"
 #include <list>
+#include <cstring>
 #include <core/xmipp_fftw.h>
 #include "morphology.h"
+#include "local_statistics.h"
+#include "connected_components.h"
 #include "wavelet.h"
 #include <data/fourier_filter.h>
 
@@ -569,125 +572,39 @@ void regionGrowing3DEqualValue(const MultidimArray<double> &V_in, MultidimArray<
 
 
 void distanceTransform(const MultidimArray<int> &in, MultidimArray<int> &out,
-                       bool wrap)
+                       bool wrap, int nThreads)
 {
-    std::list<int> toExplore; /* A list of points to explore */
-
-    in.checkDimension(2);
-
-    out.resize(in);
-    out.initConstant(XSIZE(in) + YSIZE(in));
-
-#define CHECK_POINT_DIST(i,j,proposedDistance) \
-    { \
-        int ip=i; \
-        int jp=j; \
-        if (wrap) \
-        { \
-            ip=intWRAP(ip,STARTINGY(out),FINISHINGY(out));\
-            jp=intWRAP(jp,STARTINGX(out),FINISHINGX(out));\
-        } \
-        if (ip>=STARTINGY(out) && ip<=FINISHINGY(out) && \
-            jp>=STARTINGX(out) && jp<=FINISHINGX(out)) \
-            if (out(ip,jp)>proposedDistance) \
-            { \
-                out(ip,jp)=proposedDistance; \
-                toExplore.push_back(ip); \
-                toExplore.push_back(jp); \
-                toExplore.push_back(proposedDistance); \
-            } \
-    }
-
-    // Look for all elements in the binary mask and set the corresponding
-    // distance to 0
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(in)
-    if (in(i, j))
-    {
-        out(i, j) = 0;
-        CHECK_POINT_DIST(i-1, j, 1);
-        CHECK_POINT_DIST(i+1, j, 1);
-        CHECK_POINT_DIST(i, j-1, 1);
-        CHECK_POINT_DIST(i, j+1, 1);
-    }
-
-    while (!toExplore.empty())
-    {
-        int i = toExplore.front();
-        toExplore.pop_front();
-        int j = toExplore.front();
-        toExplore.pop_front();
-        int proposedDistance = toExplore.front();
-        toExplore.pop_front();
-
-        if (proposedDistance == out(i, j))
-        {
-            // If this is the current distance (i.e., it has not
-            // been supersceded by a later value
-            CHECK_POINT_DIST(i-1, j, proposedDistance+1);
-            CHECK_POINT_DIST(i+1, j, proposedDistance+1);
-            CHECK_POINT_DIST(i, j-1, proposedDistance+1);
-            CHECK_POINT_DIST(i, j+1, proposedDistance+1);
-        }
-    }
+    distanceTransformL1(in, out, wrap, nThreads);
 }
 
 /* Label image ------------------------------------------------------------ */
 int labelImage2D(const MultidimArray<double> &I, MultidimArray<double> &label,
-                 int neighbourhood)
+                 int neighbourhood, int nThreads)
 {
     I.checkDimension(2);
-
-    label = I;
-    int colour = 32000;
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(label)
-    {
-        if (label(i, j) != 1)
-            continue;
-        regionGrowing2D(label, label, i, j, 0, colour, false, neighbourhood);
-        colour++;
-    }
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(label)
-    if (label(i, j) != 0)
-        label(i, j) = label(i, j) - 31999;
-    return colour - 32000;
+    return labelConnectedComponents(I, label, neighbourhood, nThreads);
 }
 
 /* Label volume ------------------------------------------------------------ */
-int labelImage3D(const MultidimArray<double> &V, MultidimArray<double> &label)
+int labelImage3D(const MultidimArray<double> &V, MultidimArray<double> &label,
+                 int nThreads)
 {
     V.checkDimension(3);
-
-    label = V;
-    int colour = 32000;
-    FOR_ALL_ELEMENTS_IN_ARRAY3D(label)
-    {
-        if (label(k, i, j) != 1)
-            continue;
-        regionGrowing3D(label, label, k, i, j, 0, colour, false);
-        colour++;
-    }
-    FOR_ALL_ELEMENTS_IN_ARRAY3D(label)
-    if (A3D_ELEM(label,k, i, j) != 0)
-        A3D_ELEM(label,k, i, j) = A3D_ELEM(label,k, i, j) - 31999;
-    return colour - 32000;
+    return labelConnectedComponents(V, label, 26, nThreads);
 }
 
 /* Remove small components ------------------------------------------------- */
 void removeSmallComponents(MultidimArray<double> &I, int size,
-                           int neighbourhood)
+                           int neighbourhood, int nThreads)
 {
     MultidimArray<double> label;
     int imax;
     if (ZSIZE(I)==1)
-    	imax=labelImage2D(I, label, neighbourhood);
+    	imax=labelImage2D(I, label, neighbourhood, nThreads);
     else
-    	imax=labelImage3D(I, label);
-    MultidimArray<int> nlabel(imax + 1);
-    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(label)
-    {
-    	int l=(int)DIRECT_MULTIDIM_ELEM(label,n);
-    	A1D_ELEM(nlabel,l)++;
-    }
+    	imax=labelImage3D(I, label, nThreads);
+    MultidimArray<int> nlabel;
+    componentSizes(label, imax, nlabel);
     FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(label)
     {
     	int l=(int)DIRECT_MULTIDIM_ELEM(label,n);
@@ -698,21 +615,17 @@ void removeSmallComponents(MultidimArray<double> &I, int size,
 
 /* Keep biggest component -------------------------------------------------- */
 void keepBiggestComponent(MultidimArray<double> &I, double percentage,
-                          int neighbourhood)
+                          int neighbourhood, int nThreads)
 {
     MultidimArray<double> label;
     int imax;
     if (ZSIZE(I)==1)
-    	imax=labelImage2D(I, label, neighbourhood);
+    	imax=labelImage2D(I, label, neighbourhood, nThreads);
     else
-    	imax=labelImage3D(I, label);
-    MultidimArray<int> nlabel(imax + 1);
-    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(label)
-    {
-    	int l=(int)DIRECT_MULTIDIM_ELEM(label,n);
-    	if (l>0)
-    		A1D_ELEM(nlabel,l)++;
-    }
+    	imax=labelImage3D(I, label, nThreads);
+    MultidimArray<int> nlabel;
+    componentSizes(label, imax, nlabel);
+    A1D_ELEM(nlabel,0)=0;
 
     MultidimArray <int> best;
     nlabel.indexSort(best);
@@ -742,35 +655,32 @@ void keepBiggestComponent(MultidimArray<double> &I, double percentage,
 }
 
 /* Fill object ------------------------------------------------------------- */
-void fillBinaryObject(MultidimArray<double> &I, int neighbourhood)
+void fillBinaryObject(MultidimArray<double> &I, int neighbourhood, int nThreads)
 {
     I.checkDimension(2);
 
     MultidimArray<double> label;
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(I)
-    I(i, j) = 1 - I(i, j);
-    labelImage2D(I, label, neighbourhood);
-    double l0 = label(STARTINGY(I), STARTINGX(I));
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(label)
-    if (label(i, j) == l0)
-        I(i, j) = 0;
-    else
-        I(i, j) = 1;
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(I)
+    DIRECT_MULTIDIM_ELEM(I,n) = 1 - DIRECT_MULTIDIM_ELEM(I,n);
+    labelImage2D(I, label, neighbourhood, nThreads);
+    // The component of the first pixel is the background
+    double l0 = DIRECT_A2D_ELEM(label, 0, 0);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(label)
+    DIRECT_MULTIDIM_ELEM(I,n) = (DIRECT_MULTIDIM_ELEM(label,n) == l0) ? 0 : 1;
 }
 
 /* Variance filter ----------------------------------------------------------*/
 void varianceFilter(MultidimArray<double> &I, int kernelSize, bool relative)
 {
     int kernelSize_2 = kernelSize/2;
-    MultidimArray<double> kernel;
-    kernel.resize(kernelSize,kernelSize);
-    kernel.setXmippOrigin();
 
     // std::cout << " Creating the variance matrix " << std::endl;
     MultidimArray<double> mVar(YSIZE(I),XSIZE(I));
     mVar.setXmippOrigin();
-    double stdKernel, avgKernel, min_val, max_val;
+    double stdKernel, avgKernel;
     int x0, y0, xF, yF;
+    LocalStatistics stats;
+    stats.compute(I);
 
     // I.computeStats(avgImg, stdImg, min_im, max_im);    
     
@@ -791,8 +701,8 @@ void varianceFilter(MultidimArray<double> &I, int kernelSize, bool relative)
                 if (yF > YSIZE(I))
                     yF = YSIZE(I);
 
-                I.window(kernel, y0, x0, yF, xF);
-                kernel.computeStats(avgKernel, stdKernel, min_val, max_val);
+                // Same statistics as I.window(kernel, y0, x0, yF, xF) and computeStats
+                stats.windowStats(y0, x0, yF, xF, avgKernel, stdKernel, true);
                 
                 DIRECT_A2D_ELEM(mVar, i, j) = stdKernel;
             }
@@ -848,13 +758,12 @@ void varianceFilter(MultidimArray<double> &I, int kernelSize, bool relative)
 void noisyZonesFilter(MultidimArray<double> &I, int kernelSize)
 {
     int kernelSize_2 = kernelSize/2;
-    MultidimArray<double> kernel;
-    kernel.resize(kernelSize,kernelSize);
-    kernel.setXmippOrigin();
 
     MultidimArray<double> mAvg=I, mVar=I;
-    double stdKernel, varKernel, avgKernel, min_val, max_val;
+    double stdKernel, varKernel, avgKernel;
     int x0, y0, xF, yF;
+    LocalStatistics stats;
+    stats.compute(I);
     
     for (int i=kernelSize_2; i<(int)YSIZE(I); i+=kernelSize_2)
         for (int j=kernelSize_2; j<(int)XSIZE(I); j+=kernelSize_2)
@@ -873,8 +782,7 @@ void noisyZonesFilter(MultidimArray<double> &I, int kernelSize)
                 if (yF > YSIZE(I))
                     yF = YSIZE(I);
 
-                I.window(kernel, y0, x0, yF, xF);
-                kernel.computeStats(avgKernel, stdKernel, min_val, max_val);
+                stats.windowStats(y0, x0, yF, xF, avgKernel, stdKernel, true);
                 varKernel = stdKernel*stdKernel;
 
                 DIRECT_A2D_ELEM(mAvg, i, j) = avgKernel*avgKernel;
@@ -1822,6 +1730,27 @@ void bestNonwrappingShift(const MultidimArray<double> &I1, const MultidimArray<
     I2.checkDimension(2);
 
     bestShift(I1, FFTI1, I2, shiftX, shiftY, aux);
+    chooseNonwrappingShift(I1, I2, shiftX, shiftY);
+}
+
+void bestNonwrappingShift(const MultidimArray<double> &I1, const MultidimArray< std::complex<double> >&FFTI1,
+                          const MultidimArray<double> &I2, const MultidimArray< std::complex<double> >&FFTI2,
+                          double &shiftX, double &shiftY, CorrelationAux &aux)
+{
+    I1.checkDimension(2);
+    I2.checkDimension(2);
+
+    MultidimArray<double> Mcorr;
+    Mcorr.resizeNoCopy(I2);
+    STARTINGX(Mcorr)=STARTINGX(I2);
+    STARTINGY(Mcorr)=STARTINGY(I2);
+    bestShift(FFTI1, FFTI2, Mcorr, shiftX, shiftY, aux);
+    chooseNonwrappingShift(I1, I2, shiftX, shiftY);
+}
+
+void chooseNonwrappingShift(const MultidimArray<double> &I1, const MultidimArray<double> &I2,
+                            double &shiftX, double &shiftY)
+{
     double bestCorr, corr;
     MultidimArray<double> Iaux;
 
@@ -1957,9 +1886,21 @@ void computeAlignmentTransforms(const MultidimArray<double>& I, AlignmentTransfo
 #define INITIAL_SHIFT_THRESHOLD 	SHIFT_THRESHOLD + 1.0		// Shift threshold in pixels.
 #define INITIAL_ROTATE_THRESHOLD 	ROTATE_THRESHOLD + 1.0		// Rotate threshold in degrees.
 
+// Transforms of an image to be aligned: its Fourier transform and its
+// conjugated polar transform, as computed in the first round of alignImages
+void computeAlignmentImageTransforms(const MultidimArray<double>& I, AlignmentTransforms &ITransforms,
+		AlignmentAux &aux, CorrelationAux &aux2)
+{
+	MultidimArray<double> Iaux=I;
+	aux2.transformer2.FourierTransform(Iaux, ITransforms.FFTI, true);
+	polarFourierTransform<true>(I, ITransforms.polarFourierI, true, XSIZE(I) / 5, XSIZE(I) / 2, aux.plans, 1);
+}
+
+// Align I to Iref. If ITransforms is not NULL, it contains the transforms of I
+// computed by computeAlignmentImageTransforms, and they are used in the first round
 double alignImages(const MultidimArray<double>& Iref, const AlignmentTransforms& IrefTransforms, MultidimArray<double>& I,
-                   Matrix2D<double>&M, bool wrap, AlignmentAux &aux, CorrelationAux &aux2,
-                   RotationalCorrelationAux &aux3)
+                   const AlignmentTransforms *ITransforms, Matrix2D<double>&M, bool wrap, AlignmentAux &aux,
+                   CorrelationAux &aux2, RotationalCorrelationAux &aux3)
 {
     I.checkDimension(2);
 
@@ -1981,7 +1922,10 @@ double alignImages(const MultidimArray<double>& Iref, const AlignmentTransforms&
 		if (((shiftXSR > SHIFT_THRESHOLD) || (shiftXSR < (-SHIFT_THRESHOLD))) ||
 			((shiftYSR > SHIFT_THRESHOLD) || (shiftYSR < (-SHIFT_THRESHOLD))))
 		{
-			bestNonwrappingShift(Iref, IrefTransforms.FFTI, aux.IauxSR, shiftXSR, shiftYSR, aux2);
+			if (i==0 && ITransforms!=NULL)
+				bestNonwrappingShift(Iref, IrefTransforms.FFTI, aux.IauxSR, ITransforms->FFTI, shiftXSR, shiftYSR, aux2);
+			else
+				bestNonwrappingShift(Iref, IrefTransforms.FFTI, aux.IauxSR, shiftXSR, shiftYSR, aux2);
 			MAT_ELEM(aux.ASR,0,2) += shiftXSR;
 			MAT_ELEM(aux.ASR,1,2) += shiftYSR;
 			applyGeometry(LINEAR, aux.IauxSR, I, aux.ASR, IS_NOT_INV, wrap);
@@ -2001,9 +1945,14 @@ double alignImages(const MultidimArray<double>& Iref, const AlignmentTransforms&
         // Rotate then shift
 		if (bestRotRS > ROTATE_THRESHOLD)
 		{
-			polarFourierTransform<true>(aux.IauxRS, aux.polarFourierI, true,
-											XSIZE(Iref) / 5, XSIZE(Iref) / 2, aux.plans, 1);
-			bestRotRS = best_rotation(IrefTransforms.polarFourierI, aux.polarFourierI, aux3);
+			if (i==0 && ITransforms!=NULL)
+				bestRotRS = best_rotation(IrefTransforms.polarFourierI, ITransforms->polarFourierI, aux3);
+			else
+			{
+				polarFourierTransform<true>(aux.IauxRS, aux.polarFourierI, true,
+												XSIZE(Iref) / 5, XSIZE(Iref) / 2, aux.plans, 1);
+				bestRotRS = best_rotation(IrefTransforms.polarFourierI, aux.polarFourierI, aux3);
+			}
 			rotation2DMatrix(bestRotRS, aux.R);
 			aux.ARS = aux.R * aux.ARS;
 			applyGeometry(LINEAR, aux.IauxRS, I, aux.ARS, IS_NOT_INV, wrap);
@@ -2037,6 +1986,13 @@ double alignImages(const MultidimArray<double>& Iref, const AlignmentTransforms&
     return corr;
 }
 
+double alignImages(const MultidimArray<double>& Iref, const AlignmentTransforms& IrefTransforms, MultidimArray<double>& I,
+                   Matrix2D<double>&M, bool wrap, AlignmentAux &aux, CorrelationAux &aux2,
+                   RotationalCorrelationAux &aux3)
+{
+    return alignImages(Iref, IrefTransforms, I, NULL, M, wrap, aux, aux2, aux3);
+}
+
 double alignImages(const MultidimArray<double>& Iref, MultidimArray<double>& I,
                    Matrix2D<double>&M, bool wrap, AlignmentAux &aux, CorrelationAux &aux2,
                    RotationalCorrelationAux &aux3)
@@ -2105,6 +2061,80 @@ double alignImagesConsideringMirrors(const MultidimArray<double>& Iref,
     return alignImagesConsideringMirrors(Iref, IrefTransforms, I, M, aux, aux2, aux3, wrap, mask);
 }
 
+void alignImagesToReferences(const MultidimArray<double>& Irefs, const AlignmentTransforms *IrefsTransforms,
+                             const MultidimArray<double>& I, MultidimArray<double>& Ialigned,
+                             std::vector< Matrix2D<double> > &M, std::vector<double> &corr,
+                             AlignmentAux& aux, CorrelationAux& aux2, RotationalCorrelationAux &aux3,
+                             bool wrap, bool considerMirrors, const MultidimArray<int>* mask)
+{
+    std::vector<size_t> refs(NSIZE(Irefs));
+    for (size_t n=0; n<refs.size(); ++n)
+        refs[n]=n;
+    alignImagesToReferences(Irefs, IrefsTransforms, refs, I, Ialigned, M, corr, aux, aux2, aux3,
+                            wrap, considerMirrors, mask);
+}
+
+void alignImagesToReferences(const MultidimArray<double>& Irefs, const AlignmentTransforms *IrefsTransforms,
+                             const std::vector<size_t> &refs,
+                             const MultidimArray<double>& I, MultidimArray<double>& Ialigned,
+                             std::vector< Matrix2D<double> > &M, std::vector<double> &corr,
+                             AlignmentAux& aux, CorrelationAux& aux2, RotationalCorrelationAux &aux3,
+                             bool wrap, bool considerMirrors, const MultidimArray<int>* mask)
+{
+    I.checkDimension(2);
+    if (XSIZE(Irefs)!=XSIZE(I) || YSIZE(Irefs)!=YSIZE(I))
+        REPORT_ERROR(ERR_MULTIDIM_SIZE,"alignImagesToReferences: references and image have different sizes");
+
+    // Transforms of the image and its mirror, shared by all references
+    AlignmentTransforms ITransforms, ImirrorTransforms;
+    MultidimArray<double> Imirror;
+    computeAlignmentImageTransforms(I, ITransforms, aux, aux2);
+    if (considerMirrors)
+    {
+        Imirror = I;
+        Imirror.selfReverseX();
+        Imirror.setXmippOrigin();
+        computeAlignmentImageTransforms(Imirror, ImirrorTransforms, aux, aux2);
+    }
+
+    size_t Nrefs=refs.size();
+    Ialigned.resizeNoCopy(Nrefs, 1, YSIZE(I), XSIZE(I));
+    M.resize(Nrefs);
+    corr.resize(Nrefs);
+    MultidimArray<double> Iref, Iaux, IauxMirror, IalignedN;
+    Matrix2D<double> Mmirror;
+    for (size_t n=0; n<Nrefs; ++n)
+    {
+        Iref.aliasImageInStack(Irefs, refs[n]);
+        Iref.setXmippOrigin();
+        const AlignmentTransforms &IrefTransforms=IrefsTransforms[refs[n]];
+        Iaux = I;
+        corr[n]=alignImages(Iref, IrefTransforms, Iaux, &ITransforms, M[n], wrap, aux, aux2, aux3);
+        if (considerMirrors)
+        {
+            // Same as alignImagesConsideringMirrors
+            IauxMirror = Imirror;
+            double corrMirror=alignImages(Iref, IrefTransforms, IauxMirror, &ImirrorTransforms, Mmirror,
+                                          wrap, aux, aux2, aux3);
+            if (mask!=NULL)
+            {
+                corr[n] = correlationIndex(Iref, Iaux, mask);
+                corrMirror = correlationIndex(Iref, IauxMirror, mask);
+            }
+            if (corrMirror > corr[n])
+            {
+                corr[n] = corrMirror;
+                Iaux = IauxMirror;
+                M[n] = Mmirror;
+                MAT_ELEM(M[n],0,0) *= -1;
+                MAT_ELEM(M[n],1,0) *= -1;
+            }
+        }
+        IalignedN.aliasImageInStack(Ialigned, n);
+        memcpy(MULTIDIM_ARRAY(IalignedN), MULTIDIM_ARRAY(Iaux), MULTIDIM_SIZE(Iaux)*sizeof(double));
+    }
+}
+
 void alignSetOfImages(MetaData &MD, MultidimArray<double>& Iavg, int Niter,
                       bool considerMirror)
 {
@@ -3048,6 +3078,8 @@ void localThresholding(MultidimArray<double> &img, double C, double dimLocal,
     // Convolve the input image with the kernel
     MultidimArray<double> convolved;
     convolved.initZeros(img);
+    LocalStatistics stats;
+    stats.compute(img);
     FOR_ALL_ELEMENTS_IN_ARRAY2D(convolved)
     {
         if (mask != NULL)
@@ -3057,23 +3089,7 @@ void localThresholding(MultidimArray<double> &img, double C, double dimLocal,
         int jj0 = XMIPP_MAX(STARTINGX(convolved), FLOOR(j - dimLocal));
         int iiF = XMIPP_MIN(FINISHINGY(convolved), CEIL(i + dimLocal));
         int jjF = XMIPP_MIN(FINISHINGX(convolved), CEIL(j + dimLocal));
-        double N = 0;
-        for (int ii = ii0; ii <= iiF; ii++)
-            for (int jj = jj0; jj <= jjF; jj++)
-            {
-                if (mask == NULL)
-                {
-                    convolved(i, j) += img(ii, jj);
-                    ++N;
-                }
-                else if ((*mask)(i, j))
-                {
-                    convolved(i, j) += img(ii, jj);
-                    ++N;
-                }
-            }
-        if (N != 0)
-            convolved(i, j) /= N;
+        convolved(i, j) = stats.windowMean(ii0, jj0, iiF, jjF);
     }
 
     // Subtract the original from the convolved image and threshold
@@ -3371,13 +3387,10 @@ Matrix2D<double> centerImage(MultidimArray<double> &I, CorrelationAux &aux,
 /** Force positive -------------------------------------------------------- */
 void forcePositive(MultidimArray<double> &V)
 {
-    MultidimArray<char> mask(ZSIZE(V), YSIZE(V), XSIZE(V));
-    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(V)
-    {
-        double x = DIRECT_MULTIDIM_ELEM(V, n);
-        DIRECT_MULTIDIM_ELEM(mask, n) = (x <= 0);
-    }
-    boundMedianFilter(V, mask);
+    MultidimArray<char> mask;
+    std::vector<size_t> bad;
+    detectBadPixels(V, mask, bad, [](double x) { return x <= 0; });
+    boundMedianFilterList(V, mask, bad);
 }
 
 void computeEdges(const MultidimArray<double>& vol,
@@ -3459,6 +3472,8 @@ void BadPixelFilter::readParams(XmippProgram * program)
         factor = program->getDoubleParam("--bad_pixels", "outliers");
         type = OUTLIER;
     }
+    // --thr is defined by the mean shift filter of the same program
+    Nthreads = program->getIntParam("--thr");
 }
 
 /** Apply the filter to an image or volume*/
@@ -3470,10 +3485,10 @@ void BadPixelFilter::apply(MultidimArray<double> &img)
         forcePositive(img);
         break;
     case MASK:
-        boundMedianFilter(img, mask->data);
+        boundMedianFilter(img, mask->data, 0, Nthreads);
         break;
     case OUTLIER:
-        pixelDesvFilter(img, factor);
+        pixelDesvFilter(img, factor, Nthreads);
         break;
 
     }
@@ -3575,7 +3590,9 @@ void MedianFilter::defineParams(XmippProgram * program)
 
 /** Read from program command line */
 void MedianFilter::readParams(XmippProgram * program)
-{ //Do nothing by now
+{
+    // --thr is defined by the mean shift filter of the same program
+    Nthreads = program->getIntParam("--thr");
 }
 
 /** Apply the filter to an image or volume*/
@@ -3583,7 +3600,7 @@ void MedianFilter::apply(MultidimArray<double> &img)
 {
     static MultidimArray<double> tmp;
     tmp = img;
-    medianFilter3x3(tmp, img);
+    medianFilter3x3(tmp, img, Nthreads);
 }
 
 /** Define the parameters for use inside an Xmipp program */
@@ -35,6 +35,7 @@
 #include <data/numerical_tools.h>
 #include <data/mask.h>
 #include <data/polar.h>
+#include <data/median_filter.h>
 
 /// @defgroup Filters Filters
 /// @ingroup DataLibrary
@@ -138,7 +139,7 @@ void regionGrowing3DEqualValue(const MultidimArray<double> &V_in,
   * This is useful if the image coordinates represent angles
   */
 void distanceTransform(const MultidimArray<int> &in,
-                       MultidimArray<int> &out, bool wrap=false);
+                       MultidimArray<int> &out, bool wrap=false, int nThreads=1);
 
 /** Label a binary image
  * @ingroup Filters
@@ -149,16 +150,18 @@ void distanceTransform(const MultidimArray<int> &in,
  */
 int labelImage2D(const MultidimArray< double >& I,
                  MultidimArray< double >& label,
-                 int neighbourhood = 8);
+                 int neighbourhood = 8,
+                 int nThreads = 1);
 
 /** Label a binary volume
  * @ingroup Filters
  *
  * This function receives a binary image and labels all its connected
- * components. The background is labeled as 0, and the components as 1, 2, 3
- * ...
+ * components (26-neighbourhood). The background is labeled as 0, and the
+ * components as 1, 2, 3 ...
  */
-int labelImage3D(const MultidimArray< double >& V, MultidimArray< double >& label);
+int labelImage3D(const MultidimArray< double >& V, MultidimArray< double >& label,
+                 int nThreads = 1);
 
 /** Remove connected components
  * @ingroup Filters
@@ -167,7 +170,8 @@ int labelImage3D(const MultidimArray< double >& V, MultidimArray< double >& labe
  */
 void removeSmallComponents(MultidimArray< double >& I,
                            int size,
-                           int neighbourhood = 8);
+                           int neighbourhood = 8,
+                           int nThreads = 1);
 
 /** Keep the biggest connected component
  * @ingroup Filters
@@ -177,14 +181,16 @@ void removeSmallComponents(MultidimArray< double >& I,
  */
 void keepBiggestComponent(MultidimArray< double >& I,
                           double percentage = 0,
-                          int neighbourhood = 8);
+                          int neighbourhood = 8,
+                          int nThreads = 1);
 
 /** Fill object
  * @ingroup Filters
  *
  * Everything that is not background is assumed to be object.
  */
-void fillBinaryObject(MultidimArray< double >&I, int neighbourhood = 8);
+void fillBinaryObject(MultidimArray< double >&I, int neighbourhood = 8,
+                      int nThreads = 1);
 
 /** Applays a variance filter to an image
  * @ingroup Filters
@@ -486,6 +492,22 @@ void bestNonwrappingShift(const MultidimArray<double> &I1, const MultidimArray<
                           const MultidimArray<double> &I2, double &shiftX, double &shiftY,
                           CorrelationAux &aux);
 
+/** Translational search (non-wrapping).
+ * Assumes that FFTI1 and FFTI2 are already computed (normalized, as returned by
+ * FourierTransformer).
+ */
+void bestNonwrappingShift(const MultidimArray<double> &I1, const MultidimArray< std::complex<double> > &FFTI1,
+                          const MultidimArray<double> &I2, const MultidimArray< std::complex<double> > &FFTI2,
+                          double &shiftX, double &shiftY, CorrelationAux &aux);
+
+/** Choose between a shift and its wrapped versions.
+ * Given the shift (shiftX,shiftY) found in a correlation matrix, the four
+ * possibilities (shift, shift-size) are evaluated in real space without
+ * wrapping and the best one is returned in (shiftX,shiftY).
+ */
+void chooseNonwrappingShift(const MultidimArray<double> &I1, const MultidimArray<double> &I2,
+                            double &shiftX, double &shiftY);
+
 /** Translational search (non-wrapping).
  * @ingroup Filters
  *
@@ -551,6 +573,34 @@ double alignImages(const MultidimArray< double >& Iref,
                    CorrelationAux &aux2,
                    RotationalCorrelationAux &aux3);
 
+/** Align an image to many references.
+ * @ingroup Filters
+ *
+ * Irefs is a stack with the references and IrefsTransforms their precomputed
+ * transforms (one per image in the stack). I is aligned to each of the
+ * references exactly as alignImagesConsideringMirrors (or alignImages if
+ * considerMirrors is false) would do, but the transforms of I (and of its
+ * mirror) are computed only once for the whole block of references.
+ * The aligned versions of I are returned in the stack Ialigned, and the
+ * transformation matrices and correlations in M and corr.
+ */
+void alignImagesToReferences(const MultidimArray<double>& Irefs, const AlignmentTransforms *IrefsTransforms,
+                             const MultidimArray<double>& I, MultidimArray<double>& Ialigned,
+                             std::vector< Matrix2D<double> > &M, std::vector<double> &corr,
+                             AlignmentAux& aux, CorrelationAux& aux2, RotationalCorrelationAux &aux3,
+                             bool wrap, bool considerMirrors=true, const MultidimArray<int>* mask=NULL);
+
+/** Align an image to a subset of references.
+ * Same as above, but only the references whose indexes in the stack are
+ * given in refs are used. The outputs follow the order of refs.
+ */
+void alignImagesToReferences(const MultidimArray<double>& Irefs, const AlignmentTransforms *IrefsTransforms,
+                             const std::vector<size_t> &refs,
+                             const MultidimArray<double>& I, MultidimArray<double>& Ialigned,
+                             std::vector< Matrix2D<double> > &M, std::vector<double> &corr,
+                             AlignmentAux& aux, CorrelationAux& aux2, RotationalCorrelationAux &aux3,
+                             bool wrap, bool considerMirrors=true, const MultidimArray<int>* mask=NULL);
+
 /** Auxiliary class for fast volume alignment */
 class VolumeAlignmentAux
 {
@@ -1133,82 +1183,13 @@ void median(MultidimArray< T >& x, MultidimArray< T >& y, T& m)
 
 /** Median_filter with a 3x3 selfWindow
  * @ingroup Filters
+ *
+ * The border of out is set to 0. See fastMedianFilter3x3.
  */
 template <typename T>
-void medianFilter3x3(MultidimArray< T >&m, MultidimArray< T >& out)
+void medianFilter3x3(MultidimArray< T >&m, MultidimArray< T >& out, int Nthreads=1)
 {
-    int backup_startingx = STARTINGX(m);
-    int backup_startingy = STARTINGY(m);
-
-    STARTINGX(m) = STARTINGY(m) = 0;
-    MultidimArray< T > v1(3), v2(3), v3(3), v4(3);
-    MultidimArray< T > v(6);
-
-    // Set the output matrix size
-    out.initZeros(m);
-
-    // Set the initial and final matrix indices to explore
-    int initialY = 1, initialX = 1;
-    int finalY = YSIZE(m) - 2;
-    int finalX = XSIZE(m) - 2;
-
-    // For every row
-    for (int i = initialY; i <= finalY; i++)
-    {
-        // For every pair of pixels (mean is computed obtaining
-        // two means at the same time using an efficient method)
-        for (int j = initialX; j <= finalX; j += 2)
-        {
-            // If we are in the border case
-            if (j == 1)
-            {
-                // Order the first and second vectors of 3 elements
-                sort(DIRECT_A2D_ELEM(m, i - 1, j - 1), DIRECT_A2D_ELEM(m, i, j - 1),
-                     DIRECT_A2D_ELEM(m, i + 1, j - 1), v1);
-                sort(DIRECT_A2D_ELEM(m, i - 1, j), DIRECT_A2D_ELEM(m, i, j),
-                     DIRECT_A2D_ELEM(m, i + 1, j), v2);
-            }
-            else
-            {
-                // Simply take ordered vectors from previous
-                v1 = v3;
-                v2 = v4;
-            }
-
-            // As we are computing 2 medians at the same time, if the matrix has
-            // an odd number of columns, the last column isn't calculated. It is
-            // done here
-            if (j == finalX)
-            {
-                v1 = v3;
-                v2 = v4;
-                sort(DIRECT_A2D_ELEM(m, i - 1, j + 1), DIRECT_A2D_ELEM(m, i, j + 1),
-                     DIRECT_A2D_ELEM(m, i + 1, j + 1), v3);
-                fastMergeSort(v2, v3, v);
-                median(v1, v, DIRECT_A2D_ELEM(out,i, j));
-            }
-            else
-            {
-                // Order the third and fourth vectors of 3 elements
-                sort(DIRECT_A2D_ELEM(m, i - 1, j + 1), DIRECT_A2D_ELEM(m, i, j + 1),
-                     DIRECT_A2D_ELEM(m, i + 1, j + 1), v3);
-                sort(DIRECT_A2D_ELEM(m, i - 1, j + 2), DIRECT_A2D_ELEM(m, i, j + 2),
-                     DIRECT_A2D_ELEM(m, i + 1, j + 2), v4);
-
-                // Merge sort the second and third vectors
-                fastMergeSort(v2, v3, v);
-
-                // Find the first median and assign it to the output
-                median(v1, v, DIRECT_A2D_ELEM(out, i, j));
-
-                // Find the second median and assign it to the output
-                median(v4, v, DIRECT_A2D_ELEM(out, i, j + 1));
-            }
-        }
-    }
-
-    STARTINGX(m) = STARTINGX(out) = backup_startingx;
-    STARTINGY(m) = STARTINGY(out) = backup_startingy;
+    fastMedianFilter3x3(m, out, Nthreads);
 }
 
 /** Mumford-Shah smoothing
@@ -1352,65 +1333,10 @@ void forcePositive(MultidimArray<double> &V);
  *  you further use it.
  */
 template <typename T>
-void boundMedianFilter(MultidimArray< T > &V, const MultidimArray<char> &mask, int n=0)
+void boundMedianFilter(MultidimArray< T > &V, const MultidimArray<char> &mask, int n=0,
+                       int Nthreads=1)
 {
-    bool badRemaining;
-    T neighbours[125];
-    T aux;
-    int N = 0, index;
-
-    do
-    {
-        badRemaining=false;
-
-        FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY3D(V)
-        if (DIRECT_A3D_ELEM(mask, k, i, j) != 0)
-        {
-            N = 0;
-            for (int kk=-2; kk<=2; kk++)
-            {
-            	size_t kkk=k+kk;
-                if (kkk<0 || kkk>=ZSIZE(V))
-                    continue;
-                for (int ii=-2; ii<=2; ii++)
-                {
-                	size_t iii=i+ii;
-                    if (iii<0 || iii>=YSIZE(V))
-                        continue;
-                    for (int jj=-2; jj<=2; jj++)
-                    {
-                    	size_t jjj=j+jj;
-                        if (jjj<0 || jjj>=XSIZE(V))
-                            continue;
-
-                        if (DIRECT_A3D_ELEM(mask, kkk, iii, jjj) == 0)
-                        {
-                            index = N++;
-                            neighbours[index] = DIRECT_A3D_ELEM(V, kkk,iii,jjj);
-                            //insertion sort
-                            while (index > 0 && neighbours[index-1] > neighbours[index])
-                            {
-                                SWAP(neighbours[index-1], neighbours[index], aux);
-                                --index;
-                            }
-                        }
-                    }
-                }
-                if (N == 0)
-                    badRemaining = true;
-                else
-                {
-                    //std::sort(neighbours.begin(),neighbours.end());
-                    if (N % 2 == 0)
-                        DIRECT_A3D_ELEM(V, k, i, j) = (T)(0.5*(neighbours[N/2-1]+ neighbours[N/2]));
-                    else
-                        DIRECT_A3D_ELEM(V, k, i, j) = neighbours[N/2];
-                    DIRECT_A3D_ELEM(mask, k, i, j) = false;
-                }
-            }
-        }
-    }
-    while (badRemaining);
+    fastBoundMedianFilter(V, mask, Nthreads);
 }
 
 /** Remove bad pixels.
@@ -1420,25 +1346,9 @@ void boundMedianFilter(MultidimArray< T > &V, const MultidimArray<char> &mask, i
  *  given by thresFactor * std.
   */
 template <typename T>
-void pixelDesvFilter(MultidimArray< T > &V, double thresFactor)
+void pixelDesvFilter(MultidimArray< T > &V, double thresFactor, int Nthreads=1)
 {
-    if (thresFactor > 0 )
-    {
-        double avg, stddev, high, low;
-        T dummy;
-        MultidimArray<char> mask(ZSIZE(V), YSIZE(V), XSIZE(V));
-        avg = stddev = low = high = 0;
-        V.computeStats(avg, stddev, dummy, dummy);//min and max not used
-        low  = (avg - thresFactor * stddev);
-        high = (avg + thresFactor * stddev);
-
-        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(V)
-        {
-            double x = DIRECT_MULTIDIM_ELEM(V, n);
-            DIRECT_MULTIDIM_ELEM(mask, n) = (x < low || x > high) ? 1 : 0;
-        }
-        boundMedianFilter(V, mask);
-    }
+    fastPixelDesvFilter(V, thresFactor, Nthreads);
 }
 
 /** Compute logarithm.
@@ -1512,6 +1422,9 @@ public:
     BadPixelFilterType type; //type of filter
     double factor;    //for the case of outliers bad pixels
     Image<char> *mask; //for the case of mask bad pixels
+    int Nthreads;     //for the detection of the bad pixels
+
+    BadPixelFilter(): Nthreads(1) {}
 
     /** Define the parameters for use inside an Xmipp program */
     static void defineParams(XmippProgram * program);
@@ -1567,6 +1480,11 @@ public:
 class MedianFilter: public XmippFilter
 {
 public:
+    /// Number of threads
+    int Nthreads;
+
+    MedianFilter(): Nthreads(1) {}
+
     /** Define the parameters for use inside an Xmipp program */
     static void defineParams(XmippProgram * program);
     /** Read from program command line */
@@ -25,6 +25,7 @@
 
 #include "fourier_projection.h"
 #include <core/xmipp_fft.h>
+#include <thread>
 
 /* Empty constructor ======================================================= */
 Projection::Projection(): Image<double>()
@@ -103,15 +104,55 @@ void FourierProjector::updateVolume(MultidimArray<double> &V)
 
 void FourierProjector::project(double rot, double tilt, double psi, const MultidimArray<double> *ctf)
 {
-    double freqy, freqx;
-    std::complex< double > f;
     Euler_angles2matrix(rot,tilt,psi,E);
+    interpolateProjection(E,projectionFourier,rowBuffers,ctf,0,0);
+    transformer2D.inverseFourierTransform();
+}
+
+void FourierProjector::initBuffers(FourierProjectionBuffers &buffers) const
+{
+    buffers.projection.initZeros(volumeSize,volumeSize);
+    buffers.projection.setXmippOrigin();
+    buffers.transformer2D.FourierTransform(buffers.projection,buffers.projectionFourier,false);
+    buffers.shifter.initialize(volumeSize,volumeSize);
+}
 
+void FourierProjector::project(double rot, double tilt, double psi, FourierProjectionBuffers &buffers,
+                               const MultidimArray<double> *ctf, double shiftX, double shiftY) const
+{
+    if (XSIZE(buffers.projection)!=(size_t)volumeSize)
+        initBuffers(buffers);
+    Euler_angles2matrix(rot,tilt,psi,buffers.E);
+    interpolateProjection(buffers.E,buffers.projectionFourier,buffers,ctf,shiftX,shiftY);
+    buffers.transformer2D.inverseFourierTransform();
+}
+
+void FourierProjector::interpolateProjection(const Matrix2D<double> &E,
+        MultidimArray< std::complex<double> > &projectionFourier,
+        FourierProjectionBuffers &rows, const MultidimArray<double> *ctf,
+        double shiftX, double shiftY) const
+{
+    double freqy, freqx;
     projectionFourier.initZeros();
     double maxFreq2=maxFrequency*maxFrequency;
-    int Xdim=(int)XSIZE(VfourierRealCoefs);
-    int Ydim=(int)YSIZE(VfourierRealCoefs);
-    int Zdim=(int)ZSIZE(VfourierRealCoefs);
+    bool shifted=(shiftX!=0 || shiftY!=0);
+    if (shifted)
+    {
+        rows.shifter.initialize(volumeSize,volumeSize);
+        rows.shifter.setShift(shiftX,shiftY);
+    }
+
+    // The volume coordinates of a whole row are interpolated in a single call
+    size_t Xdim=XSIZE(projectionFourier);
+    std::vector<size_t> &rowJ=rows.rowJ;
+    std::vector<double> &rowVolX=rows.rowVolX, &rowVolY=rows.rowVolY, &rowVolZ=rows.rowVolZ;
+    std::vector<double> &rowRe=rows.rowRe, &rowIm=rows.rowIm;
+    rowJ.resize(Xdim);
+    rowVolX.resize(Xdim);
+    rowVolY.resize(Xdim);
+    rowVolZ.resize(Xdim);
+    rowRe.resize(Xdim);
+    rowIm.resize(Xdim);
 
     for (size_t i=0; i<YSIZE(projectionFourier); ++i)
     {
@@ -121,7 +162,8 @@ void FourierProjector::project(double rot, double tilt, double psi, const Multid
         double freqYvol_X=MAT_ELEM(E,1,0)*freqy;
         double freqYvol_Y=MAT_ELEM(E,1,1)*freqy;
         double freqYvol_Z=MAT_ELEM(E,1,2)*freqy;
-        for (size_t j=0; j<XSIZE(projectionFourier); ++j)
+        size_t N=0;
+        for (size_t j=0; j<Xdim; ++j)
         {
             // The frequency of pairs (i,j) in 2D
             FFT_IDX2DIGFREQ(j,volumeSize,freqx);
@@ -130,110 +172,57 @@ void FourierProjector::project(double rot, double tilt, double psi, const Multid
             if ((freqy2+freqx*freqx)>maxFreq2)
                 continue;
 
-            // Compute corresponding frequency in the volume
-            double freqvol_X=freqYvol_X+MAT_ELEM(E,0,0)*freqx;
-            double freqvol_Y=freqYvol_Y+MAT_ELEM(E,0,1)*freqx;
-            double freqvol_Z=freqYvol_Z+MAT_ELEM(E,0,2)*freqx;
+            // Compute corresponding index in the volume
+            rowJ[N]=j;
+            rowVolX[N]=(freqYvol_X+MAT_ELEM(E,0,0)*freqx)*volumePaddedSize;
+            rowVolY[N]=(freqYvol_Y+MAT_ELEM(E,0,1)*freqx)*volumePaddedSize;
+            rowVolZ[N]=(freqYvol_Z+MAT_ELEM(E,0,2)*freqx)*volumePaddedSize;
+            ++N;
+        }
+        if (N==0)
+            continue;
 
-            double c,d;
-            if (BSplineDeg==0)
-            {
-                // 0 order interpolation
-                // Compute corresponding index in the volume
-                int kVolume=(int)round(freqvol_Z*volumePaddedSize);
-                int iVolume=(int)round(freqvol_Y*volumePaddedSize);
-                int jVolume=(int)round(freqvol_X*volumePaddedSize);
-                c = A3D_ELEM(VfourierRealCoefs,kVolume,iVolume,jVolume);
-                d = A3D_ELEM(VfourierImagCoefs,kVolume,iVolume,jVolume);
-            }
-            else if (BSplineDeg==1)
-            {
-                // B-spline linear interpolation
-                double kVolume=freqvol_Z*volumePaddedSize;
-                double iVolume=freqvol_Y*volumePaddedSize;
-                double jVolume=freqvol_X*volumePaddedSize;
-                c=VfourierRealCoefs.interpolatedElement3D(jVolume,iVolume,kVolume);
-                d=VfourierImagCoefs.interpolatedElement3D(jVolume,iVolume,kVolume);
-            }
-            else
+        if (BSplineDeg==0)
+        {
+            // 0 order interpolation
+            for (size_t n=0; n<N; ++n)
             {
-                // B-spline cubic interpolation
-                double kVolume=freqvol_Z*volumePaddedSize;
-                double iVolume=freqvol_Y*volumePaddedSize;
-                double jVolume=freqvol_X*volumePaddedSize;
-
-                // Commented for speed-up, the corresponding code is below
-                // c=VfourierRealCoefs.interpolatedElementBSpline3D(jVolume,iVolume,kVolume);
-                // d=VfourierImagCoefs.interpolatedElementBSpline3D(jVolume,iVolume,kVolume);
-
-                // The code below is a replicate for speed reasons of interpolatedElementBSpline3D
-                double z=kVolume;
-                double y=iVolume;
-                double x=jVolume;
-
-                // Logical to physical
-                z -= STARTINGZ(VfourierRealCoefs);
-                y -= STARTINGY(VfourierRealCoefs);
-                x -= STARTINGX(VfourierRealCoefs);
-
-                int l1 = (int)ceil(x - 2);
-                int l2 = l1 + 3;
-
-                int m1 = (int)ceil(y - 2);
-                int m2 = m1 + 3;
-
-                int n1 = (int)ceil(z - 2);
-                int n2 = n1 + 3;
-
-                c = d = 0.0;
-                double aux;
-                for (int nn = n1; nn <= n2; nn++)
-                {
-                    int equivalent_nn=nn;
-                    if      (nn<0)
-                        equivalent_nn=-nn-1;
-                    else if (nn>=Zdim)
-                        equivalent_nn=2*Zdim-nn-1;
-                    double yxsumRe = 0.0, yxsumIm = 0.0;
-                    for (int m = m1; m <= m2; m++)
-                    {
-                        int equivalent_m=m;
-                        if      (m<0)
-                            equivalent_m=-m-1;
-                        else if (m>=Ydim)
-                            equivalent_m=2*Ydim-m-1;
-                        double xsumRe = 0.0, xsumIm = 0.0;
-                        for (int l = l1; l <= l2; l++)
-                        {
-                            double xminusl = x - (double) l;
-                            int equivalent_l=l;
-                            if      (l<0)
-                                equivalent_l=-l-1;
-                            else if (l>=Xdim)
-                                equivalent_l=2*Xdim-l-1;
-                            double CoeffRe = (double) DIRECT_A3D_ELEM(VfourierRealCoefs,equivalent_nn,equivalent_m,equivalent_l);
-                            double CoeffIm = (double) DIRECT_A3D_ELEM(VfourierImagCoefs,equivalent_nn,equivalent_m,equivalent_l);
-                            BSPLINE03(aux,xminusl);
-                            xsumRe += CoeffRe * aux;
-                            xsumIm += CoeffIm * aux;
-                        }
-
-                        double yminusm = y - (double) m;
-                        BSPLINE03(aux,yminusm);
-						yxsumRe += xsumRe * aux;
-						yxsumIm += xsumIm * aux;
-                    }
-
-                    double zminusn = z - (double) nn;
-                    BSPLINE03(aux,zminusn);
-					c += yxsumRe * aux;
-					d += yxsumIm * aux;
-                }
+                int kVolume=(int)round(rowVolZ[n]);
+                int iVolume=(int)round(rowVolY[n]);
+                int jVolume=(int)round(rowVolX[n]);
+                rowRe[n] = A3D_ELEM(VfourierRealCoefs,kVolume,iVolume,jVolume);
+                rowIm[n] = A3D_ELEM(VfourierImagCoefs,kVolume,iVolume,jVolume);
             }
+        }
+        else if (BSplineDeg==1)
+            // B-spline linear interpolation, the samples outside the volume are 0
+            // as in interpolatedElement3D
+            interpolateBSpline3D<1>(VfourierRealCoefs,VfourierImagCoefs,N,
+                                    &rowVolX[0],&rowVolY[0],&rowVolZ[0],&rowRe[0],&rowIm[0],
+                                    BSPLINE_BOUNDARY_ZERO);
+        else
+            // B-spline cubic interpolation, same as interpolatedElementBSpline3D
+            interpolateBSpline3D<3>(VfourierRealCoefs,VfourierImagCoefs,N,
+                                    &rowVolX[0],&rowVolY[0],&rowVolZ[0],&rowRe[0],&rowIm[0]);
+
+        for (size_t n=0; n<N; ++n)
+        {
+            size_t j=rowJ[n];
+            double c=rowRe[n];
+            double d=rowIm[n];
 
             // Phase shift to move the origin of the image to the corner
             double a=DIRECT_A2D_ELEM(phaseShiftImgA,i,j);
             double b=DIRECT_A2D_ELEM(phaseShiftImgB,i,j);
+            if (shifted)
+            {
+                // Additional phase shift to translate the projection
+                std::complex<double> phase=rows.shifter.phase(i,j);
+                double cosPhase=phase.real(), sinPhase=phase.imag();
+                double aux=a*cosPhase-b*sinPhase;
+                b=a*sinPhase+b*cosPhase;
+                a=aux;
+            }
             if (ctf!=NULL)
             {
             	double ctfij=DIRECT_A2D_ELEM(*ctf,i,j);
@@ -252,7 +241,78 @@ void FourierProjector::project(double rot, double tilt, double psi, const Multid
             *(ptrI_ij+1) = ab_cd - ac - bd;
         }
     }
-    transformer2D.inverseFourierTransform();
+}
+
+void FourierProjector::projectBatchRange(const Matrix2D<double> &angles, const Matrix2D<double> *shifts,
+        const std::vector<CTFDescription> *ctfs, float *projections,
+        size_t n0, size_t nF) const
+{
+    FourierProjectionBuffers buffers;
+    initBuffers(buffers);
+    MultidimArray<double> ctfImage;
+    size_t projectionSize=MULTIDIM_SIZE(buffers.projection);
+    for (size_t n=n0; n<nF; ++n)
+    {
+        const MultidimArray<double> *ctf=NULL;
+        if (ctfs!=NULL)
+        {
+            // The CTF keeps precomputed values, each thread needs its copy
+            CTFDescription ctfn=(*ctfs)[n];
+            ctfn.generateCTF(volumeSize,volumeSize,ctfImage);
+            ctf=&ctfImage;
+        }
+        double shiftX=0, shiftY=0;
+        if (shifts!=NULL)
+        {
+            shiftX=MAT_ELEM(*shifts,n,0);
+            shiftY=MAT_ELEM(*shifts,n,1);
+        }
+        project(MAT_ELEM(angles,n,0),MAT_ELEM(angles,n,1),MAT_ELEM(angles,n,2),buffers,ctf,shiftX,shiftY);
+        float *ptr=projections+n*projectionSize;
+        const double *ptrProjection=MULTIDIM_ARRAY(buffers.projection);
+        for (size_t k=0; k<projectionSize; ++k)
+            ptr[k]=(float)ptrProjection[k];
+    }
+}
+
+void FourierProjector::projectBatch(const Matrix2D<double> &angles, const Matrix2D<double> *shifts,
+                                    const std::vector<CTFDescription> *ctfs, float *projections,
+                                    int Nthreads) const
+{
+    size_t N=MAT_YSIZE(angles);
+    if (MAT_XSIZE(angles)!=3)
+        REPORT_ERROR(ERR_MATRIX_SIZE,"The angles must be a N x 3 matrix");
+    if (shifts!=NULL && (MAT_YSIZE(*shifts)!=N || MAT_XSIZE(*shifts)!=2))
+        REPORT_ERROR(ERR_MATRIX_SIZE,"The shifts must be a N x 2 matrix");
+    if (ctfs!=NULL && ctfs->size()!=N)
+        REPORT_ERROR(ERR_ARG_INCORRECT,"There must be one CTF per projection");
+
+    size_t Nthr=XMIPP_MAX(1,XMIPP_MIN((size_t)Nthreads,N));
+    if (Nthr<=1)
+    {
+        projectBatchRange(angles,shifts,ctfs,projections,0,N);
+        return;
+    }
+    // The first error of any thread is reported once all of them finish
+    std::vector<std::thread> threads;
+    std::vector<std::string> errors(Nthr);
+    for (size_t t=0; t<Nthr; ++t)
+        threads.push_back(std::thread([&,t]()
+        {
+            try
+            {
+                projectBatchRange(angles,shifts,ctfs,projections,N*t/Nthr,N*(t+1)/Nthr);
+            }
+            catch (XmippError &xe)
+            {
+                errors[t]=xe.msg;
+            }
+        }));
+    for (size_t t=0; t<Nthr; ++t)
+        threads[t].join();
+    for (size_t t=0; t<Nthr; ++t)
+        if (!errors[t].empty())
+            REPORT_ERROR(ERR_UNCLASSIFIED,errors[t]);
 }
 
 void FourierProjector::produceSideInfo()
@@ -301,7 +361,10 @@ void FourierProjector::produceSideInfo()
         VfourierImagCoefs.selfWindow(idxMin,idxMin,idxMin,idxMax,idxMax,idxMax);
     }
     else
+    {
         Complex2RealImag(Vfourier, VfourierRealCoefs, VfourierImagCoefs);
+        volumePaddedSize=XSIZE(VfourierRealCoefs);
+    }
 
     // Allocate memory for the 2D Fourier transform
     projection().initZeros(volumeSize,volumeSize);
@@ -28,6 +28,9 @@
 #include <core/xmipp_image.h>
 #include <core/xmipp_program.h>
 #include <core/xmipp_fftw.h>
+#include "bspline_interpolation.h"
+#include "ctf.h"
+#include "fourier_shift.h"
 
 /**@defgroup FourierProjection Fourier projection
    @ingroup ReconsLibrary */
@@ -114,6 +117,35 @@ public:
     void assign(const Projection& P);
 };
 
+/** Work buffers of a Fourier projection.
+ * Several threads can project with the same FourierProjector as long as
+ * each of them has its own buffers (see FourierProjector::initBuffers).
+ * The buffers must not be copied once initialized.
+ */
+class FourierProjectionBuffers
+{
+public:
+    // Auxiliary FFT transformer
+    FourierTransformer transformer2D;
+
+    // Projection in Fourier space
+    MultidimArray< std::complex<double> > projectionFourier;
+
+    // Projection in real space
+    MultidimArray<double> projection;
+
+    // Euler matrix
+    Matrix2D<double> E;
+
+    // Points of the projection row being interpolated: column index,
+    // volume coordinates and interpolated real and imaginary parts
+    std::vector<size_t> rowJ;
+    std::vector<double> rowVolX, rowVolY, rowVolZ, rowRe, rowIm;
+
+    // Phase tables of the shift of the projection
+    FourierShifter shifter;
+};
+
 /** Program class to create projections in Fourier space */
 class FourierProjector
 {
@@ -152,6 +184,9 @@ public:
 
     // Euler matrix
     Matrix2D<double> E;
+private:
+    // Row buffers of project (the other buffers are the public members)
+    FourierProjectionBuffers rowBuffers;
 public:
     /* Empty constructor */
     FourierProjector(double paddFactor, double maxFreq, int degree);
@@ -166,6 +201,32 @@ public:
      */
     void project(double rot, double tilt, double psi, const MultidimArray<double> *ctf=NULL);
 
+    /** Allocate the buffers of a projection and plan its FFT */
+    void initBuffers(FourierProjectionBuffers &buffers) const;
+
+    /** Project into external buffers.
+     * The projection is left in buffers.projection. It is shifted by
+     * (shiftX,shiftY) pixels and, if ctf is not NULL, multiplied by it in
+     * Fourier space (ctf has the size of the projection and is indexed by
+     * FFT index, as produced by CTFDescription::generateCTF).
+     * This function does not modify the projector, so that it can be
+     * called from several threads with different buffers.
+     */
+    void project(double rot, double tilt, double psi, FourierProjectionBuffers &buffers,
+                 const MultidimArray<double> *ctf=NULL, double shiftX=0, double shiftY=0) const;
+
+    /** Project a batch of orientations with threads.
+     * angles is a N x 3 matrix with the Euler angles (rot, tilt, psi) of
+     * each projection. If shifts is not NULL, it is a N x 2 matrix with the
+     * (x,y) shift in pixels of each projection. If ctfs is not NULL, it has
+     * N CTFs (with their side information produced) that are applied to
+     * the projections. The projections are stored one after the other in
+     * projections, that must have room for N*volumeSize*volumeSize values.
+     */
+    void projectBatch(const Matrix2D<double> &angles, const Matrix2D<double> *shifts,
+                      const std::vector<CTFDescription> *ctfs, float *projections,
+                      int Nthreads=1) const;
+
     /** Update volume */
     void updateVolume(MultidimArray<double> &V);
 private:
@@ -173,6 +234,17 @@ private:
      * This is a private method which provides the values for the class variable
      */
     void produceSideInfo();
+
+    // Interpolate the Fourier transform of the projection of matrix E
+    void interpolateProjection(const Matrix2D<double> &E,
+                               MultidimArray< std::complex<double> > &projectionFourier,
+                               FourierProjectionBuffers &rows, const MultidimArray<double> *ctf,
+                               double shiftX, double shiftY) const;
+
+    // Project the range [n0,nF) of a batch
+    void projectBatchRange(const Matrix2D<double> &angles, const Matrix2D<double> *shifts,
+                           const std::vector<CTFDescription> *ctfs, float *projections,
+                           size_t n0, size_t nF) const;
 };
 
 /*
@@ -0,0 +1,238 @@
+/***************************************************************************
+ *
+ * Authors:    Carlos Oscar Sanchez Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include "fourier_shift.h"
+#include <string.h>
+#include <thread>
+#include <core/xmipp_error.h>
+#include <core/xmipp_macros.h>
+
+FourierShifter::FourierShifter()
+{
+    Xdim=Ydim=0;
+    shiftX=shiftY=0;
+    integerShift=true;
+}
+
+// Roots of unity exp(-2*pi*i*n/N), n=0...N-1
+static void computeRoots(size_t N, std::vector< std::complex<double> > &roots)
+{
+    roots.resize(N);
+    for (size_t n=0; n<N; ++n)
+        roots[n]=std::polar(1.0,-2*PI*n/N);
+}
+
+// Phase table of a shift along one direction of N samples
+static void computePhases(size_t N, double shift, bool integerShift,
+                          const std::vector< std::complex<double> > &roots,
+                          std::vector< std::complex<double> > &phase)
+{
+    phase.resize(N);
+    if (integerShift)
+    {
+        // The phase of the index k is the root k*shift modulo N
+        long s=((long)round(shift))%(long)N;
+        if (s<0)
+            s+=N;
+        size_t idx=0;
+        for (size_t k=0; k<N; ++k)
+        {
+            phase[k]=roots[idx];
+            idx+=s;
+            if (idx>=N)
+                idx-=N;
+        }
+    }
+    else
+    {
+        double freq;
+        for (size_t k=0; k<N; ++k)
+        {
+            FFT_IDX2DIGFREQ(k,N,freq);
+            phase[k]=std::polar(1.0,-2*PI*freq*shift);
+        }
+        // The Nyquist frequency of even sizes is both +1/2 and -1/2, the
+        // average of both phases keeps the transform of a real image
+        if (N%2==0)
+            phase[N/2]=cos(PI*shift);
+    }
+}
+
+void FourierShifter::initialize(size_t _Ydim, size_t _Xdim)
+{
+    if (Xdim==_Xdim && Ydim==_Ydim)
+        return;
+    Xdim=_Xdim;
+    Ydim=_Ydim;
+    computeRoots(Xdim,rootsX);
+    computeRoots(Ydim,rootsY);
+    setShift(0,0);
+}
+
+void FourierShifter::setShift(double _shiftX, double _shiftY)
+{
+    shiftX=_shiftX;
+    shiftY=_shiftY;
+    integerShift=fabs(shiftX-round(shiftX))<1e-9 && fabs(shiftY-round(shiftY))<1e-9;
+    computePhases(Xdim,shiftX,integerShift,rootsX,phaseX);
+    computePhases(Ydim,shiftY,integerShift,rootsY,phaseY);
+}
+
+void FourierShifter::apply(MultidimArray< std::complex<double> > &F) const
+{
+    apply(F,F);
+}
+
+void FourierShifter::apply(const MultidimArray< std::complex<double> > &Fin,
+                           MultidimArray< std::complex<double> > &Fout) const
+{
+    if (YSIZE(Fin)!=Ydim || XSIZE(Fin)>Xdim)
+        REPORT_ERROR(ERR_MULTIDIM_SIZE,"The Fourier transform does not correspond to the size of the shifter");
+    if (&Fout!=&Fin)
+        Fout.resizeNoCopy(Fin);
+    size_t XdimF=XSIZE(Fin);
+    for (size_t i=0; i<Ydim; ++i)
+    {
+        double a=phaseY[i].real(), b=phaseY[i].imag();
+        const double *ptrIn=(const double *)&DIRECT_A2D_ELEM(Fin,i,0);
+        double *ptrOut=(double *)&DIRECT_A2D_ELEM(Fout,i,0);
+        for (size_t j=0; j<XdimF; ++j, ptrIn+=2, ptrOut+=2)
+        {
+            // Phase of (i,j) times the coefficient
+            double c=phaseX[j].real(), d=phaseX[j].imag();
+            double pr=a*c-b*d;
+            double pi=a*d+b*c;
+            double re=ptrIn[0], im=ptrIn[1];
+            ptrOut[0]=pr*re-pi*im;
+            ptrOut[1]=pr*im+pi*re;
+        }
+    }
+}
+
+double FourierShifter::correlationIndex(const MultidimArray< std::complex<double> > &F1,
+                                        const MultidimArray< std::complex<double> > &F2) const
+{
+    if (YSIZE(F1)!=Ydim || XSIZE(F1)!=Xdim/2+1 || !F1.sameShape(F2))
+        REPORT_ERROR(ERR_MULTIDIM_SIZE,"The Fourier transforms do not correspond to the size of the shifter");
+
+    // By Parseval, the covariance of the two images is the inner product of
+    // their transforms without the DC term. Only half of the coefficients
+    // are stored, the others are the conjugates of the columns 1...Xdim/2-1
+    // (or Xdim/2 for odd sizes), which are counted twice
+    size_t XdimF=XSIZE(F1);
+    size_t lastDouble=(Xdim%2==0) ? XdimF-2 : XdimF-1;
+    double num=0, sum1=0, sum2=0;
+    for (size_t i=0; i<Ydim; ++i)
+    {
+        double a=phaseY[i].real(), b=phaseY[i].imag();
+        const double *ptr1=(const double *)&DIRECT_A2D_ELEM(F1,i,0);
+        const double *ptr2=(const double *)&DIRECT_A2D_ELEM(F2,i,0);
+        for (size_t j=0; j<XdimF; ++j, ptr1+=2, ptr2+=2)
+        {
+            if (i==0 && j==0)
+                continue;
+            double c=phaseX[j].real(), d=phaseX[j].imag();
+            double pr=a*c-b*d;
+            double pi=a*d+b*c;
+            double re2=pr*ptr2[0]-pi*ptr2[1];
+            double im2=pr*ptr2[1]+pi*ptr2[0];
+            double w=(j>=1 && j<=lastDouble) ? 2 : 1;
+            num+=w*(ptr1[0]*re2+ptr1[1]*im2);
+            sum1+=w*(ptr1[0]*ptr1[0]+ptr1[1]*ptr1[1]);
+            sum2+=w*(re2*re2+im2*im2);
+        }
+    }
+    if (sum1<=0 || sum2<=0)
+        return 0;
+    return num/sqrt(sum1*sum2);
+}
+
+void FourierShifter::shift(const MultidimArray<double> &I, MultidimArray<double> &Iout,
+                           double _shiftX, double _shiftY, FourierTransformer &transformer)
+{
+    I.checkDimension(2);
+    initialize(YSIZE(I),XSIZE(I));
+    setShift(_shiftX,_shiftY);
+    if (&Iout!=&I)
+        Iout=I;
+    transformer.FourierTransform(Iout,Faux,false);
+    apply(Faux);
+    transformer.inverseFourierTransform();
+}
+
+// Shift the images [n0,nF) of a stack
+static void fourierShiftStackRange(MultidimArray<double> &stack, const Matrix2D<double> &shifts,
+                                   size_t n0, size_t nF)
+{
+    FourierShifter shifter;
+    FourierTransformer transformer;
+    MultidimArray<double> I;
+    I.resizeNoCopy(YSIZE(stack),XSIZE(stack));
+    size_t imageSize=YXSIZE(stack);
+    for (size_t n=n0; n<nF; ++n)
+    {
+        double *ptrImage=MULTIDIM_ARRAY(stack)+n*imageSize;
+        memcpy(MULTIDIM_ARRAY(I),ptrImage,imageSize*sizeof(double));
+        shifter.shift(I,I,MAT_ELEM(shifts,n,0),MAT_ELEM(shifts,n,1),transformer);
+        memcpy(ptrImage,MULTIDIM_ARRAY(I),imageSize*sizeof(double));
+    }
+}
+
+void fourierShiftStack(MultidimArray<double> &stack, const Matrix2D<double> &shifts,
+                       int Nthreads)
+{
+    size_t N=NSIZE(stack);
+    if (ZSIZE(stack)!=1)
+        REPORT_ERROR(ERR_MULTIDIM_DIM,"fourierShiftStack only works with stacks of 2D images");
+    if (MAT_YSIZE(shifts)!=N || MAT_XSIZE(shifts)!=2)
+        REPORT_ERROR(ERR_MATRIX_SIZE,"The shifts must be a N x 2 matrix");
+
+    size_t Nthr=XMIPP_MAX(1,XMIPP_MIN((size_t)Nthreads,N));
+    if (Nthr<=1)
+    {
+        fourierShiftStackRange(stack,shifts,0,N);
+        return;
+    }
+    // The first error of any thread is reported once all of them finish
+    std::vector<std::thread> threads;
+    std::vector<std::string> errors(Nthr);
+    for (size_t t=0; t<Nthr; ++t)
+        threads.push_back(std::thread([&,t]()
+        {
+            try
+            {
+                fourierShiftStackRange(stack,shifts,N*t/Nthr,N*(t+1)/Nthr);
+            }
+            catch (XmippError &xe)
+            {
+                errors[t]=xe.msg;
+            }
+        }));
+    for (size_t t=0; t<Nthr; ++t)
+        threads[t].join();
+    for (size_t t=0; t<Nthr; ++t)
+        if (!errors[t].empty())
+            REPORT_ERROR(ERR_UNCLASSIFIED,errors[t]);
+}
@@ -0,0 +1,130 @@
+/***************************************************************************
+ *
+ * Authors:    Carlos Oscar Sanchez Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef _FOURIER_SHIFT_HH
+#define _FOURIER_SHIFT_HH
+
+#include <complex>
+#include <vector>
+#include <core/multidim_array.h>
+#include <core/matrix2d.h>
+#include <core/xmipp_fftw.h>
+
+/**@defgroup FourierShift Shifts in Fourier space
+   @ingroup DataLibrary */
+//@{
+
+/** Phase-ramp shift of 2D images.
+ *
+ * An image translated by (shiftX,shiftY) has the Fourier transform of the
+ * original image multiplied by exp(-2*pi*i*(fx*shiftX+fy*shiftY)), fx and fy
+ * being the digital frequencies. The ramp is separable, so the shifter only
+ * keeps one table per direction and the phase of the coefficient (i,j) is the
+ * product of both. For integer shifts the tables are read from precomputed
+ * roots of unity and no trigonometric function is evaluated; for subpixel
+ * shifts Xdim+Ydim complex exponentials are computed.
+ *
+ * The translation is circular, it produces the same image as
+ * translate(...,WRAP) but without interpolation, so that shifts can be
+ * composed and correlated in Fourier space without blurring the image and
+ * without going back to real space. For even sizes the Nyquist coefficients
+ * of a subpixel shift are multiplied by cos(pi*shift), so the shifted image is
+ * still real.
+ *
+ * The Fourier transforms are in the layout of FourierTransformer (only half
+ * of the coefficients along X). phase(i,j) is also valid for the full
+ * transform (j up to Xdim-1).
+ *
+ * @code
+ * FourierShifter shifter;
+ * shifter.initialize(YSIZE(I),XSIZE(I));
+ * transformer.FourierTransform(I,FI,false);
+ * shifter.setShift(2.5,-1);
+ * shifter.apply(FI);
+ * transformer.inverseFourierTransform();
+ * @endcode
+ */
+class FourierShifter
+{
+public:
+    /** Empty constructor */
+    FourierShifter();
+
+    /** Prepare the tables for images of Ydim x Xdim pixels.
+     * Nothing is done if the shifter is already initialized for this size. */
+    void initialize(size_t Ydim, size_t Xdim);
+
+    /** Set the shift applied by the following calls */
+    void setShift(double shiftX, double shiftY);
+
+    /** Phase of the coefficient (i,j) for the current shift */
+    inline std::complex<double> phase(size_t i, size_t j) const
+    {
+        return phaseY[i]*phaseX[j];
+    }
+
+    /** Multiply a Fourier transform by the current phase ramp */
+    void apply(MultidimArray< std::complex<double> > &F) const;
+
+    /** Fout is Fin multiplied by the current phase ramp */
+    void apply(const MultidimArray< std::complex<double> > &Fin,
+               MultidimArray< std::complex<double> > &Fout) const;
+
+    /** Correlation index between I1 and I2 shifted by the current shift.
+     * F1 and F2 are the Fourier transforms of I1 and I2 (not shifted). The
+     * result is the one of correlationIndex(I1,I2t) being I2t the image
+     * translated with wrapping, but it is computed from the transforms. */
+    double correlationIndex(const MultidimArray< std::complex<double> > &F1,
+                            const MultidimArray< std::complex<double> > &F2) const;
+
+    /** Shift an image.
+     * Iout is I translated by (shiftX,shiftY) with wrapping. The transformer
+     * is used for the forward and inverse transforms. */
+    void shift(const MultidimArray<double> &I, MultidimArray<double> &Iout,
+               double shiftX, double shiftY, FourierTransformer &transformer);
+
+protected:
+    // Image size
+    size_t Xdim, Ydim;
+    // Current shift
+    double shiftX, shiftY;
+    // The current shift is integer
+    bool integerShift;
+    // Roots of unity exp(-2*pi*i*n/Xdim) and exp(-2*pi*i*n/Ydim)
+    std::vector< std::complex<double> > rootsX, rootsY;
+    // Phase tables of the current shift
+    std::vector< std::complex<double> > phaseX, phaseY;
+    // Auxiliary transform
+    MultidimArray< std::complex<double> > Faux;
+};
+
+/** Shift all the images of a stack.
+ * The image n is translated (with wrapping) by (shifts(n,0),shifts(n,1)).
+ * The images are distributed among Nthreads threads.
+ */
+void fourierShiftStack(MultidimArray<double> &stack, const Matrix2D<double> &shifts,
+                       int Nthreads=1);
+//@}
+#endif
@@ -0,0 +1,180 @@
+/***************************************************************************
+ *
+ * Authors:     Carlos Oscar S. Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include "local_statistics.h"
+#include <limits>
+
+/* Summed-area tables ------------------------------------------------------ */
+LocalStatistics::LocalStatistics()
+{
+    Ydim=Xdim=0;
+    y0Image=x0Image=0;
+    offset=0;
+}
+
+void LocalStatistics::compute(const MultidimArray<double> &I)
+{
+    I.checkDimension(2);
+    Ydim=YSIZE(I);
+    Xdim=XSIZE(I);
+    y0Image=STARTINGY(I);
+    x0Image=STARTINGX(I);
+    offset=I.computeAvg();
+
+    size_t Xdim1=Xdim+1;
+    sat.assign((Ydim+1)*Xdim1,0.);
+    sat2.assign((Ydim+1)*Xdim1,0.);
+    for (int i=0; i<Ydim; ++i)
+    {
+        // Row sums plus the table of the previous row
+        double rowSum=0, rowSum2=0;
+        const double *ptrI=&DIRECT_A2D_ELEM(I,i,0);
+        double *ptrSat=&sat[(i+1)*Xdim1+1];
+        double *ptrSat2=&sat2[(i+1)*Xdim1+1];
+        const double *ptrSatPrev=ptrSat-Xdim1;
+        const double *ptrSat2Prev=ptrSat2-Xdim1;
+        for (int j=0; j<Xdim; ++j)
+        {
+            double val=ptrI[j]-offset;
+            rowSum+=val;
+            rowSum2+=val*val;
+            ptrSat[j]=ptrSatPrev[j]+rowSum;
+            ptrSat2[j]=ptrSat2Prev[j]+rowSum2;
+        }
+    }
+}
+
+void LocalStatistics::windowSums(int y0, int x0, int yF, int xF, double &sum, double &sum2, size_t &N) const
+{
+    // To physical indexes and clipped
+    y0=XMIPP_MAX(y0-y0Image,0);
+    x0=XMIPP_MAX(x0-x0Image,0);
+    yF=XMIPP_MIN(yF-y0Image,Ydim-1);
+    xF=XMIPP_MIN(xF-x0Image,Xdim-1);
+    if (y0>yF || x0>xF)
+    {
+        sum=sum2=0;
+        N=0;
+        return;
+    }
+    size_t Xdim1=Xdim+1;
+    size_t i00=y0*Xdim1+x0, i0F=y0*Xdim1+xF+1, iF0=(yF+1)*Xdim1+x0, iFF=(yF+1)*Xdim1+xF+1;
+    sum=sat[iFF]-sat[i0F]-sat[iF0]+sat[i00];
+    sum2=sat2[iFF]-sat2[i0F]-sat2[iF0]+sat2[i00];
+    N=(size_t)(yF-y0+1)*(xF-x0+1);
+}
+
+void LocalStatistics::windowStats(int y0, int x0, int yF, int xF, double &avg, double &stddev,
+                                  bool zeroPadding) const
+{
+    double sum, sum2;
+    size_t N;
+    windowSums(y0,x0,yF,xF,sum,sum2,N);
+    if (zeroPadding && yF>=y0 && xF>=x0)
+    {
+        // The pixels outside the image are zeros, i.e., -offset in the table
+        size_t Nwindow=(size_t)(yF-y0+1)*(xF-x0+1);
+        double Npadded=Nwindow-N;
+        sum-=Npadded*offset;
+        sum2+=Npadded*offset*offset;
+        N=Nwindow;
+    }
+    if (N==0)
+    {
+        avg=stddev=0;
+        return;
+    }
+    double iN=1.0/N;
+    double avgOffset=sum*iN;
+    avg=avgOffset+offset;
+    stddev=sqrt(fabs(sum2*iN-avgOffset*avgOffset));
+}
+
+double LocalStatistics::windowMean(int y0, int x0, int yF, int xF) const
+{
+    double sum, sum2;
+    size_t N;
+    windowSums(y0,x0,yF,xF,sum,sum2,N);
+    return (N==0) ? 0:sum/N+offset;
+}
+
+/* Local minimum and maximum ----------------------------------------------- */
+// Running minimum (or maximum) of a line with a window of 2*radius+1
+// samples clipped to the line (van Herk/Gil-Werman)
+static void localExtremumLine(const double *in, size_t inStride, int L, int radius, bool takeMin,
+                              double *out, size_t outStride,
+                              std::vector<double> &b, std::vector<double> &g, std::vector<double> &h)
+{
+    int w=2*radius+1;
+    int M=((L+2*radius+w-1)/w)*w;
+    double fill=takeMin ? std::numeric_limits<double>::infinity():-std::numeric_limits<double>::infinity();
+    b.resize(M);
+    g.resize(M);
+    h.resize(M);
+    for (int k=0; k<M; ++k)
+    {
+        int p=k-radius;
+        b[k]=(p>=0 && p<L) ? in[p*inStride]:fill;
+    }
+    // Prefix and suffix extrema inside each block of w samples
+    for (int k0=0; k0<M; k0+=w)
+    {
+        int kF=k0+w-1;
+        g[k0]=b[k0];
+        for (int k=k0+1; k<=kF; ++k)
+            g[k]=takeMin ? std::min(g[k-1],b[k]):std::max(g[k-1],b[k]);
+        h[kF]=b[kF];
+        for (int k=kF-1; k>=k0; --k)
+            h[k]=takeMin ? std::min(h[k+1],b[k]):std::max(h[k+1],b[k]);
+    }
+    for (int p=0; p<L; ++p)
+        out[p*outStride]=takeMin ? std::min(h[p],g[p+w-1]):std::max(h[p],g[p+w-1]);
+}
+
+void localMinMax(const MultidimArray<double> &I, int radiusY, int radiusX,
+                 MultidimArray<double> &minI, MultidimArray<double> &maxI)
+{
+    I.checkDimension(2);
+    int Ydim=YSIZE(I), Xdim=XSIZE(I);
+    MultidimArray<double> aux;
+    aux.resizeNoCopy(I);
+    minI.resizeNoCopy(I);
+    maxI.resizeNoCopy(I);
+    STARTINGY(minI)=STARTINGY(maxI)=STARTINGY(I);
+    STARTINGX(minI)=STARTINGX(maxI)=STARTINGX(I);
+    std::vector<double> b, g, h;
+    for (int extremum=0; extremum<2; ++extremum)
+    {
+        bool takeMin=extremum==0;
+        MultidimArray<double> &result=takeMin ? minI:maxI;
+        // Separable: first along rows, then along columns
+        for (int i=0; i<Ydim; ++i)
+            localExtremumLine(&DIRECT_A2D_ELEM(I,i,0),1,Xdim,radiusX,takeMin,
+                              &DIRECT_A2D_ELEM(aux,i,0),1,b,g,h);
+        for (int j=0; j<Xdim; ++j)
+            localExtremumLine(&DIRECT_A2D_ELEM(aux,0,j),Xdim,Ydim,radiusY,takeMin,
+                              &DIRECT_A2D_ELEM(result,0,j),Xdim,b,g,h);
+    }
+}
@@ -0,0 +1,107 @@
+/***************************************************************************
+ *
+ * Authors:     Carlos Oscar S. Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef _LOCAL_STATISTICS_HH
+#define _LOCAL_STATISTICS_HH
+
+#include <vector>
+#include <core/multidim_array.h>
+
+/**@defgroup LocalStatistics Local statistics of images
+   @ingroup DataLibrary
+
+   Summed-area tables (integral images) of an image and of its square give
+   the sum, mean and variance of any rectangular window with four lookups,
+   whatever the window size. Local minima and maxima of a fixed window size
+   are computed for all pixels with the van Herk/Gil-Werman algorithm
+   (three comparisons per pixel and axis).
+*/
+//@{
+
+/** Summed-area tables of a 2D image.
+ * Windows are given in logical coordinates of the image (the same as
+ * MultidimArray::window) and are clipped to the image.
+ *
+ * @code
+ * LocalStatistics stats;
+ * stats.compute(I);
+ * double avg, stddev;
+ * stats.windowStats(y0, x0, yF, xF, avg, stddev);
+ * @endcode
+ */
+class LocalStatistics
+{
+public:
+    /// Image size
+    int Ydim, Xdim;
+    /// Logical origin of the image
+    int y0Image, x0Image;
+    /** Value subtracted from the image before accumulating.
+     * The global mean, so that the variance of the windows does not suffer
+     * from cancellation.
+     */
+    double offset;
+    /// Summed-area table of the image, (Ydim+1)x(Xdim+1)
+    std::vector<double> sat;
+    /// Summed-area table of the squared image, (Ydim+1)x(Xdim+1)
+    std::vector<double> sat2;
+
+public:
+    /// Empty constructor
+    LocalStatistics();
+
+    /// Build the tables of a 2D image
+    void compute(const MultidimArray<double> &I);
+
+    /** Sums of a window.
+     * The window [y0,yF]x[x0,xF] is clipped to the image. sum and sum2 are
+     * the sums of the values and of the squared values inside the image,
+     * and N is the number of pixels inside the image.
+     */
+    void windowSums(int y0, int x0, int yF, int xF, double &sum, double &sum2, size_t &N) const;
+
+    /** Mean and standard deviation of a window.
+     * The standard deviation is the population one, as in
+     * MultidimArray::computeStats. If zeroPadding is true, the pixels of the
+     * window outside the image count as zeros (as in MultidimArray::window
+     * followed by computeStats), otherwise the window is clipped to the
+     * image.
+     */
+    void windowStats(int y0, int x0, int yF, int xF, double &avg, double &stddev,
+                     bool zeroPadding=false) const;
+
+    /// Mean of a window clipped to the image
+    double windowMean(int y0, int x0, int yF, int xF) const;
+};
+
+/** Local minimum and maximum of an image.
+ * For every pixel, minI and maxI are the minimum and maximum of the window
+ * [i-radiusY,i+radiusY]x[j-radiusX,j+radiusX] clipped to the image.
+ * The cost does not depend on the window size.
+ */
+void localMinMax(const MultidimArray<double> &I, int radiusY, int radiusX,
+                 MultidimArray<double> &minI, MultidimArray<double> &maxI);
+//@}
+#endif
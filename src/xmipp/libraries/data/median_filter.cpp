@@ -0,0 +1,95 @@
+/***************************************************************************
+ *
+ * Authors:    Carlos Oscar Sanchez Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include "median_filter.h"
+#include <algorithm>
+
+// Batcher's odd-even merge sort of 32 lines. The lines 25 to 31 hold +inf,
+// so the comparators that involve them are either useless or a move that is
+// done renaming the registers. Finally, only the comparators that lead to
+// the median (line 12) are kept.
+static void buildMedian25Network(std::vector<MedianComparator> &network, int &result)
+{
+    const int Nlines = 32, Nvalues = 25;
+    int reg[Nlines];
+    for (int n = 0; n < Nlines; ++n)
+        reg[n] = (n < Nvalues) ? n : -1;
+
+    std::vector<MedianComparator> full;
+    for (int p = 1; p < Nlines; p *= 2)
+        for (int k = p; k >= 1; k /= 2)
+            for (int j = k % p; j < Nlines - k; j += 2 * k)
+                for (int i = 0; i < XMIPP_MIN(k, Nlines - j - k); ++i)
+                    if ((i + j) / (2 * p) == (i + j + k) / (2 * p))
+                    {
+                        int a = i + j, b = i + j + k;
+                        if (reg[b] == -1)
+                            continue;
+                        if (reg[a] == -1)
+                        {
+                            reg[a] = reg[b];
+                            reg[b] = -1;
+                            continue;
+                        }
+                        MedianComparator c;
+                        c.a = reg[a];
+                        c.b = reg[b];
+                        c.type = MedianComparator::MEDIAN_SORT;
+                        full.push_back(c);
+                    }
+    result = reg[Nvalues / 2];
+
+    // Backwards, keep the comparators whose outputs are used
+    std::vector<bool> used(Nvalues, false);
+    used[result] = true;
+    network.clear();
+    for (int n = (int)full.size() - 1; n >= 0; --n)
+    {
+        MedianComparator c = full[n];
+        bool usedMin = used[c.a], usedMax = used[c.b];
+        if (!usedMin && !usedMax)
+            continue;
+        if (!usedMax)
+            c.type = MedianComparator::MEDIAN_MIN;
+        else if (!usedMin)
+            c.type = MedianComparator::MEDIAN_MAX;
+        used[c.a] = used[c.b] = true;
+        network.push_back(c);
+    }
+    std::reverse(network.begin(), network.end());
+}
+
+const std::vector<MedianComparator> &median25Network(int &result)
+{
+    static int networkResult;
+    static std::vector<MedianComparator> network;
+    static bool initialized = [](){
+        buildMedian25Network(network, networkResult);
+        return true;
+    }();
+    (void)initialized;
+    result = networkResult;
+    return network;
+}
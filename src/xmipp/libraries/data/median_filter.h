@@ -0,0 +1,508 @@
+/***************************************************************************
+ *
+ * Authors:    Carlos Oscar Sanchez Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef _MEDIAN_FILTER_HH
+#define _MEDIAN_FILTER_HH
+
+#include <thread>
+#include <vector>
+#include <core/multidim_array.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/**@defgroup MedianFilter Vectorized median and bad pixel filters
+   @ingroup DataLibrary
+
+   Median filters computed with sorting networks. A sorting network is a
+   fixed sequence of min/max operations, so that many pixels can be filtered
+   at the same time with SIMD instructions (AVX2 for float, double, int,
+   short, unsigned short and unsigned char; other types and instruction sets
+   use the same network on one pixel at a time). The rows of the image are
+   distributed among threads.
+
+   The 3x3 median sorts the three pixels of every column once per row, and
+   the median of each window is the median of the maximum of the column
+   minima, the median of the column medians and the minimum of the column
+   maxima. The 5x5 median uses a Batcher network pruned to the comparators
+   that contribute to the 13th element.
+
+   The bad pixel filters only visit the bad pixels, in the same order as
+   the raster scan of boundMedianFilter, so that their result is the same.
+   @{
+*/
+
+/** Operations of the sorting networks on one value */
+template<typename T>
+struct MedianScalarOps
+{
+    typedef T Vec;
+    static const int size = 1;
+    static inline Vec load(const T *p) { return *p; }
+    static inline void store(T *p, Vec v) { *p = v; }
+    static inline Vec min(Vec a, Vec b) { return (b < a) ? b : a; }
+    static inline Vec max(Vec a, Vec b) { return (a < b) ? b : a; }
+};
+
+/** Operations of the sorting networks on a SIMD register.
+ * By default, one value at a time.
+ */
+template<typename T>
+struct MedianSIMDOps: public MedianScalarOps<T>
+{};
+
+#if defined(__AVX2__)
+template<>
+struct MedianSIMDOps<float>
+{
+    typedef __m256 Vec;
+    static const int size = 8;
+    static inline Vec load(const float *p) { return _mm256_loadu_ps(p); }
+    static inline void store(float *p, Vec v) { _mm256_storeu_ps(p, v); }
+    static inline Vec min(Vec a, Vec b) { return _mm256_min_ps(a, b); }
+    static inline Vec max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+};
+
+template<>
+struct MedianSIMDOps<double>
+{
+    typedef __m256d Vec;
+    static const int size = 4;
+    static inline Vec load(const double *p) { return _mm256_loadu_pd(p); }
+    static inline void store(double *p, Vec v) { _mm256_storeu_pd(p, v); }
+    static inline Vec min(Vec a, Vec b) { return _mm256_min_pd(a, b); }
+    static inline Vec max(Vec a, Vec b) { return _mm256_max_pd(a, b); }
+};
+
+template<>
+struct MedianSIMDOps<int>
+{
+    typedef __m256i Vec;
+    static const int size = 8;
+    static inline Vec load(const int *p) { return _mm256_loadu_si256((const __m256i *)p); }
+    static inline void store(int *p, Vec v) { _mm256_storeu_si256((__m256i *)p, v); }
+    static inline Vec min(Vec a, Vec b) { return _mm256_min_epi32(a, b); }
+    static inline Vec max(Vec a, Vec b) { return _mm256_max_epi32(a, b); }
+};
+
+template<>
+struct MedianSIMDOps<short>
+{
+    typedef __m256i Vec;
+    static const int size = 16;
+    static inline Vec load(const short *p) { return _mm256_loadu_si256((const __m256i *)p); }
+    static inline void store(short *p, Vec v) { _mm256_storeu_si256((__m256i *)p, v); }
+    static inline Vec min(Vec a, Vec b) { return _mm256_min_epi16(a, b); }
+    static inline Vec max(Vec a, Vec b) { return _mm256_max_epi16(a, b); }
+};
+
+template<>
+struct MedianSIMDOps<unsigned short>
+{
+    typedef __m256i Vec;
+    static const int size = 16;
+    static inline Vec load(const unsigned short *p) { return _mm256_loadu_si256((const __m256i *)p); }
+    static inline void store(unsigned short *p, Vec v) { _mm256_storeu_si256((__m256i *)p, v); }
+    static inline Vec min(Vec a, Vec b) { return _mm256_min_epu16(a, b); }
+    static inline Vec max(Vec a, Vec b) { return _mm256_max_epu16(a, b); }
+};
+
+template<>
+struct MedianSIMDOps<unsigned char>
+{
+    typedef __m256i Vec;
+    static const int size = 32;
+    static inline Vec load(const unsigned char *p) { return _mm256_loadu_si256((const __m256i *)p); }
+    static inline void store(unsigned char *p, Vec v) { _mm256_storeu_si256((__m256i *)p, v); }
+    static inline Vec min(Vec a, Vec b) { return _mm256_min_epu8(a, b); }
+    static inline Vec max(Vec a, Vec b) { return _mm256_max_epu8(a, b); }
+};
+#endif
+
+/** Comparator of a selection network.
+ * MEDIAN_SORT leaves min(a,b) in a and max(a,b) in b. The other types
+ * only compute the output that is used later.
+ */
+struct MedianComparator
+{
+    enum {MEDIAN_SORT, MEDIAN_MIN, MEDIAN_MAX};
+    int a, b, type;
+};
+
+/** Network for the median of 25 values.
+ * The median is left in the register returned in result. The network is
+ * built the first time it is used.
+ */
+const std::vector<MedianComparator> &median25Network(int &result);
+
+/** Run f(i0,iF) on Nthreads threads that share the range [0,N) */
+template<typename F>
+void medianFilterRunThreads(size_t N, int Nthreads, F f)
+{
+    size_t Nthr = (Nthreads < 1) ? 1 : (size_t)Nthreads;
+    if (Nthr > N)
+        Nthr = N;
+    if (Nthr <= 1)
+    {
+        f((size_t)0, N);
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < Nthr; ++t)
+        threads.push_back(std::thread(f, N*t/Nthr, N*(t+1)/Nthr));
+    for (size_t t = 0; t < Nthr; ++t)
+        threads[t].join();
+}
+
+/** Median of three values with a network */
+template<typename Ops>
+inline typename Ops::Vec medianOf3(typename Ops::Vec a, typename Ops::Vec b, typename Ops::Vec c)
+{
+    return Ops::max(Ops::min(a, b), Ops::min(Ops::max(a, b), c));
+}
+
+/** Sort the columns of three rows.
+ * lo, mid and hi are the minimum, median and maximum of r0, r1 and r2 in each
+ * column. The columns [j,N) are processed by groups of Ops::size, the first
+ * column not processed is returned.
+ */
+template<typename Ops, typename T>
+inline size_t medianSortColumns3(const T *r0, const T *r1, const T *r2,
+                                 T *lo, T *mid, T *hi, size_t j, size_t N)
+{
+    typedef typename Ops::Vec Vec;
+    for (; j + Ops::size <= N; j += Ops::size)
+    {
+        Vec a = Ops::load(r0 + j), b = Ops::load(r1 + j), c = Ops::load(r2 + j);
+        Vec ab = Ops::min(a, b);
+        Vec AB = Ops::max(a, b);
+        Ops::store(hi + j, Ops::max(AB, c));
+        Vec ABc = Ops::min(AB, c);
+        Ops::store(lo + j, Ops::min(ab, ABc));
+        Ops::store(mid + j, Ops::max(ab, ABc));
+    }
+    return j;
+}
+
+/** Medians of the 3x3 windows centered at the columns [j,N).
+ * The columns of the window must have been sorted with medianSortColumns3.
+ * The first column not processed is returned.
+ */
+template<typename Ops, typename T>
+inline size_t medianCombine3x3(const T *lo, const T *mid, const T *hi, T *out,
+                               size_t j, size_t N)
+{
+    typedef typename Ops::Vec Vec;
+    for (; j + Ops::size <= N; j += Ops::size)
+    {
+        Vec maxLo = Ops::max(Ops::max(Ops::load(lo + j - 1), Ops::load(lo + j)), Ops::load(lo + j + 1));
+        Vec minHi = Ops::min(Ops::min(Ops::load(hi + j - 1), Ops::load(hi + j)), Ops::load(hi + j + 1));
+        Vec medMid = medianOf3<Ops>(Ops::load(mid + j - 1), Ops::load(mid + j), Ops::load(mid + j + 1));
+        Ops::store(out + j, medianOf3<Ops>(maxLo, medMid, minHi));
+    }
+    return j;
+}
+
+/** Medians of the 5x5 windows centered at the columns [j,N) of a row.
+ * rows are the pointers to the five rows of the window. The first column
+ * not processed is returned.
+ */
+template<typename Ops, typename T>
+inline size_t medianRow5x5(const T * const *rows, T *out, size_t j, size_t N,
+                           const std::vector<MedianComparator> &network, int result)
+{
+    typedef typename Ops::Vec Vec;
+    Vec v[25];
+    size_t Ncomparators = network.size();
+    const MedianComparator *comparators = &network[0];
+    for (; j + Ops::size <= N; j += Ops::size)
+    {
+        for (int ii = 0; ii < 5; ++ii)
+            for (int jj = 0; jj < 5; ++jj)
+                v[ii*5+jj] = Ops::load(rows[ii] + j + jj - 2);
+        for (size_t n = 0; n < Ncomparators; ++n)
+        {
+            const MedianComparator &c = comparators[n];
+            Vec a = v[c.a], b = v[c.b];
+            switch (c.type)
+            {
+            case MedianComparator::MEDIAN_SORT:
+                v[c.a] = Ops::min(a, b);
+                v[c.b] = Ops::max(a, b);
+                break;
+            case MedianComparator::MEDIAN_MIN:
+                v[c.a] = Ops::min(a, b);
+                break;
+            default:
+                v[c.b] = Ops::max(a, b);
+            }
+        }
+        Ops::store(out + j, v[result]);
+    }
+    return j;
+}
+
+/** Median filter with a 3x3 window.
+ * out has the size and origin of m, the pixels in the border of the image
+ * are set to 0 (as in medianFilter3x3). m and out must be different arrays.
+ * Only the first slice of m is filtered.
+ */
+template <typename T>
+void fastMedianFilter3x3(const MultidimArray<T> &m, MultidimArray<T> &out, int Nthreads=1)
+{
+    out.initZeros(m);
+    STARTINGX(out) = STARTINGX(m);
+    STARTINGY(out) = STARTINGY(m);
+    size_t Ydim = YSIZE(m), Xdim = XSIZE(m);
+    if (Ydim < 3 || Xdim < 3)
+        return;
+
+    medianFilterRunThreads(Ydim - 2, Nthreads, [&](size_t i0, size_t iF)
+    {
+        std::vector<T> lo(Xdim), mid(Xdim), hi(Xdim);
+        for (size_t i = i0 + 1; i < iF + 1; ++i)
+        {
+            const T *r0 = &DIRECT_A2D_ELEM(m, i - 1, 0);
+            const T *r1 = &DIRECT_A2D_ELEM(m, i, 0);
+            const T *r2 = &DIRECT_A2D_ELEM(m, i + 1, 0);
+            size_t j = medianSortColumns3< MedianSIMDOps<T> >(r0, r1, r2, &lo[0], &mid[0], &hi[0], 0, Xdim);
+            medianSortColumns3< MedianScalarOps<T> >(r0, r1, r2, &lo[0], &mid[0], &hi[0], j, Xdim);
+
+            T *ptrOut = &DIRECT_A2D_ELEM(out, i, 0);
+            j = medianCombine3x3< MedianSIMDOps<T> >(&lo[0], &mid[0], &hi[0], ptrOut, 1, Xdim - 1);
+            medianCombine3x3< MedianScalarOps<T> >(&lo[0], &mid[0], &hi[0], ptrOut, j, Xdim - 1);
+        }
+    });
+}
+
+/** Median filter with a 5x5 window.
+ * out has the size and origin of m, the two pixels closest to the border of
+ * the image are set to 0. m and out must be different arrays. Only the first
+ * slice of m is filtered.
+ */
+template <typename T>
+void fastMedianFilter5x5(const MultidimArray<T> &m, MultidimArray<T> &out, int Nthreads=1)
+{
+    out.initZeros(m);
+    STARTINGX(out) = STARTINGX(m);
+    STARTINGY(out) = STARTINGY(m);
+    size_t Ydim = YSIZE(m), Xdim = XSIZE(m);
+    if (Ydim < 5 || Xdim < 5)
+        return;
+
+    int result;
+    const std::vector<MedianComparator> &network = median25Network(result);
+    medianFilterRunThreads(Ydim - 4, Nthreads, [&](size_t i0, size_t iF)
+    {
+        const T *rows[5];
+        for (size_t i = i0 + 2; i < iF + 2; ++i)
+        {
+            for (int ii = 0; ii < 5; ++ii)
+                rows[ii] = &DIRECT_A2D_ELEM(m, i + ii - 2, 0);
+            T *ptrOut = &DIRECT_A2D_ELEM(out, i, 0);
+            size_t j = medianRow5x5< MedianSIMDOps<T> >(rows, ptrOut, 2, Xdim - 2, network, result);
+            medianRow5x5< MedianScalarOps<T> >(rows, ptrOut, j, Xdim - 2, network, result);
+        }
+    });
+}
+
+/** Replace a bad pixel by the median of its good neighbours.
+ * This is the step of boundMedianFilter for the pixel (k,i,j).
+ * Returns true if the pixel could not be replaced in one of the slices of
+ * its neighbourhood.
+ */
+template <typename T>
+bool boundMedianPixel(MultidimArray<T> &V, const MultidimArray<char> &mask,
+                      size_t k, size_t i, size_t j)
+{
+    T neighbours[125];
+    T aux;
+    int N = 0, index;
+    bool badRemaining = false;
+    for (int kk=-2; kk<=2; kk++)
+    {
+        size_t kkk=k+kk;
+        if (kkk>=ZSIZE(V))
+            continue;
+        for (int ii=-2; ii<=2; ii++)
+        {
+            size_t iii=i+ii;
+            if (iii>=YSIZE(V))
+                continue;
+            for (int jj=-2; jj<=2; jj++)
+            {
+                size_t jjj=j+jj;
+                if (jjj>=XSIZE(V))
+                    continue;
+
+                if (DIRECT_A3D_ELEM(mask, kkk, iii, jjj) == 0)
+                {
+                    index = N++;
+                    neighbours[index] = DIRECT_A3D_ELEM(V, kkk,iii,jjj);
+                    //insertion sort
+                    while (index > 0 && neighbours[index-1] > neighbours[index])
+                    {
+                        SWAP(neighbours[index-1], neighbours[index], aux);
+                        --index;
+                    }
+                }
+            }
+        }
+        if (N == 0)
+            badRemaining = true;
+        else
+        {
+            if (N % 2 == 0)
+                DIRECT_A3D_ELEM(V, k, i, j) = (T)(0.5*(neighbours[N/2-1]+ neighbours[N/2]));
+            else
+                DIRECT_A3D_ELEM(V, k, i, j) = neighbours[N/2];
+            DIRECT_A3D_ELEM(mask, k, i, j) = false;
+        }
+    }
+    return badRemaining;
+}
+
+/** Replace the bad pixels of a list.
+ * bad has the indexes (in the first image of V) of the pixels whose mask is
+ * not 0, in increasing order. They are replaced as boundMedianFilter does,
+ * but without scanning the good pixels. The mask is set to 0.
+ */
+template <typename T>
+void boundMedianFilterList(MultidimArray<T> &V, const MultidimArray<char> &mask,
+                           std::vector<size_t> &bad)
+{
+    size_t YXdim = YXSIZE(V), Xdim = XSIZE(V);
+    bool badRemaining;
+    do
+    {
+        badRemaining = false;
+        size_t Nremaining = 0;
+        for (size_t n = 0; n < bad.size(); ++n)
+        {
+            size_t idx = bad[n];
+            if (DIRECT_MULTIDIM_ELEM(mask, idx) == 0)
+                continue;
+            size_t k = idx / YXdim;
+            size_t i = (idx % YXdim) / Xdim;
+            size_t j = idx % Xdim;
+            if (boundMedianPixel(V, mask, k, i, j))
+                badRemaining = true;
+            if (DIRECT_MULTIDIM_ELEM(mask, idx) != 0)
+                bad[Nremaining++] = idx;
+        }
+        bad.resize(Nremaining);
+    }
+    while (badRemaining);
+}
+
+/** Collect the pixels of the first image of V for which isBad(value) is true.
+ * The mask is set to 1 at the bad pixels and 0 elsewhere, and the bad
+ * indexes are returned in increasing order.
+ */
+template <typename T, typename F>
+void detectBadPixels(const MultidimArray<T> &V, MultidimArray<char> &mask,
+                     std::vector<size_t> &bad, F isBad, int Nthreads=1)
+{
+    size_t N = ZYXSIZE(V);
+    mask.initZeros(ZSIZE(V), YSIZE(V), XSIZE(V));
+    size_t Nthr = (Nthreads < 1) ? 1 : (size_t)Nthreads;
+    std::vector< std::vector<size_t> > badThread(Nthr);
+    size_t Nchunks = XMIPP_MIN(Nthr, XMIPP_MAX(N, (size_t)1));
+    medianFilterRunThreads(Nchunks, Nthreads, [&](size_t t0, size_t tF)
+    {
+        for (size_t t = t0; t < tF; ++t)
+        {
+            const T *ptr = MULTIDIM_ARRAY(V);
+            char *ptrMask = MULTIDIM_ARRAY(mask);
+            std::vector<size_t> &badt = badThread[t];
+            for (size_t n = N*t/Nchunks; n < N*(t+1)/Nchunks; ++n)
+                if (isBad(ptr[n]))
+                {
+                    ptrMask[n] = 1;
+                    badt.push_back(n);
+                }
+        }
+    });
+    bad.clear();
+    for (size_t t = 0; t < Nthr; ++t)
+        bad.insert(bad.end(), badThread[t].begin(), badThread[t].end());
+}
+
+/** Remove bad pixels given by a mask.
+ * Same as boundMedianFilter, the mask is set to 0 in the process. The bad
+ * pixels are collected by several threads, they are replaced in raster
+ * order by the calling thread.
+ */
+template <typename T>
+void fastBoundMedianFilter(MultidimArray<T> &V, const MultidimArray<char> &mask, int Nthreads=1)
+{
+    size_t N = ZYXSIZE(V);
+    size_t Nthr = (Nthreads < 1) ? 1 : (size_t)Nthreads;
+    std::vector< std::vector<size_t> > badThread(Nthr);
+    size_t Nchunks = XMIPP_MIN(Nthr, XMIPP_MAX(N, (size_t)1));
+    medianFilterRunThreads(Nchunks, Nthreads, [&](size_t t0, size_t tF)
+    {
+        const char *ptrMask = MULTIDIM_ARRAY(mask);
+        for (size_t t = t0; t < tF; ++t)
+            for (size_t n = N*t/Nchunks; n < N*(t+1)/Nchunks; ++n)
+                if (ptrMask[n] != 0)
+                    badThread[t].push_back(n);
+    });
+    std::vector<size_t> bad;
+    for (size_t t = 0; t < Nthr; ++t)
+        bad.insert(bad.end(), badThread[t].begin(), badThread[t].end());
+    boundMedianFilterList(V, mask, bad);
+}
+
+/** Remove outlier pixels.
+ * Same as pixelDesvFilter: the pixels out of the range
+ * avg +- thresFactor * stddev are replaced by the median of their good
+ * neighbours. The detection is done in one threaded pass that also builds
+ * the list of bad pixels, and only those are visited afterwards.
+ */
+template <typename T>
+void fastPixelDesvFilter(MultidimArray<T> &V, double thresFactor, int Nthreads=1)
+{
+    if (thresFactor > 0)
+    {
+        double avg, stddev;
+        T dummy;
+        V.computeStats(avg, stddev, dummy, dummy);//min and max not used
+        double low  = (avg - thresFactor * stddev);
+        double high = (avg + thresFactor * stddev);
+
+        MultidimArray<char> mask;
+        std::vector<size_t> bad;
+        detectBadPixels(V, mask, bad, [low,high](T v)
+        {
+            double x = v;
+            return x < low || x > high;
+        }, Nthreads);
+        boundMedianFilterList(V, mask, bad);
+    }
+}
+//@}
+#endif
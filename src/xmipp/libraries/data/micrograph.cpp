@@ -48,6 +48,7 @@ Micrograph::Micrograph()
     IUInt = NULL;
     IFloat = NULL;
     stdevFilter = -1;
+    Nthreads = 1;
 }
 Micrograph::~Micrograph()
 {
@@ -117,32 +118,32 @@ void Micrograph::open_micrograph(const FileName &_fn_micrograph)
     case DT_UChar:
         IUChar = new (Image<unsigned char> );
         result = IUChar->readMapped(fn_micrograph, FIRST_IMAGE);
-        pixelDesvFilter(IUChar->data, stdevFilter);
+        pixelDesvFilter(IUChar->data, stdevFilter, Nthreads);
         break;
     case DT_UShort:
         IUShort = new (Image<unsigned short> );
         result = IUShort->readMapped(fn_micrograph, FIRST_IMAGE);
-        pixelDesvFilter(IUShort->data, stdevFilter);
+        pixelDesvFilter(IUShort->data, stdevFilter, Nthreads);
         break;
     case DT_Short:
         IShort = new (Image<short> );
         result = IShort->readMapped(fn_micrograph, FIRST_IMAGE);
-        pixelDesvFilter(IShort->data, stdevFilter);
+        pixelDesvFilter(IShort->data, stdevFilter, Nthreads);
         break;
     case DT_Int:
         IInt = new (Image<int> );
         result = IInt->readMapped(fn_micrograph, FIRST_IMAGE);
-        pixelDesvFilter(IInt->data, stdevFilter);
+        pixelDesvFilter(IInt->data, stdevFilter, Nthreads);
         break;
     case DT_UInt:
         IUInt = new (Image<unsigned int> );
         result = IUInt->readMapped(fn_micrograph, FIRST_IMAGE);
-        pixelDesvFilter(IUChar->data, stdevFilter);
+        pixelDesvFilter(IUInt->data, stdevFilter, Nthreads);
         break;
     case DT_Float:
         IFloat = new (Image<float> );
         result = IFloat->readMapped(fn_micrograph, FIRST_IMAGE);
-        pixelDesvFilter(IFloat->data, stdevFilter);
+        pixelDesvFilter(IFloat->data, stdevFilter, Nthreads);
         break;
     default:
         std::cerr << "Micrograph::open_micrograph: Unknown datatype "
@@ -347,6 +348,57 @@ int Micrograph::scissor(const Particle_coords &P, MultidimArray<double> &result,
 
 }
 
+/* Scissor a batch --------------------------------------------------------- */
+void Micrograph::scissorBatch(const MicrographReader &reader,
+                              const std::vector<Particle_coords> &P, MultidimArray<double> &stack,
+                              std::vector<bool> &valid, double Dmin, double Dmax,
+                              double scaleX, double scaleY, bool fillBorders)
+{
+    if (X_window_size == -1 || Y_window_size == -1)
+        REPORT_ERROR(ERR_MULTIDIM_SIZE,
+                     "Micrograph::scissorBatch: window size not set");
+    size_t N=P.size();
+    std::vector<int> x0(N), y0(N);
+    for (size_t n=0; n<N; n++)
+    {
+        x0[n]=ROUND(scaleX * P[n].X) + FIRST_XMIPP_INDEX(X_window_size);
+        y0[n]=ROUND(scaleY * P[n].Y) + FIRST_XMIPP_INDEX(Y_window_size);
+    }
+    stack.resizeNoCopy(N, 1, Y_window_size, X_window_size);
+    reader.readWindows(x0, y0, stack, valid, fillBorders);
+
+    // Same conventions as templateScissor
+    double irange=1.0/(Dmax - Dmin);
+    MultidimArray<double> window;
+    for (size_t k=0; k<N; k++)
+    {
+        window.aliasImageInStack(stack, k);
+        if (!valid[k] && fillBorders)
+            valid[k]=true;
+        if (!valid[k])
+            window.initZeros();
+        else if (compute_transmitance || compute_inverse)
+            FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(window)
+            {
+                double val=DIRECT_MULTIDIM_ELEM(window,n);
+                if (compute_transmitance)
+                {
+                    double temp;
+                    if (val < 1)
+                        temp = val;
+                    else
+                        temp = log10(val);
+                    if (compute_inverse)
+                        DIRECT_MULTIDIM_ELEM(window,n) = (Dmax - temp) * irange;
+                    else
+                        DIRECT_MULTIDIM_ELEM(window,n) = (temp - Dmin) * irange;
+                }
+                else
+                    DIRECT_MULTIDIM_ELEM(window,n) = (Dmax - val) * irange;
+            }
+    }
+}
+
 /* Produce all images ------------------------------------------------------ */
 void Micrograph::produce_all_images(int label, double minCost,
                                     const FileName &fn_rootIn, const FileName &fn_image, double ang,
@@ -423,6 +475,17 @@ void Micrograph::produce_all_images(int label, double minCost,
 	int minNoiseDistance=Y_window_size/2;
 	std::vector<Particle_coords> noiseCoords;
 
+    // When possible, the particles are read from the file in batches
+    MicrographReader reader;
+    bool useReader=!extractNoise && M->stdevFilter<=0 &&
+                   MicrographReader::supports(M->fn_micrograph);
+    if (useReader)
+        reader.open(M->fn_micrograph);
+    std::vector<Particle_coords> batchCoords;
+    std::vector<bool> batchValid;
+    MultidimArray<double> batchStack;
+    size_t batchPos=0;
+
     for (int n = 0; n < nmax; n++)
     {
         if (coords[n].valid && coords[n].cost > minCost && coords[n].label == label)
@@ -463,6 +526,21 @@ void Micrograph::produce_all_images(int label, double minCost,
         		noiseCoords.push_back(Pnoise);
             	t = M->scissor(Pnoise, I(), Dmin, Dmax, scaleX, scaleY, false, fillBorders);
             }
+            else if (useReader)
+            {
+                if (batchPos==batchCoords.size())
+                {
+                    batchCoords.clear();
+                    for (int nn = n; nn < nmax && batchCoords.size() < MICROGRAPH_BATCH; nn++)
+                        if (coords[nn].valid && coords[nn].cost > minCost && coords[nn].label == label)
+                            batchCoords.push_back(coords[nn]);
+                    M->scissorBatch(reader, batchCoords, batchStack, batchValid,
+                                    Dmin, Dmax, scaleX, scaleY, fillBorders);
+                    batchPos=0;
+                }
+                I().aliasImageInStack(batchStack, batchPos);
+                t = batchValid[batchPos++];
+            }
             else
                 t = M->scissor(coords[n], I(), Dmin, Dmax, scaleX, scaleY, false, fillBorders);
             if (!t)
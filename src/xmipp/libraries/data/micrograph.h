@@ -37,6 +37,7 @@
 #include <core/xmipp_fftw.h>
 #include <core/metadata.h>
 #include <core/xmipp_error.h>
+#include "micrograph_reader.h"
 
 /* ************************************************************************* */
 /* FORWARD DEFINITIONS                                                       */
@@ -44,6 +45,9 @@
 // This forward definitions are needed for defining operators functions that
 // use other clases type
 
+/** Number of particles read at once by produce_all_images from mapped micrographs */
+#define MICROGRAPH_BATCH 256
+
 /* ************************************************************************* */
 /* MICROGRAPHY                                                               */
 /* ************************************************************************* */
@@ -102,6 +106,7 @@ public:
     int                      fh_micrograph;
     std::vector<std::string> labels;
     double                   stdevFilter;
+    int                      Nthreads;
 public:
     Image<char>                * auxI;
     Image<unsigned char>       * IUChar;
@@ -164,6 +169,12 @@ public:
         stdevFilter=d;
     }
 
+    /** Set the number of threads of the outlier filter */
+    void setNthreads(int n)
+    {
+        Nthreads=n;
+    }
+
     /** Save coordinates to disk. */
     void write_coordinates(int label, double minCost, const FileName &fn_coords = "");
 
@@ -345,6 +356,17 @@ public:
                 double scaleX = 1, double scaleY = 1, bool only_check = false,
 				bool fillBorders = false);
 
+    /** Scissor many particles from a mapped micrograph.
+        The result is the same as calling scissor for each of the particles
+        (the window i of the stack corresponds to P[i], and valid[i] is its
+        return value), but the windows are read straight from the file in
+        tile order (see \ref MicrographReader). The reader must have been
+        opened with the same micrograph. */
+    void scissorBatch(const MicrographReader &reader,
+                      const std::vector<Particle_coords> &P, MultidimArray<double> &stack,
+                      std::vector<bool> &valid, double Dmin, double Dmax,
+                      double scaleX = 1, double scaleY = 1, bool fillBorders = false);
+
     /** Access to array of 8 bits. */
     unsigned char * arrayUChar() const
     {
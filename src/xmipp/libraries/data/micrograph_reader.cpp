@@ -0,0 +1,353 @@
+/***************************************************************************
+ *
+ * Authors: Carlos Oscar (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include "micrograph_reader.h"
+#include <core/xmipp_error.h>
+#include <core/xmipp_funcs.h>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Header information ------------------------------------------------------ */
+// Fill size, datatype and offset from the file name and header.
+// Returns false if the file is not supported.
+static bool micrographReaderInfo(const FileName &fn, FileName &fnFile,
+                                 size_t &Xdim, size_t &Ydim, DataType &datatype,
+                                 size_t &offset, String &reason)
+{
+    size_t pos=fn.find('#');
+    if (pos!=String::npos)
+    {
+        // Raw file: file#Xdim,Ydim,[Zdim,]offset,datatype
+        fnFile=fn.substr(0,pos);
+        StringVector tokens;
+        splitString(fn.substr(pos+1),",",tokens);
+        if (tokens.size()!=4 && tokens.size()!=5)
+        {
+            reason="raw files must be given as file#Xdim,Ydim,[Zdim,]offset,datatype";
+            return false;
+        }
+        Xdim=textToInteger(tokens[0]);
+        Ydim=textToInteger(tokens[1]);
+        if (tokens.size()==5 && textToInteger(tokens[2])!=1)
+        {
+            reason="only single micrographs can be mapped";
+            return false;
+        }
+        offset=textToInteger(tokens[tokens.size()-2]);
+        const String &type=tokens[tokens.size()-1];
+        if (type=="float" || type=="float32")
+            datatype=DT_Float;
+        else if (type=="int16")
+            datatype=DT_Short;
+        else if (type=="uint16")
+            datatype=DT_UShort;
+        else
+        {
+            reason="unsupported raw datatype "+type;
+            return false;
+        }
+        return true;
+    }
+
+    fnFile=fn.removeFileFormat();
+    String ext=fnFile.getExtension();
+    if (ext!="mrc" && ext!="map")
+    {
+        reason="only MRC and raw files can be mapped";
+        return false;
+    }
+    FILE *fh=fopen(fnFile.c_str(),"rb");
+    if (fh==NULL)
+    {
+        reason="cannot open "+fnFile;
+        return false;
+    }
+    int32_t header[56];
+    bool ok=fread(header,sizeof(int32_t),56,fh)==56;
+    fclose(fh);
+    if (!ok)
+    {
+        reason="cannot read the MRC header of "+fnFile;
+        return false;
+    }
+    // The machine stamp is 0x44 0x41 (or 0x44 0x44) for little endian files,
+    // old files may leave it empty
+    unsigned char *stamp=(unsigned char *)(header+53);
+    if (IsBigEndian() || (stamp[0]!=0x44 && stamp[0]!=0))
+    {
+        reason="only little endian MRC files can be mapped";
+        return false;
+    }
+    if (header[2]!=1)
+    {
+        reason="only single micrographs can be mapped";
+        return false;
+    }
+    Xdim=header[0];
+    Ydim=header[1];
+    switch (header[3])
+    {
+    case 1:
+        datatype=DT_Short;
+        break;
+    case 2:
+        datatype=DT_Float;
+        break;
+    case 6:
+        datatype=DT_UShort;
+        break;
+    default:
+        reason=formatString("unsupported MRC mode %d",header[3]);
+        return false;
+    }
+    offset=1024+header[23];
+    return true;
+}
+
+/* Constructor ------------------------------------------------------------- */
+MicrographReader::MicrographReader()
+{
+    Xdim=Ydim=0;
+    datatype=DT_Float;
+    tileSize=MICROGRAPH_READER_TILE;
+    fd=-1;
+    map=NULL;
+    mapSize=offset=0;
+    pixelSize=0;
+}
+
+MicrographReader::~MicrographReader()
+{
+    close();
+}
+
+/* Supported files --------------------------------------------------------- */
+bool MicrographReader::supports(const FileName &fn)
+{
+    FileName fnFile;
+    size_t xdim, ydim, off;
+    DataType dt;
+    String reason;
+    return micrographReaderInfo(fn,fnFile,xdim,ydim,dt,off,reason);
+}
+
+/* Open -------------------------------------------------------------------- */
+void MicrographReader::open(const FileName &fn)
+{
+    close();
+    FileName fnFile;
+    String reason;
+    if (!micrographReaderInfo(fn,fnFile,Xdim,Ydim,datatype,offset,reason))
+        REPORT_ERROR(ERR_IO_NOREAD,"MicrographReader: cannot map "+fn+", "+reason);
+    pixelSize=gettypesize(datatype);
+
+    fd=::open(fnFile.c_str(),O_RDONLY);
+    if (fd<0)
+        REPORT_ERROR(ERR_IO_NOTOPEN,"MicrographReader: cannot open "+fnFile);
+    struct stat info;
+    if (fstat(fd,&info)!=0 || (size_t)info.st_size<offset+Xdim*Ydim*pixelSize)
+    {
+        close();
+        REPORT_ERROR(ERR_IO_SIZE,"MicrographReader: "+fnFile+" is smaller than expected");
+    }
+    mapSize=info.st_size;
+    map=(char *)mmap(NULL,mapSize,PROT_READ,MAP_SHARED,fd,0);
+    if (map==MAP_FAILED)
+    {
+        map=NULL;
+        close();
+        REPORT_ERROR(ERR_MMAP,"MicrographReader: cannot map "+fnFile);
+    }
+    // Windows are requested in small pieces, do not read ahead the whole file
+    madvise(map,mapSize,MADV_RANDOM);
+}
+
+/* Close ------------------------------------------------------------------- */
+void MicrographReader::close()
+{
+    if (map!=NULL)
+        munmap(map,mapSize);
+    if (fd>=0)
+        ::close(fd);
+    map=NULL;
+    fd=-1;
+    mapSize=0;
+}
+
+/* Prefetch ---------------------------------------------------------------- */
+void MicrographReader::prefetchRows(int y0, int yF) const
+{
+    y0=std::max(y0,0);
+    yF=std::min(yF,(int)Ydim-1);
+    if (y0>yF)
+        return;
+    size_t pageSize=sysconf(_SC_PAGESIZE);
+    size_t start=offset+(size_t)y0*Xdim*pixelSize;
+    size_t end=offset+(size_t)(yF+1)*Xdim*pixelSize;
+    start-=start%pageSize;
+    madvise(map+start,end-start,MADV_WILLNEED);
+}
+
+/* Read window ------------------------------------------------------------- */
+template <typename T>
+static void micrographReaderRow(const char *ptrRow, int x0, int xdim, int Xdim,
+                                bool fillBorders, double *ptrOut)
+{
+    const T *row=(const T *)ptrRow;
+    int j=0;
+    // Left border
+    for (; j<xdim && x0+j<0; ++j)
+        ptrOut[j]=fillBorders ? row[0]:0;
+    // Inside
+    int jF=std::min(xdim,Xdim-x0);
+    for (; j<jF; ++j)
+        ptrOut[j]=row[x0+j];
+    // Right border
+    for (; j<xdim; ++j)
+        ptrOut[j]=fillBorders ? row[Xdim-1]:0;
+}
+
+static bool micrographReaderWindow(const MicrographReader &reader, const char *data,
+                                   int x0, int y0, int xdim, int ydim,
+                                   bool fillBorders, double *ptrOut)
+{
+    int Xdim=reader.Xdim, Ydim=reader.Ydim;
+    bool inside=x0>=0 && y0>=0 && x0+xdim<=Xdim && y0+ydim<=Ydim;
+    size_t rowSize=Xdim*gettypesize(reader.datatype);
+    for (int i=0; i<ydim; ++i, ptrOut+=xdim)
+    {
+        int y=y0+i;
+        if (y<0 || y>=Ydim)
+        {
+            if (!fillBorders)
+            {
+                memset(ptrOut,0,xdim*sizeof(double));
+                continue;
+            }
+            y=(y<0) ? 0:Ydim-1;
+        }
+        const char *ptrRow=data+y*rowSize;
+        switch (reader.datatype)
+        {
+        case DT_Float:
+            micrographReaderRow<float>(ptrRow,x0,xdim,Xdim,fillBorders,ptrOut);
+            break;
+        case DT_Short:
+            micrographReaderRow<short>(ptrRow,x0,xdim,Xdim,fillBorders,ptrOut);
+            break;
+        case DT_UShort:
+            micrographReaderRow<unsigned short>(ptrRow,x0,xdim,Xdim,fillBorders,ptrOut);
+            break;
+        default:
+            break;
+        }
+    }
+    return inside;
+}
+
+bool MicrographReader::readWindow(int x0, int y0, MultidimArray<double> &window,
+                                  bool fillBorders) const
+{
+    if (map==NULL)
+        REPORT_ERROR(ERR_IO_NOTOPEN,"MicrographReader: the micrograph is not open");
+    return micrographReaderWindow(*this,map+offset,x0,y0,XSIZE(window),YSIZE(window),
+                                  fillBorders,MULTIDIM_ARRAY(window));
+}
+
+/* Tile order -------------------------------------------------------------- */
+struct MicrographReaderTileKey
+{
+    int tileY, tileX, y0;
+    size_t n;
+    bool operator<(const MicrographReaderTileKey &other) const
+    {
+        if (tileY!=other.tileY)
+            return tileY<other.tileY;
+        if (tileX!=other.tileX)
+            return tileX<other.tileX;
+        if (y0!=other.y0)
+            return y0<other.y0;
+        return n<other.n;
+    }
+};
+
+void MicrographReader::tileOrder(const std::vector<int> &x0, const std::vector<int> &y0,
+                                 std::vector<size_t> &order) const
+{
+    size_t N=x0.size();
+    std::vector<MicrographReaderTileKey> keys(N);
+    for (size_t n=0; n<N; ++n)
+    {
+        // Floor division so that negative corners go to the first tile
+        keys[n].tileY=(int)floor((double)y0[n]/tileSize);
+        keys[n].tileX=(int)floor((double)x0[n]/tileSize);
+        keys[n].y0=y0[n];
+        keys[n].n=n;
+    }
+    std::sort(keys.begin(),keys.end());
+    order.resize(N);
+    for (size_t n=0; n<N; ++n)
+        order[n]=keys[n].n;
+}
+
+/* Read windows ------------------------------------------------------------ */
+void MicrographReader::readWindows(const std::vector<int> &x0, const std::vector<int> &y0,
+                                   MultidimArray<double> &stack, std::vector<bool> &valid,
+                                   bool fillBorders) const
+{
+    if (map==NULL)
+        REPORT_ERROR(ERR_IO_NOTOPEN,"MicrographReader: the micrograph is not open");
+    if (x0.size()!=y0.size() || NSIZE(stack)!=x0.size())
+        REPORT_ERROR(ERR_ARG_INCORRECT,"MicrographReader::readWindows: the number of corners "
+                     "and images in the stack do not match");
+    std::vector<size_t> order;
+    tileOrder(x0,y0,order);
+    valid.resize(x0.size());
+
+    int xdim=XSIZE(stack), ydim=YSIZE(stack);
+    size_t windowSize=(size_t)xdim*ydim;
+    int currentTile=INT_MIN;
+    for (size_t k=0; k<order.size(); ++k)
+    {
+        size_t n=order[k];
+        // When entering a new band of tiles, ask for the rows of the next one
+        int tile=(int)floor((double)y0[n]/tileSize);
+        if (tile!=currentTile)
+        {
+            if (currentTile==INT_MIN)
+                prefetchRows(y0[n],(tile+1)*tileSize+ydim-1);
+            prefetchRows((tile+1)*tileSize,(tile+2)*tileSize+ydim-1);
+            currentTile=tile;
+        }
+        valid[n]=micrographReaderWindow(*this,map+offset,x0[n],y0[n],xdim,ydim,fillBorders,
+                                        MULTIDIM_ARRAY(stack)+n*windowSize);
+    }
+}
@@ -0,0 +1,132 @@
+/***************************************************************************
+ *
+ * Authors: Carlos Oscar (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef _MICROGRAPH_READER_H
+#define _MICROGRAPH_READER_H
+
+#include <vector>
+#include <core/multidim_array.h>
+#include <core/xmipp_filename.h>
+#include <core/xmipp_datatype.h>
+
+/// @defgroup MicrographReader Memory mapped micrograph reader
+/// @ingroup DataLibrary
+//@{
+
+/** Default tile size (in pixels) used to order batch extractions */
+#define MICROGRAPH_READER_TILE 512
+
+/** Memory mapped micrograph reader.
+    The micrograph is mapped read-only and windows are copied straight from
+    the mapping, so that only the pages covering the requested windows are
+    ever read from disk. Supported files are MRC micrographs (modes 1, 2 and 6,
+    little endian, a single image) and raw images given as
+    file#Xdim,Ydim,[Zdim,]offset,datatype with datatype float, int16 or uint16.
+
+    All the access methods are const and do not modify the object, so a single
+    reader can be shared by several threads. They all use the same mapping
+    and, therefore, the same pages of the system cache.
+
+    @code
+    MicrographReader reader;
+    reader.open("micrograph.mrc");
+    MultidimArray<double> window(256,256);
+    reader.readWindow(x0,y0,window);
+    @endcode
+*/
+class MicrographReader
+{
+public:
+    /// Micrograph size
+    size_t Xdim, Ydim;
+
+    /// Datatype (DT_Float, DT_Short or DT_UShort)
+    DataType datatype;
+
+    /// Tile size used to sort the windows of a batch
+    int tileSize;
+
+public:
+    /// Empty constructor
+    MicrographReader();
+
+    /// Destructor
+    ~MicrographReader();
+
+    /** True if the file can be read by this class */
+    static bool supports(const FileName &fn);
+
+    /** Open and map a micrograph. */
+    void open(const FileName &fn);
+
+    /** Unmap the micrograph. */
+    void close();
+
+    /** Read a window whose top-left corner is at (x0,y0).
+        The window size is taken from the output array, whose logical
+        origin is not changed. If the window is not completely inside the
+        micrograph, the function returns false and, if fillBorders is set,
+        the missing pixels are taken from the closest border pixel
+        (otherwise they are set to 0). */
+    bool readWindow(int x0, int y0, MultidimArray<double> &window,
+                    bool fillBorders=false) const;
+
+    /** Read many windows.
+        The windows have their top-left corners at (x0[n],y0[n]) and they are
+        stored in the images of the stack (whose X and Y sizes define the
+        window size) in the input order. However, they are read in tile order,
+        so that neighbouring windows are read together and each tile is read
+        from disk only once, and the pages of the next tile are requested in
+        advance. valid[n] tells whether each window was completely inside
+        the micrograph. */
+    void readWindows(const std::vector<int> &x0, const std::vector<int> &y0,
+                     MultidimArray<double> &stack, std::vector<bool> &valid,
+                     bool fillBorders=false) const;
+
+    /** Order in which readWindows reads a set of windows. */
+    void tileOrder(const std::vector<int> &x0, const std::vector<int> &y0,
+                   std::vector<size_t> &order) const;
+
+protected:
+    // File descriptor
+    int fd;
+
+    // Mapping of the whole file
+    char *map;
+
+    // Size of the mapping
+    size_t mapSize;
+
+    // Offset of the first pixel in the file
+    size_t offset;
+
+    // Size of a pixel in bytes
+    size_t pixelSize;
+
+    // Request the pages of rows y0 to yF
+    void prefetchRows(int y0, int yF) const;
+};
+//@}
+#endif
@@ -28,6 +28,8 @@
 /* ------------------------------------------------------------------------- */
 
 #include <stdio.h>
+#include <thread>
+#include <functional>
 
 #include "phantom.h"
 #include <core/geometry.h>
@@ -1046,24 +1048,42 @@ const
 /* ------------------------------------------------------------------------- */
 /* Draw in                                                                   */
 /* ------------------------------------------------------------------------- */
-/* Corners ----------------------------------------------------------------- */
-void Feature::corners(const MultidimArray<double> &V, Matrix1D<double> &corner1,
-                      Matrix1D<double> &corner2)
+/* Bounding box ------------------------------------------------------------ */
+void Feature::bounding_box(Matrix1D<double> &corner1, Matrix1D<double> &corner2) const
 {
     corner1.resize(3);
     corner2.resize(3);
-    XX(corner1) = XMIPP_MAX(FLOOR(XX(Center) - max_distance), STARTINGX(V));
-    YY(corner1) = XMIPP_MAX(FLOOR(YY(Center) - max_distance), STARTINGY(V));
-    ZZ(corner1) = XMIPP_MAX(FLOOR(ZZ(Center) - max_distance), STARTINGZ(V));
-    XX(corner2) = XMIPP_MIN(CEIL(XX(Center) + max_distance), FINISHINGX(V));
-    YY(corner2) = XMIPP_MIN(CEIL(YY(Center) + max_distance), FINISHINGY(V));
-    ZZ(corner2) = XMIPP_MIN(CEIL(ZZ(Center) + max_distance), FINISHINGZ(V));
+    XX(corner1) = FLOOR(XX(Center) - max_distance);
+    YY(corner1) = FLOOR(YY(Center) - max_distance);
+    ZZ(corner1) = FLOOR(ZZ(Center) - max_distance);
+    XX(corner2) = CEIL(XX(Center) + max_distance);
+    YY(corner2) = CEIL(YY(Center) + max_distance);
+    ZZ(corner2) = CEIL(ZZ(Center) + max_distance);
+}
+
+/* Corners ----------------------------------------------------------------- */
+void Feature::corners(const MultidimArray<double> &V, Matrix1D<double> &corner1,
+                      Matrix1D<double> &corner2) const
+{
+    bounding_box(corner1, corner2);
+    XX(corner1) = XMIPP_MAX(XX(corner1), STARTINGX(V));
+    YY(corner1) = XMIPP_MAX(YY(corner1), STARTINGY(V));
+    ZZ(corner1) = XMIPP_MAX(ZZ(corner1), STARTINGZ(V));
+    XX(corner2) = XMIPP_MIN(XX(corner2), FINISHINGX(V));
+    YY(corner2) = XMIPP_MIN(YY(corner2), FINISHINGY(V));
+    ZZ(corner2) = XMIPP_MIN(ZZ(corner2), FINISHINGZ(V));
 }
 
 /* Draw a feature ---------------------------------------------------------- */
+void Feature::draw_in(MultidimArray<double> &V, int colour_mode, double colour)
+{
+    draw_in(V, colour_mode, colour, STARTINGZ(V), FINISHINGZ(V));
+}
+
 //#define DEBUG
 #define Vr A3D_ELEM(V,(int)ZZ(r),(int)YY(r),(int)XX(r))
-void Feature::draw_in(MultidimArray<double> &V, int colour_mode, double colour)
+void Feature::draw_in(MultidimArray<double> &V, int colour_mode, double colour,
+                      int k0, int kF) const
 {
     Matrix1D<double>   aux1(3), aux2(3), corner1(3), corner2(3), r(3);
     int               add;
@@ -1082,6 +1102,10 @@ void Feature::draw_in(MultidimArray<double> &V, int colour_mode, double colour)
     }
 
     corners(V, corner1, corner2);
+    ZZ(corner1) = XMIPP_MAX(ZZ(corner1), k0);
+    ZZ(corner2) = XMIPP_MIN(ZZ(corner2), kF);
+    if (ZZ(corner1) > ZZ(corner2))
+        return;
 #ifdef DEBUG
 
     std::cout << "Drawing \n";
@@ -1367,6 +1391,12 @@ double Cone::intersection(
 //#define DEBUG_EVEN_MORE
 void Feature::project_to(Projection &P, const Matrix2D<double> &VP,
                          const Matrix2D<double> &PV) const
+{
+    project_to(P, VP, PV, STARTINGY(P()), FINISHINGY(P()));
+}
+
+void Feature::project_to(Projection &P, const Matrix2D<double> &VP,
+                         const Matrix2D<double> &PV, int v0, int vF) const
 {
 #define SUBSAMPLING 2                  // for every measure 2x2 line
     // integrals will be taken to
@@ -1478,6 +1508,10 @@ void Feature::project_to(Projection &P, const Matrix2D<double> &VP,
     if (YY(corner1) == YY(corner2))
         return;
 
+    // Keep only the rows of this band
+    YY(corner1) = XMIPP_MAX(YY(corner1), v0);
+    YY(corner2) = XMIPP_MIN(YY(corner2), vF);
+
     // Study the projection for each point in the projection plane ..........
     // (u,v) are in the deformed projection plane (if any deformation)
     for (int v = (int)YY(corner1); v <= (int)YY(corner2); v++)
@@ -2043,6 +2077,7 @@ Phantom::Phantom()
     fn = "";
     current_scale = 1;
     phantom_scale = 1.;
+    Nthreads = 1;
 }
 
 void Phantom::clear()
@@ -2066,6 +2101,7 @@ Phantom & Phantom::operator = (const Phantom &P)
     zdim = P.zdim;
     phantom_scale = P.phantom_scale;
     Background_Density = P.Background_Density;
+    Nthreads = P.Nthreads;
     Sphere     *sph;
     Blob       *blo;
     Gaussian   *gau;
@@ -2459,6 +2495,64 @@ void Phantom::write(const FileName &fn_phantom)
     MD2.write((std::string)"block2@"+fn_phantom.c_str(), MD_APPEND);
 }
 
+/* Feature grid ------------------------------------------------------------ */
+void FeatureGrid::build(const std::vector<Feature*> &VF, const MultidimArray<double> &V,
+                        int cellSize)
+{
+    this->cellSize = cellSize;
+    k0 = STARTINGZ(V);
+    i0 = STARTINGY(V);
+    j0 = STARTINGX(V);
+    Zcells = XMIPP_MAX(1, (int)(ZSIZE(V) + cellSize - 1) / cellSize);
+    Ycells = XMIPP_MAX(1, (int)(YSIZE(V) + cellSize - 1) / cellSize);
+    Xcells = XMIPP_MAX(1, (int)(XSIZE(V) + cellSize - 1) / cellSize);
+    cells.clear();
+    cells.resize((size_t)Zcells * Ycells * Xcells);
+
+    // Boxes are clipped to the grid as voxels outside the grid are
+    // assigned to the closest cell
+    Matrix1D<double> corner1(3), corner2(3);
+    for (size_t n = 0; n < VF.size(); n++)
+    {
+        VF[n]->bounding_box(corner1, corner2);
+        int kc0 = CLIP(((int)ZZ(corner1) - k0) / cellSize, 0, Zcells - 1);
+        int kcF = CLIP(((int)ZZ(corner2) - k0) / cellSize, 0, Zcells - 1);
+        int ic0 = CLIP(((int)YY(corner1) - i0) / cellSize, 0, Ycells - 1);
+        int icF = CLIP(((int)YY(corner2) - i0) / cellSize, 0, Ycells - 1);
+        int jc0 = CLIP(((int)XX(corner1) - j0) / cellSize, 0, Xcells - 1);
+        int jcF = CLIP(((int)XX(corner2) - j0) / cellSize, 0, Xcells - 1);
+        for (int kc = kc0; kc <= kcF; kc++)
+            for (int ic = ic0; ic <= icF; ic++)
+                for (int jc = jc0; jc <= jcF; jc++)
+                    cells[((size_t)kc * Ycells + ic) * Xcells + jc].push_back(n);
+    }
+}
+
+const std::vector<size_t> & FeatureGrid::candidates(int k, int i, int j) const
+{
+    int kc = CLIP((k - k0) / cellSize, 0, Zcells - 1);
+    int ic = CLIP((i - i0) / cellSize, 0, Ycells - 1);
+    int jc = CLIP((j - j0) / cellSize, 0, Xcells - 1);
+    return cells[((size_t)kc * Ycells + ic) * Xcells + jc];
+}
+
+/* Run a function on several bands of consecutive indexes ------------------ */
+// The band [first,last] is split in Nthreads bands that are processed in
+// parallel. The calling thread processes the first one.
+static void processBands(int first, int last, int Nthreads,
+                         const std::function<void(int, int)> &f)
+{
+    int N = last - first + 1;
+    int Nthr = XMIPP_MAX(1, XMIPP_MIN(Nthreads, N));
+    std::vector<std::thread> threads;
+    for (int t = 1; t < Nthr; t++)
+        threads.push_back(std::thread(f, first + (N * t) / Nthr,
+                                      first + (N * (t + 1)) / Nthr - 1));
+    f(first, first + N / Nthr - 1);
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+}
+
 /* Voxel Inside any feature ------------------------------------------------ */
 int Phantom::voxel_inside_any_feat(const Matrix1D<double> &r,
                                    Matrix1D<double> &aux1, Matrix1D<double> &aux2) const
@@ -2479,6 +2573,27 @@ int Phantom::voxel_inside_any_feat(const Matrix1D<double> &r,
     return current_i;
 }
 
+int Phantom::voxel_inside_any_feat(const Matrix1D<double> &r, const FeatureGrid &grid,
+                                   Matrix1D<double> &aux1, Matrix1D<double> &aux2) const
+{
+    int inside, current_i;
+    double current_density;
+    current_i = 0;
+    current_density = Background_Density;
+    const std::vector<size_t> &candidates = grid.candidates((int)ZZ(r), (int)YY(r), (int)XX(r));
+    for (size_t n = 0; n < candidates.size(); n++)
+    {
+        size_t i = candidates[n];
+        inside = VF[i]->voxel_inside(r, aux1, aux2);
+        if (inside != 0 && VF[i]->Density > current_density)
+        {
+            current_i = i + 1;
+            current_density = VF[i]->Density;
+        }
+    }
+    return current_i;
+}
+
 /* Any feature intersects sphere ------------------------------------------- */
 int Phantom::any_feature_intersects_sphere(const Matrix1D<double> &r,
         double radius, Matrix1D<double> &aux1, Matrix1D<double> &aux2,
@@ -2487,6 +2602,12 @@ int Phantom::any_feature_intersects_sphere(const Matrix1D<double> &r,
     bool intersects;
     for (size_t i = 0; i < VF.size(); i++)
     {
+        // Features too far from the sphere cannot intersect it
+        double reach = VF[i]->max_distance + radius + 1;
+        if (fabs(XX(r) - XX(VF[i]->Center)) > reach ||
+            fabs(YY(r) - YY(VF[i]->Center)) > reach ||
+            fabs(ZZ(r) - ZZ(VF[i]->Center)) > reach)
+            continue;
         intersects = VF[i]->intersects_sphere(r, radius, aux1, aux2, aux3);
         if (intersects)
             return i + 1;
@@ -2501,30 +2622,42 @@ void Phantom::draw_in(MultidimArray<double> &V)
     V.resize(zdim, ydim, xdim);
     V.setXmippOrigin();
     V.initConstant(Background_Density);
-    for (size_t i = 0; i < VF.size(); i++)
-        VF[i]->draw_in(V);
+    // Each slab is drawn with all the features in order, so that the
+    // result does not depend on the number of threads
+    processBands(STARTINGZ(V), FINISHINGZ(V), Nthreads, [&](int k0, int kF)
+    {
+        for (size_t i = 0; i < VF.size(); i++)
+            VF[i]->draw_in(V, INTERNAL, -1, k0, kF);
+    });
 }
 
 /* Label a Phantom --------------------------------------------------------- */
 // Always suppose CC grid
 void Phantom::label(MultidimArray<double> &V)
 {
-    Matrix1D<double> r(3), aux1(3), aux2(3);
     V.resize(zdim, ydim, xdim);
     V.setXmippOrigin();
-    FOR_ALL_ELEMENTS_IN_ARRAY3D(V)
+    FeatureGrid grid;
+    grid.build(VF, V);
+    processBands(STARTINGZ(V), FINISHINGZ(V), Nthreads, [&](int k0, int kF)
     {
-        ZZ(r) = k;
-        YY(r) = i;
-        XX(r) = j;
-        int sel_feat = voxel_inside_any_feat(r, aux1, aux2);
-        // If it is not in the background, check that it is completely
-        // inside the feature, if not set it to border.
-        if (sel_feat != 0)
-            if (VF[sel_feat-1]->voxel_inside(r, aux1, aux2) != 8)
-                sel_feat = -sel_feat;
-        A3D_ELEM(V, k, i, j) = sel_feat;
-    }
+        Matrix1D<double> r(3), aux1(3), aux2(3);
+        for (int k = k0; k <= kF; k++)
+            for (int i = STARTINGY(V); i <= FINISHINGY(V); i++)
+                for (int j = STARTINGX(V); j <= FINISHINGX(V); j++)
+                {
+                    ZZ(r) = k;
+                    YY(r) = i;
+                    XX(r) = j;
+                    int sel_feat = voxel_inside_any_feat(r, grid, aux1, aux2);
+                    // If it is not in the background, check that it is completely
+                    // inside the feature, if not set it to border.
+                    if (sel_feat != 0)
+                        if (VF[sel_feat-1]->voxel_inside(r, aux1, aux2) != 8)
+                            sel_feat = -sel_feat;
+                    A3D_ELEM(V, k, i, j) = sel_feat;
+                }
+    });
 }
 
 /* Sketch a Phantom -------------------------------------------------------- */
@@ -2572,6 +2705,19 @@ void Phantom::selfApplyGeometry(const Matrix2D<double> &A, int inv)
 }
 
 /* Projecting a phantom ---------------------------------------------------- */
+// Each band of rows is projected with all the features in order, so that
+// the result does not depend on the number of threads
+static void projectFeatures(const std::vector<Feature*> &features, Projection &P,
+                            const Matrix2D<double> &VP, const Matrix2D<double> &PV,
+                            int Nthreads)
+{
+    processBands(STARTINGY(P()), FINISHINGY(P()), Nthreads, [&](int v0, int vF)
+    {
+        for (size_t i = 0; i < features.size(); i++)
+            features[i]->project_to(P, VP, PV, v0, vF);
+    });
+}
+
 //#define DEBUG
 void Phantom::project_to(Projection &P, int Ydim, int Xdim,
                          double rot, double tilt, double psi, const Matrix2D<double> *A) const
@@ -2592,8 +2738,7 @@ void Phantom::project_to(Projection &P, int Ydim, int Xdim,
         VP = (*A) * VP;
     Matrix2D<double> PV = VP.inv();
     // Project all features
-    for (size_t i = 0; i < VF.size(); i++)
-        VF[i]->project_to(P, VP, PV);
+    projectFeatures(VF, P, VP, PV, Nthreads);
 }
 #undef DEBUG
 
@@ -2609,20 +2754,21 @@ void Phantom::project_to(Projection &P,
     Matrix2D<double> PV = VP.inv();
 
     // Project all features
-    for (size_t i = 0; i < VF.size(); i++)
-        VF[i]->project_to(P, VP, PV);
+    projectFeatures(VF, P, VP, PV, Nthreads);
 }
 
 void Phantom::project_to(Projection &P, const Matrix2D<double> &VP, double    disappearing_th) const
 {
     Matrix2D<double> PV = VP.inv();
 
-    // Project all features
+    // Choose the features to project, then project them
+    std::vector<Feature*> selected;
     for (size_t i = 0; i < VF.size(); i++)
     {
         if (rnd_unif(0, 1) < disappearing_th)
-            VF[i]->project_to(P, VP, PV);
+            selected.push_back(VF[i]);
     }
+    projectFeatures(selected, P, VP, PV, Nthreads);
 }
 
 /* Surface ----------------------------------------------------------------- */
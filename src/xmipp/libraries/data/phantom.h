@@ -307,6 +307,19 @@ public:
     void project_to(Projection &P, const Matrix2D<double> &VP,
                     const Matrix2D<double> &PV) const;
 
+    /** Project feature onto some rows of a projection plane.
+        The same as the previous one but only the rows between v0 and vF
+        (both included, logical indexes) are modified, so that different
+        bands of the same projection can be computed in parallel. */
+    void project_to(Projection &P, const Matrix2D<double> &VP,
+                    const Matrix2D<double> &PV, int v0, int vF) const;
+
+    /** Bounding box of the feature.
+        This function returns the two integer Z3 points of the box containing
+        all the voxels that may share a corner with the feature. The box
+        is not clipped to any volume. */
+    void bounding_box(Matrix1D<double> &corner1, Matrix1D<double> &corner2) const;
+
     /** Define 3D corners for a feature.
         This function returns two Z3 points where the feature is confined.
         The volume borders are taken into account and you might make a for
@@ -321,7 +334,7 @@ public:
         }
         @endcode*/
     void corners(const MultidimArray<double> &V, Matrix1D<double> &corner1,
-                 Matrix1D<double> &corner2);
+                 Matrix1D<double> &corner2) const;
 
 #define INTERNAL 0
 #define EXTERNAL 1
@@ -351,6 +364,13 @@ public:
     */
     void draw_in(MultidimArray<double> &V, int color_mode = INTERNAL, double colour = -1);
 
+    /** Draw a feature in some slices of a volume.
+        The same as the previous one but only the slices between k0 and kF
+        (both included, logical indexes) are modified, so that different
+        slabs of the same volume can be drawn in parallel. */
+    void draw_in(MultidimArray<double> &V, int color_mode, double colour,
+                 int k0, int kF) const;
+
     /** Draw the surface of the feature.
         This function draws the surface of the feature at the given volume.
         A voxel is said to belong to the surface if the number of corners
@@ -1363,6 +1383,35 @@ public:
         double minpsi = 0,    double maxpsi = 360);
 };
 
+/** Uniform grid of features.
+    The volume is divided in cubic cells and each cell keeps the list of
+    features whose bounding box overlaps it. The features that may contain
+    a voxel are then found without visiting all the features of a phantom. */
+class FeatureGrid
+{
+public:
+    /// Side of the cells in voxels
+    int cellSize;
+
+    /// Logical indexes of the first voxel of the grid
+    int k0, i0, j0;
+
+    /// Number of cells in Z, Y and X
+    int Zcells, Ycells, Xcells;
+
+    /// Indexes of the features overlapping each cell, in increasing order
+    std::vector< std::vector<size_t> > cells;
+public:
+    /** Build the grid of a list of features covering the volume V. */
+    void build(const std::vector<Feature*> &VF, const MultidimArray<double> &V,
+               int cellSize = 8);
+
+    /** Features that may contain the voxel (k,i,j).
+        Voxels outside the grid are assigned to the closest cell, so the
+        list always contains all the features that may contain the voxel. */
+    const std::vector<size_t> & candidates(int k, int i, int j) const;
+};
+
 /* PHANTOM ================================================================= */
 /** Phantom class.
     The phantom class is simply a list (STL vector) of features plus some
@@ -1411,6 +1460,9 @@ public:
 
     /// List with the features
     std::vector<Feature*> VF;
+
+    /// Number of threads used to draw, label and project the phantom
+    int            Nthreads;
 public:
     /** Empty constructor.
         The empty phantom is 0x0x0, background density=0, no feature is inside
@@ -1422,6 +1474,7 @@ public:
         The file must accomplish the structure given in \ref Phantoms. */
     Phantom(const FileName &fn_phantom)
     {
+        Nthreads = 1;
         read(fn_phantom);
     }
 
@@ -1526,6 +1579,13 @@ public:
         return voxel_inside_any_feat(r, aux1, aux2);
     }
 
+    /** Voxel inside any feature using a feature grid.
+        The same as the previous one, but only the features listed in the
+        grid cell of the voxel are checked. The grid must have been built
+        with the features of this phantom. */
+    int voxel_inside_any_feat(const Matrix1D<double> &r, const FeatureGrid &grid,
+                              Matrix1D<double> &aux1, Matrix1D<double> &aux2) const;
+
     /** Speeded up sphere intersecting any feature.
         This function returns the first feature in the list intersecting
         a sphere with center r in R3 and the given radius. In none, 0 is
@@ -1549,7 +1609,8 @@ public:
     /** Draw the phantom in the volume.
         The volume is cleaned, resized to the phantom size and its origin
         is set at the center of the volume. Then every feature is drawn into
-        the volume */
+        the volume. The volume is divided in Nthreads slabs along Z that are
+        drawn in parallel. */
     void draw_in(MultidimArray<double> &V);
 
     /** Label a volume after the phantom.
@@ -35,6 +35,7 @@
 #include <core/multidim_array.h>
 #include <core/transformations.h>
 #include <core/xmipp_fftw.h>
+#include "bspline_interpolation.h"
 
 #define FULL_CIRCLES 0
 #define HALF_CIRCLES 1
@@ -67,6 +68,8 @@ public:
     double                     oversample;
     std::vector<double>        ring_radius;  // radius of each ring
     std::vector<MultidimArray<T> >  rings;        // vector with all rings
+protected:
+    std::vector<double>        ringValues;   // auxiliary for the interpolation of a ring
 public:
     /** Empty constructor
      *
@@ -600,6 +603,22 @@ public:
 
     }
 
+    /** Interpolate a ring with the batched B-spline kernel.
+     * Order 1 is equivalent to interpolatedElement2DOutsideZero and
+     * order 3 to interpolatedElementBSpline2D.
+     */
+    template<int Degree>
+    void interpolateRing(const MultidimArray<T> &M1, MultidimArray<T> &Mring,
+                         const std::vector<double> &axp, const std::vector<double> &ayp,
+                         BSplineBoundary boundary)
+    {
+        size_t nsam = axp.size();
+        ringValues.resize(nsam);
+        interpolateBSpline2D<Degree>(M1, nsam, &axp[0], &ayp[0], &ringValues[0], boundary);
+        for (size_t iphi = 0; iphi < nsam; iphi++)
+            DIRECT_A1D_ELEM(Mring,iphi) = (T) ringValues[iphi];
+    }
+
     /** Convert cartesian MultidimArray to Polar using B-spline interpolation
      *
      * The input MultidimArray is assumed to be pre-processed for B-splines
@@ -622,6 +641,7 @@ public:
         double xp, yp, minxp, maxxp, minyp, maxyp;
 
         MultidimArray<T> Mring;
+        std::vector<double> axp, ayp;
         rings.clear();
         ring_radius.clear();
         mode = mode1;
@@ -654,43 +674,9 @@ public:
             nsam = XMIPP_MAX(1, nsam);
             float dphi = twopi / (float)nsam;
             Mring.resizeNoCopy(nsam);
-            int iphi = 0;
-#define VEC_LEN 8
-            double axp[VEC_LEN];
-            double ayp[VEC_LEN];
-            for (iphi = 0; iphi < nsam-VEC_LEN; iphi+=VEC_LEN)
-            {
-                for (int jphi = 0; jphi < VEC_LEN; jphi++) {
-                    // from polar to original cartesian coordinates
-                    float phi = (iphi+jphi) * dphi;
-                    axp[jphi] = sin(phi) * radius;
-                    ayp[jphi] = cos(phi) * radius;
-
-                    // Origin offsets
-                    axp[jphi] += xoff;
-                    ayp[jphi] += yoff;
-                }
-
-                for (int jphi = 0; jphi < VEC_LEN; jphi++) {
-                    // Wrap coordinates
-   	                axp[jphi] = realWRAP(axp[jphi], minxp - 0.5, maxxp + 0.5);
-   	                ayp[jphi] = realWRAP(ayp[jphi], minyp - 0.5, maxyp + 0.5);
-                }
-
-                // Perform the convolution interpolation
-                if (BsplineOrder==1) {
-                    #pragma simd
-                    for (int jphi = 0; jphi < VEC_LEN; jphi++) {
-                        DIRECT_A1D_ELEM(Mring,iphi+jphi) = M1.interpolatedElement2DOutsideZero(axp[jphi],ayp[jphi]);
-                    }
-                }
-                else {
-                    for (int jphi = 0; jphi < VEC_LEN; jphi++) {
-                        DIRECT_A1D_ELEM(Mring,iphi+jphi) = M1.interpolatedElementBSpline2D(axp[jphi],ayp[jphi],BsplineOrder);
-                    }
-                }
-            }
-            for (; iphi < nsam; iphi++)
+            axp.resize(nsam);
+            ayp.resize(nsam);
+            for (int iphi = 0; iphi < nsam; iphi++)
             {
                 // from polar to original cartesian coordinates
                 float phi = iphi * dphi;
@@ -706,13 +692,18 @@ public:
                     xp = realWRAP(xp, minxp - 0.5, maxxp + 0.5);
                 if (yp < minyp_e || yp > maxyp_e)
                     yp = realWRAP(yp, minyp - 0.5, maxyp + 0.5);
-
-                // Perform the convolution interpolation
-                if (BsplineOrder==1)
-                    DIRECT_A1D_ELEM(Mring,iphi) = M1.interpolatedElement2DOutsideZero(xp,yp);
-                else
-                    DIRECT_A1D_ELEM(Mring,iphi) = M1.interpolatedElementBSpline2D(xp,yp,BsplineOrder);
+                axp[iphi] = xp;
+                ayp[iphi] = yp;
             }
+
+            // Perform the convolution interpolation of the whole ring
+            if (BsplineOrder==1)
+                interpolateRing<1>(M1, Mring, axp, ayp, BSPLINE_BOUNDARY_ZERO);
+            else if (BsplineOrder==3)
+                interpolateRing<3>(M1, Mring, axp, ayp, BSPLINE_BOUNDARY_MIRROR);
+            else
+                for (int iphi = 0; iphi < nsam; iphi++)
+                    DIRECT_A1D_ELEM(Mring,iphi) = M1.interpolatedElementBSpline2D(axp[iphi],ayp[iphi],BsplineOrder);
             rings.push_back(Mring);
             ring_radius.push_back(radius);
         }
@@ -0,0 +1,555 @@
+/***************************************************************************
+ *
+ * Authors:    Carlos Oscar Sanchez Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include "profiler.h"
+#include <core/xmipp_program.h>
+#include <core/xmipp_error.h>
+#include <core/xmipp_macros.h>
+#include <core/xmipp_strings.h>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <unistd.h>
+
+std::atomic<bool> Profiler::enabled(false);
+std::atomic<bool> Profiler::tracing(false);
+size_t Profiler::maxEvents=1000000;
+
+static const char *phaseNames[PROFILE_NPHASES]={"io","fft","interpolation","reduction","compute"};
+
+static thread_local ProfileThreadData *profileThreadData=NULL;
+
+static void writeProfileAtExit()
+{
+    Profiler &profiler=Profiler::instance();
+    if (!Profiler::enabled)
+        return;
+    // An exception cannot leave an exit handler
+    try
+    {
+        profiler.write();
+    }
+    catch (XmippError &xe)
+    {
+        std::cerr << "Warning: the profile could not be written: " << xe.msg << std::endl;
+    }
+}
+
+Profiler::Profiler()
+{
+    done=false;
+    t0=std::chrono::steady_clock::now();
+}
+
+Profiler &Profiler::instance()
+{
+    static Profiler profiler;
+    static bool initialized=false;
+    if (!initialized)
+    {
+        initialized=true;
+        // Registered after the construction so that it runs before the destructor
+        atexit(writeProfileAtExit);
+        const char *env=getenv("XMIPP_PROFILE");
+        if (env!=NULL && env[0]!='\0')
+        {
+            String fn=env, format="json";
+            size_t comma=fn.find(',');
+            if (comma!=String::npos)
+            {
+                format=fn.substr(comma+1);
+                fn=fn.substr(0,comma);
+            }
+            size_t pos=fn.find("%p");
+            if (pos!=String::npos)
+                fn.replace(pos,2,integerToString(getpid()));
+            profiler.start(fn,format);
+        }
+    }
+    return profiler;
+}
+
+// Force the reading of XMIPP_PROFILE before main
+static Profiler &profilerAtStartup=Profiler::instance();
+
+void Profiler::defineParams(XmippProgram *program)
+{
+    program->addParamsLine("  [--profile <file> <format=json>] : Profile the program and write the time spent in each phase");
+    program->addParamsLine("         where <format>");
+    program->addParamsLine("                json          : Summary of calls and times per region and phase");
+    program->addParamsLine("                trace         : Chrome trace (chrome://tracing) with every timed interval");
+}
+
+void Profiler::readParams(XmippProgram *program)
+{
+    if (program->checkParam("--profile"))
+        instance().start(program->getParam("--profile"), program->getParam("--profile",1));
+}
+
+size_t Profiler::registerRegion(const char *name, ProfilePhase phase)
+{
+    Profiler &profiler=instance();
+    std::lock_guard<std::mutex> lock(profiler.mutex);
+    RegionInfo info;
+    info.name=name;
+    info.phase=phase;
+    profiler.regions.push_back(info);
+    return profiler.regions.size()-1;
+}
+
+size_t Profiler::registerCounter(const char *name)
+{
+    Profiler &profiler=instance();
+    std::lock_guard<std::mutex> lock(profiler.mutex);
+    for (size_t i=0; i<profiler.counterNames.size(); ++i)
+        if (profiler.counterNames[i]==name)
+            return i;
+    profiler.counterNames.push_back(name);
+    return profiler.counterNames.size()-1;
+}
+
+void Profiler::start(const FileName &fn, const String &format)
+{
+    if (format!="json" && format!="trace")
+        REPORT_ERROR(ERR_ARG_INCORRECT,"Unknown profile format "+format+", valid formats are json and trace");
+    clear();
+    fnOut=fn;
+    tracing=format=="trace";
+    done=false;
+    t0=std::chrono::steady_clock::now();
+    enabled=true;
+}
+
+ProfileThreadData *Profiler::threadData()
+{
+    if (profileThreadData==NULL)
+    {
+        ProfileThreadData *td=new ProfileThreadData;
+        td->current=0;
+        td->droppedEvents=0;
+        ProfileThreadData::Node root;
+        root.region=(size_t)-1;
+        root.parent=-1;
+        root.calls=0;
+        root.total=root.childTime=root.maxTime=0;
+        root.minTime=std::numeric_limits<double>::max();
+        td->nodes.push_back(root);
+        std::lock_guard<std::mutex> lock(mutex);
+        td->tid=(int)threads.size();
+        threads.push_back(td);
+        profileThreadData=td;
+    }
+    return profileThreadData;
+}
+
+void Profiler::enter(size_t region)
+{
+    ProfileThreadData *td=instance().threadData();
+    ProfileThreadData::Node &current=td->nodes[td->current];
+    int child=-1;
+    for (size_t n=0; n<current.children.size(); ++n)
+        if (td->nodes[current.children[n]].region==region)
+        {
+            child=current.children[n];
+            break;
+        }
+    if (child<0)
+    {
+        ProfileThreadData::Node node;
+        node.region=region;
+        node.parent=td->current;
+        node.calls=0;
+        node.total=node.childTime=node.maxTime=0;
+        node.minTime=std::numeric_limits<double>::max();
+        child=(int)td->nodes.size();
+        td->nodes[td->current].children.push_back(child);
+        td->nodes.push_back(node);
+    }
+    td->current=child;
+}
+
+void Profiler::leave(std::chrono::steady_clock::time_point tStart)
+{
+    std::chrono::steady_clock::time_point tEnd=std::chrono::steady_clock::now();
+    ProfileThreadData *td=profileThreadData;
+    if (td==NULL || td->current<=0)
+        return; // Profiling was started inside this scope
+    double dt=std::chrono::duration<double>(tEnd-tStart).count();
+    ProfileThreadData::Node &node=td->nodes[td->current];
+    node.calls++;
+    node.total+=dt;
+    node.minTime=XMIPP_MIN(node.minTime,dt);
+    node.maxTime=XMIPP_MAX(node.maxTime,dt);
+    if (tracing)
+    {
+        if (td->events.size()<maxEvents)
+        {
+            ProfileEvent event;
+            event.region=node.region;
+            event.start=std::chrono::duration<double>(tStart-instance().t0).count();
+            event.duration=dt;
+            td->events.push_back(event);
+        }
+        else
+            td->droppedEvents++;
+    }
+    td->current=node.parent;
+    td->nodes[td->current].childTime+=dt;
+}
+
+void Profiler::count(size_t counter, double n)
+{
+    ProfileThreadData *td=instance().threadData();
+    if (td->counters.size()<=counter)
+        td->counters.resize(counter+1,0.0);
+    td->counters[counter]+=n;
+}
+
+double Profiler::elapsed() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+}
+
+void Profiler::collect(std::vector<ProfileRecord> &records) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<String,ProfileRecord> merged;
+    std::vector<String> paths;
+    for (size_t t=0; t<threads.size(); ++t)
+    {
+        const std::vector<ProfileThreadData::Node> &nodes=threads[t]->nodes;
+        // Parents are always created before their children
+        paths.resize(nodes.size());
+        for (size_t n=1; n<nodes.size(); ++n)
+        {
+            const ProfileThreadData::Node &node=nodes[n];
+            const String &name=regions[node.region].name;
+            paths[n]=node.parent==0 ? name : paths[node.parent]+"/"+name;
+            if (node.calls==0)
+                continue;
+            std::map<String,ProfileRecord>::iterator it=merged.find(paths[n]);
+            if (it==merged.end())
+            {
+                ProfileRecord record;
+                record.path=paths[n];
+                record.phase=regions[node.region].phase;
+                record.calls=0;
+                record.total=record.self=record.maxTime=record.threadMax=0;
+                record.minTime=std::numeric_limits<double>::max();
+                record.threads=0;
+                it=merged.insert(std::make_pair(paths[n],record)).first;
+            }
+            ProfileRecord &record=it->second;
+            record.calls+=node.calls;
+            record.total+=node.total;
+            record.self+=node.total-node.childTime;
+            record.minTime=XMIPP_MIN(record.minTime,node.minTime);
+            record.maxTime=XMIPP_MAX(record.maxTime,node.maxTime);
+            record.threadMax=XMIPP_MAX(record.threadMax,node.total);
+            record.threads++;
+        }
+    }
+    records.clear();
+    for (std::map<String,ProfileRecord>::const_iterator it=merged.begin(); it!=merged.end(); ++it)
+        records.push_back(it->second);
+}
+
+void Profiler::collectCounters(std::map<String,double> &counters) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    counters.clear();
+    for (size_t t=0; t<threads.size(); ++t)
+        for (size_t c=0; c<threads[t]->counters.size(); ++c)
+            counters[counterNames[c]]+=threads[t]->counters[c];
+}
+
+String Profiler::serialize() const
+{
+    std::vector<ProfileRecord> records;
+    std::map<String,double> counters;
+    collect(records);
+    collectCounters(counters);
+
+    std::ostringstream out;
+    out << std::setprecision(12);
+    out << "W\t" << elapsed() << "\n";
+    for (size_t n=0; n<records.size(); ++n)
+    {
+        const ProfileRecord &r=records[n];
+        out << "R\t" << r.phase << "\t" << r.calls << "\t" << r.total << "\t" << r.self << "\t"
+        << r.minTime << "\t" << r.maxTime << "\t" << r.threadMax << "\t" << r.threads << "\t"
+        << r.path << "\n";
+    }
+    for (std::map<String,double>::const_iterator it=counters.begin(); it!=counters.end(); ++it)
+        out << "C\t" << it->second << "\t" << it->first << "\n";
+    if (tracing)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t t=0; t<threads.size(); ++t)
+        {
+            const ProfileThreadData *td=threads[t];
+            for (size_t e=0; e<td->events.size(); ++e)
+            {
+                const ProfileEvent &event=td->events[e];
+                out << "E\t" << td->tid << "\t" << event.start << "\t" << event.duration << "\t"
+                << regions[event.region].phase << "\t" << regions[event.region].name << "\n";
+            }
+            if (td->droppedEvents>0)
+                out << "C\t" << td->droppedEvents << "\tdropped trace events\n";
+        }
+    }
+    return out.str();
+}
+
+void Profiler::addRank(int rank, const String &data)
+{
+    RankData rankData;
+    rankData.rank=rank;
+    rankData.wall=0;
+    std::map<String,size_t> eventNameIdx;
+    std::istringstream in(data);
+    String line;
+    while (std::getline(in,line))
+    {
+        if (line.size()<2)
+            continue;
+        std::istringstream fields(line.substr(2));
+        switch (line[0])
+        {
+        case 'W':
+            fields >> rankData.wall;
+            break;
+        case 'R':
+            {
+                ProfileRecord r;
+                fields >> r.phase >> r.calls >> r.total >> r.self >> r.minTime >> r.maxTime
+                >> r.threadMax >> r.threads;
+                fields.get();
+                std::getline(fields,r.path);
+                rankData.records.push_back(r);
+                break;
+            }
+        case 'C':
+            {
+                double value;
+                String name;
+                fields >> value;
+                fields.get();
+                std::getline(fields,name);
+                rankData.counters[name]+=value;
+                break;
+            }
+        case 'E':
+            {
+                int tid, phase;
+                ProfileEvent event;
+                String name;
+                fields >> tid >> event.start >> event.duration >> phase;
+                fields.get();
+                std::getline(fields,name);
+                std::map<String,size_t>::iterator it=eventNameIdx.find(name);
+                if (it==eventNameIdx.end())
+                {
+                    it=eventNameIdx.insert(std::make_pair(name,rankData.eventNames.size())).first;
+                    rankData.eventNames.push_back(name);
+                    rankData.eventPhases.push_back(phase);
+                }
+                event.region=it->second;
+                rankData.events.push_back(std::make_pair(tid,event));
+                break;
+            }
+        }
+    }
+    ranks.push_back(rankData);
+}
+
+static String jsonString(const String &s)
+{
+    String out="\"";
+    for (size_t i=0; i<s.size(); ++i)
+    {
+        if (s[i]=='"' || s[i]=='\\')
+            out+='\\';
+        out+=s[i];
+    }
+    return out+"\"";
+}
+
+void Profiler::writeSummary(std::ostream &out) const
+{
+    // Merge the ranks by path
+    std::map<String,ProfileRecord> merged;
+    std::map<String,std::vector<double> > rankTotals;
+    std::map<String,double> counters;
+    double phaseSelf[PROFILE_NPHASES]={0,0,0,0,0};
+    double wall=0;
+    for (size_t r=0; r<ranks.size(); ++r)
+    {
+        const RankData &rank=ranks[r];
+        wall=XMIPP_MAX(wall,rank.wall);
+        for (size_t n=0; n<rank.records.size(); ++n)
+        {
+            const ProfileRecord &record=rank.records[n];
+            std::map<String,ProfileRecord>::iterator it=merged.find(record.path);
+            if (it==merged.end())
+                merged[record.path]=record;
+            else
+            {
+                ProfileRecord &m=it->second;
+                m.calls+=record.calls;
+                m.total+=record.total;
+                m.self+=record.self;
+                m.minTime=XMIPP_MIN(m.minTime,record.minTime);
+                m.maxTime=XMIPP_MAX(m.maxTime,record.maxTime);
+                m.threadMax=XMIPP_MAX(m.threadMax,record.threadMax);
+                m.threads+=record.threads;
+            }
+            rankTotals[record.path].push_back(record.total);
+            if (record.phase>=0 && record.phase<PROFILE_NPHASES)
+                phaseSelf[record.phase]+=record.self;
+        }
+        for (std::map<String,double>::const_iterator it=rank.counters.begin(); it!=rank.counters.end(); ++it)
+            counters[it->first]+=it->second;
+    }
+
+    out << std::setprecision(9);
+    out << "{\n";
+    out << "  \"wall_time\": " << wall << ",\n";
+    out << "  \"ranks\": " << ranks.size() << ",\n";
+    out << "  \"phases\": {";
+    for (int p=0; p<PROFILE_NPHASES; ++p)
+        out << (p==0 ? "\n" : ",\n") << "    " << jsonString(phaseNames[p]) << ": " << phaseSelf[p];
+    out << "\n  },\n";
+    out << "  \"regions\": [";
+    bool first=true;
+    for (std::map<String,ProfileRecord>::const_iterator it=merged.begin(); it!=merged.end(); ++it)
+    {
+        const ProfileRecord &r=it->second;
+        const std::vector<double> &totals=rankTotals[r.path];
+        double rankMin=totals[0], rankMax=totals[0], rankMean=0;
+        for (size_t n=0; n<totals.size(); ++n)
+        {
+            rankMin=XMIPP_MIN(rankMin,totals[n]);
+            rankMax=XMIPP_MAX(rankMax,totals[n]);
+            rankMean+=totals[n];
+        }
+        rankMean/=totals.size();
+        out << (first ? "\n" : ",\n") << "    {\"path\": " << jsonString(r.path)
+        << ", \"phase\": " << jsonString(r.phase>=0 && r.phase<PROFILE_NPHASES ? phaseNames[r.phase] : "unknown")
+        << ", \"calls\": " << r.calls
+        << ", \"total\": " << r.total
+        << ", \"self\": " << r.self
+        << ", \"min\": " << r.minTime
+        << ", \"max\": " << r.maxTime
+        << ", \"threads\": " << r.threads
+        << ", \"thread_max\": " << r.threadMax
+        << ", \"ranks\": " << totals.size()
+        << ", \"rank_min\": " << rankMin
+        << ", \"rank_max\": " << rankMax
+        << ", \"rank_mean\": " << rankMean << "}";
+        first=false;
+    }
+    out << "\n  ],\n";
+    out << "  \"counters\": {";
+    first=true;
+    for (std::map<String,double>::const_iterator it=counters.begin(); it!=counters.end(); ++it)
+    {
+        out << (first ? "\n" : ",\n") << "    " << jsonString(it->first) << ": " << it->second;
+        first=false;
+    }
+    out << "\n  }\n}\n";
+}
+
+void Profiler::writeTrace(std::ostream &out) const
+{
+    out << std::setprecision(12);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool first=true;
+    for (size_t r=0; r<ranks.size(); ++r)
+    {
+        const RankData &rank=ranks[r];
+        for (size_t e=0; e<rank.events.size(); ++e)
+        {
+            const ProfileEvent &event=rank.events[e].second;
+            int phase=rank.eventPhases[event.region];
+            out << (first ? "\n" : ",\n") << "{\"name\": " << jsonString(rank.eventNames[event.region])
+            << ", \"cat\": " << jsonString(phase>=0 && phase<PROFILE_NPHASES ? phaseNames[phase] : "unknown")
+            << ", \"ph\": \"X\", \"ts\": " << event.start*1e6 << ", \"dur\": " << event.duration*1e6
+            << ", \"pid\": " << rank.rank << ", \"tid\": " << rank.events[e].first << "}";
+            first=false;
+        }
+        for (std::map<String,double>::const_iterator it=rank.counters.begin(); it!=rank.counters.end(); ++it)
+        {
+            out << (first ? "\n" : ",\n") << "{\"name\": " << jsonString(it->first)
+            << ", \"ph\": \"C\", \"ts\": " << rank.wall*1e6 << ", \"pid\": " << rank.rank
+            << ", \"args\": {\"value\": " << it->second << "}}";
+            first=false;
+        }
+    }
+    out << "\n]}\n";
+}
+
+void Profiler::write()
+{
+    if (done)
+        return;
+    if (ranks.empty())
+        addRank(0,serialize());
+    enabled=false;
+    done=true;
+    std::ofstream fh(fnOut.c_str());
+    if (!fh)
+        REPORT_ERROR(ERR_IO_NOWRITE,fnOut);
+    if (tracing)
+        writeTrace(fh);
+    else
+        writeSummary(fh);
+}
+
+void Profiler::stop()
+{
+    enabled=false;
+    done=true;
+}
+
+void Profiler::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t t=0; t<threads.size(); ++t)
+    {
+        ProfileThreadData *td=threads[t];
+        td->nodes.resize(1);
+        td->nodes[0].children.clear();
+        td->nodes[0].childTime=0;
+        td->current=0;
+        td->counters.clear();
+        td->events.clear();
+        td->droppedEvents=0;
+    }
+    ranks.clear();
+}
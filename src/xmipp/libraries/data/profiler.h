@@ -0,0 +1,259 @@
+/***************************************************************************
+ *
+ * Authors:    Carlos Oscar Sanchez Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef _PROFILER_HH
+#define _PROFILER_HH
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <core/xmipp_filename.h>
+
+class XmippProgram;
+
+/**@defgroup Profiler Profiler
+   @ingroup DataLibrary */
+//@{
+
+/** Phases in which the profiled regions are classified */
+enum ProfilePhase
+{
+    PROFILE_IO,
+    PROFILE_FFT,
+    PROFILE_INTERPOLATION,
+    PROFILE_REDUCTION,
+    PROFILE_COMPUTE,
+    PROFILE_NPHASES
+};
+
+/** Statistics of a profiled region.
+ * Regions are identified by their path in the call tree (parent/child).
+ * Times are in seconds. total and self are summed over threads (and ranks),
+ * so they are thread-seconds; threadMax is the largest per-thread total.
+ */
+struct ProfileRecord
+{
+    String path;
+    int phase;
+    size_t calls;
+    double total, self, minTime, maxTime, threadMax;
+    size_t threads;
+};
+
+/** A timed interval of the Chrome trace */
+struct ProfileEvent
+{
+    size_t region;
+    double start, duration;
+};
+
+/** Per-thread profiling data */
+struct ProfileThreadData
+{
+    struct Node
+    {
+        size_t region;
+        int parent;
+        std::vector<int> children;
+        size_t calls;
+        double total, childTime, minTime, maxTime;
+    };
+    int tid;
+    int current;
+    std::vector<Node> nodes;
+    std::vector<double> counters;
+    std::vector<ProfileEvent> events;
+    size_t droppedEvents;
+};
+
+/** Hierarchical profiler with scoped timers and counters.
+ *
+ * The profiler is disabled by default and the cost of a disabled scope
+ * is a test of a global flag. When enabled, every thread accumulates
+ * the time of its regions in its own call tree, so no locks are taken in
+ * the timed code; trees are merged by path when the profile is written.
+ * MPI programs gather the profile of all ranks through MpiNode::gatherProfile.
+ *
+ * Programs enable it with the --profile parameter (see defineParams and
+ * readParams). Any program can also be profiled by setting the environment
+ * variable XMIPP_PROFILE=<file>[,trace]; a %p in the file name is replaced
+ * by the process id. The profile is written at exit if it has not been
+ * written before.
+ *
+ * @code
+ * void heavyFunction()
+ * {
+ *     XMIPP_PROFILE_SCOPE("heavyFunction", PROFILE_COMPUTE);
+ *     for (...)
+ *     {
+ *         XMIPP_PROFILE_SCOPE("fft", PROFILE_FFT);
+ *         transformer.FourierTransform();
+ *         XMIPP_PROFILE_COUNT("transforms", 1);
+ *     }
+ * }
+ * @endcode
+ */
+class Profiler
+{
+public:
+    /** Profiling is active.
+        It is read by the timed regions of every thread. */
+    static std::atomic<bool> enabled;
+    /** Keep the individual intervals for a Chrome trace */
+    static std::atomic<bool> tracing;
+    /** Maximum number of trace events kept per thread */
+    static size_t maxEvents;
+
+    /** The profiler of this process */
+    static Profiler &instance();
+
+    /** Define the --profile parameter in a program */
+    static void defineParams(XmippProgram *program);
+
+    /** Read the --profile parameter and start profiling if given */
+    static void readParams(XmippProgram *program);
+
+    /** Register a region. Thread safe, it is meant to be called once per
+     * region (see XMIPP_PROFILE_SCOPE). */
+    static size_t registerRegion(const char *name, ProfilePhase phase);
+
+    /** Register a counter. Thread safe. */
+    static size_t registerCounter(const char *name);
+
+    /** Start profiling. Format is json (summary) or trace (Chrome trace). */
+    void start(const FileName &fnOut, const String &format="json");
+
+    /** Enter a region in the calling thread */
+    static void enter(size_t region);
+
+    /** Leave the current region of the calling thread, that started at t0 */
+    static void leave(std::chrono::steady_clock::time_point t0);
+
+    /** Add to a counter in the calling thread */
+    static void count(size_t counter, double n);
+
+    /** Seconds since profiling started */
+    double elapsed() const;
+
+    /** Merge the trees of all threads of this process */
+    void collect(std::vector<ProfileRecord> &records) const;
+
+    /** Sum of the counters of all threads of this process */
+    void collectCounters(std::map<String,double> &counters) const;
+
+    /** Text serialization of this process profile (used to gather ranks) */
+    String serialize() const;
+
+    /** Add the serialized profile of a rank. If no rank is added, write
+     * uses the profile of this process as rank 0. */
+    void addRank(int rank, const String &data);
+
+    /** Write the profile to the output file and stop profiling */
+    void write();
+
+    /** Stop profiling without writing (e.g., MPI workers after gathering) */
+    void stop();
+
+    /** Forget all the data collected so far (regions are kept registered) */
+    void clear();
+
+protected:
+    Profiler();
+
+    ProfileThreadData *threadData();
+
+    void writeSummary(std::ostream &out) const;
+    void writeTrace(std::ostream &out) const;
+
+    struct RegionInfo
+    {
+        String name;
+        ProfilePhase phase;
+    };
+    struct RankData
+    {
+        int rank;
+        double wall;
+        std::vector<ProfileRecord> records;
+        std::map<String,double> counters;
+        std::vector<std::pair<int,ProfileEvent> > events;
+        std::vector<String> eventNames;
+        std::vector<int> eventPhases;
+    };
+
+    mutable std::mutex mutex;
+    std::vector<RegionInfo> regions;
+    std::vector<String> counterNames;
+    std::vector<ProfileThreadData *> threads;
+    std::vector<RankData> ranks;
+    std::chrono::steady_clock::time_point t0;
+    FileName fnOut;
+    bool done;
+};
+
+/** Times the enclosing scope as a region of the profiler */
+class ProfileScope
+{
+public:
+    explicit ProfileScope(size_t region): active(Profiler::enabled)
+    {
+        if (active)
+        {
+            Profiler::enter(region);
+            t0 = std::chrono::steady_clock::now();
+        }
+    }
+    ~ProfileScope()
+    {
+        if (active)
+            Profiler::leave(t0);
+    }
+private:
+    bool active;
+    std::chrono::steady_clock::time_point t0;
+};
+
+#define XMIPP_PROFILE_CONCAT2(a,b) a##b
+#define XMIPP_PROFILE_CONCAT(a,b) XMIPP_PROFILE_CONCAT2(a,b)
+
+/** Time the rest of the enclosing scope as a region with this name and phase */
+#define XMIPP_PROFILE_SCOPE(name, phase) \
+    static const size_t XMIPP_PROFILE_CONCAT(profileRegion_,__LINE__)=Profiler::registerRegion(name, phase); \
+    ProfileScope XMIPP_PROFILE_CONCAT(profileScope_,__LINE__)(XMIPP_PROFILE_CONCAT(profileRegion_,__LINE__))
+
+/** Add n to the counter with this name */
+#define XMIPP_PROFILE_COUNT(name, n) \
+    do { \
+        if (Profiler::enabled) \
+        { \
+            static const size_t profileCounter=Profiler::registerCounter(name); \
+            Profiler::count(profileCounter, n); \
+        } \
+    } while (0)
+//@}
+#endif
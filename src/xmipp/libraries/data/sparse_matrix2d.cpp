@@ -25,6 +25,7 @@
 
 
 #include "sparse_matrix2d.h"
+#include <thread>
 
 
 // Sparse matrices --------------------------------------------------------
@@ -69,6 +70,12 @@ SparseMatrix2D::SparseMatrix2D(std::vector<SparseElement> &_elements, int _Nelem
 			++i;
 		}
 	}
+	// Rows after the last nonzero value are empty
+	while (++actualRow < N)
+		DIRECT_MULTIDIM_ELEM(iIdx,actualRow) = 0;
+	// Zero values were not stored
+	values.resize(i);
+	jIdx.resize(i);
 }
 
 /*
@@ -151,6 +158,49 @@ void SparseMatrix2D::multMv(double* x, double* y)
     }
 }
 
+void SparseMatrix2D::getRowPointers(std::vector<size_t> &rowPtr) const
+{
+	rowPtr.resize(N+1);
+	rowPtr[N] = XSIZE(values);
+	for (int i = N-1; i >= 0; --i)
+	{
+		// Empty rows start where the next one does
+		int rowBeg = DIRECT_MULTIDIM_ELEM(iIdx,i);
+		rowPtr[i] = (rowBeg == 0) ? rowPtr[i+1] : (size_t)(rowBeg-1);
+	}
+}
+
+void SparseMatrix2D::multMv(const double* x, double* y, int Nthreads) const
+{
+	std::vector<size_t> rowPtr;
+	getRowPointers(rowPtr);
+	const double *ptrValues = MULTIDIM_ARRAY(values);
+	const int *ptrJ = MULTIDIM_ARRAY(jIdx);
+	auto multRows = [&](int i0, int iF)
+	{
+		for (int i = i0; i < iF; i++)
+		{
+			double val = 0.0;
+			for (size_t k = rowPtr[i]; k < rowPtr[i+1]; k++)
+				val += ptrValues[k] * x[ptrJ[k]-1];
+			y[i] = val;
+		}
+	};
+
+	int Nthr = XMIPP_MAX(1,XMIPP_MIN(Nthreads,N));
+	if (Nthr == 1)
+	{
+		multRows(0,N);
+		return;
+	}
+	std::vector<std::thread> threads;
+	for (int t = 1; t < Nthr; ++t)
+		threads.push_back(std::thread(multRows,(int)(((size_t)N*t)/Nthr),(int)(((size_t)N*(t+1))/Nthr)));
+	multRows(0,N/Nthr);
+	for (size_t t = 0; t < threads.size(); ++t)
+		threads[t].join();
+}
+
 /*
  * It shows the sparse matrix as a full matrix. If the sparse matrix is real big, you shoudn't use it
  * */
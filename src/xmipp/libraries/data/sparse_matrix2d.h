@@ -27,6 +27,7 @@
 #define SPARSE_MATRIX2D_H_
 
 #include <core/multidim_array.h>
+#include <vector>
 
 /** @ingroup Matrices
  */
@@ -105,6 +106,18 @@ public:
      */
     void multMv(double* x, double* y);
 
+    /** Computes y=this*x with several threads.
+     * y and x are vectors of size Nx1. Each thread computes a block of
+     * consecutive rows of y.
+     */
+    void multMv(const double* x, double* y, int Nthreads) const;
+
+    /** Positions of the rows in values.
+     * The elements of row i are in [rowPtr[i],rowPtr[i+1]) of values and
+     * jIdx (0-based). rowPtr has N+1 elements, and empty rows are supported.
+     */
+    void getRowPointers(std::vector<size_t> &rowPtr) const;
+
     /// Computes Y=this*X
     void multMM(const SparseMatrix2D &X, SparseMatrix2D &Y);
 
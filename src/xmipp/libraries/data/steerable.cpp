@@ -32,19 +32,32 @@
 
 // Remove wedge ------------------------------------------------------------
 void MissingWedge::removeWedge(MultidimArray<double> &V) const
+{
+    MultidimArray<double> measured;
+    getMeasuredRegion(V,measured);
+
+    FourierTransformer transformer;
+    MultidimArray< std::complex<double> > Vfft;
+    transformer.FourierTransform(V,Vfft,false);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(Vfft)
+        if (DIRECT_MULTIDIM_ELEM(measured,n)==0)
+            DIRECT_MULTIDIM_ELEM(Vfft,n)=0;
+    transformer.inverseFourierTransform();
+}
+
+// Measured region ---------------------------------------------------------
+void MissingWedge::getMeasuredRegion(const MultidimArray<double> &V,
+                                     MultidimArray<double> &measured) const
 {
     Matrix2D<double> Epos, Eneg;
     Euler_angles2matrix(rotPos,tiltPos,0,Epos);
     Euler_angles2matrix(rotNeg,tiltNeg,0,Eneg);
-    
+
     Matrix1D<double> freq(3), freqPos, freqNeg;
     Matrix1D<int> idx(3);
 
-    FourierTransformer transformer;
-    MultidimArray< std::complex<double> > Vfft;
-    transformer.FourierTransform(V,Vfft,false);
-
-    FOR_ALL_ELEMENTS_IN_ARRAY3D(Vfft)
+    measured.initZeros(ZSIZE(V),YSIZE(V),XSIZE(V)/2+1);
+    FOR_ALL_ELEMENTS_IN_ARRAY3D(measured)
     {
         // Frequency in the coordinate system of the volume
         VECTOR_R3(idx,j,i,k);
@@ -53,10 +66,9 @@ void MissingWedge::removeWedge(MultidimArray<double> &V) const
         // Frequency in the coordinate system of the plane
         freqPos=Epos*freq;
         freqNeg=Eneg*freq;
-        if (ZZ(freqPos)<0 || ZZ(freqNeg)>0)
-            Vfft(k,i,j)=0;
+        if (ZZ(freqPos)>=0 && ZZ(freqNeg)<=0)
+            A3D_ELEM(measured,k,i,j)=1;
     }
-    transformer.inverseFourierTransform();
 }
 
 // Constructor -------------------------------------------------------------
@@ -58,6 +58,11 @@ public:
 
     /// Remove wedge
     void removeWedge(MultidimArray<double> &V) const;
+
+    /** Measured region of the Fourier transform of V.
+        measured has the size of the (half) Fourier transform of V and it is 1
+        for the frequencies outside the wedge and 0 for those inside. */
+    void getMeasuredRegion(const MultidimArray<double> &V, MultidimArray<double> &measured) const;
 };
 
 /** Class for performing steerable filters */
@@ -241,7 +241,15 @@ void ProgTransformGeometry::processImage(const FileName &fnImg,
         imgOut.setDatatype(img.getDatatype());
         imgOut().resize(1, zdimOut, ydimOut, xdimOut, false);
         imgOut().setXmippOrigin();
-        applyGeometry(splineDegree, imgOut(), img(), T, IS_NOT_INV, wrap, 0.);
+        if (splineDegree == BSPLINE3)
+        {
+#define APPLYGEO(type) applyGeometryBSpline(*((MultidimArray<type>*)imgOut().im), \
+                                            *((MultidimArray<type>*)img().im), T, IS_NOT_INV, wrap, (type)0);
+            SWITCHDATATYPE(img().datatype, APPLYGEO);
+#undef APPLYGEO
+        }
+        else
+            applyGeometry(splineDegree, imgOut(), img(), T, IS_NOT_INV, wrap, 0.);
         imgOut.write(fnImgOut);
         rowOut.resetGeo(false);
     }
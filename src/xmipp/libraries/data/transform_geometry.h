@@ -33,6 +33,7 @@
 #include <core/xmipp_fftw.h>
 #include <core/xmipp_program.h>
 #include <core/matrix2d.h>
+#include "bspline_interpolation.h"
 
 
 class ProgTransformGeometry: public XmippMetadataProgram
@@ -285,6 +285,23 @@ void adaptive_soft_thresholding2D(MultidimArray< double >& I, int scale);
  */
 void DWT_keep_central_part(MultidimArray< double >& I, double R);
 
+/** Solve the equation system of the Bayesian, Wiener filtering.
+ *
+ * power, average and Ncoefs are the power, average and number of
+ * coefficients of the subbands at each scale. estimatedS returns the noise
+ * (first half) and signal (second half) power at each scale.
+ */
+void bayesian_solve_eq_system(const Matrix1D< double >& power,
+                              const Matrix1D< double >& average,
+                              const Matrix1D< double >& Ncoefs,
+                              double SNR0,
+                              double SNRF,
+                              double powerI,
+                              double power_rest,
+                              bool white_noise,
+                              int tell,
+                              Matrix1D< double >& estimatedS);
+
 /** Bayesian, Wiener filtering.
  *
  * Bijaoui, Signal Processing 2002, 82: 709-712. The Denoising procedure is
@@ -0,0 +1,500 @@
+/***************************************************************************
+ *
+ * Authors:    Carlos Oscar Sanchez Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include "wavelet_lifting.h"
+#include "wavelet.h"
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <core/xmipp_error.h>
+#include <core/xmipp_strings.h>
+
+// Lines transformed at the same time in a pass
+#define LIFTING_COLUMNS 32
+
+// Number of threads used for N tasks
+static size_t liftingThreads(size_t N, int Nthreads)
+{
+    size_t Nthr=(Nthreads<1) ? 1 : (size_t)Nthreads;
+    return XMIPP_MAX(1,XMIPP_MIN(Nthr,N));
+}
+
+// Run f(task,thread) for all tasks. The tasks are handed out one by one, so
+// that the threads are balanced even if the tasks have different sizes.
+template<typename F>
+static void liftingRunTasks(size_t Ntasks, size_t Nthr, F f)
+{
+    if (Nthr<=1)
+    {
+        for (size_t n=0; n<Ntasks; ++n)
+            f(n,(size_t)0);
+        return;
+    }
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> threads;
+    for (size_t t=0; t<Nthr; ++t)
+        threads.push_back(std::thread([&,t]()
+        {
+            size_t n;
+            while ((n=next++)<Ntasks)
+                f(n,t);
+        }));
+    for (size_t t=0; t<Nthr; ++t)
+        threads[t].join();
+}
+
+int liftingMaxLevels(size_t Xdim, size_t Ydim, size_t Zdim)
+{
+    int levels=-1;
+    size_t dims[3]={Xdim, Ydim, Zdim};
+    for (int d=0; d<3; ++d)
+    {
+        size_t n=dims[d];
+        if (n<=1)
+            continue;
+        int l=0;
+        while (n%2==0 && n>=4)
+        {
+            n/=2;
+            ++l;
+        }
+        levels=(levels<0) ? l : XMIPP_MIN(levels,l);
+    }
+    return XMIPP_MAX(levels,0);
+}
+
+// Number of levels to use for V
+template<typename T>
+static int liftingCheckLevels(const MultidimArray<T> &V, int levels)
+{
+    if (NSIZE(V)!=1)
+        REPORT_ERROR(ERR_MULTIDIM_DIM,"The lifting wavelet transform only works with single images or volumes");
+    int maxLevels=liftingMaxLevels(XSIZE(V),YSIZE(V),ZSIZE(V));
+    if (levels<0)
+        levels=maxLevels;
+    if (levels>maxLevels)
+        REPORT_ERROR(ERR_MULTIDIM_SIZE,formatString("The size of the image only allows %d levels of the wavelet transform",maxLevels));
+    return levels;
+}
+
+// Daubechies-4 lifting steps. The W columns of buf are w independent lines.
+// The first N/2 rows are the even samples (s) and the last N/2 the odd
+// ones (d), at the end they are the low pass and high pass coefficients.
+#define LIFTING_SQRT3 1.7320508075688772
+#define LIFTING_SQRT2 1.4142135623730951
+
+template<typename T>
+static void liftingForward(T *buf, size_t N, size_t W, size_t w)
+{
+    const T sqrt3=(T)LIFTING_SQRT3;
+    const T c1=(T)(LIFTING_SQRT3/4), c2=(T)((LIFTING_SQRT3-2)/4);
+    const T k1=(T)((LIFTING_SQRT3-1)/LIFTING_SQRT2), k2=(T)((LIFTING_SQRT3+1)/LIFTING_SQRT2);
+    size_t h=N/2;
+    T *s=buf, *d=buf+h*W;
+    for (size_t n=0; n<h; ++n)
+    {
+        T *sn=s+n*W;
+        const T *dn=d+n*W;
+        for (size_t v=0; v<w; ++v)
+            sn[v]+=sqrt3*dn[v];
+    }
+    for (size_t n=0; n<h; ++n)
+    {
+        const T *sn=s+n*W, *sp=s+((n+h-1)%h)*W;
+        T *dn=d+n*W;
+        for (size_t v=0; v<w; ++v)
+            dn[v]-=c1*sn[v]+c2*sp[v];
+    }
+    for (size_t n=0; n<h; ++n)
+    {
+        T *sn=s+n*W;
+        const T *dn=d+((n+1)%h)*W;
+        for (size_t v=0; v<w; ++v)
+            sn[v]-=dn[v];
+    }
+    for (size_t n=0; n<h; ++n)
+    {
+        T *sn=s+n*W, *dn=d+n*W;
+        for (size_t v=0; v<w; ++v)
+        {
+            sn[v]*=k1;
+            dn[v]*=k2;
+        }
+    }
+}
+
+template<typename T>
+static void liftingInverse(T *buf, size_t N, size_t W, size_t w)
+{
+    const T sqrt3=(T)LIFTING_SQRT3;
+    const T c1=(T)(LIFTING_SQRT3/4), c2=(T)((LIFTING_SQRT3-2)/4);
+    const T ik1=(T)(LIFTING_SQRT2/(LIFTING_SQRT3-1)), ik2=(T)(LIFTING_SQRT2/(LIFTING_SQRT3+1));
+    size_t h=N/2;
+    T *s=buf, *d=buf+h*W;
+    for (size_t n=0; n<h; ++n)
+    {
+        T *sn=s+n*W, *dn=d+n*W;
+        for (size_t v=0; v<w; ++v)
+        {
+            sn[v]*=ik1;
+            dn[v]*=ik2;
+        }
+    }
+    for (size_t n=0; n<h; ++n)
+    {
+        T *sn=s+n*W;
+        const T *dn=d+((n+1)%h)*W;
+        for (size_t v=0; v<w; ++v)
+            sn[v]+=dn[v];
+    }
+    for (size_t n=0; n<h; ++n)
+    {
+        const T *sn=s+n*W, *sp=s+((n+h-1)%h)*W;
+        T *dn=d+n*W;
+        for (size_t v=0; v<w; ++v)
+            dn[v]+=c1*sn[v]+c2*sp[v];
+    }
+    for (size_t n=0; n<h; ++n)
+    {
+        T *sn=s+n*W;
+        const T *dn=d+n*W;
+        for (size_t v=0; v<w; ++v)
+            sn[v]-=sqrt3*dn[v];
+    }
+}
+
+// Transform the lines of N samples (separated by axisStride) that start at
+// data+o*outerStride+v*vecStride, o<Nouter, v<Nvec
+template<typename T>
+static void liftingPass(T *data, size_t N, size_t axisStride,
+                        size_t Nvec, size_t vecStride,
+                        size_t Nouter, size_t outerStride,
+                        bool forward, int Nthreads)
+{
+    const size_t W=LIFTING_COLUMNS;
+    size_t Nchunks=(Nvec+W-1)/W;
+    size_t Ntasks=Nouter*Nchunks;
+    size_t Nthr=liftingThreads(Ntasks,Nthreads);
+    std::vector< std::vector<T> > buffers(Nthr);
+    for (size_t t=0; t<Nthr; ++t)
+        buffers[t].resize(N*W);
+    size_t h=N/2;
+    liftingRunTasks(Ntasks,Nthr,[&](size_t task, size_t thread)
+    {
+        T *buf=&buffers[thread][0];
+        size_t v0=(task%Nchunks)*W;
+        size_t w=XMIPP_MIN(W,Nvec-v0);
+        T *base=data+(task/Nchunks)*outerStride+v0*vecStride;
+
+        // The direct transform splits even and odd samples, the inverse one
+        // interleaves them back
+        for (size_t n=0; n<N; ++n)
+        {
+            size_t row=(forward && n%2==1) ? h+n/2 : (forward ? n/2 : n);
+            const T *src=base+n*axisStride;
+            T *dst=buf+row*W;
+            for (size_t v=0; v<w; ++v)
+                dst[v]=src[v*vecStride];
+        }
+        if (forward)
+            liftingForward(buf,N,W,w);
+        else
+            liftingInverse(buf,N,W,w);
+        for (size_t n=0; n<N; ++n)
+        {
+            size_t row=(!forward && n%2==1) ? h+n/2 : (forward ? n : n/2);
+            const T *src=buf+row*W;
+            T *dst=base+n*axisStride;
+            for (size_t v=0; v<w; ++v)
+                dst[v*vecStride]=src[v];
+        }
+    });
+}
+
+// One level of the transform on the low pass subband of the previous level
+template<typename T>
+static void liftingLevel(MultidimArray<T> &V, int level, bool forward, int Nthreads)
+{
+    T *data=MULTIDIM_ARRAY(V);
+    size_t Xdim=XSIZE(V), Ydim=YSIZE(V), Zdim=ZSIZE(V), YXdim=YXSIZE(V);
+    size_t nx=(Xdim>1) ? Xdim>>level : 1;
+    size_t ny=(Ydim>1) ? Ydim>>level : 1;
+    size_t nz=(Zdim>1) ? Zdim>>level : 1;
+    if (forward)
+    {
+        if (Xdim>1)
+            liftingPass(data,nx,1,ny,Xdim,nz,YXdim,true,Nthreads);
+        if (Ydim>1)
+            liftingPass(data,ny,Xdim,nx,1,nz,YXdim,true,Nthreads);
+        if (Zdim>1)
+            liftingPass(data,nz,YXdim,nx,1,ny,Xdim,true,Nthreads);
+    }
+    else
+    {
+        if (Zdim>1)
+            liftingPass(data,nz,YXdim,nx,1,ny,Xdim,false,Nthreads);
+        if (Ydim>1)
+            liftingPass(data,ny,Xdim,nx,1,nz,YXdim,false,Nthreads);
+        if (Xdim>1)
+            liftingPass(data,nx,1,ny,Xdim,nz,YXdim,false,Nthreads);
+    }
+}
+
+template<typename T>
+void liftingDWT(MultidimArray<T> &V, int levels, int Nthreads)
+{
+    levels=liftingCheckLevels(V,levels);
+    for (int l=0; l<levels; ++l)
+        liftingLevel(V,l,true,Nthreads);
+}
+
+template<typename T>
+void liftingIDWT(MultidimArray<T> &V, int levels, int Nthreads)
+{
+    levels=liftingCheckLevels(V,levels);
+    for (int l=levels-1; l>=0; --l)
+        liftingLevel(V,l,false,Nthreads);
+}
+
+// Bayesian Wiener filtering ----------------------------------------------
+// Piece of a subband. scale is -1 for the low pass subband of the coarsest
+// scale considered.
+struct LiftingBlock
+{
+    size_t x0, xF, y0, yF, z0, zF;
+    int scale;
+};
+
+// Subbands of the first scale_dim scales, split in slabs of about 64k
+// coefficients. The split does not depend on the number of threads, so
+// neither do the sums.
+static void liftingSubbandBlocks(size_t Xdim, size_t Ydim, size_t Zdim, int scale_dim,
+                                 std::vector<LiftingBlock> &blocks)
+{
+    size_t dims[3]={Xdim, Ydim, Zdim};
+    blocks.clear();
+    for (int j=0; j<scale_dim; ++j)
+        for (int q=0; q<8; ++q)
+        {
+            // q=0 is the low pass subband, only needed at the coarsest scale
+            if (q==0 && j!=scale_dim-1)
+                continue;
+            size_t x0[3], xF[3];
+            bool valid=true;
+            for (int d=0; d<3; ++d)
+            {
+                bool high=(q>>d)&1;
+                if (dims[d]<=1)
+                {
+                    valid=valid && !high;
+                    x0[d]=0;
+                    xF[d]=1;
+                }
+                else
+                {
+                    size_t half=dims[d]>>(j+1);
+                    x0[d]=high ? half : 0;
+                    xF[d]=high ? 2*half : half;
+                }
+            }
+            if (!valid)
+                continue;
+
+            LiftingBlock block;
+            block.x0=x0[0];
+            block.xF=xF[0];
+            block.scale=(q==0) ? -1 : j;
+            size_t rowSize=xF[0]-x0[0];
+            if (Zdim>1)
+            {
+                block.y0=x0[1];
+                block.yF=xF[1];
+                size_t Nslab=XMIPP_MAX(1,65536/(rowSize*(xF[1]-x0[1])));
+                for (size_t z=x0[2]; z<xF[2]; z+=Nslab)
+                {
+                    block.z0=z;
+                    block.zF=XMIPP_MIN(z+Nslab,xF[2]);
+                    blocks.push_back(block);
+                }
+            }
+            else
+            {
+                block.z0=0;
+                block.zF=1;
+                size_t Nrows=XMIPP_MAX(1,65536/rowSize);
+                for (size_t y=x0[1]; y<xF[1]; y+=Nrows)
+                {
+                    block.y0=y;
+                    block.yF=XMIPP_MIN(y+Nrows,xF[1]);
+                    blocks.push_back(block);
+                }
+            }
+        }
+}
+
+// Number of scales considered by the Bayesian filter
+template<typename T>
+static int liftingScaleDim(const MultidimArray<T> &WI, int allowed_scale)
+{
+    int maxLevels=liftingMaxLevels(XSIZE(WI),YSIZE(WI),ZSIZE(WI));
+    int scale_dim=XMIPP_MIN(allowed_scale+1,maxLevels);
+    if (scale_dim<1)
+        REPORT_ERROR(ERR_VALUE_INCORRECT,"bayesianWienerFiltering: there are no scales to denoise");
+    return scale_dim;
+}
+
+template<typename T>
+Matrix1D<double> bayesianWienerFiltering(MultidimArray<T> &WI, int allowed_scale,
+        double SNR0, double SNRF, bool white_noise, int tell, bool denoise, int Nthreads)
+{
+    int scale_dim=liftingScaleDim(WI,allowed_scale);
+    std::vector<LiftingBlock> blocks;
+    liftingSubbandBlocks(XSIZE(WI),YSIZE(WI),ZSIZE(WI),scale_dim,blocks);
+
+    // Power and sum of each block
+    size_t Nblocks=blocks.size();
+    std::vector<double> blockPower(Nblocks), blockSum(Nblocks);
+    liftingRunTasks(Nblocks,liftingThreads(Nblocks,Nthreads),[&](size_t b, size_t)
+    {
+        const LiftingBlock &block=blocks[b];
+        double power=0, sum=0;
+        for (size_t k=block.z0; k<block.zF; ++k)
+            for (size_t i=block.y0; i<block.yF; ++i)
+            {
+                const T *ptr=&DIRECT_A3D_ELEM(WI,k,i,0);
+                for (size_t j=block.x0; j<block.xF; ++j)
+                {
+                    double aux=ptr[j];
+                    power+=aux*aux;
+                    sum+=aux;
+                }
+            }
+        blockPower[b]=power;
+        blockSum[b]=sum;
+    });
+
+    // Power at each band and of the unconsidered part of the image
+    Matrix1D<double> power(scale_dim), average(scale_dim), Ncoefs(scale_dim);
+    double power_rest=0;
+    size_t Ncoefs_rest=0;
+    for (size_t b=0; b<Nblocks; ++b)
+    {
+        const LiftingBlock &block=blocks[b];
+        size_t N=(block.xF-block.x0)*(block.yF-block.y0)*(block.zF-block.z0);
+        if (block.scale<0)
+        {
+            power_rest+=blockPower[b];
+            Ncoefs_rest+=N;
+        }
+        else
+        {
+            VEC_ELEM(power,block.scale)+=blockPower[b];
+            VEC_ELEM(average,block.scale)+=blockSum[b];
+            VEC_ELEM(Ncoefs,block.scale)+=N;
+        }
+    }
+    for (int j=0; j<scale_dim; ++j)
+        VEC_ELEM(average,j)/=VEC_ELEM(Ncoefs,j);
+    double powerI=power.sum()+power_rest;
+
+    if (tell)
+    {
+        std::cout << "power= " << std::endl << power << "\n";
+        std::cout << "average= " << std::endl << average << "\n";
+        std::cout << "Ncoefs= " << std::endl << Ncoefs << "\n";
+        std::cout << "power_rest= " << power_rest << "\n";
+        std::cout << "Ncoefs_rest= " << Ncoefs_rest << "\n";
+        std::cout << "powerI= " << powerI << std::endl;
+    }
+
+    // Solve the equation system
+    Matrix1D<double> estimatedS;
+    bayesian_solve_eq_system(power, average, Ncoefs,
+                             SNR0, SNRF, powerI, power_rest, white_noise, tell, estimatedS);
+    if (tell)
+        std::cout << "estimatedS =\n" << estimatedS << std::endl;
+
+    if (denoise)
+        bayesianWienerFiltering(WI, allowed_scale, estimatedS, Nthreads);
+    return estimatedS;
+}
+
+template<typename T>
+void bayesianWienerFiltering(MultidimArray<T> &WI, int allowed_scale,
+                             const Matrix1D<double> &estimatedS, int Nthreads)
+{
+    int scale_dim=liftingScaleDim(WI,allowed_scale);
+    if (VEC_XSIZE(estimatedS)!=2*(size_t)scale_dim)
+        REPORT_ERROR(ERR_MATRIX_SIZE,"bayesianWienerFiltering: estimatedS does not correspond to the scales");
+    std::vector<LiftingBlock> blocks;
+    liftingSubbandBlocks(XSIZE(WI),YSIZE(WI),ZSIZE(WI),scale_dim,blocks);
+
+    size_t Nblocks=blocks.size();
+    liftingRunTasks(Nblocks,liftingThreads(Nblocks,Nthreads),[&](size_t b, size_t)
+    {
+        const LiftingBlock &block=blocks[b];
+        if (block.scale<0)
+            return;
+        double N=VEC_ELEM(estimatedS,block.scale);
+        double S=VEC_ELEM(estimatedS,block.scale+scale_dim);
+        double SN=S+N;
+        double S_N=S/SN;
+        double iSN=1.0/SN;
+        double iN=1.0/N;
+        bool clean=S<1e-6 && N<1e-6;
+        for (size_t k=block.z0; k<block.zF; ++k)
+            for (size_t i=block.y0; i<block.yF; ++i)
+            {
+                T *ptr=&DIRECT_A3D_ELEM(WI,k,i,0);
+                for (size_t j=block.x0; j<block.xF; ++j)
+                {
+                    if (clean)
+                    {
+                        ptr[j]=0;
+                        continue;
+                    }
+                    double y=ptr[j];
+                    double ymu2=-0.5*y*y;
+                    double expymu2SN=exp(ymu2*iSN);
+                    double den=exp(ymu2*iN)+expymu2SN;
+                    if (den>1e-10)
+                        ptr[j]=(T)(S_N*expymu2SN/den*y);
+                }
+            }
+    });
+}
+
+template void liftingDWT<float>(MultidimArray<float> &, int, int);
+template void liftingDWT<double>(MultidimArray<double> &, int, int);
+template void liftingIDWT<float>(MultidimArray<float> &, int, int);
+template void liftingIDWT<double>(MultidimArray<double> &, int, int);
+template Matrix1D<double> bayesianWienerFiltering<float>(MultidimArray<float> &, int,
+        double, double, bool, int, bool, int);
+template Matrix1D<double> bayesianWienerFiltering<double>(MultidimArray<double> &, int,
+        double, double, bool, int, bool, int);
+template void bayesianWienerFiltering<float>(MultidimArray<float> &, int,
+        const Matrix1D<double> &, int);
+template void bayesianWienerFiltering<double>(MultidimArray<double> &, int,
+        const Matrix1D<double> &, int);
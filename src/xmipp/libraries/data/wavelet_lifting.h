@@ -0,0 +1,95 @@
+/***************************************************************************
+ *
+ * Authors:    Carlos Oscar Sanchez Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef _WAVELET_LIFTING_HH
+#define _WAVELET_LIFTING_HH
+
+#include <core/multidim_array.h>
+#include <core/matrix1d.h>
+
+/**@defgroup WaveletLifting Lifting wavelet transform
+   @ingroup DataLibrary
+
+   Orthonormal Daubechies-4 wavelet transform computed with the lifting
+   scheme (Daubechies and Sweldens, J. Fourier Anal. Appl. 1998, 4: 247-269)
+   with periodic boundary conditions. The transform is done in place, in
+   float or double precision, and the coefficients are stored as in DWT: at
+   each level the low pass subband is in the first half of every dimension,
+   so that SelectDWTBlock, clean_quadrant3D, ... can be used on the result.
+
+   Each level is a separable pass along X, Y and Z. The lines of a pass are
+   processed in groups of contiguous columns (so that the lifting steps are
+   vectorized by the compiler) and the groups are distributed among threads.
+
+   @code
+   liftingDWT(V, -1, Nthreads);
+   bayesianWienerFiltering(V, 2, 0.1, 0.2, false, 0, true, Nthreads);
+   liftingIDWT(V, -1, Nthreads);
+   @endcode
+   @{
+*/
+
+/** Maximum number of levels of the lifting transform.
+ * Every dimension larger than 1 is halved at each level. As in DWT, the
+ * last level transforms lines of at least 4 samples.
+ */
+int liftingMaxLevels(size_t Xdim, size_t Ydim, size_t Zdim);
+
+/** Lifting wavelet transform in place.
+ * levels=-1 performs the maximum number of levels. All dimensions larger
+ * than 1 must be multiple of 2^levels. V must be a single image or volume.
+ */
+template<typename T>
+void liftingDWT(MultidimArray<T> &V, int levels=-1, int Nthreads=1);
+
+/** Inverse lifting wavelet transform in place.
+ * levels must be the one used for the direct transform.
+ */
+template<typename T>
+void liftingIDWT(MultidimArray<T> &V, int levels=-1, int Nthreads=1);
+
+/** Bayesian, Wiener filtering.
+ *
+ * Same as bayesian_wiener_filtering2D and bayesian_wiener_filtering3D, but the
+ * power of the subbands is computed in parallel, and the image may be float.
+ * The subbands are the ones of the transform with the maximum number of levels
+ * (liftingMaxLevels), the sizes need not be powers of 2. The result does not
+ * depend on the number of threads.
+ */
+template<typename T>
+Matrix1D<double> bayesianWienerFiltering(MultidimArray<T> &WI, int allowed_scale,
+        double SNR0 = 0.1, double SNRF = 0.2, bool white_noise = false,
+        int tell = 0, bool denoise = true, int Nthreads = 1);
+
+/** Bayesian, Wiener filtering.
+ *
+ * This is the function that really denoise. Each subband is processed in
+ * parallel.
+ */
+template<typename T>
+void bayesianWienerFiltering(MultidimArray<T> &WI, int allowed_scale,
+                             const Matrix1D<double> &estimatedS, int Nthreads = 1);
+//@}
+#endif
@@ -62,10 +62,11 @@ void DiffusionMaps::reduceDimensionality()
     FOR_ALL_ELEMENTS_IN_MATRIX2D(L2distance)
         MAT_ELEM(L2distance,i,j)/=VEC_ELEM(p,i)*VEC_ELEM(p,j);
 
-    // L2distance=U*S*V^t
-    Matrix2D<double> U,V;
+    // Leading eigenvectors of L2distance. It is symmetric and positive semidefinite,
+    // so they are also its leading singular vectors
+    Matrix2D<double> U;
     Matrix1D<double> S;
-    svdcmp(L2distance,U,S,V);
+    lanczosEigs(DenseSymmetricOperator(L2distance,Nthreads),0,outputDim,S,U,true);
 
     // Get columns 1 to outputDim of U as output
     // normalzied by the first element in its row
@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include "dimred_tools.h"
+#include <thread>
 
 void GenerateData::generateNewDataset(const DatasetType &type, int N, double noise)
 {
@@ -447,10 +448,367 @@ void extractNearestNeighbours(const Matrix2D<double> &X, Matrix2D<int> &idx, int
 	}
 }
 
+void DenseSymmetricOperator::multiply(const double *x, double *y) const
+{
+	int N=(int)MAT_YSIZE(A);
+	int Ncols=(int)MAT_XSIZE(A);
+	auto multRows = [&](int i0, int iF)
+	{
+		for (int i=i0; i<iF; ++i)
+		{
+			const double *ptrA=&MAT_ELEM(A,i,0);
+			double val=0.0;
+			for (int j=0; j<Ncols; ++j)
+				val+=ptrA[j]*x[j];
+			y[i]=val;
+		}
+	};
+
+	int Nthr=XMIPP_MAX(1,XMIPP_MIN(Nthreads,N));
+	std::vector<std::thread> threads;
+	for (int t=1; t<Nthr; ++t)
+		threads.push_back(std::thread(multRows,(int)(((size_t)N*t)/Nthr),(int)(((size_t)N*(t+1))/Nthr)));
+	multRows(0,N/Nthr);
+	for (size_t t=0; t<threads.size(); ++t)
+		threads[t].join();
+}
+
+/* Eigendecomposition of a small symmetric matrix by cyclic Jacobi rotations.
+ * T=Y*diag(d)*Y^t, the eigenvalues are not sorted. */
+static void symmetricJacobi(const Matrix2D<double> &T, Matrix1D<double> &d, Matrix2D<double> &Y)
+{
+	Matrix2D<double> A=T;
+	int n=(int)MAT_YSIZE(A);
+	Y.initIdentity(n);
+	for (int sweep=0; sweep<100; ++sweep)
+	{
+		double off=0, total=0;
+		for (int p=0; p<n; ++p)
+			for (int q=0; q<n; ++q)
+			{
+				double apq2=MAT_ELEM(A,p,q)*MAT_ELEM(A,p,q);
+				total+=apq2;
+				if (p!=q)
+					off+=apq2;
+			}
+		if (off<=1e-32*total)
+			break;
+
+		for (int p=0; p<n-1; ++p)
+			for (int q=p+1; q<n; ++q)
+			{
+				double apq=MAT_ELEM(A,p,q);
+				if (apq==0)
+					continue;
+				double theta=(MAT_ELEM(A,q,q)-MAT_ELEM(A,p,p))/(2*apq);
+				double t=1/(fabs(theta)+sqrt(theta*theta+1));
+				if (theta<0)
+					t=-t;
+				double c=1/sqrt(t*t+1);
+				double s=t*c;
+				for (int k=0; k<n; ++k)
+				{
+					double akp=MAT_ELEM(A,k,p), akq=MAT_ELEM(A,k,q);
+					MAT_ELEM(A,k,p)=c*akp-s*akq;
+					MAT_ELEM(A,k,q)=s*akp+c*akq;
+				}
+				for (int k=0; k<n; ++k)
+				{
+					double apk=MAT_ELEM(A,p,k), aqk=MAT_ELEM(A,q,k);
+					MAT_ELEM(A,p,k)=c*apk-s*aqk;
+					MAT_ELEM(A,q,k)=s*apk+c*aqk;
+				}
+				for (int k=0; k<n; ++k)
+				{
+					double ykp=MAT_ELEM(Y,k,p), ykq=MAT_ELEM(Y,k,q);
+					MAT_ELEM(Y,k,p)=c*ykp-s*ykq;
+					MAT_ELEM(Y,k,q)=s*ykp+c*ykq;
+				}
+			}
+	}
+	d.resizeNoCopy(n);
+	for (int i=0; i<n; ++i)
+		VEC_ELEM(d,i)=MAT_ELEM(A,i,i);
+}
+
+/* Orthogonalize w with respect to the first j rows of V (twice is enough)
+ * and accumulate the projection coefficients in h */
+static void orthogonalizeToRows(const Matrix2D<double> &V, size_t j, double *w, double *h)
+{
+	size_t N=MAT_XSIZE(V);
+	for (size_t i=0; i<j; ++i)
+		h[i]=0;
+	for (int pass=0; pass<2; ++pass)
+		for (size_t i=0; i<j; ++i)
+		{
+			const double *vi=&MAT_ELEM(V,i,0);
+			double c=0;
+			for (size_t n=0; n<N; ++n)
+				c+=vi[n]*w[n];
+			for (size_t n=0; n<N; ++n)
+				w[n]-=c*vi[n];
+			h[i]+=c;
+		}
+}
+
+static double vectorNorm(const double *w, size_t N)
+{
+	double norm2=0;
+	for (size_t n=0; n<N; ++n)
+		norm2+=w[n]*w[n];
+	return sqrt(norm2);
+}
+
+void lanczosEigs(const SymmetricOperator &A, size_t i0, size_t iF, Matrix1D<double> &D, Matrix2D<double> &P,
+		bool largest, double tol, int maxRestarts, size_t blockSize)
+{
+	size_t N=A.size();
+	if (i0>iF || iF>=N)
+		REPORT_ERROR(ERR_ARG_INCORRECT,"lanczosEigs: the eigenvalue indexes are out of range");
+
+	// Block size, size of the Krylov subspace and number of Ritz vectors kept
+	// at each restart
+	size_t K=iF+1;
+	size_t b=XMIPP_MIN(N,blockSize==0 ? K:blockSize);
+	size_t m=XMIPP_MIN(N,XMIPP_MAX(2*K+b+10,K+b+30));
+	size_t kk=m<N ? XMIPP_MIN(K+(m-K-b)/2,m-b-1) : K;
+
+	Matrix2D<double> V(m,N), R(b,N), T(m,m), Y;
+	Matrix1D<double> theta, w(N), h(m);
+	std::mt19937 g(42);
+	std::normal_distribution<> distGauss(0.0, 1.0);
+	double *ptrW=MATRIX1D_ARRAY(w);
+	double *ptrH=MATRIX1D_ARRAY(h);
+	auto randomVector = [&](size_t j)
+	{
+		double *vj=&MAT_ELEM(V,j,0);
+		for (size_t n=0; n<N; ++n)
+			vj[n]=distGauss(g);
+		orthogonalizeToRows(V,j,vj,ptrH);
+		double norm=vectorNorm(vj,N);
+		for (size_t n=0; n<N; ++n)
+			vj[n]/=norm;
+	};
+
+	// Make the row j of V the normalized w, or a random direction if w is
+	// (numerically) in the span of the previous rows
+	auto setRow = [&](size_t j, double beta, double scale)
+	{
+		if (beta<=1e-14*scale)
+			randomVector(j);
+		else
+		{
+			double *vj=&MAT_ELEM(V,j,0);
+			for (size_t n=0; n<N; ++n)
+				vj[n]=ptrW[n]/beta;
+		}
+	};
+
+	std::vector<size_t> order(m);
+	for (size_t j=0; j<b; ++j)
+		randomVector(j);
+	size_t j0=0;
+	double thetaMax=0;
+	for (int restart=0; ; ++restart)
+	{
+		// Extend the block Krylov basis up to m vectors. The row j+b is A
+		// times the row j orthogonalized to all the previous rows. The
+		// residuals of the last b rows are kept in R
+		for (size_t j=j0; j<m; ++j)
+		{
+			size_t jNew=j+b;
+			size_t Nrows=XMIPP_MIN(jNew,m);
+			A.multiply(&MAT_ELEM(V,j,0),ptrW);
+			orthogonalizeToRows(V,Nrows,ptrW,ptrH);
+			for (size_t i=0; i<Nrows; ++i)
+				MAT_ELEM(T,i,j)=MAT_ELEM(T,j,i)=ptrH[i];
+			if (jNew<m)
+				setRow(jNew,vectorNorm(ptrW,N),vectorNorm(ptrH,Nrows));
+			else
+				memcpy(&MAT_ELEM(R,jNew-m,0),ptrW,N*sizeof(double));
+		}
+
+		// Ritz pairs sorted from the wanted end of the spectrum
+		symmetricJacobi(T,theta,Y);
+		for (size_t i=0; i<m; ++i)
+			order[i]=i;
+		if (largest)
+			std::sort(order.begin(),order.end(),[&](size_t i1, size_t i2) { return VEC_ELEM(theta,i1)>VEC_ELEM(theta,i2); });
+		else
+			std::sort(order.begin(),order.end(),[&](size_t i1, size_t i2) { return VEC_ELEM(theta,i1)<VEC_ELEM(theta,i2); });
+
+		// The residual of the Ritz pair i is |sum_c Y(m-b+c,i) R_c|
+		thetaMax=0;
+		for (size_t i=0; i<m; ++i)
+			thetaMax=XMIPP_MAX(thetaMax,fabs(VEC_ELEM(theta,i)));
+		bool converged=true;
+		for (size_t k=i0; k<=iF && converged; ++k)
+		{
+			memset(ptrW,0,N*sizeof(double));
+			for (size_t c=0; c<b; ++c)
+			{
+				double yci=MAT_ELEM(Y,m-b+c,order[k]);
+				const double *rc=&MAT_ELEM(R,c,0);
+				for (size_t n=0; n<N; ++n)
+					ptrW[n]+=yci*rc[n];
+			}
+			converged=vectorNorm(ptrW,N)<=tol*thetaMax;
+		}
+		if (converged || m==N)
+			break;
+		if (restart==maxRestarts)
+			REPORT_ERROR(ERR_NUMERICAL,"lanczosEigs: the eigenvectors did not converge");
+
+		// Thick restart: keep the first kk Ritz vectors and the residual block
+		Matrix2D<double> Vkk(kk,N);
+		Vkk.initZeros();
+		for (size_t l=0; l<kk; ++l)
+		{
+			double *ptrVkk=&MAT_ELEM(Vkk,l,0);
+			for (size_t i=0; i<m; ++i)
+			{
+				double yil=MAT_ELEM(Y,i,order[l]);
+				const double *vi=&MAT_ELEM(V,i,0);
+				for (size_t n=0; n<N; ++n)
+					ptrVkk[n]+=yil*vi[n];
+			}
+		}
+		memcpy(&MAT_ELEM(V,0,0),&MAT_ELEM(Vkk,0,0),kk*N*sizeof(double));
+		for (size_t c=0; c<b; ++c)
+		{
+			memcpy(ptrW,&MAT_ELEM(R,c,0),N*sizeof(double));
+			orthogonalizeToRows(V,kk+c,ptrW,ptrH);
+			setRow(kk+c,vectorNorm(ptrW,N),thetaMax);
+		}
+		T.initZeros();
+		for (size_t l=0; l<kk; ++l)
+			MAT_ELEM(T,l,l)=VEC_ELEM(theta,order[l]);
+		j0=kk;
+	}
+
+	// Ritz vectors of the requested eigenvalues
+	size_t Nout=iF-i0+1;
+	D.resizeNoCopy(Nout);
+	P.initZeros(N,Nout);
+	for (size_t l=0; l<Nout; ++l)
+	{
+		size_t il=order[i0+l];
+		VEC_ELEM(D,l)=VEC_ELEM(theta,il);
+		for (size_t i=0; i<m; ++i)
+		{
+			double yil=MAT_ELEM(Y,i,il);
+			const double *vi=&MAT_ELEM(V,i,0);
+			for (size_t n=0; n<N; ++n)
+				MAT_ELEM(P,n,l)+=yil*vi[n];
+		}
+	}
+}
+
+void sparseMatrixFromElements(std::vector<SparseElement> &elements, int N, SparseMatrix2D &A, bool sumRepeated)
+{
+	std::sort(elements.begin(),elements.end());
+	std::vector<SparseElement> merged;
+	merged.reserve(elements.size());
+	for (size_t k=0; k<elements.size(); ++k)
+	{
+		const SparseElement &e=elements[k];
+		if (!merged.empty() && merged.back().i==e.i && merged.back().j==e.j)
+		{
+			if (sumRepeated)
+				merged.back().value+=e.value;
+		}
+		else
+			merged.push_back(e);
+	}
+	A=SparseMatrix2D(merged,N);
+}
+
+void computeSparseNeighbourSimilarity(const Matrix2D<double> &X, int K, double sigma, SparseMatrix2D &G, DimRedDistance2 f)
+{
+	Matrix2D<int> idx;
+	Matrix2D<double> kDistance;
+	kNearestNeighbours(X, K, idx, kDistance, f, false);
+	double maxDistance=kDistance.computeMax();
+	double iK=-0.5/(sigma*sigma*maxDistance);
+
+	std::vector<SparseElement> elements;
+	elements.reserve(2*MAT_XSIZE(kDistance)*MAT_YSIZE(kDistance));
+	SparseElement e;
+	FOR_ALL_ELEMENTS_IN_MATRIX2D(kDistance)
+	{
+		double d=MAT_ELEM(kDistance,i,j);
+		if (d==0)
+			continue;
+		e.value=exp(d*iK);
+		e.i=i;
+		e.j=MAT_ELEM(idx,i,j);
+		elements.push_back(e);
+		e.i=e.j;
+		e.j=i;
+		elements.push_back(e);
+	}
+	sparseMatrixFromElements(elements,MAT_YSIZE(X),G,false);
+}
+
+void computeSparseGraphLaplacian(const SparseMatrix2D &G, SparseMatrix2D &L, Matrix1D<double> &d)
+{
+	std::vector<size_t> rowPtr;
+	G.getRowPointers(rowPtr);
+	d.initZeros(G.N);
+	std::vector<SparseElement> elements;
+	elements.reserve(XSIZE(G.values)+G.N);
+	SparseElement e;
+	for (int i=0; i<G.N; ++i)
+	{
+		e.i=i;
+		for (size_t k=rowPtr[i]; k<rowPtr[i+1]; ++k)
+		{
+			double gij=DIRECT_MULTIDIM_ELEM(G.values,k);
+			VEC_ELEM(d,i)+=gij;
+			e.j=DIRECT_MULTIDIM_ELEM(G.jIdx,k)-1;
+			e.value=-gij;
+			elements.push_back(e);
+		}
+		e.j=i;
+		e.value=VEC_ELEM(d,i);
+		elements.push_back(e);
+	}
+	sparseMatrixFromElements(elements,G.N,L);
+}
+
+void sparseMatrixOperation_XtAX(const Matrix2D<double> &X, const SparseMatrix2D &A, Matrix2D<double> &XtAX)
+{
+	std::vector<size_t> rowPtr;
+	A.getRowPointers(rowPtr);
+	size_t dim=MAT_XSIZE(X);
+	XtAX.initZeros(dim,dim);
+
+	// XtAX=sum_i X_i^t (sum_j A_ij X_j)
+	Matrix1D<double> AXi(dim);
+	for (int i=0; i<A.N; ++i)
+	{
+		if (rowPtr[i]==rowPtr[i+1])
+			continue;
+		AXi.initZeros();
+		for (size_t k=rowPtr[i]; k<rowPtr[i+1]; ++k)
+		{
+			double aij=DIRECT_MULTIDIM_ELEM(A.values,k);
+			const double *ptrXj=&MAT_ELEM(X,DIRECT_MULTIDIM_ELEM(A.jIdx,k)-1,0);
+			for (size_t c=0; c<dim; ++c)
+				VEC_ELEM(AXi,c)+=aij*ptrXj[c];
+		}
+		const double *ptrXi=&MAT_ELEM(X,i,0);
+		for (size_t r=0; r<dim; ++r)
+			for (size_t c=0; c<dim; ++c)
+				MAT_ELEM(XtAX,r,c)+=ptrXi[r]*VEC_ELEM(AXi,c);
+	}
+}
+
 DimRedAlgorithm::DimRedAlgorithm()
 {
 	X=NULL;
 	distance=NULL;
+	Nthreads=1;
 }
 
 void DimRedAlgorithm::setInputData(Matrix2D<double> &X)
@@ -463,6 +821,11 @@ void DimRedAlgorithm::setOutputDimensionality(size_t outputDim)
 	this->outputDim=outputDim;
 }
 
+void DimRedAlgorithm::setThreads(int Nthreads)
+{
+	this->Nthreads=Nthreads;
+}
+
 const Matrix2D<double> &DimRedAlgorithm::getReducedData()
 {
 	return Y;
@@ -27,6 +27,7 @@
 
 #include <core/matrix2d.h>
 #include <core/matrix1d.h>
+#include <data/sparse_matrix2d.h>
 
 
 /**@defgroup DimRedTools Tools for dimensionality reduction
@@ -132,6 +133,97 @@ void kNearestNeighbours(const Matrix2D<double> &X, int K, Matrix2D<int> &idx, Ma
  */
 void extractNearestNeighbours(const Matrix2D<double> &X, Matrix2D<int> &idx, int i, Matrix2D<double> &Xi);
 
+/** Symmetric matrix seen through its product with a vector.
+ * This is the input of lanczosEigs, so that sparse matrices do not have
+ * to be made dense.
+ */
+class SymmetricOperator
+{
+public:
+	/// Destructor
+	virtual ~SymmetricOperator() {}
+
+	/// Size of the (square) matrix
+	virtual size_t size() const=0;
+
+	/// y=A*x
+	virtual void multiply(const double *x, double *y) const=0;
+};
+
+/** Sparse symmetric matrix. The products use Nthreads threads. */
+class SparseSymmetricOperator: public SymmetricOperator
+{
+public:
+	const SparseMatrix2D &A;
+	int Nthreads;
+public:
+	/// Constructor
+	SparseSymmetricOperator(const SparseMatrix2D &A, int Nthreads=1): A(A), Nthreads(Nthreads) {}
+
+	/// Size
+	size_t size() const { return A.N; }
+
+	/// y=A*x
+	void multiply(const double *x, double *y) const { A.multMv(x,y,Nthreads); }
+};
+
+/** Dense symmetric matrix. The products use Nthreads threads. */
+class DenseSymmetricOperator: public SymmetricOperator
+{
+public:
+	const Matrix2D<double> &A;
+	int Nthreads;
+public:
+	/// Constructor
+	DenseSymmetricOperator(const Matrix2D<double> &A, int Nthreads=1): A(A), Nthreads(Nthreads) {}
+
+	/// Size
+	size_t size() const { return MAT_YSIZE(A); }
+
+	/// y=A*x
+	void multiply(const double *x, double *y) const;
+};
+
+/** Partial eigendecomposition of a symmetric matrix.
+ * Computes the eigenvalues i0 to iF (both included) and their eigenvectors
+ * (columns of P) with a thick restarted block Lanczos algorithm that only
+ * needs the products of A with vectors. Indexes count from the smallest
+ * eigenvalue, or from the largest one if largest is true; the eigenvalues
+ * are returned in that order. With largest=false the result is the same
+ * as the one of eigsBetween, up to the sign of the eigenvectors (and a
+ * rotation within the eigenspaces of repeated eigenvalues).
+ * A Krylov block of blockSize vectors finds eigenvalues of multiplicity up to
+ * blockSize, as the null spaces of HLLE and LTSA, or the Laplacian of a graph
+ * with several connected components. By default (blockSize=0) the block has
+ * iF+1 vectors, so that all the requested eigenvalues may be repeated.
+ * The iterations stop when the residual of all the requested eigenpairs
+ * is below tol times the largest Ritz value.
+ */
+void lanczosEigs(const SymmetricOperator &A, size_t i0, size_t iF, Matrix1D<double> &D, Matrix2D<double> &P,
+		bool largest=false, double tol=1e-12, int maxRestarts=2000, size_t blockSize=0);
+
+/** Build a NxN sparse matrix from a list of elements.
+ * The list is sorted. Repeated elements are added if sumRepeated is true,
+ * otherwise only one of them is kept.
+ */
+void sparseMatrixFromElements(std::vector<SparseElement> &elements, int N, SparseMatrix2D &A, bool sumRepeated=true);
+
+/** Sparse similarity graph of the K nearest neighbours.
+ * G is the same matrix as the one computed by computeDistanceToNeighbours (squared
+ * distances) followed by computeSimilarityMatrix(G,sigma,true,true), but sparse.
+ */
+void computeSparseNeighbourSimilarity(const Matrix2D<double> &X, int K, double sigma, SparseMatrix2D &G, DimRedDistance2 f=NULL);
+
+/** Sparse graph laplacian.
+ * L=D-G where D is a diagonal matrix with the row sums of G, which are also returned in d.
+ */
+void computeSparseGraphLaplacian(const SparseMatrix2D &G, SparseMatrix2D &L, Matrix1D<double> &d);
+
+/** XtAX=X^t*A*X for a sparse symmetric matrix A.
+ * Each observation is a row of X.
+ */
+void sparseMatrixOperation_XtAX(const Matrix2D<double> &X, const SparseMatrix2D &A, Matrix2D<double> &XtAX);
+
 /** Generic class for dimensionality reduction */
 class DimRedAlgorithm
 {
@@ -150,6 +242,9 @@ public:
 
 	/// Save mapping
 	FileName fnMapping;
+
+	/// Number of threads for the matrix products of the eigensolvers
+	int Nthreads;
 public:
 	/// Empty constructor
 	DimRedAlgorithm();
@@ -160,6 +255,9 @@ public:
 	/// Set output dimensionality
 	void setOutputDimensionality(size_t outputDim);
 
+	/// Set number of threads
+	void setThreads(int Nthreads);
+
 	/// Reduce dimensionality
 	virtual void reduceDimensionality()=0;
 
@@ -37,10 +37,14 @@ void HessianLLE::reduceDimensionality()
 
     size_t sizeY = MAT_YSIZE(*X);
     size_t dp = outputDim * (outputDim+1)/2;
-    Matrix2D<double> weightMatrix, thisX, U, V, Vpr, Yi, Yi_complete, Yt, R, Pii;
+    Matrix2D<double> thisX, U, V, Vpr, Yi, Yi_complete, Yt, R, Pii;
     Matrix1D<double> D, vector;
 
-    weightMatrix.initZeros(dp*sizeY,sizeY);
+    // G=W^t*W is accumulated directly, each row of the weight matrix W
+    // only has nonzero values at the neighbours of an observation
+    std::vector<SparseElement> elements;
+    elements.reserve(sizeY*dp*kNeighbours*kNeighbours);
+    SparseElement e;
 
     for(size_t index=0; index<MAT_YSIZE(*X);++index)
     {
@@ -79,17 +83,21 @@ void HessianLLE::reduceDimensionality()
         		vector*=1.0/sum;
 
         	//Fill weight matrix
-          	for(int k = 0; k<kNeighbours; k++){
-        		size_t neighbourElem = MAT_ELEM(neighboursMatrix,index,k);
-        		MAT_ELEM(weightMatrix,index*dp+j,neighbourElem) = VEC_ELEM(vector,k);
+          	for(int k1 = 0; k1<kNeighbours; k1++){
+          		e.i = MAT_ELEM(neighboursMatrix,index,k1);
+          		for(int k2 = 0; k2<kNeighbours; k2++){
+          			e.j = MAT_ELEM(neighboursMatrix,index,k2);
+          			e.value = VEC_ELEM(vector,k1)*VEC_ELEM(vector,k2);
+          			elements.push_back(e);
+          		}
           	}
         }
     }
-  	Matrix2D<double> G;
-  	matrixOperation_AtA(weightMatrix,G);
+  	SparseMatrix2D G;
+  	sparseMatrixFromElements(elements,sizeY,G);
 
   	Matrix1D<double> v;
-  	eigsBetween(G,1,outputDim,v,Y);
+  	lanczosEigs(SparseSymmetricOperator(G,Nthreads),1,outputDim,v,Y);
   	Y*=sqrt(sizeY);
 }
 
@@ -34,19 +34,28 @@ void LaplacianEigenmap::setSpecificParameters(double sigma, size_t numberOfNeigh
 
 void LaplacianEigenmap::reduceDimensionality()
 {
-	Matrix2D<double> G,L,D;
-	Matrix1D<double> mappedX;
-	//Construct neighborhood graph
-	computeDistanceToNeighbours(*X,numberOfNeighbours,G,distance,false);
-	//Compute Gaussian kernel(heat kernel based weights)
-	computeSimilarityMatrix(G,sigma,true,true);
-	//Compute Laplacian
-	computeGraphLaplacian(G,L);
-	//Construct diagonal weight matrix
-	D.initZeros(MAT_YSIZE(G),MAT_YSIZE(G));
-	FOR_ALL_ELEMENTS_IN_MATRIX2D(G)
-		MAT_ELEM(D,i,i)+=MAT_ELEM(G,i,j);
+	//Construct neighborhood graph with Gaussian kernel(heat kernel based weights)
+	SparseMatrix2D G;
+	computeSparseNeighbourSimilarity(*X,numberOfNeighbours,sigma,G,distance);
+	//Construct diagonal weight matrix (D^-1/2)
+	std::vector<size_t> rowPtr;
+	G.getRowPointers(rowPtr);
+	Matrix1D<double> d;
+	d.initZeros(G.N);
+	for (int i=0; i<G.N; ++i)
+	{
+		for (size_t k=rowPtr[i]; k<rowPtr[i+1]; ++k)
+			VEC_ELEM(d,i)+=DIRECT_MULTIDIM_ELEM(G.values,k);
+		VEC_ELEM(d,i)=(VEC_ELEM(d,i)>0) ? 1/sqrt(VEC_ELEM(d,i)) : 0;
+	}
+	//L*y=lambda*D*y with L=D-G is solved as Gn*z=(1-lambda)*z with Gn=D^-1/2*G*D^-1/2 and
+	//y=D^-1/2*z, so only the largest eigenvalues of a sparse matrix are needed
+	for (int i=0; i<G.N; ++i)
+		for (size_t k=rowPtr[i]; k<rowPtr[i+1]; ++k)
+			DIRECT_MULTIDIM_ELEM(G.values,k)*=VEC_ELEM(d,i)*VEC_ELEM(d,DIRECT_MULTIDIM_ELEM(G.jIdx,k)-1);
 	//Construct eigenmaps
-	generalizedEigs(L,D,mappedX,Y);
-	keepColumns(Y,1,(int)outputDim);
+	Matrix1D<double> mappedX;
+	lanczosEigs(SparseSymmetricOperator(G,Nthreads),1,outputDim,mappedX,Y,true);
+	FOR_ALL_ELEMENTS_IN_MATRIX2D(Y)
+		MAT_ELEM(Y,i,j)*=VEC_ELEM(d,i);
 }
@@ -34,13 +34,13 @@ void eraseLastNColumns(Matrix2D<double> &A, int N)
 
 void LLTSA::reduceDimensionality()
 {
-	Matrix2D<double> B, XtBX, XtX;
+	SparseMatrix2D B;
+	Matrix2D<double> XtBX, XtX;
 	computeAlignmentMatrix(B);
 
     Matrix1D<double> DEigs;
-    matrixOperation_AtB(*X, B, XtBX);
+    sparseMatrixOperation_XtAX(*X, B, XtBX);
     matrixOperation_AtA(*X, XtX);
-    XtBX = XtBX * (*X);
     generalizedEigs(XtBX, XtX, DEigs, A);
     eraseLastNColumns(A, MAT_XSIZE(A) - outputDim);
     Y = *X * A;
@@ -36,20 +36,18 @@ void LPP::setSpecificParameters(int k, double sigma)
  */
 void LPP::reduceDimensionality()
 {
-	// Compute the distance to the k nearest neighbors
-	Matrix2D<double> D2;
-	computeDistanceToNeighbours(*X, k, D2, distance, false);
-
-	// Compute similarity matrix
-	computeSimilarityMatrix(D2,sigma,true,true);
+	// Compute the similarity matrix of the k nearest neighbors
+	SparseMatrix2D G;
+	computeSparseNeighbourSimilarity(*X, k, sigma, G, distance);
 
 	// Compute graph laplacian
-	Matrix2D<double> L;
-	computeGraphLaplacian(D2,L);
+	SparseMatrix2D L;
+	Matrix1D<double> d;
+	computeSparseGraphLaplacian(G,L,d);
 
 	Matrix2D<double> DP, LP;
-	matrixOperation_XtAX_symmetric(*X,D2,DP);
-	matrixOperation_XtAX_symmetric(*X,L,LP);
+	sparseMatrixOperation_XtAX(*X,G,DP);
+	sparseMatrixOperation_XtAX(*X,L,LP);
 
 	// Compute eigenvalues and eigenvectors resolving the generalized eigenvector problem
 	Matrix2D<double> Peigvec, eigvector;
@@ -53,7 +53,7 @@ void getLessWeightNColumns(const Matrix2D<double> &A, const Matrix1D<int> &weigh
             }
 }
 
-void LTSA::computeAlignmentMatrix(Matrix2D<double> &B)
+void LTSA::computeAlignmentMatrix(SparseMatrix2D &B)
 {
 	subtractColumnMeans(*X);
 
@@ -63,7 +63,9 @@ void LTSA::computeAlignmentMatrix(Matrix2D<double> &B)
 	kNearestNeighbours(*X, k, ni, D);
 	Matrix2D<double> Xi(MAT_XSIZE(ni), MAT_XSIZE(*X)), W, Vi, Vi2, Si, Gi;
 
-	B.initIdentity(n);
+	std::vector<SparseElement> elements;
+	elements.reserve(n*MAT_XSIZE(ni)*MAT_XSIZE(ni));
+	SparseElement e;
 	Matrix1D<int> weightVector;
 	for (size_t iLoop = 0; iLoop < n; ++iLoop)
 	{
@@ -84,16 +86,21 @@ void LTSA::computeAlignmentMatrix(Matrix2D<double> &B)
 
 		// Compute partial B with correlation matrix Gi
 		FOR_ALL_ELEMENTS_IN_MATRIX2D(Gi)
-			MAT_ELEM(B, MAT_ELEM(ni,iLoop,i), MAT_ELEM(ni,iLoop,j)) += MAT_ELEM(Gi, i, j);
-		MAT_ELEM(B, iLoop, iLoop)-=1;
+		{
+			e.i=MAT_ELEM(ni,iLoop,i);
+			e.j=MAT_ELEM(ni,iLoop,j);
+			e.value=MAT_ELEM(Gi, i, j);
+			elements.push_back(e);
+		}
 	}
+	sparseMatrixFromElements(elements,n,B);
 }
 
 void LTSA::reduceDimensionality()
 {
-	Matrix2D<double> B;
+	SparseMatrix2D B;
     computeAlignmentMatrix(B);
 
     Matrix1D<double> DEigs;
-    eigsBetween(B, 1, outputDim, DEigs, Y);
+    lanczosEigs(SparseSymmetricOperator(B,Nthreads), 1, outputDim, DEigs, Y);
 }
@@ -45,7 +45,7 @@ public:
 	virtual void reduceDimensionality();
 protected:
 	/// Common part
-	void computeAlignmentMatrix(Matrix2D<double> &B);
+	void computeAlignmentMatrix(SparseMatrix2D &B);
 };
 //@}
 #endif
@@ -39,6 +39,7 @@ void ProgDimRed::readParams()
     dimRefMethod = getParam("-m");
     outputDim  = getIntParam("--dout");
     dimEstMethod = getParam("--dout",1);
+    Nthreads = getIntParam("--thr");
 
     if (dimRefMethod=="LTSA" || dimRefMethod=="LLTSA" || dimRefMethod=="LPP" || dimRefMethod=="LE" || dimRefMethod=="HLLE" ||
     	dimRefMethod=="NPE" || dimRefMethod=="SPE")
@@ -65,6 +66,7 @@ void ProgDimRed::show()
         << "Output mapping:         " << fnMapping     << std::endl
         << "Dim Red Method:         " << dimRefMethod  << std::endl
         << "Dimension out:          " << outputDim     << std::endl
+        << "Number of threads:      " << Nthreads      << std::endl
         ;
     if (dimRefMethod=="LTSA" || dimRefMethod=="LLTSA" || dimRefMethod=="LPP" || dimRefMethod=="LE" || dimRefMethod=="HLLE" ||
     	dimRefMethod=="SPE" || dimRefMethod=="NPE")
@@ -101,6 +103,7 @@ void ProgDimRed::defineParams()
     addParamsLine("       where <method>");
     addParamsLine("                  CorrDim: Correlation dimension");
     addParamsLine("                  MLE: Maximum Likelihood Estimate");
+    addParamsLine("  [--thr <N=1>]           : Number of threads for the eigensolvers (LTSA, DM, LE, HLLE)");
     addParamsLine("  [--saveMapping <fn=\"\">] : Save mapping if available (PCA, LLTSA, LPP, pPCA, NPE) so that it can be reused later (Y=X*M)");
     addParamsLine("                            :+X is the input matrix with individuals as rows");
     addParamsLine("                            :+Y is the output matrix with individuals as rows");
@@ -155,6 +158,7 @@ void ProgDimRed::produceSideInfo()
     }
 
     algorithm->setOutputDimensionality(outputDim);
+    algorithm->setThreads(Nthreads);
     algorithm->fnMapping=fnMapping;
 }
 
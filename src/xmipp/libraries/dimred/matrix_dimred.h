@@ -55,6 +55,8 @@ public:
     FileName fnMapping;
     /** Output dimension */
     int outputDim;
+    /** Number of threads */
+    int Nthreads;
     /** Method */
     String dimRefMethod, dimEstMethod;
     /** Method parameters */
@@ -47,7 +47,7 @@ void NPE::reduceDimensionality()
 	Matrix2D<int> idx;
 	kNearestNeighbours(*X,k,idx,D,distance,false);
 
-	Matrix2D<double> W(k,n), Xi, C, M;
+	Matrix2D<double> W(k,n), Xi, C;
 	Matrix1D<double> wi;
 
 	PseudoInverseHelper h;
@@ -78,7 +78,15 @@ void NPE::reduceDimensionality()
 	}
 
 	//Find the sparse cost matrix
-	M.initIdentity(n);
+	std::vector<SparseElement> elements;
+	elements.reserve(n*(1+2*k+k*k));
+	SparseElement e;
+	for(int i=0;i<n; ++i)
+	{
+		e.i=e.j=i;
+		e.value=1;
+		elements.push_back(e);
+	}
 	Matrix1D<int> neighboursi;
 
 	for(int i=0;i<n; ++i)
@@ -93,22 +101,28 @@ void NPE::reduceDimensionality()
 		{
 			int j1=VEC_ELEM(neighboursi,p1); // j is the index of the neighbour
 			double w1=VEC_ELEM(wi,p1);
-			MAT_ELEM(M,i,j1)-=w1;
-			MAT_ELEM(M,j1,i)-=w1;
+			e.value=-w1;
+			e.i=i; e.j=j1;
+			elements.push_back(e);
+			e.i=j1; e.j=i;
+			elements.push_back(e);
 			for (size_t p2=0; p2<VEC_XSIZE(neighboursi); p2++)
 			{
-				int j2=VEC_ELEM(neighboursi,p2);
-				MAT_ELEM(M,j1,j2)+=w1*VEC_ELEM(wi,p2);
+				e.i=j1;
+				e.j=VEC_ELEM(neighboursi,p2);
+				e.value=w1*VEC_ELEM(wi,p2);
+				elements.push_back(e);
 			}
 
 		}
 	}
+	SparseMatrix2D M;
+	sparseMatrixFromElements(elements,n,M);
 
 	//Check symmetry
 	Matrix2D<double> DP, WP;
 
-	X->transpose();
-	matrixOperation_XtAX_symmetric(*X,M,WP);
+	sparseMatrixOperation_XtAX(*X,M,WP);
 	matrixOperation_AtA(*X, DP);
 
 	//Solve eigenvector problem
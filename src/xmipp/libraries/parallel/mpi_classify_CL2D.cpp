@@ -231,6 +231,13 @@ void CL2DClass::fitBasic(MultidimArray<double> &I, CL2DAssignment &result,
 	// Align the image with the node
     if (prm->alignImages)
     {
+		// The projection is transformed once for all the shift searches
+		transformerP.FourierTransform(P, FFTP, false);
+		MultidimArray<double> Mcorr;
+		Mcorr.resizeNoCopy(I);
+		STARTINGX(Mcorr)=STARTINGX(I);
+		STARTINGY(Mcorr)=STARTINGY(I);
+
 		double shiftXSR=INITIAL_SHIFT_THRESHOLD, shiftYSR=INITIAL_SHIFT_THRESHOLD, bestRotSR=INITIAL_ROTATE_THRESHOLD;
 		double shiftXRS=INITIAL_SHIFT_THRESHOLD, shiftYRS=INITIAL_SHIFT_THRESHOLD, bestRotRS=INITIAL_ROTATE_THRESHOLD;
 
@@ -240,10 +247,26 @@ void CL2DClass::fitBasic(MultidimArray<double> &I, CL2DAssignment &result,
 			if (((shiftXSR > SHIFT_THRESHOLD) || (shiftXSR < (-SHIFT_THRESHOLD))) ||
 				((shiftYSR > SHIFT_THRESHOLD) || (shiftYSR < (-SHIFT_THRESHOLD))))
 			{
-				bestShift(P, IauxSR, shiftXSR, shiftYSR, corrAux);
-				MAT_ELEM(ASR,0,2) += shiftXSR;
-				MAT_ELEM(ASR,1,2) += shiftYSR;
-				applyGeometry(LINEAR, IauxSR, I, ASR, IS_NOT_INV, WRAP);
+				if (i==0)
+				{
+					// IauxSR is still I, it is shifted in Fourier space
+					// with the transform used for the search
+					transformerI.FourierTransform(IauxSR, FFTI, false);
+					bestShift(FFTP, FFTI, Mcorr, shiftXSR, shiftYSR, corrAux);
+					MAT_ELEM(ASR,0,2) += shiftXSR;
+					MAT_ELEM(ASR,1,2) += shiftYSR;
+					shifter.initialize(YSIZE(I), XSIZE(I));
+					shifter.setShift(shiftXSR, shiftYSR);
+					shifter.apply(FFTI);
+					transformerI.inverseFourierTransform();
+				}
+				else
+				{
+					bestShift(P, FFTP, IauxSR, shiftXSR, shiftYSR, corrAux);
+					MAT_ELEM(ASR,0,2) += shiftXSR;
+					MAT_ELEM(ASR,1,2) += shiftYSR;
+					applyGeometry(LINEAR, IauxSR, I, ASR, IS_NOT_INV, WRAP);
+				}
 			}
 
 	#ifdef DEBUG_MORE
@@ -291,7 +314,7 @@ void CL2DClass::fitBasic(MultidimArray<double> &I, CL2DAssignment &result,
 			if (((shiftXRS > SHIFT_THRESHOLD) || (shiftXRS < (-SHIFT_THRESHOLD))) ||
 				((shiftYRS > SHIFT_THRESHOLD) || (shiftYRS < (-SHIFT_THRESHOLD))))
 			{
-				bestShift(P, IauxRS, shiftXRS, shiftYRS, corrAux);
+				bestShift(P, FFTP, IauxRS, shiftXRS, shiftYRS, corrAux);
 				MAT_ELEM(ARS,0,2) += shiftXRS;
 				MAT_ELEM(ARS,1,2) += shiftYRS;
 				applyGeometry(LINEAR, IauxRS, I, ARS, IS_NOT_INV, WRAP);
@@ -29,6 +29,7 @@
 #include <core/metadata.h>
 #include <core/metadata_extension.h>
 #include <data/polar.h>
+#include <data/fourier_shift.h>
 #include <core/xmipp_fftw.h>
 #include <core/histogram.h>
 #include <data/numerical_tools.h>
@@ -84,6 +85,15 @@ public:
     // Correlation aux
     CorrelationAux corrAux;
 
+    // Fourier transforms of the projection and of the image being fitted
+    MultidimArray< std::complex<double> > FFTP, FFTI;
+
+    // Transformers of the projection and of the image being fitted
+    FourierTransformer transformerP, transformerI;
+
+    // Shifter to translate the image in Fourier space
+    FourierShifter shifter;
+
     // Rotational correlation aux
     RotationalCorrelationAux rotAux;
 
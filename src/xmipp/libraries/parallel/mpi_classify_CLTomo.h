@@ -37,6 +37,7 @@
 #include <data/numerical_tools.h>
 #include <core/xmipp_program.h>
 #include <core/symmetries.h>
+#include <reconstruction/frm_rotational_search.h>
 #include <vector>
 
 /**@defgroup VQforVolumes Vector Quantization for Volumes
@@ -92,6 +93,10 @@ public:
     // Mask for experimental image as a python object
 	PyObject *pyIfourierMaskFRM;
 
+    // Centroid prepared for the native FRM pre-search (valid if PfrmValid)
+    FRMReference Pfrm;
+    bool PfrmValid;
+
     // Update for next iteration
     MultidimArray< std::complex<double> > Pupdate;
 
@@ -140,6 +145,13 @@ public:
         (2 iterations), to make it fit with the node. */
     void fitBasic(MultidimArray<double> &I, CL3DAssignment &result);
 
+    /** Align the input image with this node using the native FRM pre-search.
+        The best FRM rotations are refined with a translational search and
+        the one with the highest correlation is kept. A is the transformation
+        to apply on I to fit P. */
+    void alignFRMPresearch(MultidimArray<double> &I, CL3DAssignment &result,
+                           double &score, Matrix2D<double> &A);
+
     /// Look for K-nearest neighbours
     void lookForNeighbours(const std::vector<CL3DClass *> listP, int K);
 };
@@ -277,6 +289,12 @@ public:
     /// Don't align
     bool dontAlign;
 
+    /// Number of FRM rotations refined by the native pre-search (0=use the Python FRM)
+    int frmPresearch;
+
+    /// Native fast rotational search
+    FRMRotationalSearch frm;
+
     /// Generate aligned subvolumes
     bool generateAlignedVolumes;
 
@@ -95,6 +95,7 @@ CL3DClass::CL3DClass()
     Pupdate.initZeros(transformer.fFourier);
     PupdateMask.initZeros(Pupdate);
     pyIfourierMaskFRM=NULL;
+    PfrmValid=false;
     //weightSum=0;
 }
 
@@ -169,6 +170,7 @@ void CL3DClass::updateProjection(MultidimArray<double> &I,
 //#define DEBUG
 void CL3DClass::transferUpdate()
 {
+    PfrmValid=false;
     if (nextListImg.size() > 0)
     {
         // Take from Pupdate
@@ -331,7 +333,9 @@ void CL3DClass::fitBasic(MultidimArray<double> &I, CL3DAssignment &result)
     Matrix2D<double> A;
     double frmScore;
     constructFourierMask(I);
-    if (!prmCL3Dprog->dontAlign)
+    if (!prmCL3Dprog->dontAlign && prmCL3Dprog->frmPresearch>0)
+        alignFRMPresearch(I,result,frmScore,A);
+    else if (!prmCL3Dprog->dontAlign)
     {
         constructFourierMaskFRM();
 		alignVolumesFRM(prmCL3Dprog->frmFunc, P, I, pyIfourierMaskFRM, result.rot, result.tilt, result.psi, result.shiftx, result.shifty, result.shiftz,
@@ -371,6 +375,59 @@ void CL3DClass::fitBasic(MultidimArray<double> &I, CL3DAssignment &result)
 }
 #undef DEBUG
 
+/* Native FRM alignment ----------------------------------------------------- */
+void CL3DClass::alignFRMPresearch(MultidimArray<double> &I, CL3DAssignment &result,
+                                  double &score, Matrix2D<double> &A)
+{
+    const FRMRotationalSearch &frm=prmCL3Dprog->frm;
+    if (!PfrmValid)
+    {
+        frm.computeReference(P,Pfrm);
+        PfrmValid=true;
+    }
+
+    // Best rotations of the measured Fourier coefficients of I
+    MultidimArray<double> measured;
+    typeCast(IfourierMask,measured);
+    std::vector<FRMRotation> rotations;
+    frm.search(Pfrm,I,&measured,prmCL3Dprog->frmPresearch,rotations);
+
+    // Refine each of them with a translational search
+    const MultidimArray<int> &mask=prmCL3Dprog->mask.get_binary_mask();
+    Matrix2D<double> R, T, Acandidate;
+    Matrix1D<double> shift(3);
+    MultidimArray<double> Irot, Ialigned;
+    CorrelationAux aux;
+    A.initIdentity(4);
+    result.rot=result.tilt=result.psi=result.shiftx=result.shifty=result.shiftz=0.;
+    score=-1e38;
+    for (size_t n=0; n<rotations.size(); ++n)
+    {
+        const FRMRotation &rotation=rotations[n];
+        Euler_angles2matrix(rotation.rot,rotation.tilt,rotation.psi,R,true);
+        applyGeometry(LINEAR,Irot,I,R,IS_NOT_INV,DONT_WRAP);
+        bestShift(P,Irot,XX(shift),YY(shift),ZZ(shift),aux);
+        if (shift.module()>prmCL3Dprog->maxShift)
+            continue;
+        translation3DMatrix(shift,T);
+        Acandidate=T*R;
+        applyGeometry(LINEAR,Ialigned,I,Acandidate,IS_NOT_INV,DONT_WRAP);
+        double corr=correlationIndex(P,Ialigned,&mask);
+        if (corr>score)
+        {
+            score=corr;
+            A=Acandidate;
+            result.rot=rotation.rot;
+            result.tilt=rotation.tilt;
+            result.psi=rotation.psi;
+            // A=T(shift)*R=R*T(R^t shift), as in alignVolumesFRM
+            result.shiftx=MAT_ELEM(R,0,0)*XX(shift)+MAT_ELEM(R,1,0)*YY(shift)+MAT_ELEM(R,2,0)*ZZ(shift);
+            result.shifty=MAT_ELEM(R,0,1)*XX(shift)+MAT_ELEM(R,1,1)*YY(shift)+MAT_ELEM(R,2,1)*ZZ(shift);
+            result.shiftz=MAT_ELEM(R,0,2)*XX(shift)+MAT_ELEM(R,1,2)*YY(shift)+MAT_ELEM(R,2,2)*ZZ(shift);
+        }
+    }
+}
+
 /* Look for K neighbours in a list ----------------------------------------- */
 //#define DEBUG
 void CL3DClass::lookForNeighbours(const std::vector<CL3DClass *> listP, int K)
@@ -1039,6 +1096,7 @@ void CL3D::splitNode(CL3DClass *node, CL3DClass *&node1, CL3DClass *&node2,
         node2->neighboursIdx = node1->neighboursIdx = node->neighboursIdx;
         node1->P = node->P;
         node2->P = node->P;
+        node1->PfrmValid = node2->PfrmValid = false;
 
         size_t imax = node->currentListImg.size();
         if (imax < minAllowedSize)
@@ -1329,6 +1387,7 @@ void ProgClassifyCL3D::readParams()
     if (checkParam("--mask"))
         mask.readParams(this);
     dontAlign = checkParam("--dontAlign");
+    frmPresearch = getIntParam("--frmPresearch");
     generateAlignedVolumes = checkParam("--generateAlignedVolumes");
 
     prmCL3Dprog = this; // FIXME HACK because of the global variable. Solve it properly
@@ -1359,6 +1418,7 @@ void ProgClassifyCL3D::show() const
     << "Classify all images:     " << classifyAllImages << std::endl
     << "Symmetry:                " << fnSym << std::endl
     << "Don't align:             " << dontAlign << std::endl
+    << "FRM pre-search:          " << frmPresearch << std::endl
     << "Generate aligned volumes:" << generateAlignedVolumes << std::endl
     ;
     mask.show();
@@ -1397,6 +1457,8 @@ void ProgClassifyCL3D::defineParams()
     addParamsLine("   [--maxFreq <w=0.2>]       : Maximum frequency to be reconstructed");
     addParamsLine("   [--randomizeStartingOrientation] : Use this option to avoid aligning all missing wedges");
     addParamsLine("   [--dontAlign]             : Do not align volumes, only classify");
+    addParamsLine("   [--frmPresearch <N=0>]    : Align with the native FRM, refining the N best rotations with a shift search");
+    addParamsLine("                             : By default, the Python FRM is used");
     addParamsLine("   [--generateAlignedVolumes]: Generate aligned subvolumes at the end");
     Mask::defineParams(this,INT_MASK,NULL,NULL,true);
     addExampleLine("The MPI program as to be called through a python wrapper that encapsulates some path setting",false);
@@ -1433,6 +1495,10 @@ void ProgClassifyCL3D::produceSideInfo()
     		A3D_ELEM(maxFreqMask,k,i,j)=1;
     }
 
+    // Native fast rotational search
+    if (frmPresearch>0)
+        frm.setup(Xdim,maxFreq);
+
     // Prepare symmetry list
     SL.readSymmetryFile(fnSym);
 
@@ -34,6 +34,7 @@ MpiProgImageRotationalPCA::MpiProgImageRotationalPCA(int argc, char **argv)
 {
     node = new MpiNode(argc,argv);
     rank = node->rank;
+    Nprocessors = node->size;
     if (!IS_MASTER)
         verbose = 0;
 }
@@ -61,60 +62,11 @@ void MpiProgImageRotationalPCA::selectPartFromMd(MetaData &MDin)
   }
 }
 
-void MpiProgImageRotationalPCA::comunicateMatrix(Matrix2D<double> &W)
+void MpiProgImageRotationalPCA::reduceSums(Matrix2D<double> &sketch, Matrix1D<double> &sum, double &N)
 {
-    MPI_Bcast(&MAT_ELEM(W,0,0),MAT_XSIZE(W)*MAT_YSIZE(W),MPI_DOUBLE,0,MPI_COMM_WORLD);
-}
-
-void MpiProgImageRotationalPCA::createMutexes(size_t Nimgs)
-{
-  fileMutex = new MpiFileMutex(node);
-  threadMutex = new Mutex();
-  taskDistributor = new MpiTaskDistributor(Nimgs, XMIPP_MAX(1,Nimgs/(5*node->size)), node);
-}
-
-/** Last part of function applyT */
-void  MpiProgImageRotationalPCA::allReduceApplyT(Matrix2D<double> &Wnode_0)
-{
-    MPI_Allreduce(MPI_IN_PLACE, MATRIX2D_ARRAY(Wnode_0), MAT_XSIZE(Wnode_0)*MAT_YSIZE(Wnode_0),
+    MPI_Allreduce(MPI_IN_PLACE, MATRIX2D_ARRAY(sketch), MAT_XSIZE(sketch)*MAT_YSIZE(sketch),
         MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, MATRIX1D_ARRAY(sum), VEC_XSIZE(sum),
+        MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, &N, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
 }
-
-void MpiProgImageRotationalPCA::comunicateQrDim(int &qrDim)
-{
-  if (IS_MASTER)
-    ProgImageRotationalPCA::comunicateQrDim(qrDim);
-  node->barrierWait();
-  MPI_Bcast(&qrDim,1,MPI_INT,0,MPI_COMM_WORLD);
-}
-
-void MpiProgImageRotationalPCA::mapMatrix(int qrDim)
-{
-// Load the first qrDim columns of F in matrix H
-  if (IS_MASTER)
-  {
-    ProgImageRotationalPCA::mapMatrix(qrDim);
-    node->barrierWait();
-  }
-  else
-  {
-    node->barrierWait();
-    H.mapToFile(fnRoot+"_matrixH.raw",MAT_XSIZE(F),qrDim);
-  }
-}
-
-void MpiProgImageRotationalPCA::applySVD()
-{
-  if (IS_MASTER)
-    ProgImageRotationalPCA::applySVD();
-  node->barrierWait();
-}
-
-// Copy H to F ============================================================
-void MpiProgImageRotationalPCA::copyHtoF(int block)
-{
-  if (IS_MASTER)
-    ProgImageRotationalPCA::copyHtoF(block);
-  node->barrierWait();
-}
-
@@ -39,7 +39,6 @@ class MpiProgImageRotationalPCA: public ProgImageRotationalPCA
 public:
     // Mpi node
     MpiNode *node;
-    // H buffer
 
     /// Empty constructor
     MpiProgImageRotationalPCA(int argc, char **argv);
@@ -50,26 +49,8 @@ public:
     /** Read input images */
     virtual void selectPartFromMd(MetaData &MDin);
 
-    /** Comunicate matrix, only meanful for MPI */
-    virtual void comunicateMatrix(Matrix2D<double> &W);
-
-    /** Create mutexes and distributor */
-    virtual void createMutexes(size_t Nimgs);
-
-    /** Last part of function applyT */
-    virtual void allReduceApplyT(Matrix2D<double> &Wnode_0);
-
-    /** Comunicate int param */
-    virtual void comunicateQrDim(int &qrDim);
-
-    /** Map matrix */
-    virtual void mapMatrix(int qrDim);
-
-    /** Apply SVD */
-    virtual void applySVD();
-
-    /** Copy H to F. */
-    virtual void copyHtoF(int block);
+    /** Add the sums of the streaming PCA of all nodes */
+    virtual void reduceSums(Matrix2D<double> &sketch, Matrix1D<double> &sum, double &N);
 };
 //@}
 #endif
@@ -68,6 +68,8 @@ void ProgMPIRecFourier::readParams()
 {
     ProgRecFourier::readParams();
     mpi_job_size=getIntParam("--mpi_job_size");
+    // Workers only hold partial sums, the checkpoint is saved by rank 1 at the end
+    periodicCheckpoint=false;
 }
 
 /* Pre Run PreRun for all nodes but not for all works */
@@ -80,6 +82,7 @@ void ProgMPIRecFourier::preRun()
     {
         show();
         SF.read(fn_sel);
+        removeAccumulatedImages();
 
         //Send verbose level to node 1
         MPI_Send(&verbose, 1, MPI_INT, 1, TAG_SETVERBOSE, MPI_COMM_WORLD);
@@ -343,6 +346,7 @@ void ProgMPIRecFourier::run()
 
                         if ( nProcs > 2 )
                         {
+                            XMIPP_PROFILE_SCOPE("reduceVolume", PROFILE_REDUCTION);
                             // Receive from other workers
                             for ( size_t i = 2 ; i <= nProcs ; i++)
                             {
@@ -372,6 +376,7 @@ void ProgMPIRecFourier::run()
                                               &status );
 
                                     MPI_Get_count( &status, MPI_DOUBLE, &receivedSize );
+                                    XMIPP_PROFILE_COUNT("reduced bytes", receivedSize*sizeof(double));
 
                                     for ( int i = 0 ; i < receivedSize ; i ++ )
                                     {
@@ -431,9 +436,12 @@ void ProgMPIRecFourier::run()
                     std::cerr << "Wr" << node->rank << " " << "TAG_STOP" << std::endl;
 #endif
 
-                    MPI_Allreduce(MPI_IN_PLACE, fourierWeights,
-                                  sizeout, MPI_DOUBLE,
-                                  MPI_SUM, new_comm);
+                    {
+                        XMIPP_PROFILE_SCOPE("allreduceWeights", PROFILE_REDUCTION);
+                        MPI_Allreduce(MPI_IN_PLACE, fourierWeights,
+                                      sizeout, MPI_DOUBLE,
+                                      MPI_SUM, new_comm);
+                    }
                     /*if (iter != NiterWeight)
                 {
                         MPI_Allreduce(MPI_IN_PLACE, fourierWeights,
@@ -470,6 +478,7 @@ void ProgMPIRecFourier::run()
 
                         if ( nProcs > 1 )
                         {
+                            XMIPP_PROFILE_SCOPE("reduceVolume", PROFILE_REDUCTION);
                             // Receive from other workers
 
                             for (size_t i = 0 ; i <= (nProcs-2) ; i++)
@@ -501,6 +510,7 @@ void ProgMPIRecFourier::run()
                                               &status );
 
                                     MPI_Get_count( &status, MPI_DOUBLE, &receivedSize );
+                                    XMIPP_PROFILE_COUNT("reduced bytes", receivedSize*sizeof(double));
 
                                     for ( int i = 0 ; i < receivedSize ; i ++ )
                                     {
@@ -515,6 +525,9 @@ void ProgMPIRecFourier::run()
                         free( recBuffer );
                         if (iter==0)
                         {
+                            addAccumulators();
+                            if (!fn_checkpoint.empty())
+                                saveAccumulator(fn_checkpoint, (int)SF.size() - 1);
                             VoutFourierTmp=VoutFourier;
                             FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY3D(VoutFourier)
                             {
@@ -661,10 +674,12 @@ void ProgMPIRecFourier::run()
         iter++;
     }
     while(iter<NiterWeight);
+    node->gatherProfile();
 }
 
 int  ProgMPIRecFourier::sendDataInChunks( double * pointer, int dest, int totalSize, int buffSize, MPI_Comm comm )
 {
+    XMIPP_PROFILE_SCOPE("sendVolume", PROFILE_REDUCTION);
     double * localPointer = pointer;
 
     int numChunks =(int)ceil((double)totalSize/(double)buffSize);
@@ -247,6 +247,7 @@ void ProgMPIRecFourierAccel::run()
 				std::cerr << "Wr" << node->rank << " " << "TAG_STOP" << std::endl;
 #endif
 				for(int z = 0; z <= maxVolumeIndexYZ; z++) {
+					XMIPP_PROFILE_SCOPE("reduceVolume", PROFILE_REDUCTION);
 					for(int y = 0; y <= maxVolumeIndexYZ; y++) {
 						if (node->rank == 1) {
 							MPI_Reduce(MPI_IN_PLACE,&(tempVolume[z][y][0]),
@@ -305,4 +306,5 @@ void ProgMPIRecFourierAccel::run()
 		cleanLoadingThread();
 	}
 	delete[] ranks;
+	node->gatherProfile();
 }
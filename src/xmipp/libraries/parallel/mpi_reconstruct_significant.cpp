@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include "mpi_reconstruct_significant.h"
+#include <cstring>
 
 MpiProgReconstructSignificant::MpiProgReconstructSignificant()
 {
@@ -32,6 +33,9 @@ MpiProgReconstructSignificant::MpiProgReconstructSignificant()
 
 MpiProgReconstructSignificant::~MpiProgReconstructSignificant()
 {
+	// The shared windows must be released before finalizing MPI
+	for (size_t n=0; n<galleryMemory.size(); ++n)
+		delete galleryMemory[n];
 	delete node;
 }
 
@@ -107,3 +111,140 @@ void MpiProgReconstructSignificant::gatherAlignment()
 	synchronize();
 
 }
+
+// Make V point to an external buffer that it will not free
+template<typename T>
+static void aliasSharedMemory(MultidimArray<T> &V, T *ptr, size_t Ndim, size_t Ydim, size_t Xdim)
+{
+	V.clear();
+	V.setDimensions(Xdim,Ydim,1,Ndim);
+	V.nzyxdimAlloc=V.nzyxdim;
+	V.data=ptr;
+	V.destroyData=false;
+}
+
+// Forget the external buffer
+template<typename T>
+static void unaliasSharedMemory(MultidimArray<T> &V)
+{
+	if (!V.destroyData)
+	{
+		V.data=NULL;
+		V.clear();
+		V.destroyData=true;
+	}
+}
+
+void MpiProgReconstructSignificant::readGallery(int n, const FileName &fnGallery)
+{
+	if (galleryMemory.size()<=(size_t)n)
+		galleryMemory.resize(n+1,NULL);
+	if (galleryMemory[n]==NULL)
+		galleryMemory[n]=new MpiNodeSharedMemory(node);
+	MpiNodeSharedMemory &shared=*galleryMemory[n];
+
+	// The gallery of the previous iteration is still in the shared buffer
+	unaliasSharedMemory(gallery[n]());
+	unaliasSharedMemory(galleryInvariants[n]);
+	if (galleryTransforms[n]!=NULL)
+		for (size_t k=0; k<mdGallery[n].size(); ++k)
+		{
+			unaliasSharedMemory(galleryTransforms[n][k].FFTI);
+			Polar< std::complex<double> > &P=galleryTransforms[n][k].polarFourierI;
+			for (size_t i=0; i<P.rings.size(); ++i)
+				unaliasSharedMemory(P.rings[i]);
+		}
+
+	// The producer reads the gallery and tells the rest its layout:
+	// number of images, Ydim, Xdim, number of rings, invariant length and polar mode
+	size_t layout[6]={0,0,0,0,0,0};
+	double oversample=0;
+	std::vector<int> ringSize;
+	std::vector<double> ringRadius;
+	if (shared.isProducer())
+	{
+		ProgReconstructSignificant::readGallery(n,fnGallery);
+		const MultidimArray<double> &mGallery=gallery[n]();
+		layout[0]=NSIZE(mGallery);
+		layout[1]=YSIZE(mGallery);
+		layout[2]=XSIZE(mGallery);
+		layout[4]=XSIZE(galleryInvariants[n]);
+		if (layout[0]>0)
+		{
+			const Polar< std::complex<double> > &P=galleryTransforms[n][0].polarFourierI;
+			layout[3]=P.getRingNo();
+			layout[5]=P.mode;
+			oversample=P.oversample;
+			for (int i=0; i<P.getRingNo(); ++i)
+			{
+				ringSize.push_back(XSIZE(P.rings[i]));
+				ringRadius.push_back(P.ring_radius[i]);
+			}
+		}
+	}
+	shared.broadcast(layout,sizeof(layout));
+	shared.broadcast(&oversample,sizeof(oversample));
+	size_t Nimgs=layout[0], Ydim=layout[1], Xdim=layout[2], Nrings=layout[3], L=layout[4];
+	ringSize.resize(Nrings);
+	ringRadius.resize(Nrings);
+	if (Nrings>0)
+	{
+		shared.broadcast(&ringSize[0],Nrings*sizeof(int));
+		shared.broadcast(&ringRadius[0],Nrings*sizeof(double));
+	}
+
+	// Layout of the shared buffer: images, Fourier transforms, polar transforms and invariants
+	size_t XdimFourier=Xdim/2+1;
+	size_t imageSize=Ydim*Xdim, fourierSize=Ydim*XdimFourier, polarSize=0;
+	for (size_t i=0; i<Nrings; ++i)
+		polarSize+=ringSize[i];
+	size_t bytes=Nimgs*(imageSize*sizeof(double)+(fourierSize+polarSize)*sizeof(std::complex<double>)+
+	                    L*sizeof(double));
+	double *ptrImages=(double *)shared.allocate(bytes);
+	std::complex<double> *ptrFourier=(std::complex<double> *)(ptrImages+Nimgs*imageSize);
+	std::complex<double> *ptrPolar=ptrFourier+Nimgs*fourierSize;
+	double *ptrInvariants=(double *)(ptrPolar+Nimgs*polarSize);
+
+	if (galleryTransforms[n]==NULL)
+		galleryTransforms[n]=new AlignmentTransforms[Nimgs];
+	AlignmentTransforms *transforms=galleryTransforms[n];
+	if (shared.isProducer())
+	{
+		memcpy(ptrImages,MULTIDIM_ARRAY(gallery[n]()),Nimgs*imageSize*sizeof(double));
+		for (size_t k=0; k<Nimgs; ++k)
+		{
+			memcpy(ptrFourier+k*fourierSize,MULTIDIM_ARRAY(transforms[k].FFTI),
+			       fourierSize*sizeof(std::complex<double>));
+			std::complex<double> *ptrRing=ptrPolar+k*polarSize;
+			for (size_t i=0; i<Nrings; ++i)
+			{
+				memcpy(ptrRing,MULTIDIM_ARRAY(transforms[k].polarFourierI.rings[i]),
+				       ringSize[i]*sizeof(std::complex<double>));
+				ptrRing+=ringSize[i];
+			}
+		}
+		if (L>0)
+			memcpy(ptrInvariants,MULTIDIM_ARRAY(galleryInvariants[n]),Nimgs*L*sizeof(double));
+	}
+	shared.sync();
+
+	// All processes (including the producer, whose private copy is freed) use the shared copy
+	aliasSharedMemory(gallery[n](),ptrImages,Nimgs,Ydim,Xdim);
+	for (size_t k=0; k<Nimgs; ++k)
+	{
+		aliasSharedMemory(transforms[k].FFTI,ptrFourier+k*fourierSize,1,Ydim,XdimFourier);
+		Polar< std::complex<double> > &P=transforms[k].polarFourierI;
+		P.mode=(int)layout[5];
+		P.oversample=oversample;
+		P.ring_radius=ringRadius;
+		P.rings.resize(Nrings);
+		std::complex<double> *ptrRing=ptrPolar+k*polarSize;
+		for (size_t i=0; i<Nrings; ++i)
+		{
+			aliasSharedMemory(P.rings[i],ptrRing,1,1,ringSize[i]);
+			ptrRing+=ringSize[i];
+		}
+	}
+	if (L>0)
+		aliasSharedMemory(galleryInvariants[n],ptrInvariants,1,Nimgs,L);
+}
@@ -38,6 +38,9 @@ class MpiProgReconstructSignificant: public ProgReconstructSignificant
 {
 public:
 	MpiNode *node;
+
+	// Memory shared by the processes of a node with the gallery of each volume
+	std::vector<MpiNodeSharedMemory *> galleryMemory;
 public:
 	// Empty constructor
 	MpiProgReconstructSignificant();
@@ -53,6 +56,12 @@ public:
 
 	// Redefine how to gather the alignment
     void gatherAlignment();
+
+    /** Read the gallery in node shared memory.
+     * The first process of each node reads the gallery and computes its
+     * transforms, the rest of processes of the node use the same copy.
+     */
+    void readGallery(int n, const FileName &fnGallery);
 };
 //@}
 #endif
@@ -32,6 +32,57 @@ MpiTaskDistributor::MpiTaskDistributor(size_t nTasks, size_t bSize,
         ThreadTaskDistributor(nTasks, bSize)
 {
     this->node = node;
+    prefetch = true;
+    guided = true;
+    minBlockSize = 1;
+    pendingRequest = false;
+    pendingResponse = MPI_REQUEST_NULL;
+    waitTime = 0;
+    if (node->isMaster())
+        stats.resize(node->size);
+}
+
+MpiTaskDistributor::~MpiTaskDistributor()
+{
+    // A pending response can only exist if the worker did not consume all tasks
+    if (pendingRequest)
+        MPI_Wait(&pendingResponse, MPI_STATUS_IGNORE);
+}
+
+void MpiTaskDistributor::setPrefetch(bool prefetch)
+{
+    this->prefetch = prefetch;
+}
+
+void MpiTaskDistributor::setGuided(bool guided, size_t minBlockSize)
+{
+    this->guided = guided;
+    this->minBlockSize = XMIPP_MAX(1, minBlockSize);
+}
+
+const std::vector<MpiTaskStatistics>& MpiTaskDistributor::getStatistics() const
+{
+    return stats;
+}
+
+void MpiTaskDistributor::showStatistics(std::ostream &out) const
+{
+    if (!node->isMaster())
+        return;
+    out << "MPI task distribution (" << numberOfTasks << " tasks)" << std::endl
+        << "  rank   blocks    tasks   elapsed(s)   tasks/s   wait(s)" << std::endl;
+    size_t totalTasks = 0, totalBlocks = 0;
+    for (size_t rank = 1; rank < stats.size(); ++rank)
+    {
+        const MpiTaskStatistics &st = stats[rank];
+        double elapsed = (st.firstRequest < 0) ? 0 : st.lastRequest - st.firstRequest;
+        double throughput = (elapsed > 0) ? st.tasks / elapsed : 0;
+        out << formatString("  %4lu %8lu %8lu %12.3f %9.2f %9.3f", rank, st.blocks,
+                            st.tasks, elapsed, throughput, st.waitTime) << std::endl;
+        totalTasks += st.tasks;
+        totalBlocks += st.blocks;
+    }
+    out << formatString("  total %7lu %8lu", totalBlocks, totalTasks) << std::endl;
 }
 
 bool MpiTaskDistributor::distribute(size_t &first, size_t &last)
@@ -39,28 +90,70 @@ bool MpiTaskDistributor::distribute(size_t &first, size_t &last)
     return node->isMaster() ? distributeMaster() : distributeSlaves(first, last);
 }
 
+bool MpiTaskDistributor::distributeGuided(size_t &first, size_t &last)
+{
+    first = last = 0;
+    if (assignedTasks >= numberOfTasks)
+        return false;
+    size_t remaining = numberOfTasks - assignedTasks;
+    size_t bSize = blockSize;
+    if (guided)
+    {
+        // Each block is a fraction of the remaining work, so that the last
+        // blocks are small and the workers finish at the same time
+        size_t workers = XMIPP_MAX(1, node->size - 1);
+        size_t guidedSize = (remaining + 2 * workers - 1) / (2 * workers);
+        bSize = XMIPP_MIN(blockSize, XMIPP_MAX(minBlockSize, guidedSize));
+    }
+    bSize = XMIPP_MIN(bSize, remaining);
+    first = assignedTasks;
+    assignedTasks += bSize;
+    last = assignedTasks - 1;
+    return true;
+}
+
 bool MpiTaskDistributor::distributeMaster()
 {
     int size = node->size;
     size_t workBuffer[3];
+    double workerWait;
     MPI_Status status;
     int finalizedWorkers = 0;
 
     while (finalizedWorkers < size - 1)
     {
-        //wait for request form workers
-        MPI_Recv(0, 0, MPI_INT, MPI_ANY_SOURCE, TAG_WORK_REQUEST, MPI_COMM_WORLD, &status);
+        //wait for request form workers, they report the time they were waiting
+        MPI_Recv(&workerWait, 1, MPI_DOUBLE, MPI_ANY_SOURCE, TAG_WORK_REQUEST, MPI_COMM_WORLD, &status);
 
-        workBuffer[0] = ThreadTaskDistributor::distribute(workBuffer[1], workBuffer[2]) ? 1 : 0;
+        workBuffer[0] = distributeGuided(workBuffer[1], workBuffer[2]) ? 1 : 0;
 
+        MpiTaskStatistics &st = stats[status.MPI_SOURCE];
+        double now = MPI_Wtime();
+        if (st.firstRequest < 0)
+            st.firstRequest = now;
+        st.lastRequest = now;
+        st.waitTime += workerWait;
         if (workBuffer[0] == 0) //no more jobs, count finalized workers
             finalizedWorkers++;
+        else
+        {
+            st.blocks++;
+            st.tasks += workBuffer[2] - workBuffer[1] + 1;
+        }
         //send response (either task or finish answer)
         MPI_Send(workBuffer, 3, MPI_LONG_LONG_INT, status.MPI_SOURCE, TAG_WORK_RESPONSE, MPI_COMM_WORLD);
     }
     return false;
 }
 
+void MpiTaskDistributor::postRequest()
+{
+    MPI_Send(&waitTime, 1, MPI_DOUBLE, 0, TAG_WORK_REQUEST, MPI_COMM_WORLD);
+    waitTime = 0;
+    MPI_Irecv(prefetchBuffer, 3, MPI_LONG_LONG_INT, 0, TAG_WORK_RESPONSE, MPI_COMM_WORLD, &pendingResponse);
+    pendingRequest = true;
+}
+
 bool MpiTaskDistributor::distributeSlaves(size_t &first, size_t &last)
 {
   // Worker nodes should ask for task to master
@@ -68,16 +161,24 @@ bool MpiTaskDistributor::distributeSlaves(size_t &first, size_t &last)
   //   workBuffer[0] = 0 if no more jobs, 1 otherwise
   //   workBuffer[1] = first
   //   workBuffer[2] = last
-  size_t workBuffer[3];
-  MPI_Status status;
-  //any message from the master, is tag is TAG_STOP then stop
-  MPI_Send(0, 0, MPI_INT, 0, TAG_WORK_REQUEST, MPI_COMM_WORLD);
-  MPI_Recv(workBuffer, 3, MPI_LONG_LONG_INT, 0, TAG_WORK_RESPONSE, MPI_COMM_WORLD, &status);
-
-  first = workBuffer[1];
-  last = workBuffer[2];
-
-  return (workBuffer[0] == 1);
+  // With prefetching, the request for the next block was already posted
+  // when the current one was received
+  if (!pendingRequest)
+      postRequest();
+  double t0 = MPI_Wtime();
+  MPI_Wait(&pendingResponse, MPI_STATUS_IGNORE);
+  waitTime += MPI_Wtime() - t0;
+  pendingRequest = false;
+
+  first = prefetchBuffer[1];
+  last = prefetchBuffer[2];
+  bool moreTasks = (prefetchBuffer[0] == 1);
+
+  // Ask for the next block while this one is being processed
+  if (moreTasks && prefetch)
+      postRequest();
+
+  return moreTasks;
 }
 
 void MpiTaskDistributor::wait()
@@ -138,6 +239,99 @@ MpiFileMutex::~MpiFileMutex()
     }
 }
 
+// ================= NODE SHARED MEMORY ==========================
+MpiNodeSharedMemory::MpiNodeSharedMemory(MpiNode *node)
+{
+    hasWindow = false;
+    buffer = NULL;
+#if MPI_VERSION >= 3
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, (int)node->rank, MPI_INFO_NULL, &nodeComm);
+#else
+    // Each process is a node by itself
+    MPI_Comm_split(MPI_COMM_WORLD, (int)node->rank, 0, &nodeComm);
+#endif
+    int irank, isize;
+    MPI_Comm_rank(nodeComm, &irank);
+    MPI_Comm_size(nodeComm, &isize);
+    nodeRank = irank;
+    nodeSize = isize;
+}
+
+MpiNodeSharedMemory::~MpiNodeSharedMemory()
+{
+    release();
+    MPI_Comm_free(&nodeComm);
+}
+
+void *MpiNodeSharedMemory::allocate(size_t bytes)
+{
+    release();
+#if MPI_VERSION >= 3
+    // The whole buffer is allocated by the producer, the rest ask for 0 bytes
+    MPI_Aint size = isProducer() ? (MPI_Aint)bytes : 0;
+    if (MPI_Win_allocate_shared(size, 1, MPI_INFO_NULL, nodeComm, &buffer, &win) != MPI_SUCCESS)
+        REPORT_ERROR(ERR_MEM_NOTENOUGH, formatString("MpiNodeSharedMemory: cannot allocate %lu bytes", bytes));
+    hasWindow = true;
+    // Passive epoch during the life of the window so that MPI_Win_sync can be used
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, win);
+    if (!isProducer())
+    {
+        MPI_Aint producerSize;
+        int dispUnit;
+        MPI_Win_shared_query(win, 0, &producerSize, &dispUnit, &buffer);
+    }
+#else
+    buffer = malloc(bytes);
+    if (buffer == NULL && bytes > 0)
+        REPORT_ERROR(ERR_MEM_NOTENOUGH, formatString("MpiNodeSharedMemory: cannot allocate %lu bytes", bytes));
+#endif
+    return buffer;
+}
+
+void MpiNodeSharedMemory::release()
+{
+#if MPI_VERSION >= 3
+    if (hasWindow)
+    {
+        MPI_Win_unlock_all(win);
+        MPI_Win_free(&win);
+    }
+#else
+    free(buffer);
+#endif
+    hasWindow = false;
+    buffer = NULL;
+}
+
+void *MpiNodeSharedMemory::getBuffer() const
+{
+    return buffer;
+}
+
+bool MpiNodeSharedMemory::isProducer() const
+{
+    return nodeRank == 0;
+}
+
+void MpiNodeSharedMemory::sync()
+{
+#if MPI_VERSION >= 3
+    // Make the stores of the producer visible to the rest of processes
+    if (hasWindow)
+        MPI_Win_sync(win);
+    MPI_Barrier(nodeComm);
+    if (hasWindow)
+        MPI_Win_sync(win);
+#else
+    MPI_Barrier(nodeComm);
+#endif
+}
+
+void MpiNodeSharedMemory::broadcast(void *data, size_t bytes)
+{
+    MPI_Bcast(data, (int)bytes, MPI_BYTE, 0, nodeComm);
+}
+
 //------------ MPI ---------------------------
 MpiNode::MpiNode(int &argc, char **& argv)
 {
@@ -229,6 +423,40 @@ void MpiNode::gatherMetadatas(MetaData &MD, const FileName &rootname)
     }
 }
 
+void MpiNode::gatherProfile()
+{
+    Profiler &profiler = Profiler::instance();
+    // All ranks have the same command line, so all of them agree on this
+    if (!Profiler::enabled)
+        return;
+
+    String local = profiler.serialize();
+    int localSize = (int)local.size();
+    std::vector<int> sizes(size), displs(size);
+    MPI_Gather(&localSize, 1, MPI_INT, &sizes[0], 1, MPI_INT, 0, MPI_COMM_WORLD);
+    std::vector<char> buffer(1);
+    if (isMaster())
+    {
+        size_t total = 0;
+        for (size_t r = 0; r < size; ++r)
+        {
+            displs[r] = (int)total;
+            total += sizes[r];
+        }
+        buffer.resize(XMIPP_MAX(total, 1));
+    }
+    MPI_Gatherv((void *)local.c_str(), localSize, MPI_CHAR, &buffer[0], &sizes[0],
+                &displs[0], MPI_CHAR, 0, MPI_COMM_WORLD);
+    if (isMaster())
+    {
+        for (size_t r = 0; r < size; ++r)
+            profiler.addRank((int)r, String(&buffer[displs[r]], sizes[r]));
+        profiler.write();
+    }
+    else
+        profiler.stop();
+}
+
 /* -------------------- XmippMPIProgram ---------------------- */
 
 XmippMpiProgram::XmippMpiProgram()
@@ -287,6 +515,7 @@ MpiMetadataProgram::MpiMetadataProgram()
 {
     node = NULL;
     distributor = NULL;
+    mpiStats = false;
 }
 
 MpiMetadataProgram::~MpiMetadataProgram()
@@ -305,11 +534,16 @@ void MpiMetadataProgram::defineParams()
 {
     addParamsLine("== MPI ==");
     addParamsLine(" [--mpi_job_size <size=0>]     : Number of images sent simultaneously to a mpi node");
+    addParamsLine("                               : Blocks are smaller than this towards the end of the job");
+    addParamsLine(" [--mpi_stats]                 : Show the number of images processed per second by each node");
+    Profiler::defineParams(this);
 }
 
 void MpiMetadataProgram::readParams()
 {
     blockSize = getIntParam("--mpi_job_size");
+    mpiStats = checkParam("--mpi_stats");
+    Profiler::readParams(this);
 }
 
 void MpiMetadataProgram::createTaskDistributor(MetaData &mdIn,
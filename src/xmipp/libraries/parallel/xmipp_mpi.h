@@ -32,9 +32,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
+#include <vector>
 
 #include <core/xmipp_threads.h>
 #include <core/xmipp_program.h>
+#include <data/profiler.h>
 
 #define XMIPP_MPI_SIZE_T MPI_UNSIGNED_LONG
 
@@ -64,6 +66,13 @@ public:
     /** Gather metadatas */
     void gatherMetadatas(MetaData &MD, const FileName &rootName);
 
+    /** Gather the profile of all the nodes in the master and write it.
+     * It is collective and does nothing if profiling is not enabled.
+     * The profile of each rank is merged by region path, keeping the
+     * minimum, maximum and mean time over ranks.
+     */
+    void gatherProfile();
+
     /** Update the MPI communicator to connect the currently active nodes */
 //    void updateComm();
 
@@ -81,10 +90,32 @@ protected:
 #define TAG_WORK_REQUEST 100
 #define TAG_WORK_RESPONSE 101
 
+/** Throughput statistics of a worker as seen by the MpiTaskDistributor */
+struct MpiTaskStatistics
+{
+    /** Number of blocks given to the worker */
+    size_t blocks;
+    /** Number of tasks given to the worker */
+    size_t tasks;
+    /** Time (MPI_Wtime) of the first and last request of the worker */
+    double firstRequest, lastRequest;
+    /** Time the worker was blocked waiting for a response (reported by the worker) */
+    double waitTime;
+
+    MpiTaskStatistics(): blocks(0), tasks(0), firstRequest(-1), lastRequest(-1), waitTime(0) {}
+};
+
 /** This class is another implementation of ParallelTaskDistributor with MPI workers.
  * It extends from ThreadTaskDistributor and adds the MPI call
  * for making the distribution and extra locking mechanisms among
  * MPI nodes.
+ *
+ * Workers prefetch: as soon as a block is received, the request for the next
+ * one is posted, so that the round-trip to the master overlaps with the
+ * processing of the current block. The block size given at construction is
+ * an upper bound; blocks shrink towards the end of the run (guided
+ * scheduling) so that all workers finish at about the same time.
+ * The master keeps per-rank statistics that can be shown with showStatistics.
  */
 class MpiTaskDistributor: public ThreadTaskDistributor
 {
@@ -95,11 +126,31 @@ protected:
 
 public:
     MpiTaskDistributor(size_t nTasks, size_t bSize, MpiNode *node);
+    /** Destructor */
+    ~MpiTaskDistributor();
     /** All nodes wait until distribution is done.
      * In particular, the master node should wait for the distribution thread.
      */
     void wait();
 
+    /** Enable or disable the prefetching of the next block in workers.
+     * It must be set with the same value in all the nodes and before
+     * the first call to getTasks.
+     */
+    void setPrefetch(bool prefetch);
+
+    /** Enable or disable guided scheduling. When enabled, blocks are never
+     * larger than the block size and never smaller than minBlockSize.
+     * It only has effect in the master.
+     */
+    void setGuided(bool guided, size_t minBlockSize=1);
+
+    /** Per-rank statistics, only meaningful in the master. Index is the rank */
+    const std::vector<MpiTaskStatistics>& getStatistics() const;
+
+    /** Show the per-rank throughput in the master */
+    void showStatistics(std::ostream &out) const;
+
 private:
     /** Method that should be called in the master only.
      * It will listen for job requests from nodes, assign tasks and
@@ -108,6 +159,20 @@ private:
     bool distributeMaster();
     /** Workers should ask for jobs from master. */
     bool distributeSlaves(size_t &first, size_t &last);
+    /** Assign the next block in the master, shrinking it near the end if guided */
+    bool distributeGuided(size_t &first, size_t &last);
+    /** Post the request for the next block (worker) */
+    void postRequest();
+
+    bool prefetch, guided;
+    size_t minBlockSize;
+    // Prefetching state in the workers
+    bool pendingRequest;
+    MPI_Request pendingResponse;
+    size_t prefetchBuffer[3];
+    double waitTime;
+    // Statistics in the master
+    std::vector<MpiTaskStatistics> stats;
 }
 ;//end of class MpiTaskDistributor
 
@@ -144,6 +209,66 @@ public:
 }
 ;//end of class MpiFileMutex
 
+/** Memory shared by all the MPI processes of a compute node.
+ * The memory is allocated once per node (MPI-3 shared window) and all the
+ * processes of the node get a pointer to the same pages. The producer
+ * (the first process of each node) fills the buffer and, after sync(),
+ * the rest of processes of the node may read it. The buffer must be treated
+ * as read-only by the processes that are not the producer.
+ *
+ * If the MPI library does not support MPI-3, each process gets its own
+ * private buffer and is the producer of it, so the calling code is the same.
+ *
+ * @code
+ * MpiNodeSharedMemory shared(node);
+ * double *ptr=(double *)shared.allocate(N*sizeof(double));
+ * if (shared.isProducer())
+ *    fill(ptr);
+ * shared.sync();
+ * @endcode
+ */
+class MpiNodeSharedMemory
+{
+public:
+    /** Rank and number of processes within the node */
+    size_t nodeRank, nodeSize;
+
+    /** Constructor.
+     * It is collective over all the processes in MPI_COMM_WORLD.
+     */
+    MpiNodeSharedMemory(MpiNode *node);
+
+    /** Destructor. It must be called before MPI_Finalize. */
+    ~MpiNodeSharedMemory();
+
+    /** Allocate a buffer with the given number of bytes.
+     * The previous buffer, if any, is released. It is collective over the
+     * processes of the node and all of them must ask for the same size.
+     */
+    void *allocate(size_t bytes);
+
+    /** Release the buffer (collective over the processes of the node) */
+    void release();
+
+    /** Pointer to the buffer */
+    void *getBuffer() const;
+
+    /** True if this process must fill the buffer */
+    bool isProducer() const;
+
+    /** Wait until all the processes of the node reach this point */
+    void sync();
+
+    /** Broadcast data from the producer to the rest of processes of the node */
+    void broadcast(void *data, size_t bytes);
+
+protected:
+    MPI_Comm nodeComm;
+    MPI_Win win;
+    bool hasWindow;
+    void *buffer;
+};
+
 /** This class represent an Xmipp MPI Program.
  *  It includes the basic MPI functionalities to the programs,
  *  like an mpinode, a mutex...
@@ -189,6 +314,8 @@ class MpiMetadataProgram: public XmippMpiProgram
 protected:
     /** Divide the job in this number block with this number of images */
     int blockSize;
+    /** Show the per-rank throughput of the distribution */
+    bool mpiStats;
     MpiTaskDistributor *distributor;
     std::vector<size_t> imgsId;
     size_t first, last;
@@ -264,6 +391,9 @@ public:\
     }\
     void finishProcessing()\
     {\
+        if (node->isMaster() && mpiStats)\
+            distributor->showStatistics(std::cout);\
+        node->gatherProfile();\
         node->gatherMetadatas(*getOutputMd(), fn_out);\
     	MetaData MDaux; \
     	MDaux.sort(*getOutputMd(), MDL_GATHER_ID); \
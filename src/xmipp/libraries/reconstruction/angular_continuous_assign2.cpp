@@ -217,7 +217,7 @@ void ProgAngularContinuousAssign2::updateCTFImage(double defocusU, double defocu
 		ctfImage->resizeNoCopy(projector->projection());
 		STARTINGY(*ctfImage)=STARTINGX(*ctfImage)=0;
 	}
-	ctf.generateCTF(YSIZE(projector->projection()),XSIZE(projector->projection()),*ctfImage,Ts);
+	ctfGenerator.generateCTF(ctf,YSIZE(projector->projection()),XSIZE(projector->projection()),*ctfImage,Ts);
 	if (phaseFlipped)
 		FOR_ALL_ELEMENTS_IN_ARRAY2D(*ctfImage)
 			A2D_ELEM(*ctfImage,i,j)=fabs(A2D_ELEM(*ctfImage,i,j));
@@ -28,6 +28,7 @@
 
 #include <core/xmipp_program.h>
 #include <data/ctf.h>
+#include <data/ctf_image_cache.h>
 #include <data/fourier_projection.h>
 #include <data/fourier_filter.h>
 
@@ -127,6 +128,8 @@ public:
 	double currentDefocusU, currentDefocusV, currentAngle;
 	// CTF image
 	MultidimArray<double> *ctfImage;
+	// Generator of the CTF image
+	CTFImageGenerator ctfGenerator;
 public:
     /// Empty constructor
     ProgAngularContinuousAssign2();
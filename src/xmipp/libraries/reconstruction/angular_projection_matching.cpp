@@ -778,9 +778,8 @@ void ProgAngularProjectionMatching::translationallyAlignOneImage(MultidimArray<d
         double &maxcorr)
 {
 
-	MultidimArray<double> Mtrans,Mimg,Mref;
+	MultidimArray<double> Mimg,Mref;
     int refno;
-    Mtrans.setXmippOrigin();
     Mimg.setXmippOrigin();
     Mref.setXmippOrigin();
 #ifdef TIMING
@@ -826,11 +825,22 @@ void ProgAngularProjectionMatching::translationallyAlignOneImage(MultidimArray<d
         Mimg = img;
 
 
+    // Both images are transformed only once, for the search of the shift
+    // and for the correlation of the shifted image
+    MultidimArray< std::complex<double> > Fref, Fimg;
+    FourierTransformer transformerRef, transformerImg;
+    transformerRef.FourierTransform(Mref,Fref,false);
+    transformerImg.FourierTransform(Mimg,Fimg,false);
+
     // Perform the actual search for the optimal shift
     if (max_shift>0)
     {
         CorrelationAux aux;
-        bestShift(Mref,Mimg,opt_xoff,opt_yoff,aux);
+        MultidimArray<double> Mcorr;
+        Mcorr.resizeNoCopy(Mimg);
+        STARTINGX(Mcorr)=STARTINGX(Mimg);
+        STARTINGY(Mcorr)=STARTINGY(Mimg);
+        bestShift(Fref,Fimg,Mcorr,opt_xoff,opt_yoff,aux);
     }
     else
         opt_xoff = opt_yoff = 0.;
@@ -842,9 +852,12 @@ void ProgAngularProjectionMatching::translationallyAlignOneImage(MultidimArray<d
     std::cerr<<"optimal shift "<<opt_xoff<<" "<<opt_yoff<<std::endl;
 #endif
 
-    // Calculate standard cross-correlation coefficient
-    translate(LINEAR,Mtrans,Mimg,vectorR2(opt_xoff,opt_yoff),true);
-    maxcorr = correlationIndex(Mref,Mtrans);
+    // Calculate standard cross-correlation coefficient of the image
+    // translated with wrapping, directly from the Fourier transforms
+    FourierShifter shifter;
+    shifter.initialize(YSIZE(Mimg),XSIZE(Mimg));
+    shifter.setShift(opt_xoff,opt_yoff);
+    maxcorr = shifter.correlationIndex(Fref,Fimg);
 
 #ifdef DEBUG
 
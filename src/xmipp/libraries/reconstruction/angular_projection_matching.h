@@ -32,6 +32,7 @@
 #include <core/metadata.h>
 #include <core/xmipp_image.h>
 #include <data/filters.h>
+#include <data/fourier_shift.h>
 #include <data/mask.h>
 #include <data/polar.h>
 #include <core/xmipp_fftw.h>
@@ -46,6 +46,7 @@ void ProgCorrectWiener2D::defineParams()
     addKeywords("correct CTF by Wiener filtering");
     addParamsLine("   [--phase_flipped]       : Is the data already phase-flipped?");
     addParamsLine("   [--isIsotropic]         : Must be considered the defocus isotropic?");
+    addParamsLine("                           : The CTF is computed with the average of DefocusU and DefocusV");
     addParamsLine("   [--sampling_rate <float=1.0>]     : Sampling rate of the input particles");
     addParamsLine("   [--wc <float=-1>]       : Wiener-filter constant (if < 0: use FREALIGN default)");
     addParamsLine("   [--pad <factor=2.> ]    : Padding factor for Wiener correction");
@@ -53,40 +54,44 @@ void ProgCorrectWiener2D::defineParams()
 }
 
 // Define parameters ==========================================================
+void ProgCorrectWiener2D::removeCTFLabels(MetaData &md)
+{
+	md.removeLabel(MDL_CTF_DEFOCUSA);
+	md.removeLabel(MDL_CTF_DEFOCUSU);
+	md.removeLabel(MDL_CTF_DEFOCUS_ANGLE);
+	md.removeLabel(MDL_CTF_DEFOCUSV);
+	md.removeLabel(MDL_CTF_BG_BASELINE);
+	md.removeLabel(MDL_CTF_BG_GAUSSIAN2_ANGLE);
+	md.removeLabel(MDL_CTF_BG_GAUSSIAN2_CU);
+	md.removeLabel(MDL_CTF_BG_GAUSSIAN2_CV);
+	md.removeLabel(MDL_CTF_BG_GAUSSIAN2_K);
+	md.removeLabel(MDL_CTF_BG_GAUSSIAN2_SIGMAU);
+	md.removeLabel(MDL_CTF_BG_GAUSSIAN2_SIGMAV);
+	md.removeLabel(MDL_CTF_BG_GAUSSIAN_ANGLE);
+	md.removeLabel(MDL_CTF_BG_GAUSSIAN_CU);
+	md.removeLabel(MDL_CTF_BG_GAUSSIAN_CV);
+	md.removeLabel(MDL_CTF_BG_GAUSSIAN_K);
+	md.removeLabel(MDL_CTF_BG_GAUSSIAN_SIGMAU);
+	md.removeLabel(MDL_CTF_BG_GAUSSIAN_SIGMAV);
+	md.removeLabel(MDL_CTF_BG_SQRT_ANGLE);
+	md.removeLabel(MDL_CTF_BG_SQRT_K);
+	md.removeLabel(MDL_CTF_BG_SQRT_U);
+	md.removeLabel(MDL_CTF_BG_SQRT_V);
+	md.removeLabel(MDL_CTF_CA);
+	md.removeLabel(MDL_CTF_CONVERGENCE_CONE);
+	md.removeLabel(MDL_CTF_ENERGY_LOSS);
+	md.removeLabel(MDL_CTF_ENVELOPE);
+	md.removeLabel(MDL_CTF_LENS_STABILITY);
+	md.removeLabel(MDL_CTF_TRANSVERSAL_DISPLACEMENT);
+	md.removeLabel(MDL_CTF_LONGITUDINAL_DISPLACEMENT);
+	md.removeLabel(MDL_CTF_K);
+}
+
 void ProgCorrectWiener2D::postProcess()
 {
 
 	MetaData &ptrMdOut=*getOutputMd();
-
-	ptrMdOut.removeLabel(MDL_CTF_DEFOCUSA);
-	ptrMdOut.removeLabel(MDL_CTF_DEFOCUSU);
-	ptrMdOut.removeLabel(MDL_CTF_DEFOCUS_ANGLE);
-	ptrMdOut.removeLabel(MDL_CTF_DEFOCUSV);
-	ptrMdOut.removeLabel(MDL_CTF_BG_BASELINE);
-	ptrMdOut.removeLabel(MDL_CTF_BG_GAUSSIAN2_ANGLE);
-	ptrMdOut.removeLabel(MDL_CTF_BG_GAUSSIAN2_CU);
-	ptrMdOut.removeLabel(MDL_CTF_BG_GAUSSIAN2_CV);
-	ptrMdOut.removeLabel(MDL_CTF_BG_GAUSSIAN2_K);
-	ptrMdOut.removeLabel(MDL_CTF_BG_GAUSSIAN2_SIGMAU);
-	ptrMdOut.removeLabel(MDL_CTF_BG_GAUSSIAN2_SIGMAV);
-	ptrMdOut.removeLabel(MDL_CTF_BG_GAUSSIAN_ANGLE);
-	ptrMdOut.removeLabel(MDL_CTF_BG_GAUSSIAN_CU);
-	ptrMdOut.removeLabel(MDL_CTF_BG_GAUSSIAN_CV);
-	ptrMdOut.removeLabel(MDL_CTF_BG_GAUSSIAN_K);
-	ptrMdOut.removeLabel(MDL_CTF_BG_GAUSSIAN_SIGMAU);
-	ptrMdOut.removeLabel(MDL_CTF_BG_GAUSSIAN_SIGMAV);
-	ptrMdOut.removeLabel(MDL_CTF_BG_SQRT_ANGLE);
-	ptrMdOut.removeLabel(MDL_CTF_BG_SQRT_K);
-	ptrMdOut.removeLabel(MDL_CTF_BG_SQRT_U);
-	ptrMdOut.removeLabel(MDL_CTF_BG_SQRT_V);
-	ptrMdOut.removeLabel(MDL_CTF_CA);
-	ptrMdOut.removeLabel(MDL_CTF_CONVERGENCE_CONE);
-	ptrMdOut.removeLabel(MDL_CTF_ENERGY_LOSS);
-	ptrMdOut.removeLabel(MDL_CTF_ENVELOPE);
-	ptrMdOut.removeLabel(MDL_CTF_LENS_STABILITY);
-	ptrMdOut.removeLabel(MDL_CTF_TRANSVERSAL_DISPLACEMENT);
-	ptrMdOut.removeLabel(MDL_CTF_LONGITUDINAL_DISPLACEMENT);
-	ptrMdOut.removeLabel(MDL_CTF_K);
+	removeCTFLabels(ptrMdOut);
 
 	ptrMdOut.write(fn_out.replaceExtension("xmd"));
 
@@ -98,9 +103,7 @@ void ProgCorrectWiener2D::generateWienerFilter(MultidimArray<double> &Mwien, CTF
 	int paddimX = Xdim*pad;
 	ctf.enable_CTF = true;
 	ctf.enable_CTFnoise = false;
-	ctf.produceSideInfo();
 
-	MultidimArray<std::complex<double> > ctfComplex;
 	MultidimArray<double> ctfIm;
 
 	Mwien.resize(paddimY,paddimX);
@@ -114,24 +117,16 @@ void ProgCorrectWiener2D::generateWienerFilter(MultidimArray<double> &Mwien, CTF
 		ctf.DeltafU = avgdef;
 		ctf.DeltafV = avgdef;
 	}
+	// The CTF image is computed from the side info, it must see the final defocus
+	ctf.produceSideInfo();
 
-
-	ctfIm.resize(1, 1, paddimY, paddimX,false);
 	//Esto puede estar mal. Cuidado con el sampling de la ctf!!!
+	// Particles of the same micrograph share the CTF image
+	ctfCache.getCTF(ctf, paddimY, paddimX, ctfIm, -1, correct_envelope);
 
-	if (correct_envelope)
-		ctf.generateCTF(paddimY, paddimX, ctfComplex);
-
-	else
-		ctf.generateCTFWithoutDamping(paddimY, paddimX, ctfComplex);
-
-	FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(ctfIm)
-	{
-		if (phase_flipped)
-			dAij(ctfIm, i, j) = fabs(dAij(ctfComplex, i, j).real());
-		else
-			dAij(ctfIm, i, j) = dAij(ctfComplex, i, j).real();
-	}
+	if (phase_flipped)
+		FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(ctfIm)
+			DIRECT_MULTIDIM_ELEM(ctfIm, n) = fabs(DIRECT_MULTIDIM_ELEM(ctfIm, n));
 
 //#define DEBUG
 #ifdef DEBUG
@@ -205,11 +200,19 @@ void ProgCorrectWiener2D::processImage(const FileName &fnImg, const FileName &fn
 	rowOut = rowIn;
 
 	img.read(fnImg);
-	ctf.readFromMdRow(rowIn);
+	applyWienerFilter(img(), rowIn);
+
+    img.write(fnImgOut);
+    rowOut.setValue(MDL_IMAGE, fnImgOut);
+}
+
+void ProgCorrectWiener2D::applyWienerFilter(MultidimArray<double> &I, const MDRow &row)
+{
+	ctf.readFromMdRow(row);
 	ctf.phase_shift = (ctf.phase_shift*PI)/180;
-	img().setXmippOrigin();
-	Ydim = YSIZE(img());
-	Xdim = XSIZE(img());
+	I.setXmippOrigin();
+	Ydim = YSIZE(I);
+	Xdim = XSIZE(I);
 	int paddimY = Ydim*pad;
 	int paddimX = Xdim*pad;
 	MultidimArray<std::complex<double> > Faux;
@@ -237,16 +240,16 @@ void ProgCorrectWiener2D::processImage(const FileName &fnImg, const FileName &fn
         int xF = LAST_XMIPP_INDEX(paddimX);
         int y0 = FIRST_XMIPP_INDEX(paddimY);
         int yF = LAST_XMIPP_INDEX(paddimY);
-        img().selfWindow(y0, x0, yF, xF);
+        I.selfWindow(y0, x0, yF, xF);
     }
 
-    transformer.FourierTransform(img(), Faux);
+    transformer.FourierTransform(I, Faux);
     FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY2D(Faux)
     {
         dAij(Faux,i,j) *= dAij(Mwien,i,j);
     }
 
-    transformer.inverseFourierTransform(Faux, img());
+    transformer.inverseFourierTransform(Faux, I);
 	if (paddimX >= Xdim)
     {
         // de-pad real-space image
@@ -254,16 +257,13 @@ void ProgCorrectWiener2D::processImage(const FileName &fnImg, const FileName &fn
         int y0 = FIRST_XMIPP_INDEX(Ydim);
         int xF = LAST_XMIPP_INDEX(Xdim);
         int yF = LAST_XMIPP_INDEX(Ydim);
-        img().selfWindow(y0, x0, yF, xF);
+        I.selfWindow(y0, x0, yF, xF);
     }
 
-    img.write(fnImgOut);
-    rowOut.setValue(MDL_IMAGE, fnImgOut);
-
 #ifdef DEBUG
 {
 	Image<double> save;
-	save()=img;
+	save()=I;
 	save.write("imgW.spi");
 	exit(0);
 }
@@ -32,6 +32,7 @@
 #include <core/xmipp_fftw.h>
 #include <core/args.h>
 #include <data/ctf.h>
+#include <data/ctf_image_cache.h>
 #include <core/xmipp_image.h>
 #include <data/filters.h>
 
@@ -70,12 +71,23 @@ public:
 
     void generateWienerFilter(MultidimArray<double> &Mwien, CTFDescription &ctf);
 
+    /** Correct an image in memory with the CTF described in row.
+     * The image keeps its size.
+     */
+    void applyWienerFilter(MultidimArray<double> &I, const MDRow &row);
+
+	/** Remove the CTF labels of a metadata whose images have been corrected */
+	static void removeCTFLabels(MetaData &md);
+
 	void postProcess();
 public:
 	Image<double> img;
 
 	CTFDescription ctf;
 
+	// CTF images of the last micrographs
+	CTFImageCache ctfCache;
+
 	size_t Ydim, Xdim;
 
 	MultidimArray<double> Mwien;
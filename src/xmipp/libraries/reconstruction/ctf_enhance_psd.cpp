@@ -108,7 +108,7 @@ void ProgCTFEnhancePSD::processImage(const FileName &fnImg, const FileName &fnIm
 }
 
 //#define DEBUG
-void ProgCTFEnhancePSD::applyFilter(MultidimArray<double> &PSD)
+void ProgCTFEnhancePSD::applyFilter(MultidimArray<double> &PSD, int Nthreads)
 {
     // Take the logarithm
     FOR_ALL_ELEMENTS_IN_ARRAY2D(PSD)
@@ -117,7 +117,7 @@ void ProgCTFEnhancePSD::applyFilter(MultidimArray<double> &PSD)
     // Remove single outliers
     CenterFFT(PSD, true);
     MultidimArray<double> aux;
-    medianFilter3x3(PSD, aux);
+    medianFilter3x3(PSD, aux, Nthreads);
     PSD = aux;
 
     // Reject other outliers
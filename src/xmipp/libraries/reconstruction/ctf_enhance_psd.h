@@ -73,8 +73,8 @@ public:
 
     /** Apply filter method to a single PSD.
         The steps are basically: outlier removal, band pass filtration, masking
-        and normalization. */
-    void applyFilter(MultidimArray<double> &PSD);
+        and normalization. The outliers are removed with Nthreads threads. */
+    void applyFilter(MultidimArray<double> &PSD, int Nthreads=1);
 
     /** Apply SPHT to a single PSD.*/
     void applySPHT(MultidimArray<double> &PSD);
@@ -986,7 +986,7 @@ void fastEstimateEnhancedPSD(const FileName &fnMicrograph, double downsampling,
     prog2.mask_w1 = 0.005;
     prog2.mask_w2 = 0.5;
 
-    prog2.applyFilter(*(args.PSD));
+    prog2.applyFilter(*(args.PSD), numberOfThreads);
     enhancedPSD = *(args.PSD);
 
     int downXdim = (int) (XSIZE(enhancedPSD) / downsampling);
@@ -26,6 +26,7 @@
 #include "denoise.h"
 #include <core/args.h>
 #include <data/wavelet.h>
+#include <data/wavelet_lifting.h>
 #include <core/histogram.h>
 #include <data/filters.h>
 
@@ -46,6 +47,7 @@ WaveletFilter::WaveletFilter()
     adjust_range = true;
     verbose = 0;
     dont_denoise = false;
+    Nthreads = 1;
 }
 
 // defineParams -------------------------------------------------------------------s
@@ -55,6 +57,7 @@ void WaveletFilter::defineParams(XmippProgram *program)
     program->addParamsLine("  [--wavelet <DWT_type=DAUB12> <mode=remove_scale>]   : Different types of filters using wavelets");
     program->addParamsLine("    where <DWT_type>");
     program->addParamsLine("       DAUB4 DAUB12 DAUB20    : Discrete Wavelet Transform");
+    program->addParamsLine("       LIFTING                : Daubechies-4 lifting scheme, in place and using --thr threads");
     program->addParamsLine("    where <mode>");
     program->addParamsLine("       remove_scale");
     program->addParamsLine("       bayesian <SNR0=0.1> <SNRF=0.2> : Smallest(SNR0) and largest(SNRF) SNR.");
@@ -99,6 +102,8 @@ void WaveletFilter::readParams(XmippProgram *program)
     R = program->getIntParam("-R");
     white_noise = program->checkParam("--white_noise");
     verbose = program->verbose;
+    // --thr is defined by the mean shift filter of the same program
+    Nthreads = program->getIntParam("--thr");
     produceSideInfo();
 }
 
@@ -111,6 +116,8 @@ void WaveletFilter::produceSideInfo()
         set_DWT_type(DAUB12);
     else if (DWT_type == "DAUB20")
         set_DWT_type(DAUB20);
+    else if (DWT_type == "LIFTING")
+        ; // Nothing to set
     else
         REPORT_ERROR(ERR_VALUE_INCORRECT, "Unknown DWT type");
 }
@@ -122,6 +129,8 @@ void WaveletFilter::show()
         return;
     ///Show specific options
     std::cout << "DWT type: " << DWT_type << std::endl;
+    if (DWT_type == "LIFTING")
+        std::cout << "Threads: " << Nthreads << std::endl;
     std::cout << "Denoising: ";
     switch (denoising_type)
     {
@@ -151,19 +160,27 @@ void WaveletFilter::show()
 // Denoise volume ----------------------------------------------------------
 void WaveletFilter::apply(MultidimArray<double> &img)
 {
+    bool lifting = DWT_type == "LIFTING";
     if (img.getDim()==2)
     {
         // 2D image denoising
         if (denoising_type == BAYESIAN && adjust_range)
             img.rangeAdjust(0, 1);
 
-        double size2 = log10((double)XSIZE(img)) / log10(2.0);
-        if (ABS(size2 - ROUND(size2)) > 1e-6)
-            REPORT_ERROR(ERR_MULTIDIM_SIZE, "Input image must be of a size power of 2");
-        size2 = log10((double)YSIZE(img)) / log10(2.0);
-        if (ABS(size2 - ROUND(size2)) > 1e-6)
-            REPORT_ERROR(ERR_MULTIDIM_SIZE, "Input image must be of a size power of 2");
-        DWT(img, img);
+        // The lifting transform only needs sizes multiple of 2^levels
+        if (!lifting)
+        {
+            double size2 = log10((double)XSIZE(img)) / log10(2.0);
+            if (ABS(size2 - ROUND(size2)) > 1e-6)
+                REPORT_ERROR(ERR_MULTIDIM_SIZE, "Input image must be of a size power of 2");
+            size2 = log10((double)YSIZE(img)) / log10(2.0);
+            if (ABS(size2 - ROUND(size2)) > 1e-6)
+                REPORT_ERROR(ERR_MULTIDIM_SIZE, "Input image must be of a size power of 2");
+        }
+        if (lifting)
+            liftingDWT(img, -1, Nthreads);
+        else
+            DWT(img, img);
         Histogram1D hist;
         switch (denoising_type)
         {
@@ -177,8 +194,12 @@ void WaveletFilter::apply(MultidimArray<double> &img)
             soft_thresholding(img, hist.percentil(threshold));
             break;
         case BAYESIAN:
-            estimatedS = bayesian_wiener_filtering2D(img, scale, SNR0, SNRF,
-                         white_noise, 0, !dont_denoise);
+            if (lifting)
+                estimatedS = bayesianWienerFiltering(img, scale, SNR0, SNRF,
+                             white_noise, 0, !dont_denoise, Nthreads);
+            else
+                estimatedS = bayesian_wiener_filtering2D(img, scale, SNR0, SNRF,
+                             white_noise, 0, !dont_denoise);
             break;
         case ADAPTIVE_SOFT:
             adaptive_soft_thresholding2D(img, scale);
@@ -192,22 +213,32 @@ void WaveletFilter::apply(MultidimArray<double> &img)
                 int reduction = (int)pow(2.0, output_scale);
                 img.resize(YSIZE(img) / reduction, XSIZE(img) / reduction);
             }
-            IDWT(img, img);
+            if (lifting)
+                liftingIDWT(img, -1, Nthreads);
+            else
+                IDWT(img, img);
     }
     else
     {
         // 3D image denoising
-        double size2 = log10((double)XSIZE(img)) / log10(2.0);
-        if (ABS(size2 - ROUND(size2)) > 1e-6)
-            REPORT_ERROR(ERR_MULTIDIM_SIZE, "Input volume must be of a size power of 2");
-        size2 = log10((double)YSIZE(img)) / log10(2.0);
-        if (ABS(size2 - ROUND(size2)) > 1e-6)
-            REPORT_ERROR(ERR_MULTIDIM_SIZE, "Input volume must be of a size power of 2");
-        size2 = log10((double)ZSIZE(img)) / log10(2.0);
-        if (ABS(size2 - ROUND(size2)) > 1e-6)
-            REPORT_ERROR(ERR_MULTIDIM_SIZE, "Input volume must be of a size power of 2");
+        // The lifting transform only needs sizes multiple of 2^levels
+        if (!lifting)
+        {
+            double size2 = log10((double)XSIZE(img)) / log10(2.0);
+            if (ABS(size2 - ROUND(size2)) > 1e-6)
+                REPORT_ERROR(ERR_MULTIDIM_SIZE, "Input volume must be of a size power of 2");
+            size2 = log10((double)YSIZE(img)) / log10(2.0);
+            if (ABS(size2 - ROUND(size2)) > 1e-6)
+                REPORT_ERROR(ERR_MULTIDIM_SIZE, "Input volume must be of a size power of 2");
+            size2 = log10((double)ZSIZE(img)) / log10(2.0);
+            if (ABS(size2 - ROUND(size2)) > 1e-6)
+                REPORT_ERROR(ERR_MULTIDIM_SIZE, "Input volume must be of a size power of 2");
+        }
 
-        DWT(img, img);
+        if (lifting)
+            liftingDWT(img, -1, Nthreads);
+        else
+            DWT(img, img);
         Histogram1D hist;
         switch (denoising_type)
         {
@@ -225,8 +256,12 @@ void WaveletFilter::apply(MultidimArray<double> &img)
             soft_thresholding(img, hist.percentil(threshold));
             break;
         case BAYESIAN:
-            estimatedS = bayesian_wiener_filtering3D(img, scale, SNR0, SNRF,
-                         white_noise, verbose, !dont_denoise);
+            if (lifting)
+                estimatedS = bayesianWienerFiltering(img, scale, SNR0, SNRF,
+                             white_noise, verbose, !dont_denoise, Nthreads);
+            else
+                estimatedS = bayesian_wiener_filtering3D(img, scale, SNR0, SNRF,
+                             white_noise, verbose, !dont_denoise);
             break;
         case ADAPTIVE_SOFT:
             std::cout << "Adaptive soft-thresholding not implemented for imgumes\n";
@@ -241,20 +276,56 @@ void WaveletFilter::apply(MultidimArray<double> &img)
             int reduction = (int)pow(2.0, output_scale);
             img.resizeNoCopy(ZSIZE(img) / reduction, YSIZE(img) / reduction, XSIZE(img) / reduction);
         }
-        IDWT(img, img);
+        if (lifting)
+            liftingIDWT(img, -1, Nthreads);
+        else
+            IDWT(img, img);
+
+    }
+}
+
+void WaveletFilter::apply(MultidimArray<float> &img)
+{
+    if (DWT_type != "LIFTING" || denoising_type != BAYESIAN)
+        REPORT_ERROR(ERR_NOT_IMPLEMENTED, "Only the Bayesian denoising with the LIFTING wavelet works in single precision");
+    bool is2D = img.getDim()==2;
+    if (is2D && adjust_range)
+        img.rangeAdjust(0, 1);
 
+    liftingDWT(img, -1, Nthreads);
+    estimatedS = bayesianWienerFiltering(img, scale, SNR0, SNRF,
+                 white_noise, is2D ? 0 : verbose, !dont_denoise, Nthreads);
+    if (output_scale != 0)
+    {
+        int reduction = (int)pow(2.0, output_scale);
+        if (is2D)
+            img.resize(YSIZE(img) / reduction, XSIZE(img) / reduction);
+        else
+            img.resize(ZSIZE(img) / reduction, YSIZE(img) / reduction, XSIZE(img) / reduction);
     }
+    liftingIDWT(img, -1, Nthreads);
 }
 
 void WaveletFilter::denoiseAvgBayesian(MultidimArray<double> &vol)
 {
-    DWT(vol, vol);
-    bayesian_wiener_filtering3D(vol, scale, estimatedS);
+    if (DWT_type == "LIFTING")
+    {
+        liftingDWT(vol, -1, Nthreads);
+        bayesianWienerFiltering(vol, scale, estimatedS, Nthreads);
+    }
+    else
+    {
+        DWT(vol, vol);
+        bayesian_wiener_filtering3D(vol, scale, estimatedS);
+    }
 
     if (output_scale != 0)
     {
         int reduction = (int)pow(2.0, output_scale);
         vol.resizeNoCopy(ZSIZE(vol) / reduction, YSIZE(vol) / reduction, XSIZE(vol) / reduction);
     }
-    IDWT(vol, vol);
+    if (DWT_type == "LIFTING")
+        liftingIDWT(vol, -1, Nthreads);
+    else
+        IDWT(vol, vol);
 }
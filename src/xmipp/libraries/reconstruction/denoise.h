@@ -48,7 +48,8 @@ public:
 
     /** Wavelet type.
      *
-     * Valid types DAUB4, DAUB12, DAUB20
+     * Valid types DAUB4, DAUB12, DAUB20, LIFTING. LIFTING is a multithreaded
+     * Daubechies-4 transform computed in place (see liftingDWT).
      */
     String DWT_type;
 
@@ -111,6 +112,12 @@ public:
      */
     bool dont_denoise;
 
+    /** Number of threads.
+     *
+     * Used by the LIFTING transform and its Bayesian denoising.
+     */
+    int Nthreads;
+
     static void defineParams(XmippProgram *program);
     void readParams(XmippProgram *program);
 
@@ -135,6 +142,14 @@ public:
      */
     void apply(MultidimArray< double >& img);
 
+    /** Denoise an image or volume in single precision.
+     *
+     * Only the Bayesian denoising with the LIFTING wavelet is available. The
+     * size must only allow the transform (liftingMaxLevels), it does not need
+     * to be a power of 2.
+     */
+    void apply(MultidimArray< float >& img);
+
     /** Denoise a volume using a precalculated estimate of the bayesian
      * parameters.
      */
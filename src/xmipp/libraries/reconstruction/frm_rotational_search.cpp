@@ -0,0 +1,293 @@
+/***************************************************************************
+ *
+ * Authors:     Carlos Oscar S. Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include "frm_rotational_search.h"
+#include <core/xmipp_fftw.h>
+#include <core/geometry.h>
+#include <sh_alignment/frm.h>
+#include <sh_alignment/lib_eul.h>
+#include <sh_alignment/SpharmonicKit27/cospmls.h>
+#include <sh_alignment/SpharmonicKit27/FST_semi_memo.h>
+
+/* Helpers ----------------------------------------------------------------- */
+// Amplitude of the (half) Fourier transform
+static void fourierAmplitude(const MultidimArray<double> &V, MultidimArray<double> &amplitude)
+{
+    FourierTransformer transformer;
+    MultidimArray< std::complex<double> > Vfft;
+    MultidimArray<double> Vaux=V;
+    transformer.FourierTransform(Vaux,Vfft,false);
+    amplitude.initZeros(Vfft);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(Vfft)
+        DIRECT_MULTIDIM_ELEM(amplitude,n)=abs(DIRECT_MULTIDIM_ELEM(Vfft,n));
+}
+
+// Value of the half Fourier transform at an integer frequency.
+// The frequencies with negative X are taken from their Hermitian symmetric.
+static inline double halfValue(const MultidimArray<double> &A, int Xdim, int X, int Y, int Z)
+{
+    if (X<0)
+    {
+        X=-X;
+        Y=-Y;
+        Z=-Z;
+    }
+    if (X>Xdim/2)
+        return 0;
+    int Ydim=YSIZE(A), Zdim=ZSIZE(A);
+    int i=((Y%Ydim)+Ydim)%Ydim;
+    int k=((Z%Zdim)+Zdim)%Zdim;
+    return DIRECT_A3D_ELEM(A,k,i,X);
+}
+
+// Sample the half Fourier transform A on the 2bw x 2bw grid of the sphere of radius r
+static void sampleShell(const MultidimArray<double> &A, int Xdim, int bw, double r,
+                        bool nearest, std::vector<double> &f)
+{
+    int size=2*bw;
+    f.resize(size*size);
+    for (int j=0; j<size; ++j)
+    {
+        double theta=PI*(2*j+1)/(4*bw);
+        double sinTheta=sin(theta), cosTheta=cos(theta);
+        for (int k=0; k<size; ++k)
+        {
+            double phi=PI*k/bw;
+            double x=r*sinTheta*cos(phi), y=r*sinTheta*sin(phi), z=r*cosTheta;
+            double &val=f[j*size+k];
+            if (nearest)
+                val=halfValue(A,Xdim,ROUND(x),ROUND(y),ROUND(z));
+            else
+            {
+                int x0=FLOOR(x), y0=FLOOR(y), z0=FLOOR(z);
+                double wx=x-x0, wy=y-y0, wz=z-z0;
+                val=0;
+                for (int dz=0; dz<=1; ++dz)
+                {
+                    double wzz=dz ? wz:1-wz;
+                    for (int dy=0; dy<=1; ++dy)
+                    {
+                        double wyy=wzz*(dy ? wy:1-wy);
+                        for (int dx=0; dx<=1; ++dx)
+                            val+=wyy*(dx ? wx:1-wx)*halfValue(A,Xdim,x0+dx,y0+dy,z0+dz);
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* Setup ------------------------------------------------------------------- */
+FRMRotationalSearch::FRMRotationalSearch()
+{
+    bw=0;
+    Xdim=0;
+    shell0=shellF=0;
+}
+
+void FRMRotationalSearch::setup(int _Xdim, double maxFreq, int _bw, double minFreq)
+{
+    Xdim=_Xdim;
+    bw=_bw;
+    shell0=XMIPP_MAX(1,CEIL(minFreq*Xdim));
+    shellF=XMIPP_MIN(FLOOR(maxFreq*Xdim),Xdim/2-1);
+    if (shellF<shell0)
+        REPORT_ERROR(ERR_ARG_INCORRECT,"FRM: there are no frequency shells to search");
+
+    // Legendre tables
+    tableSpace.resize(Reduced_Naive_TableSize(bw,bw)+Reduced_SpharmonicTableSize(bw,bw));
+    std::vector<double> workspace(8*bw*bw+29*bw);
+    double **table=SemiNaive_Naive_Pml_Table(bw,bw,&tableSpace[0],&workspace[0]);
+    tableOffsets.resize(bw+1);
+    for (int i=0; i<=bw; ++i)
+        tableOffsets[i]=table[i]-&tableSpace[0];
+    free(table);
+
+    ddd.resize(bw*(4*bw*bw-1)/3);
+    sh_alignment::wigner(bw,0.5*PI,&ddd[0]);
+
+    std::vector<double> one(4*bw*bw,1.);
+    oneR.resize(bw*bw);
+    oneI.resize(bw*bw);
+    sphericalTransform(one,&oneR[0],&oneI[0],workspace);
+}
+
+void FRMRotationalSearch::sphericalTransform(std::vector<double> &f, double *coeffR, double *coeffI,
+        std::vector<double> &workspace) const
+{
+    int size=2*bw;
+    std::vector<double *> table(bw+1);
+    double *tableStart=(double *)&tableSpace[0];
+    for (int i=0; i<=bw; ++i)
+        table[i]=tableStart+tableOffsets[i];
+    std::vector<double> zero(size*size,0.);
+    workspace.resize(8*bw*bw+29*bw);
+    FST_semi_memo(&f[0],&zero[0],coeffR,coeffI,size,&table[0],&workspace[0],1,bw);
+}
+
+/* Reference --------------------------------------------------------------- */
+void FRMRotationalSearch::computeReference(const MultidimArray<double> &ref, FRMReference &frmRef) const
+{
+    if (XSIZE(ref)!=(size_t)Xdim || YSIZE(ref)!=(size_t)Xdim || ZSIZE(ref)!=(size_t)Xdim)
+        REPORT_ERROR(ERR_MULTIDIM_SIZE,"FRM: the reference does not have the size of the search");
+    MultidimArray<double> amplitude;
+    fourierAmplitude(ref,amplitude);
+
+    int Nshells=shellF-shell0+1;
+    size_t bw2=bw*bw;
+    frmRef.Xdim=Xdim;
+    frmRef.coeffR.resize(Nshells*bw2);
+    frmRef.coeffI.resize(Nshells*bw2);
+    frmRef.coeff2R.resize(Nshells*bw2);
+    frmRef.coeff2I.resize(Nshells*bw2);
+    std::vector<double> g, workspace;
+    for (int shell=shell0; shell<=shellF; ++shell)
+    {
+        size_t offset=(shell-shell0)*bw2;
+        sampleShell(amplitude,Xdim,bw,shell,false,g);
+        sphericalTransform(g,&frmRef.coeffR[offset],&frmRef.coeffI[offset],workspace);
+        for (size_t n=0; n<g.size(); ++n)
+            g[n]*=g[n];
+        sphericalTransform(g,&frmRef.coeff2R[offset],&frmRef.coeff2I[offset],workspace);
+    }
+}
+
+/* Search ------------------------------------------------------------------ */
+void FRMRotationalSearch::correlationFromCoefficients(std::vector<double> &T, std::vector<double> &C) const
+{
+    // The correlation is the real part of the backward FFT of T, that is the
+    // real part of the forward FFT of its conjugate
+    int size=2*bw;
+    MultidimArray< std::complex<double> > Tc(size,size,size), Cfft;
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(Tc)
+        DIRECT_MULTIDIM_ELEM(Tc,n)=std::complex<double>(T[2*n],-T[2*n+1]);
+    FourierTransformer transformer;
+    transformer.FourierTransform(Tc,Cfft,false);
+    C.resize(MULTIDIM_SIZE(Cfft));
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(Cfft)
+        C[n]=real(DIRECT_MULTIDIM_ELEM(Cfft,n));
+}
+
+void FRMRotationalSearch::search(const FRMReference &frmRef, const MultidimArray<double> &particle,
+                                 const MultidimArray<double> *measured, int N,
+                                 std::vector<FRMRotation> &rotations) const
+{
+    if (frmRef.Xdim!=Xdim)
+        REPORT_ERROR(ERR_MULTIDIM_SIZE,"FRM: the reference has not been computed for this search");
+    if (XSIZE(particle)!=(size_t)Xdim || YSIZE(particle)!=(size_t)Xdim || ZSIZE(particle)!=(size_t)Xdim)
+        REPORT_ERROR(ERR_MULTIDIM_SIZE,"FRM: the particle does not have the size of the search");
+    MultidimArray<double> amplitude;
+    fourierAmplitude(particle,amplitude);
+    if (measured!=NULL && (XSIZE(*measured)!=XSIZE(amplitude) || YSIZE(*measured)!=YSIZE(amplitude) ||
+                           ZSIZE(*measured)!=ZSIZE(amplitude)))
+        REPORT_ERROR(ERR_MULTIDIM_SIZE,"FRM: the measured region does not match the particle");
+
+    // Fourier coefficients of the numerator and the two normalization terms
+    // of the constrained correlation, accumulated over all shells
+    int size=2*bw;
+    size_t size3=(size_t)size*size*size, bw2=bw*bw;
+    std::vector<double> Tnum(2*size3,0.), Tden1(2*size3,0.), Tden2(2*size3,0.);
+    std::vector<double> f, m, fm(size*size), f2m(size*size), workspace;
+    std::vector<double> fmR(bw2), fmI(bw2), f2mR(bw2), f2mI(bw2), mR(bw2), mI(bw2);
+    for (int shell=shell0; shell<=shellF; ++shell)
+    {
+        sampleShell(amplitude,Xdim,bw,shell,false,f);
+        if (measured!=NULL)
+            sampleShell(*measured,Xdim,bw,shell,true,m);
+        else
+            m.assign(size*size,1.);
+        double weight=shell*shell;
+        for (size_t n=0; n<f.size(); ++n)
+        {
+            m[n]*=weight;
+            fm[n]=f[n]*m[n];
+            f2m[n]=f[n]*fm[n];
+        }
+        sphericalTransform(fm,&fmR[0],&fmI[0],workspace);
+        sphericalTransform(f2m,&f2mR[0],&f2mI[0],workspace);
+        sphericalTransform(m,&mR[0],&mI[0],workspace);
+
+        size_t offset=(shell-shell0)*bw2;
+        double *gR=(double *)&frmRef.coeffR[offset], *gI=(double *)&frmRef.coeffI[offset];
+        double *g2R=(double *)&frmRef.coeff2R[offset], *g2I=(double *)&frmRef.coeff2I[offset];
+        double *ddd0=(double *)&ddd[0];
+        sh_alignment::fourier_corr(bw,&fmR[0],&fmI[0],gR,gI,ddd0,&Tnum[0]);
+        sh_alignment::fourier_corr(bw,&f2mR[0],&f2mI[0],(double *)&oneR[0],(double *)&oneI[0],ddd0,&Tden1[0]);
+        sh_alignment::fourier_corr(bw,&mR[0],&mI[0],g2R,g2I,ddd0,&Tden2[0]);
+    }
+
+    std::vector<double> C, den1, den2;
+    correlationFromCoefficients(Tnum,C);
+    correlationFromCoefficients(Tden1,den1);
+    correlationFromCoefficients(Tden2,den2);
+    for (size_t n=0; n<size3; ++n)
+    {
+        double den=sqrt(fabs(den1[n])*fabs(den2[n]));
+        C[n]=(den>0) ? C[n]/den:0;
+    }
+
+    // Peaks of the correlation
+    std::vector<double> res(4*N);
+    for (int n=0; n<N; ++n)
+        res[4*n]=-1e38;
+    find_topn_angles(&C[0],size3,bw,&res[0],4*N,3.0);
+
+    rotations.clear();
+    Matrix2D<double> E(3,3);
+    double M[3][3];
+    for (int n=0; n<N; ++n)
+    {
+        if (res[4*n]==-1e38)
+            break;
+        get_rot_matrix(M,DEG2RAD(res[4*n+1]),DEG2RAD(res[4*n+2]),DEG2RAD(res[4*n+3]));
+        for (int i=0; i<3; ++i)
+            for (int j=0; j<3; ++j)
+                MAT_ELEM(E,i,j)=M[i][j];
+        FRMRotation rotation;
+        Euler_matrix2angles(E,rotation.rot,rotation.tilt,rotation.psi);
+        rotation.score=res[4*n];
+        rotations.push_back(rotation);
+    }
+}
+
+void FRMRotationalSearch::search(const FRMReference &frmRef, const MultidimArray<double> &particle,
+                                 const MissingWedge &wedge, int N,
+                                 std::vector<FRMRotation> &rotations) const
+{
+    MultidimArray<double> measured;
+    wedge.getMeasuredRegion(particle,measured);
+    search(frmRef,particle,&measured,N,rotations);
+}
+
+double FRMRotationalSearch::rotationDistance(const Matrix2D<double> &E1, const Matrix2D<double> &E2)
+{
+    // trace(E1^t E2)=1+2cos(angle)
+    double trace=0;
+    for (int i=0; i<3; ++i)
+        for (int j=0; j<3; ++j)
+            trace+=MAT_ELEM(E1,i,j)*MAT_ELEM(E2,i,j);
+    double cosAngle=CLIP(0.5*(trace-1),-1.,1.);
+    return RAD2DEG(acos(cosAngle));
+}
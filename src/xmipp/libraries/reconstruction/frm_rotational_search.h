@@ -0,0 +1,139 @@
+/***************************************************************************
+ *
+ * Authors:     Carlos Oscar S. Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef _FRM_ROTATIONAL_SEARCH_HH
+#define _FRM_ROTATIONAL_SEARCH_HH
+
+#include <core/multidim_array.h>
+#include <core/matrix2d.h>
+#include <data/steerable.h>
+#include <vector>
+
+/**@defgroup FRMRotationalSearch Fast rotational search of subtomograms
+   @ingroup ReconstructionLibrary
+
+   Native implementation of the Fast Rotational Matching of the amplitudes
+   of the Fourier transforms of a reference and a particle with a missing
+   region (Chen et al., J. Struct. Biol. 182: 235-245 (2013)). The
+   amplitudes on each frequency shell are expanded in spherical harmonics
+   and the constrained correlation of all rotations is computed with a
+   single FFT. Since amplitudes are translation invariant, the rotations
+   found are independent of the shift of the particle.
+*/
+//@{
+
+/** A candidate rotation.
+ * (rot, tilt, psi) are the Euler angles of the rotation that has to be
+ * applied to the particle to fit the reference.
+ */
+struct FRMRotation
+{
+    double rot, tilt, psi;
+    /// Constrained correlation of the Fourier amplitudes
+    double score;
+};
+
+/** Precomputed reference.
+ * Spherical harmonic coefficients of the Fourier amplitude (and of the
+ * squared amplitude) of the reference on each frequency shell.
+ */
+class FRMReference
+{
+public:
+    /// Size of the reference
+    int Xdim;
+    /// Coefficients of the amplitude (bw*bw per shell)
+    std::vector<double> coeffR, coeffI;
+    /// Coefficients of the squared amplitude (bw*bw per shell)
+    std::vector<double> coeff2R, coeff2I;
+public:
+    /// Empty constructor
+    FRMReference(): Xdim(0) {}
+};
+
+/** Fast rotational search.
+ * Once set up, the search is const and it can be called from several
+ * threads at the same time.
+ */
+class FRMRotationalSearch
+{
+public:
+    /// Bandwidth of the spherical harmonics
+    int bw;
+    /// Size of the volumes
+    int Xdim;
+    /// First and last frequency shells (in Fourier pixels)
+    int shell0, shellF;
+protected:
+    // Legendre tables of the spherical transform
+    std::vector<double> tableSpace;
+    // Offsets of the table rows in tableSpace
+    std::vector<size_t> tableOffsets;
+    // Wigner d-functions at pi/2
+    std::vector<double> ddd;
+    // Coefficients of the constant function 1
+    std::vector<double> oneR, oneI;
+public:
+    /// Empty constructor
+    FRMRotationalSearch();
+
+    /** Set up the search.
+     * maxFreq and minFreq are digital frequencies (<=0.5) that delimit
+     * the shells used for the search.
+     */
+    void setup(int Xdim, double maxFreq, int bw=16, double minFreq=0);
+
+    /// Precompute a reference
+    void computeReference(const MultidimArray<double> &ref, FRMReference &frmRef) const;
+
+    /** Search the N best rotations.
+     * measured is the measured region of the particle, with the size of its
+     * (half) Fourier transform and 1 in the measured frequencies
+     * (see MissingWedge::getMeasuredRegion). If it is NULL, the particle is
+     * fully measured. The rotations are sorted by decreasing score; there
+     * may be less than N if the correlation does not have so many local
+     * maxima.
+     */
+    void search(const FRMReference &frmRef, const MultidimArray<double> &particle,
+                const MultidimArray<double> *measured, int N,
+                std::vector<FRMRotation> &rotations) const;
+
+    /// Search the N best rotations of a particle with a missing wedge
+    void search(const FRMReference &frmRef, const MultidimArray<double> &particle,
+                const MissingWedge &wedge, int N,
+                std::vector<FRMRotation> &rotations) const;
+
+    /// Angle (in degrees) of the rotation between two rotation matrices (3x3 or 4x4)
+    static double rotationDistance(const Matrix2D<double> &E1, const Matrix2D<double> &E2);
+protected:
+    // Spherical harmonic coefficients of a function sampled on the 2bw x 2bw grid
+    void sphericalTransform(std::vector<double> &f, double *coeffR, double *coeffI,
+                            std::vector<double> &workspace) const;
+
+    // Inverse FFT of the Fourier coefficients of a correlation (real part)
+    void correlationFromCoefficients(std::vector<double> &T, std::vector<double> &C) const;
+};
+//@}
+#endif
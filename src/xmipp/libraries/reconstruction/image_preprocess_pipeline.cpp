@@ -0,0 +1,453 @@
+/***************************************************************************
+ *
+ * Authors:     Carlos Oscar S. Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#include "image_preprocess_pipeline.h"
+#include "ctf_correct_wiener2d.h"
+#include <core/xmipp_image.h>
+#include <core/transformations.h>
+#include <core/metadata_extension.h>
+#include <data/bspline_interpolation.h>
+#include <data/fourier_filter.h>
+#include <data/normalize.h>
+#include <data/mask.h>
+#include <thread>
+
+/* Stages ------------------------------------------------------------------ */
+// Apply the alignment in the metadata
+class PreprocessApplyGeo: public PreprocessStage
+{
+public:
+    MultidimArray<double> Iaux;
+    Matrix2D<double> A;
+
+    void apply(MultidimArray<double> &I, MDRow &row)
+    {
+        geo2TransformationMatrix(row, A);
+        if (A.isIdentity())
+            return;
+        I.setXmippOrigin();
+        Iaux.resizeNoCopy(I);
+        Iaux.setXmippOrigin();
+        applyGeometryBSpline(Iaux, I, A, IS_NOT_INV, DONT_WRAP, 0.);
+        I=Iaux;
+        row.resetGeo(false);
+    }
+
+    PreprocessStage* clone() const
+    {
+        return new PreprocessApplyGeo();
+    }
+};
+
+// Wiener correction of the CTF in the metadata
+class PreprocessCTF: public PreprocessStage
+{
+public:
+    ProgCorrectWiener2D wiener;
+
+    PreprocessCTF(double Ts, double pad, double wc, bool phaseFlipped)
+    {
+        wiener.sampling_rate=Ts;
+        wiener.pad=XMIPP_MAX(1.,pad);
+        wiener.wiener_constant=wc;
+        wiener.phase_flipped=phaseFlipped;
+        wiener.isIsotropic=false;
+        wiener.correct_envelope=false;
+    }
+
+    void apply(MultidimArray<double> &I, MDRow &row)
+    {
+        wiener.applyWienerFilter(I, row);
+    }
+
+    PreprocessStage* clone() const
+    {
+        return new PreprocessCTF(wiener.sampling_rate, wiener.pad, wiener.wiener_constant, wiener.phase_flipped);
+    }
+};
+
+// Resize by windowing or padding in Fourier space
+class PreprocessResize: public PreprocessStage
+{
+public:
+    int Xdim, Ydim;
+
+    PreprocessResize(int _Ydim, int _Xdim): Xdim(_Xdim), Ydim(_Ydim) {}
+
+    void apply(MultidimArray<double> &I, MDRow &row)
+    {
+        if ((int)XSIZE(I)!=Xdim || (int)YSIZE(I)!=Ydim)
+            selfScaleToSizeFourier(Ydim, Xdim, I, 1);
+    }
+
+    PreprocessStage* clone() const
+    {
+        return new PreprocessResize(Ydim, Xdim);
+    }
+};
+
+// Low pass filter
+class PreprocessLowPass: public PreprocessStage
+{
+public:
+    double w;
+    FourierFilter filter;
+    bool maskReady;
+
+    PreprocessLowPass(double _w): w(_w), maskReady(false)
+    {
+        filter.FilterShape=RAISED_COSINE;
+        filter.FilterBand=LOWPASS;
+        filter.w1=w;
+        filter.raised_w=0.02;
+    }
+
+    void apply(MultidimArray<double> &I, MDRow &row)
+    {
+        if (!maskReady)
+        {
+            filter.generateMask(I);
+            maskReady=true;
+        }
+        filter.applyMaskSpace(I);
+    }
+
+    PreprocessStage* clone() const
+    {
+        return new PreprocessLowPass(w);
+    }
+};
+
+// Normalization of the background
+class PreprocessNormalize: public PreprocessStage
+{
+public:
+    String method;
+    double radius;
+    MultidimArray<int> bgMask;
+
+    PreprocessNormalize(const String &_method, double _radius): method(_method), radius(_radius) {}
+
+    void apply(MultidimArray<double> &I, MDRow &row)
+    {
+        I.setXmippOrigin();
+        if (method=="OldXmipp")
+        {
+            normalize_OldXmipp(I);
+            return;
+        }
+        if (XSIZE(bgMask)!=XSIZE(I) || YSIZE(bgMask)!=YSIZE(I))
+        {
+            bgMask.resizeNoCopy(I);
+            bgMask.setXmippOrigin();
+            double r=radius>0 ? radius:XSIZE(I)/2;
+            BinaryCircularMask(bgMask, r, OUTSIDE_MASK);
+        }
+        if (method=="Ramp")
+            normalize_ramp(I, &bgMask);
+        else
+            normalize_NewXmipp(I, bgMask);
+    }
+
+    PreprocessStage* clone() const
+    {
+        return new PreprocessNormalize(method, radius);
+    }
+};
+
+// Circular mask
+class PreprocessMask: public PreprocessStage
+{
+public:
+    double radius;
+    MultidimArray<int> mask;
+
+    PreprocessMask(double _radius): radius(_radius) {}
+
+    void apply(MultidimArray<double> &I, MDRow &row)
+    {
+        I.setXmippOrigin();
+        if (XSIZE(mask)!=XSIZE(I) || YSIZE(mask)!=YSIZE(I))
+        {
+            mask.resizeNoCopy(I);
+            mask.setXmippOrigin();
+            double r=radius>0 ? radius:XSIZE(I)/2;
+            BinaryCircularMask(mask, r, INNER_MASK);
+        }
+        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(I)
+        if (!DIRECT_MULTIDIM_ELEM(mask,n))
+            DIRECT_MULTIDIM_ELEM(I,n)=0;
+    }
+
+    PreprocessStage* clone() const
+    {
+        return new PreprocessMask(radius);
+    }
+};
+
+/* Program ----------------------------------------------------------------- */
+ProgImagePreprocessPipeline::ProgImagePreprocessPipeline()
+{
+    currentBatch=NULL;
+    batchDistributor=NULL;
+}
+
+ProgImagePreprocessPipeline::~ProgImagePreprocessPipeline()
+{
+    for (size_t t=0; t<threadStages.size(); ++t)
+        for (size_t s=0; s<threadStages[t].size(); ++s)
+            delete threadStages[t][s];
+}
+
+void ProgImagePreprocessPipeline::defineParams()
+{
+    addUsageLine("Preprocess a set of particles in memory.");
+    addUsageLine("+The stages are applied to each image in the following order: CTF correction, alignment,");
+    addUsageLine("+resizing, low pass filtering, normalization and masking. The input images are read once");
+    addUsageLine("+and only the final stack is written, without intermediate files.");
+    addParamsLine("   -i <metadata>                    : Input images");
+    addParamsLine("   -o <stack>                       : Output stack. The output metadata is written with the same");
+    addParamsLine("                                    : rootname and extension xmd");
+    addParamsLine("  [--apply_geo]                     : Apply the alignment stored in the metadata");
+    addParamsLine("  [--correct_ctf <Ts=1> <pad=2> <wc=-1>] : Wiener correction of the CTF stored in the metadata.");
+    addParamsLine("                                    : Ts is the sampling rate, pad the padding factor and wc");
+    addParamsLine("                                    : the Wiener constant (if < 0, FREALIGN default)");
+    addParamsLine("  [--phase_flipped]                 : The images are already phase flipped");
+    addParamsLine("  [--fourier_resize <Xdim>]         : Resize the images (in Fourier space) to this size");
+    addParamsLine("  [--lowpass <w>]                   : Low pass filter, digital frequency (<0.5)");
+    addParamsLine("  [--normalize <method=NewXmipp> <radius=-1>] : Normalize the background. The radius is that");
+    addParamsLine("                                    : of the particle, by default half the image size");
+    addParamsLine("     where <method>");
+    addParamsLine("           OldXmipp NewXmipp Ramp");
+    addParamsLine("  [--mask <radius=-1>]              : Set to 0 the pixels outside this radius");
+    addParamsLine("  [--thr <N=1>]                     : Number of threads");
+    addParamsLine("  [--batch <N=128>]                 : Number of images read, processed and written together");
+    addExampleLine("xmipp_image_preprocess_pipeline -i particles.xmd -o preprocessed.stk --correct_ctf 1.2 --fourier_resize 128 --normalize NewXmipp 55 --thr 8");
+}
+
+void ProgImagePreprocessPipeline::readParams()
+{
+    fnIn=getParam("-i");
+    fnOut=getParam("-o");
+    applyGeo=checkParam("--apply_geo");
+    correctCTF=checkParam("--correct_ctf");
+    if (correctCTF)
+    {
+        Ts=getDoubleParam("--correct_ctf",0);
+        pad=getDoubleParam("--correct_ctf",1);
+        wc=getDoubleParam("--correct_ctf",2);
+    }
+    phaseFlipped=checkParam("--phase_flipped");
+    XdimOut=checkParam("--fourier_resize") ? getIntParam("--fourier_resize") : -1;
+    lowpass=checkParam("--lowpass") ? getDoubleParam("--lowpass") : -1;
+    normalize=checkParam("--normalize");
+    if (normalize)
+    {
+        normalizeMethod=getParam("--normalize",0);
+        bgRadius=getDoubleParam("--normalize",1);
+    }
+    mask=checkParam("--mask");
+    if (mask)
+        maskRadius=getDoubleParam("--mask");
+    Nthreads=getIntParam("--thr");
+    batchSize=XMIPP_MAX(1,getIntParam("--batch"));
+}
+
+void ProgImagePreprocessPipeline::show()
+{
+    if (verbose==0)
+        return;
+    std::cout << "Input:          " << fnIn << std::endl
+    << "Output:         " << fnOut << std::endl
+    << "Apply geo:      " << applyGeo << std::endl;
+    if (correctCTF)
+        std::cout << "Correct CTF:    Ts=" << Ts << " pad=" << pad << " wc=" << wc
+        << " phase flipped=" << phaseFlipped << std::endl;
+    if (XdimOut>0)
+        std::cout << "Resize to:      " << XdimOut << std::endl;
+    if (lowpass>0)
+        std::cout << "Low pass:       " << lowpass << std::endl;
+    if (normalize)
+        std::cout << "Normalize:      " << normalizeMethod << " radius=" << bgRadius << std::endl;
+    if (mask)
+        std::cout << "Mask radius:    " << maskRadius << std::endl;
+    std::cout << "Threads:        " << Nthreads << std::endl
+    << "Batch size:     " << batchSize << std::endl;
+}
+
+void ProgImagePreprocessPipeline::createStages(std::vector<PreprocessStage *> &stages)
+{
+    stages.clear();
+    // The CTF is corrected before aligning because the defocus angle refers
+    // to the frame of the micrograph, as in ctf_correct_wiener2d followed by
+    // transform_geometry
+    if (correctCTF)
+        stages.push_back(new PreprocessCTF(Ts, pad, wc, phaseFlipped));
+    if (applyGeo)
+        stages.push_back(new PreprocessApplyGeo());
+    if (XdimOut>0)
+        stages.push_back(new PreprocessResize((int)YdimOut, XdimOut));
+    if (lowpass>0)
+        stages.push_back(new PreprocessLowPass(lowpass));
+    if (normalize)
+        stages.push_back(new PreprocessNormalize(normalizeMethod, bgRadius));
+    if (mask)
+        stages.push_back(new PreprocessMask(maskRadius));
+}
+
+void ProgImagePreprocessPipeline::readBatchRows(size_t first, PreprocessBatch &batch)
+{
+    size_t last=XMIPP_MIN(first+batchSize, ids.size());
+    batch.first=first;
+    batch.images.resize(last-first);
+    batch.rows.resize(last-first);
+    for (size_t k=first; k<last; ++k)
+        mdIn.getRow(batch.rows[k-first], ids[k]);
+}
+
+void ProgImagePreprocessPipeline::readBatchImages(PreprocessBatch &batch)
+{
+    Image<double> I;
+    FileName fnImg;
+    for (size_t k=0; k<batch.rows.size(); ++k)
+    {
+        batch.rows[k].getValue(MDL_IMAGE, fnImg);
+        I.read(fnImg);
+        batch.images[k]=I();
+    }
+}
+
+static void threadProcessBatch(ThreadArgument &thArg)
+{
+    ProgImagePreprocessPipeline *self=(ProgImagePreprocessPipeline *)thArg.workClass;
+    std::vector<PreprocessStage *> &stages=self->threadStages[thArg.thread_id];
+    PreprocessBatch &batch=*(self->currentBatch);
+    size_t first, last;
+    while (self->batchDistributor->getTasks(first, last))
+    {
+        for (size_t k=first; k<=last; ++k)
+            for (size_t s=0; s<stages.size(); ++s)
+                stages[s]->apply(batch.images[k], batch.rows[k]);
+    }
+}
+
+void ProgImagePreprocessPipeline::processBatch(PreprocessBatch &batch)
+{
+    currentBatch=&batch;
+    ThreadTaskDistributor distributor(batch.images.size(), 1);
+    batchDistributor=&distributor;
+    ThreadManager thMgr(Nthreads, this);
+    thMgr.run(threadProcessBatch);
+    batchDistributor=NULL;
+    currentBatch=NULL;
+}
+
+void ProgImagePreprocessPipeline::writeBatchImages(PreprocessBatch &batch)
+{
+    Image<double> I;
+    FileName fnImg;
+    for (size_t k=0; k<batch.images.size(); ++k)
+    {
+        size_t idx=batch.first+k+1;
+        I()=batch.images[k];
+        I.write(fnOut, idx, true, WRITE_REPLACE);
+        fnImg.compose(idx, fnOut);
+        batch.rows[k].setValue(MDL_IMAGE, fnImg);
+    }
+}
+
+void ProgImagePreprocessPipeline::writeBatchRows(PreprocessBatch &batch)
+{
+    for (size_t k=0; k<batch.rows.size(); ++k)
+        mdOut.addRow(batch.rows[k]);
+}
+
+void ProgImagePreprocessPipeline::run()
+{
+    show();
+    mdIn.read(fnIn);
+    mdIn.removeDisabled();
+    mdIn.findObjects(ids);
+    size_t Zdim, Ndim;
+    getImageSize(mdIn, Xdim, Ydim, Zdim, Ndim);
+    if (Zdim>1)
+        REPORT_ERROR(ERR_MULTIDIM_DIM, "This program only works with images");
+    if (XdimOut>0)
+        YdimOut=(size_t)round(Ydim*(double)XdimOut/Xdim);
+    else
+    {
+        XdimOut=-1;
+        YdimOut=Ydim;
+    }
+    size_t XdimFinal=XdimOut>0 ? XdimOut:Xdim;
+    createEmptyFile(fnOut, XdimFinal, YdimOut, 1, ids.size(), true, WRITE_REPLACE);
+
+    threadStages.resize(Nthreads);
+    for (int t=0; t<Nthreads; ++t)
+        createStages(threadStages[t]);
+
+    // Read batch b+1 and write batch b-1 while batch b is processed. All the
+    // metadata objects share the same database connection, so the rows are
+    // read and written by this thread and the reader and writer threads only
+    // access the images
+    size_t Nbatches=(ids.size()+batchSize-1)/batchSize;
+    std::vector<PreprocessBatch> buffers(3);
+    if (Nbatches>0)
+    {
+        readBatchRows(0, buffers[0]);
+        readBatchImages(buffers[0]);
+    }
+    std::thread reader, writer;
+    if (verbose)
+        init_progress_bar(Nbatches);
+    for (size_t b=0; b<Nbatches; ++b)
+    {
+        if (b+1<Nbatches)
+        {
+            PreprocessBatch &next=buffers[(b+1)%3];
+            readBatchRows((b+1)*batchSize, next);
+            reader=std::thread(&ProgImagePreprocessPipeline::readBatchImages, this, std::ref(next));
+        }
+        processBatch(buffers[b%3]);
+        if (writer.joinable())
+        {
+            writer.join();
+            writeBatchRows(buffers[(b+2)%3]);
+        }
+        writer=std::thread(&ProgImagePreprocessPipeline::writeBatchImages, this, std::ref(buffers[b%3]));
+        if (reader.joinable())
+            reader.join();
+        if (verbose)
+            progress_bar(b+1);
+    }
+    if (writer.joinable())
+    {
+        writer.join();
+        writeBatchRows(buffers[(Nbatches-1)%3]);
+    }
+    if (correctCTF)
+        ProgCorrectWiener2D::removeCTFLabels(mdOut);
+    mdOut.write(fnOut.withoutExtension()+".xmd");
+}
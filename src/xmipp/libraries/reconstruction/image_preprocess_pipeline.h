@@ -0,0 +1,165 @@
+/***************************************************************************
+ *
+ * Authors:     Carlos Oscar S. Sorzano (coss@cnb.csic.es)
+ *
+ * Unidad de  Bioinformatica of Centro Nacional de Biotecnologia , CSIC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ * 02111-1307  USA
+ *
+ *  All comments concerning this program package may be sent to the
+ *  e-mail address 'xmipp@cnb.csic.es'
+ ***************************************************************************/
+
+#ifndef _PROG_IMAGE_PREPROCESS_PIPELINE
+#define _PROG_IMAGE_PREPROCESS_PIPELINE
+
+#include <vector>
+#include <core/xmipp_program.h>
+#include <core/metadata.h>
+#include <core/multidim_array.h>
+#include <core/xmipp_threads.h>
+
+/**@defgroup ImagePreprocessPipeline Fused preprocessing of particles
+   @ingroup ReconsLibrary */
+//@{
+
+/** Stage of the preprocessing pipeline.
+ * A stage processes one image in memory and may update its metadata row.
+ * Each thread has its own copy of the stages (see clone), so that the stages
+ * can keep work buffers (masks, Fourier transformers, ...).
+ */
+class PreprocessStage
+{
+public:
+    /// Virtual destructor
+    virtual ~PreprocessStage() {}
+
+    /// Process an image
+    virtual void apply(MultidimArray<double> &I, MDRow &row)=0;
+
+    /// Copy of the stage for another thread
+    virtual PreprocessStage* clone() const=0;
+};
+
+/** Images of the pipeline that are read, processed or written together */
+struct PreprocessBatch
+{
+    /// Index of the first image of the batch in the input metadata
+    size_t first;
+    /// Images
+    std::vector< MultidimArray<double> > images;
+    /// Metadata rows
+    std::vector<MDRow> rows;
+};
+
+/** Fused preprocessing of a set of particles.
+ * The usual preprocessing chain (CTF correction, alignment, Fourier resizing,
+ * low pass filtering, normalization and masking) is applied in memory to each
+ * image, so that the input is read once and only the final stack is written.
+ * Images are processed in batches: while one batch is processed by the
+ * threads, the next one is read and the previous one is written.
+ */
+class ProgImagePreprocessPipeline: public XmippProgram
+{
+public:
+    /// Input metadata
+    FileName fnIn;
+    /// Output stack
+    FileName fnOut;
+    /// Apply the alignment in the metadata
+    bool applyGeo;
+    /// Correct the CTF
+    bool correctCTF;
+    /// Sampling rate, padding and Wiener constant for the CTF correction
+    double Ts, pad, wc;
+    /// The images are phase flipped
+    bool phaseFlipped;
+    /// Output size (-1 to keep the input size)
+    int XdimOut;
+    /// Low pass frequency (digital, -1 for no filtering)
+    double lowpass;
+    /// Normalize
+    bool normalize;
+    /// Normalization method (OldXmipp, NewXmipp, Ramp)
+    String normalizeMethod;
+    /// Background radius for the normalization (-1 for half the size)
+    double bgRadius;
+    /// Apply a circular mask
+    bool mask;
+    /// Mask radius (-1 for half the size)
+    double maskRadius;
+    /// Number of threads
+    int Nthreads;
+    /// Number of images per batch
+    size_t batchSize;
+
+public:
+    /// Stages of each thread
+    std::vector< std::vector<PreprocessStage *> > threadStages;
+    /// Batch being processed
+    PreprocessBatch *currentBatch;
+    /// Distributor of the images of the current batch
+    ThreadTaskDistributor *batchDistributor;
+    /// Input and output metadata
+    MetaData mdIn, mdOut;
+    /// Identifiers of the input images
+    std::vector<size_t> ids;
+    /// Input and output sizes
+    size_t Xdim, Ydim, YdimOut;
+
+public:
+    /// Constructor
+    ProgImagePreprocessPipeline();
+
+    /// Destructor
+    ~ProgImagePreprocessPipeline();
+
+    /// Read arguments
+    void readParams();
+
+    /// Define parameters
+    void defineParams();
+
+    /// Show
+    void show();
+
+    /** Create the stages in the order in which they are applied */
+    void createStages(std::vector<PreprocessStage *> &stages);
+
+    /** Read the metadata rows of a batch starting at the input image first.
+     * The metadata must only be accessed from the main thread.
+     */
+    void readBatchRows(size_t first, PreprocessBatch &batch);
+
+    /** Read the images of a batch whose rows have been read */
+    void readBatchImages(PreprocessBatch &batch);
+
+    /** Process a batch with all threads */
+    void processBatch(PreprocessBatch &batch);
+
+    /** Write the images of a processed batch and set their names in the rows */
+    void writeBatchImages(PreprocessBatch &batch);
+
+    /** Add the rows of a written batch to the output metadata.
+     * The metadata must only be accessed from the main thread.
+     */
+    void writeBatchRows(PreprocessBatch &batch);
+
+    /// Run
+    void run();
+};
+//@}
+#endif
@@ -27,7 +27,7 @@
 
 #include <core/metadata.h>
 #include <core/xmipp_program.h>
-#include <core/xmipp_threads.h>
+#include <core/xmipp_image.h>
 #include <classification/pca.h>
 
 #define IS_MASTER (rank == 0)
@@ -35,8 +35,14 @@
 /**@defgroup RotationalPCA Rotational invariant PCA
    @ingroup ReconsLibrary */
 //@{
-/** Rotational invariant PCA parameters. */
-class ProgImageRotationalPCA: public XmippProgram
+/** Rotational invariant PCA parameters.
+ * The eigenimages are the left singular vectors of the matrix whose
+ * columns are all the rotated, shifted and mirrored copies of the input
+ * images. They are computed with a StreamingPCA whose items are the
+ * input images, so that the memory needed does not depend on the number
+ * of images.
+ */
+class ProgImageRotationalPCA: public XmippProgram, public PCASampleSource
 {
 public:
 	/** Input selfile */
@@ -59,36 +65,24 @@ public:
     int Nthreads;
     /** Rank, used later for MPI */
     int rank;
+    /** Number of processes, used later for MPI */
+    int Nprocessors;
 
 public:
-    // Input metadata
+    // Input metadata (one per thread)
     std::vector<MetaData> MD;
     // Number of images
     size_t Nimg;
     // Number of angles
     int Nangles;
+    // Number of shifts in each direction
+    int Nshifts1D;
     // Number of shifts
     int Nshifts;
     // Image size
     size_t Xdim;
     // Number of pixels
     int Npixels;
-    // Mpi node
-    //MpiNode *node;
-    // H buffer
-    std::vector<double *> Hbuffer;
-    // H buffer destination addresses
-    std::vector<double *> HbufferDestination;
-    // Buffer maximum length
-    static const int HbufferMax=20;
-    // Mpi file lock
-    Mutex *fileMutex;
-    // Thread mutex
-    Mutex *threadMutex;
-    // SVD matrix
-    Matrix2D<double> H;
-    // SVD matrix
-    Matrix2D<double> F;
 public:
     // Input image
     std::vector< Image<double> > I;
@@ -96,27 +90,16 @@ public:
     std::vector< MultidimArray<double> > Iaux;
     // Geometric transformation
     std::vector< Matrix2D<double> > A;
-    // H block
-    std::vector< Matrix2D<double> > Hblock;
-    // W node
-    std::vector< Matrix2D<double> > Wnode;
-    // W transpose
-    Matrix2D<double> Wtranspose;
     // Mask
     MultidimArray< unsigned char > mask;
-    // FileTaskDistributor
-    ThreadTaskDistributor *taskDistributor;
-    // Thread Manager
-    ThreadManager *thMgr;
-    // Vector of object ids
+    // Object ids of the images processed by this node
     std::vector<size_t> objId;
+    // PCA
+    StreamingPCA pca;
 public:
     /// Empty constructor
     ProgImageRotationalPCA();
 
-    /// Destructor
-    virtual ~ProgImageRotationalPCA();
-
     /// Read argument from command line
     void readParams();
 
@@ -129,30 +112,19 @@ public:
     /// Produce side info
     void produceSideInfo();
 
-    /** Write to H buffer */
-    void writeToHBuffer(int idx, double *dest);
-
-    /** Flush buffer */
-    void flushHBuffer();
-
-    /** Clear H buffer */
-    void clearHbuffer();
+    /// Dimension of the samples (number of pixels in the mask)
+    size_t getSampleDimension();
 
-    /** Apply T.
-     * W=T(H).
-     */
-    void applyT();
+    /// Number of images processed by this node
+    size_t getNumberOfItems();
 
-    /** Apply Tt.
-     * H=Tt(W).
+    /** All the rotated, shifted and mirrored copies of an image.
+     * Each row of samples contains the pixels within the mask of one copy.
      */
-    void applyTt();
+    void getSamples(size_t item, int thread, Matrix2D<double> &samples);
 
-    /** QR decomposition.
-     * In fact, only Q is computed. It returns the number of columns
-     * of Q different from 0.
-     */
-    int QR();
+    /** Write the eigenimages */
+    void writeResults();
 
     /** Run. */
     void run();
@@ -160,27 +132,6 @@ public:
     /********************** Following functions should be overwritten in MPI version ******/
     /** Read input images */
     virtual void selectPartFromMd(MetaData &MDin);
-
-    /** Comunicate matrix, only meanful for MPI */
-    virtual void comunicateMatrix(Matrix2D<double> &W);
-
-    /** Create mutexes and distributor */
-    virtual void createMutexes(size_t Nimgs);
-
-    /** Last part of function applyT */
-    virtual void allReduceApplyT(Matrix2D<double> &Wnode_0);
-
-    /** Comunicate int param */
-    virtual void comunicateQrDim(int &qrDim);
-
-    /** Map matrix */
-    virtual void mapMatrix(int qrDim);
-
-    /** Apply SVD */
-    virtual void applySVD();
-
-    /** Copy H to F. */
-    virtual void copyHtoF(int block);
 };
 //@}
 #endif
@@ -33,6 +33,7 @@ public:
     FileName fn_in, fn_root;
     bool invert;
     double min_size;
+    int Nthreads;
 
     void readParams()
     {
@@ -40,6 +41,7 @@ public:
         fn_root = getParam("--oroot");
         invert  = checkParam("--invert");
         min_size  = getDoubleParam("--min_size");
+        Nthreads  = getIntParam("--thr");
         if (fn_root == "")
             fn_root = fn_in.withoutExtension();
     }
@@ -59,6 +61,7 @@ public:
         addParamsLine("                           : The output masks are <fn_root>_000001.vol, ...");
         addParamsLine("  [--invert]               : Produce inverse masks");
         addParamsLine("  [--min_size <size=0>]    : Save if size is greater than this");
+        addParamsLine("  [--thr <N=1>]            : Number of threads for labelling the objects");
         addSeeAlsoLine("transform_morphology, transform_threshold, transform_mask, volume_segment");
     }
 
@@ -70,9 +73,9 @@ public:
         I.read(fn_in);
         int object_no;
         if (ZSIZE(I())==1)
-            object_no=labelImage2D(I(), label());
+            object_no=labelImage2D(I(), label(), 8, Nthreads);
         else
-            object_no=labelImage3D(I(), label());
+            object_no=labelImage3D(I(), label(), Nthreads);
         for (int o = 0; o <= object_no; o++)
         {
             I() = label();
@@ -35,7 +35,9 @@
 int flagAbort=0;
 
 AutoParticlePicking2::AutoParticlePicking2()
-{}
+{
+    Nthreads=1;
+}
 
 AutoParticlePicking2::AutoParticlePicking2(int pSize, int filterNum, int corrNum, int basisPCA,
         const FileName &model_name, const std::vector<MDRow> &vMicList)
@@ -48,6 +50,7 @@ AutoParticlePicking2::AutoParticlePicking2(int pSize, int filterNum, int corrNum
     fnVector=fn_model+"_training.txt";
     fnSVMModel=fn_model+"_svm.txt";
     fnSVMModel2=fn_model+"_svm2.txt";
+    Nthreads=1;
     fnInvariant=fn_model+"_invariant";
     fnParticles=fn_model+"_particle";
 
@@ -109,6 +112,7 @@ void AutoParticlePicking2::readMic(const FileName &fn_micrograph, int keepPrev)
         microImagePrev=microImage;
         micrographStackPre=micrographStack;
     }
+    m.setNthreads(Nthreads);
     m.open_micrograph(fn_micrograph);
     microImage.read(fn_micrograph);
     // Resize the Micrograph
@@ -539,15 +543,52 @@ void AutoParticlePicking2::saveTrainingSet()
     fhTrain.close();
 }
 
+void AutoParticlePicking2::classifyCandidates(int num, const std::vector<Particle2> &positionArray)
+{
+    // Normalize the feature vectors of the candidates between 0 and 1
+    MultidimArray<double> featMatrix, labels, scores;
+    featMatrix.initZeros(num,num_features);
+    for (int k=0;k<num;k++)
+    {
+        double max=DIRECT_A2D_ELEM(autoFeatVec,k,0);
+        double min=max;
+        for (int i=1;i<num_features;i++)
+        {
+            double f=DIRECT_A2D_ELEM(autoFeatVec,k,i);
+            if (f>max)
+                max=f;
+            else if (f<min)
+                min=f;
+        }
+        for (int i=0;i<num_features;i++)
+            DIRECT_A2D_ELEM(featMatrix,k,i)=(DIRECT_A2D_ELEM(autoFeatVec,k,i)-min)/(max-min);
+    }
+
+    // Classify all of them at once
+    classifier.predict(featMatrix,labels,scores,Nthreads);
+
+    Particle2 p;
+    p.vec.resizeNoCopy(num_features);
+    for (int k=0;k<num;k++)
+        if (DIRECT_A1D_ELEM(labels,k)==1)
+        {
+            p.x=positionArray[k].x;
+            p.y=positionArray[k].y;
+            p.status=1;
+            p.cost=DIRECT_A1D_ELEM(scores,k);
+            for (int i=0;i<num_features;i++)
+                DIRECT_A1D_ELEM(p.vec,i)=DIRECT_A2D_ELEM(autoFeatVec,k,i);
+            auto_candidates.push_back(p);
+        }
+}
+
 int AutoParticlePicking2::automaticallySelectParticles(FileName fnmicrograph, int proc_prec, std::vector<MDRow> &md)
 {
     // bool error=MDSql::deactivateThreadMuting();
     auto_candidates.clear();
     //    md.clear();
 
-    double label, score;
     Particle2 p;
-    MultidimArray<double> featVec, featVecNN;
     std::vector<Particle2> positionArray;
 
     if (thread == NULL)
@@ -574,41 +615,8 @@ int AutoParticlePicking2::automaticallySelectParticles(FileName fnmicrograph, in
     //    generateFeatVec(fnmicrograph,proc_prec,positionArray);
     //    classifier.LoadModel(fnSVMModel);
     int num=(int)(positionArray.size()*(proc_prec/100.0));
-    featVec.resize(num_features);
     //    negative_candidates.clear();
-
-    for (int k=0;k<num;k++)
-    {
-        FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY1D(featVec)
-        DIRECT_A1D_ELEM(featVec,i)=DIRECT_A2D_ELEM(autoFeatVec,k,i);
-        featVecNN=featVec;
-        double max=featVec.computeMax();
-        double min=featVec.computeMin();
-        FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY1D(featVec)
-        DIRECT_A1D_ELEM(featVec,i)=0+((1)*((DIRECT_A1D_ELEM(featVec,i)-min)/(max-min)));
-        int j=positionArray[k].x;
-        int i=positionArray[k].y;
-        label= classifier.predict(featVec, score);
-        if (label==1)
-        {
-            p.x=j;
-            p.y=i;
-            p.status=1;
-            p.cost=score;
-            p.vec=featVecNN;
-            auto_candidates.push_back(p);
-
-        }
-        //        else
-        //        {
-        //            p.x=j;
-        //            p.y=i;
-        //            p.status=1;
-        //            p.cost=score;
-        //            p.vec=featVecNN;
-        //            negative_candidates.push_back(p);
-        //        }
-    }
+    classifyCandidates(num,positionArray);
     if (auto_candidates.size() == 0)
         return 0;
     // Remove the occluded particles
@@ -653,39 +661,14 @@ int AutoParticlePicking2::automaticWithouThread(FileName fnmicrograph, int proc_
     // Read the SVM model
     //    classifier.LoadModel(fnSVMModel);
 
-    double label, score;
     Particle2 p;
-    MultidimArray<double> featVec, featVecNN;
     std::vector<Particle2> positionArray;
     MetaData md;
 
     generateFeatVec(fnmicrograph,proc_prec,positionArray);
 
     int num=(int)(positionArray.size()*(proc_prec/100.0));
-    featVec.resize(num_features);
-    for (int k=0;k<num;k++)
-    {
-        FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY1D(featVec)
-        DIRECT_A1D_ELEM(featVec,i)=DIRECT_A2D_ELEM(autoFeatVec,k,i);
-        featVecNN=featVec;
-        double max=featVec.computeMax();
-        double min=featVec.computeMin();
-        FOR_ALL_DIRECT_ELEMENTS_IN_ARRAY1D(featVec)
-        DIRECT_A1D_ELEM(featVec,i)=0+((1)*((DIRECT_A1D_ELEM(featVec,i)-min)/(max-min)));
-        int j=positionArray[k].x;
-        int i=positionArray[k].y;
-        label= classifier.predict(featVec, score);
-        if (label==1)
-        {
-            p.x=j;
-            p.y=i;
-            p.status=1;
-            p.cost=score;
-            p.vec=featVecNN;
-            auto_candidates.push_back(p);
-
-        }
-    }
+    classifyCandidates(num,positionArray);
 
     if (auto_candidates.size() == 0)
         return 0;
@@ -1166,12 +1149,12 @@ void AutoParticlePicking2::trainSVM(const FileName &fnModel,
 
     if (numClassifier==1)
     {
-        classifier.SVMTrain(dataSetNormal,classLabel);
+        classifier.SVMTrain(dataSetNormal,classLabel,Nthreads);
         classifier.SaveModel(fnModel);
     }
     else
     {
-        classifier2.SVMTrain(dataSet1,classLabel1);
+        classifier2.SVMTrain(dataSet1,classLabel1,Nthreads);
         classifier2.SaveModel(fnModel);
     }
 }
@@ -1820,6 +1803,8 @@ void ProgMicrographAutomaticPicking2::run()
     MD.read(fn_model.beforeLastOf("/")+"/config.xmd");
     MD.getValue( MDL_PICKING_AUTOPICKPERCENT,proc_prec,MD.firstObject());
 
+    int Nthreads=autoPicking->Nthreads;
     autoPicking = new AutoParticlePicking2(autoPicking->particle_size,autoPicking->filter_num,autoPicking->corr_num,autoPicking->NPCA,fn_model,std::vector<MDRow>());
+    autoPicking->Nthreads=Nthreads;
     autoPicking->automaticWithouThread(fn_micrograph,proc_prec,fnAutoParticles);
 }
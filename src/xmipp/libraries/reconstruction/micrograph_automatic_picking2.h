@@ -146,6 +146,9 @@ public:
 
     void saveTrainingSet();
 
+    /// Classify the first num candidates of autoFeatVec and keep the particles in auto_candidates
+    void classifyCandidates(int num, const std::vector<Particle2> &positionArray);
+
 //    int automaticallySelectParticles(FileName fnmicrograph, int proc_prec, MetaData &md);
 
     int automaticallySelectParticles(FileName fnmicrograph, int proc_prec, std::vector<MDRow> &md);
@@ -1081,6 +1081,7 @@ void ProgMLRefine3D::postProcessVolumes()
                     segm_prm.fn_vol = fn_vol;
                     segm_prm.fn_mask = fn_vol + ".solv";
                     segm_prm.do_prob = true;
+                    segm_prm.Nthreads = ml2d->threads;
                     segm_prm.show();
                     segm_prm.produce_side_info();
                     segm_prm.segment(Vsolv);
@@ -1120,7 +1121,7 @@ void ProgMLRefine3D::postProcessVolumes()
                     int object_no;
                     double nr_vox, max_vox = 0.;
                     Image<double> label;
-                    object_no = labelImage3D(Vsolv(), label());
+                    object_no = labelImage3D(Vsolv(), label(), ml2d->threads);
                     max_vox = 0;
                     for (int o = 0; o <= object_no; o++)
                     {
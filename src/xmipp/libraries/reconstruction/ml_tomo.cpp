@@ -83,6 +83,12 @@ ProgMLTomo::defineParams()
         " [ --dont_limit_psirange ]       : Exhaustive psi searches when using -ang_search (only for c1 symmetry)");
     addParamsLine(
         " [ --limit_trans <float=-1.> ]   : Maximum allowed shifts (negative value means no restriction)");
+    addParamsLine(
+        " [ --frm_presearch <int=0> ]     : Only search around the N best rotations per reference found by FRM ");
+    addParamsLine(
+        "                                 : (Fast Rotational Matching of the Fourier amplitudes, only for c1 symmetry)");
+    addParamsLine(
+        " [ --frm_radius <float=20.> ]    : Angular search range (in degrees) around the FRM rotations");
     addParamsLine(
         " [ --tilt0+ <float=0> ]          : Limit tilt angle search from tilt0 to tiltF (in degrees) ");
     addParamsLine(
@@ -361,6 +367,8 @@ ProgMLTomo::readParams()
     ang_search = getDoubleParam("--ang_search");
     do_limit_psirange = !checkParam("--dont_limit_psirange");
     limit_trans = getDoubleParam("--limit_trans");
+    frm_presearch = getIntParam("--frm_presearch");
+    frm_radius = getDoubleParam("--frm_radius");
 
     // Skip rotation, only translate and classify
     dont_rotate = checkParam("--dont_rotate");
@@ -554,6 +562,10 @@ ProgMLTomo::show()
                     << "                          : but with complete psi searches"
                     << std::endl;
             }
+            if (frm_presearch > 0)
+                std::cout << "  FRM pre-search          : " << frm_presearch
+                << " rotations per reference, " << frm_radius << " degrees"
+                << std::endl;
         }
         if (limit_trans >= 0.)
             std::cout << "  Maximum allowed shifts  : " << limit_trans << " pixels"
@@ -815,6 +827,7 @@ ProgMLTomo::produceSideInfo()
                 ERR_ARG_MISSING,
                 "Options --dont_align, --dont_rotate and --only_average require that angle information is present in input images metadata");
         ang_search = -1.;
+        frm_presearch = 0;
     }
     else
     {
@@ -843,6 +856,9 @@ ProgMLTomo::produceSideInfo()
             if (!do_limit_psirange && ang_search > 0.)
                 REPORT_ERROR(ERR_ARG_INCORRECT,
                              "exhaustive psi-angle search only allowed for C1 symmetry");
+            if (frm_presearch > 0)
+                REPORT_ERROR(ERR_ARG_INCORRECT,
+                             "FRM pre-search only allowed for C1 symmetry");
         }
         mysampling.fillLRRepository();
         // by default max_tilt= 180, min_tilt= 0
@@ -853,6 +869,9 @@ ProgMLTomo::produceSideInfo()
         if (psi_sampling < 0)
             psi_sampling = angular_sampling;
 
+        // Fast rotational search up to the maximum resolution
+        if (frm_presearch > 0)
+            frm.setup(dim, maxres);
     }
     readMissingInfo();////////////////////////////
     // Get number of references
@@ -1750,6 +1769,52 @@ ProgMLTomo::maskSphericalAverageOutside(MultidimArray<double> &Min)
     }
 }
 
+void
+ProgMLTomo::getFRMAllowedAngles(const MultidimArray<double> &Mimg,
+                                const MultidimArray<unsigned char> &Mmissing,
+                                std::vector<bool> &allowed)
+{
+    // Best rotations of the image against all references
+    std::vector<Matrix2D<double> > candidates;
+    std::vector<FRMRotation> rotations;
+    MultidimArray<double> measured;
+    Matrix2D<double> E;
+    if (do_missing)
+        typeCast(Mmissing, measured);
+    for (int refno = 0; refno < nr_ref; refno++)
+    {
+        frm.search(frmReferences[refno], Mimg, do_missing ? &measured : NULL,
+                   frm_presearch, rotations);
+        for (size_t i = 0; i < rotations.size(); i++)
+        {
+            Euler_angles2matrix(rotations[i].rot, rotations[i].tilt, rotations[i].psi, E);
+            candidates.push_back(E);
+        }
+    }
+
+    // Allow the orientations around each of them
+    // (at least the closest one, in case the sampling is coarser than frm_radius)
+    allowed.assign(nr_ang, false);
+    for (size_t c = 0; c < candidates.size(); c++)
+    {
+        int closest = 0;
+        double closest_dist = 360.;
+        for (int angno = 0; angno < nr_ang; angno++)
+        {
+            double dist = FRMRotationalSearch::rotationDistance(candidates[c],
+                          all_angle_info[angno].A);
+            if (dist <= frm_radius)
+                allowed[angno] = true;
+            if (dist < closest_dist)
+            {
+                closest_dist = dist;
+                closest = angno;
+            }
+        }
+        allowed[closest] = true;
+    }
+}
+
 void
 ProgMLTomo::reScaleVolume(MultidimArray<double> &Min, bool down_scale)
 {
@@ -2094,6 +2159,11 @@ ProgMLTomo::expectationSingleImage(MultidimArray<double> &Mimg, int imgno,
     local_transformer.inverseFourierTransform();
     myXi2 = Maux.sum2();
 
+    // Restrict the orientations to those close to the FRM rotations
+    std::vector<bool> frm_allowed;
+    if (frm_presearch > 0 && !dont_align && !dont_rotate)
+        getFRMAllowedAngles(Mimg, Mmissing, frm_allowed);
+
     // To avoid numerical problems, subtract smallest difference from all differences.
     // That way: Pmax will be one and all other probabilities will be [0,1>
     // But to find mindiff I first have to loop over all hidden variables...
@@ -2171,6 +2241,8 @@ ProgMLTomo::expectationSingleImage(MultidimArray<double> &Mimg, int imgno,
             {
                 is_a_neighbor = true;
             }
+            if (is_a_neighbor && !frm_allowed.empty())
+                is_a_neighbor = frm_allowed[angno];
 
             // If it is in the neighborhood: proceed
             if (is_a_neighbor)
@@ -2493,6 +2565,11 @@ ProgMLTomo::maxConstrainedCorrSingleImage(MultidimArray<double> &Mimg,
         Fimg0 = Faux;
     Mimg0 = Maux;
 
+    // Restrict the orientations to those close to the FRM rotations
+    std::vector<bool> frm_allowed;
+    if (frm_presearch > 0 && !dont_align && !dont_rotate && !do_only_average)
+        getFRMAllowedAngles(Mimg, Mmissing, frm_allowed);
+
     if (do_only_average)
     {
         maxcorr = 1.;
@@ -2555,6 +2632,8 @@ ProgMLTomo::maxConstrainedCorrSingleImage(MultidimArray<double> &Mimg,
             {
                 is_a_neighbor = true;
             }
+            if (is_a_neighbor && !frm_allowed.empty())
+                is_a_neighbor = frm_allowed[angno];
             // If it is in the neighborhoood: proceed
             if (is_a_neighbor)
             {
@@ -2867,6 +2946,14 @@ ProgMLTomo::expectation(MetaData &MDimg, std::vector<Image<double> > &Iref,
         calculatePdfTranslations();
     }
 
+    // Spherical harmonics of the references for the FRM pre-search
+    if (frm_presearch > 0)
+    {
+        frmReferences.resize(nr_ref);
+        for (int refno = 0; refno < nr_ref; refno++)
+            frm.computeReference(Iref[refno](), frmReferences[refno]);
+    }
+
     // Initialize weighted sums
     LL = 0.;
     wsum_sigma_noise = 0.;
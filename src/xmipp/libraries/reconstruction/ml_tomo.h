@@ -39,6 +39,7 @@
 #include <data/sampling.h>
 #include <core/symmetries.h>
 #include "symmetrize.h"
+#include "frm_rotational_search.h"
 #include <core/xmipp_threads.h>
 #include <vector>
 #include <core/xmipp_program.h>
@@ -152,6 +153,14 @@ public:
     bool do_limit_psirange;
     /** Prohibit translations larger than this value */
     double limit_trans;
+    /** Number of FRM rotations per reference that restrict the angular search (0=no pre-search) */
+    int frm_presearch;
+    /** Only orientations closer than this (in degrees) to the FRM rotations are searched */
+    double frm_radius;
+    /** Fast rotational search */
+    FRMRotationalSearch frm;
+    /** Spherical harmonics of the references for the fast rotational search */
+    std::vector<FRMReference> frmReferences;
     /** Perturb angular sampling */
     bool do_perturb;
     /** Low-pass filter at FSC=0.5 resolution in each step */
@@ -293,6 +302,15 @@ public:
 
     void maskSphericalAverageOutside(MultidimArray<double> &Min);
 
+    /** Orientations allowed by the FRM pre-search.
+     * allowed[angno] is true if the orientation angno is closer than frm_radius
+     * to any of the best FRM rotations of the image against the references.
+     * Mmissing is only used if do_missing.
+     */
+    void getFRMAllowedAngles(const MultidimArray<double> &Mimg,
+                             const MultidimArray<unsigned char> &Mmissing,
+                             std::vector<bool> &allowed);
+
     // Resize a volume, based on the max_resol
     // if down_scale=true: go from oridim to dim
     // if down_scale=false: go from dim to oridim
@@ -1443,10 +1443,11 @@ void ProgMLF2D::fourierTranslate2D(const std::vector<double> &in,
                                    std::vector<double> &out,
                                    int point_start)
 {
-    double xx, yy, xxshift, yyshift, dotp;
     double a, b, c, d, ac, bd, ab_cd;
-    xxshift = -trans(0) / (double)dim;
-    yyshift = -trans(1) / (double)dim;
+    // The translations are integer, so the phases are taken from the
+    // precomputed roots of unity of the shifter
+    shifter.initialize(dim, dim);
+    shifter.setShift(trans(0), trans(1));
     //Not very clean, but very fast
     const double * ptrIn = &(in[point_start]);
     int * ptrJ = &(pointer_j[0]);
@@ -1454,11 +1455,9 @@ void ProgMLF2D::fourierTranslate2D(const std::vector<double> &in,
 
     for (size_t i = 0; i < nr_points_2d; i++)
     {
-        xx = (double)ptrJ[i];
-        yy = (double)ptrI[i];
-        dotp = 2 * PI * (xx * xxshift + yyshift * yy);
-        a = cos(dotp);
-        b = sin(dotp);
+        std::complex<double> phase = shifter.phase(ptrI[i], ptrJ[i]);
+        a = phase.real();
+        b = phase.imag();
         c = *ptrIn++;//in[point_start + 2*i];
         d = *ptrIn++;//in[point_start + 2*i+1];
         ac = a * c;
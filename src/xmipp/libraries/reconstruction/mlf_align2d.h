@@ -28,6 +28,7 @@
 
 #include "ml2d.h"
 #include <numeric>
+#include <data/fourier_shift.h>
 
 /**@defgroup MLFalign2D mlf_align2d (Maximum likelihood in 2D in Fourier space)
    @ingroup ReconsLibrary */
@@ -125,6 +126,8 @@ public:
     /** Pointers to the 2D matrices (in FourierTransformHalf format) */
     std::vector<int> pointer_2d, pointer_i, pointer_j;
     size_t nr_points_prob, nr_points_2d, dnr_points_2d;
+    /** Phase tables of the translations in Fourier space */
+    FourierShifter shifter;
     /** Current highest resolution shell */
     size_t current_highres_limit;
 
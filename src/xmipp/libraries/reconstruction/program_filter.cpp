@@ -61,6 +61,8 @@ void ProgFilter::defineParams()
     addExampleLine("xmipp_transform_filter  -i volume.vol -o volumeFiltered.vol -f band_pass 0.1 0.3");
     addExampleLine("xmipp_transform_filter  -i image.ser  -o imageFiltered.xmp --background plane");
     addExampleLine("xmipp_transform_filter  -i smallStack.stk -o smallFiltered.stk -w DAUB12 difussion");
+    addExampleLine("Bayesian wavelet denoising of a tomogram in single precision with 8 threads",false);
+    addExampleLine("xmipp_transform_filter  -i tomogram.mrc -o tomogramFiltered.mrc --wavelet LIFTING bayesian 0.1 0.2 --scale 2 --thr 8");
     addExampleLine("Filter a volume using a wedge mask rotated 10 degress",false);
     addExampleLine("xmipp_transform_filter  --fourier wedge  -60 60 0 0 10 -i ico.spi -o kk0.spi --verbose");
     addExampleLine("Save filtering mask (do not filter)",false);
@@ -73,6 +75,7 @@ void ProgFilter::defineParams()
 void ProgFilter::readParams()
 {
 	readCTF=false;
+    bool isWavelet=false;
     XmippMetadataProgram::readParams();
 
     if (checkParam("--fourier"))
@@ -83,7 +86,10 @@ void ProgFilter::readParams()
         	readCTF=true;
     }
     else if (checkParam("--wavelet"))
+    {
         filter = new WaveletFilter();
+        isWavelet=true;
+    }
     else if (checkParam("--bad_pixels"))
         filter = new BadPixelFilter();
     else if (checkParam("--mean_shift"))
@@ -108,6 +114,15 @@ void ProgFilter::readParams()
         REPORT_ERROR(ERR_ARG_MISSING, "You should provide some filter");
     //Read params
     filter->readParams(this);
+
+    // The lifting Bayesian denoising does not need double precision, which
+    // halves the memory needed by large tomograms
+    singlePrecision=false;
+    if (isWavelet)
+    {
+        WaveletFilter *wavelet=(WaveletFilter *)filter;
+        singlePrecision=wavelet->DWT_type=="LIFTING" && wavelet->denoising_type==WaveletFilter::BAYESIAN;
+    }
 }
 
 void ProgFilter::preProcess()
@@ -118,6 +133,14 @@ void ProgFilter::preProcess()
 
 void ProgFilter::processImage(const FileName &fnImg, const FileName &fnImgOut, const MDRow &rowIn, MDRow &rowOut)
 {
+    if (singlePrecision)
+    {
+        Image<float> imgFloat;
+        imgFloat.read(fnImg);
+        ((WaveletFilter *)filter)->apply(imgFloat());
+        imgFloat.write(fnImgOut);
+        return;
+    }
     Image<double> img;
     img.read(fnImg);
     if (readCTF)
@@ -36,6 +36,9 @@ private:
     // Read CTF
     bool readCTF;
 
+    // Process the images in single precision
+    bool singlePrecision;
+
 protected:
     void defineParams();
     void readParams();
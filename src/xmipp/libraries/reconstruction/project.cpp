@@ -36,6 +36,7 @@ void ProgProject::readParams()
     fnPhantom = getParam("-i");
     fnOut = getParam("-o");
     samplingRate  = getDoubleParam("--sampling_rate");
+    Nthreads = getIntParam("--thr");
     singleProjection = false;
     if (STR_EQUAL(getParam("--method"), "real_space"))
         projType = REALSPACE;
@@ -95,6 +96,7 @@ void ProgProject::defineParams()
     addParamsLine("   -i <volume_file>                           : Voxel volume, PDB or description file");
     addParamsLine("   -o <image_file>                            : Output stack or image");
     addParamsLine("  [--sampling_rate <Ts=1>]                    : It is only used for PDB phantoms");
+    addParamsLine("  [--thr <N=1>]                               : Number of threads, it is only used for description files");
     addParamsLine("  [--method <method=real_space>]              : Projection method");
     addParamsLine("        where <method>");
     addParamsLine("                real_space                    : Makes projections by ray tracing in real space");
@@ -883,6 +885,7 @@ void PROJECT_Side_Info::produce_Side_Info(ParametersProjection &prm,
     if (prog_prm.fnPhantom.isMetaData())
     {
         phantomDescr.read(prog_prm.fnPhantom);
+        phantomDescr.Nthreads = prog_prm.Nthreads;
         phantomMode = XMIPP;
         if (prog_prm.singleProjection)
         {
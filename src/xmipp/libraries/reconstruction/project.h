@@ -83,6 +83,8 @@ public:
     double maxFrequency;
     /// The type of interpolation (NEAR
     int BSplineDeg;
+    /// Number of threads for the projection of geometric descriptions
+    int Nthreads;
 
 public:
     /** Read parameters. */
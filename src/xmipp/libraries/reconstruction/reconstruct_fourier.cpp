@@ -27,6 +27,9 @@
  ***************************************************************************/
 
 #include "reconstruct_fourier.h"
+#include <cstdio>
+#include <fstream>
+#include <set>
 
 // Define params
 void ProgRecFourier::defineParams()
@@ -52,8 +55,18 @@ void ProgRecFourier::defineParams()
     addParamsLine("  [--phaseFlipped]               : Give this flag if images have been already phase flipped");
     addParamsLine("  [--minCTF <ctf=0.01>]          : Minimum value of the CTF that will be inverted");
     addParamsLine("                                 : CTF values (in absolute value) below this one will not be corrected");
+    addParamsLine("  [--checkpoint <root> <images=1000>] : Save the accumulated Fourier volume and weights every this number of images");
+    addParamsLine("                                 : (root.xmd, root_Fourier.raw and root_Weights.raw). If root.xmd exists,");
+    addParamsLine("                                 : the reconstruction is resumed and the images already accumulated are skipped");
+    addParamsLine("  [--merge <...>]                : Root names of the accumulators (see --checkpoint) of other jobs to be added.");
+    addParamsLine("                                 : The images already accumulated in them are skipped");
+    Profiler::defineParams(this);
     addExampleLine("For reconstruct enforcing i3 symmetry and using stored weights:", false);
     addExampleLine("   xmipp_reconstruct_fourier  -i reconstruction.sel --sym i3 --weight");
+    addExampleLine("For reconstructing two halves of a dataset in independent jobs and merging them:", false);
+    addExampleLine("   xmipp_reconstruct_fourier  -i half1.xmd -o half1.vol --checkpoint half1");
+    addExampleLine("   xmipp_reconstruct_fourier  -i half2.xmd -o half2.vol --checkpoint half2");
+    addExampleLine("   xmipp_reconstruct_fourier  -i all.xmd -o all.vol --merge half1 half2");
 }
 
 // Read arguments ==========================================================
@@ -79,6 +92,22 @@ void ProgRecFourier::readParams()
     minCTF = getDoubleParam("--minCTF");
     if (useCTF)
         Ts=getDoubleParam("--sampling");
+    if (checkParam("--checkpoint"))
+    {
+        fn_checkpoint = getParam("--checkpoint");
+        checkpointImages = getIntParam("--checkpoint", 1);
+    }
+    periodicCheckpoint = true;
+    Profiler::readParams(this);
+    if (checkParam("--merge"))
+        getListParam("--merge", fn_merge);
+    if (!fn_checkpoint.empty() || !fn_merge.empty())
+    {
+        if (NiterWeight>1)
+            REPORT_ERROR(ERR_ARG_INCORRECT,"--checkpoint and --merge cannot be used with more than one weight iteration");
+        if (!fn_fsc.empty())
+            REPORT_ERROR(ERR_ARG_INCORRECT,"--checkpoint and --merge cannot be used with --prepare_fsc");
+    }
 }
 
 // Show ====================================================================
@@ -97,6 +126,11 @@ void ProgRecFourier::show()
             std::cout << " Symmetry file for projections : "  << fn_sym << std::endl;
         if (fn_fsc != "")
             std::cout << " File root for FSC files: " << fn_fsc << std::endl;
+        if (fn_checkpoint != "")
+            std::cout << " Checkpoint root           : " << fn_checkpoint
+            << " (every " << checkpointImages << " images)" << std::endl;
+        for (size_t n=0; n<fn_merge.size(); ++n)
+            std::cout << " Merge accumulator         : " << fn_merge[n] << std::endl;
         if (do_weights)
             std::cout << " Use weights stored in the image headers or doc file" << std::endl;
         else
@@ -121,6 +155,8 @@ void ProgRecFourier::run()
 {
     show();
     produceSideinfo();
+    addAccumulators();
+    lastCheckpointIndex = 0;
     // Process all images in the selfile
     if (verbose)
     {
@@ -148,6 +184,8 @@ void ProgRecFourier::run()
 
     //Computing interpolated volume
     processImages(0, SF.size() - 1, !fn_fsc.empty(), false);
+    if (!fn_checkpoint.empty())
+        saveAccumulator(fn_checkpoint, (int)SF.size() - 1);
 
     // Correcting the weights
     correctWeight();
@@ -179,6 +217,7 @@ void ProgRecFourier::run()
 
 void ProgRecFourier::produceSideinfo()
 {
+    XMIPP_PROFILE_SCOPE("produceSideinfo", PROFILE_IO);
     // Translate the maximum resolution to digital frequency
     // maxResolution=sampling_rate/maxResolution;
     maxResolution2=maxResolution*maxResolution;
@@ -198,6 +237,7 @@ void ProgRecFourier::produceSideinfo()
     if (Ydim!=Xdim)
         REPORT_ERROR(ERR_MULTIDIM_SIZE,"This algorithm only works for squared images");
     imgSize=Xdim;
+    removeAccumulatedImages();
     volPadSizeX = volPadSizeY = volPadSizeZ=(int)(Xdim*padding_factor_vol);
     Vout().initZeros(volPadSizeZ,volPadSizeY,volPadSizeX);
 
@@ -355,7 +395,11 @@ void * ProgRecFourier::processImageThread( void * threadArgs )
                     //Read projection from selfile, read also angles and shifts if present
                     //but only apply shifts
 
-                    proj.readApplyGeo(*(threadParams->selFile), objId[threadParams->imageIndex], params);
+                    {
+                        XMIPP_PROFILE_SCOPE("readImage", PROFILE_IO);
+                        proj.readApplyGeo(*(threadParams->selFile), objId[threadParams->imageIndex], params);
+                    }
+                    XMIPP_PROFILE_COUNT("images read", 1);
                     rot  = proj.rot();
                     tilt = proj.tilt();
                     psi  = proj.psi();
@@ -398,6 +442,7 @@ void * ProgRecFourier::processImageThread( void * threadArgs )
                         CenterFFT(localPaddedImg,true);
 
                         // Fourier transformer for the images
+                        XMIPP_PROFILE_SCOPE("imageFFT", PROFILE_FFT);
                         localTransformerImg.setReal(localPaddedImg);
                         localTransformerImg.FourierTransform();
                         localTransformerImg.getFourierAlias(localPaddedFourier);
@@ -448,6 +493,7 @@ void * ProgRecFourier::processImageThread( void * threadArgs )
             return NULL;
         case PROCESS_WEIGHTS:
             {
+                XMIPP_PROFILE_SCOPE("correctWeights", PROFILE_COMPUTE);
 
                 // Get a first approximation of the reconstruction
                 double corr2D_3D=pow(parent->padding_factor_proj,2.)/
@@ -478,6 +524,7 @@ void * ProgRecFourier::processImageThread( void * threadArgs )
                 MultidimArray< std::complex<double> > *paddedFourier = threadParams->paddedFourier;
                 if (threadParams->weight==0.0)
                     break;
+                XMIPP_PROFILE_SCOPE("interpolate", PROFILE_INTERPOLATION);
                 bool reprocessFlag = threadParams->reprocessFlag;
                 int * statusArray = parent->statusArray;
 
@@ -1005,6 +1052,13 @@ void ProgRecFourier::processImages( int firstImageIndex, int lastImageIndex, boo
                 }
             }
         }
+
+        if (periodicCheckpoint && !fn_checkpoint.empty() && !reprocessFlag && !saveFSC && processed &&
+            imgIndex - lastCheckpointIndex >= checkpointImages)
+        {
+            saveAccumulator(fn_checkpoint, imgIndex - 1);
+            lastCheckpointIndex = imgIndex;
+        }
     }
     while ( processed );
 
@@ -1049,8 +1103,134 @@ void ProgRecFourier::processImages( int firstImageIndex, int lastImageIndex, boo
     }
 }
 
+String ProgRecFourier::accumulatorSignature()
+{
+    String retval=formatString("padding=%g,%g blob=%g,%d,%g max_resolution=%g sym=%s weight=%d",
+                               padding_factor_proj, padding_factor_vol, blob.radius, blob.order, blob.alpha,
+                               maxResolution, fn_sym.c_str(), (int)do_weights);
+    if (useCTF)
+        retval+=formatString(" ctf sampling=%g phaseFlipped=%d minCTF=%g", Ts, (int)phaseFlipped, minCTF);
+    return retval;
+}
+
+void ProgRecFourier::removeAccumulatedImages()
+{
+    accumulatorsIn.clear();
+    mdAccumulated.clear();
+    // A checkpoint from a previous run already contains the merged accumulators
+    if (!fn_checkpoint.empty() && FileName(fn_checkpoint+".xmd").exists())
+        accumulatorsIn.push_back(fn_checkpoint);
+    else
+        for (size_t n=0; n<fn_merge.size(); ++n)
+            accumulatorsIn.push_back(fn_merge[n]);
+    if (accumulatorsIn.empty())
+        return;
+
+    String signature=accumulatorSignature(), otherSignature;
+    std::set<String> accumulated;
+    MetaData mdInfo, mdImages;
+    FileName fnImg;
+    for (size_t n=0; n<accumulatorsIn.size(); ++n)
+    {
+        const FileName &fnRoot=accumulatorsIn[n];
+        mdInfo.read((String)"accumulator@"+fnRoot+".xmd");
+        mdInfo.getValue(MDL_COMMENT,otherSignature,mdInfo.firstObject());
+        if (otherSignature!=signature)
+            REPORT_ERROR(ERR_ARG_INCORRECT,formatString("Accumulator %s was computed with different parameters (%s)",
+                         fnRoot.c_str(),otherSignature.c_str()));
+        mdImages.read((String)"images@"+fnRoot+".xmd");
+        FOR_ALL_OBJECTS_IN_METADATA(mdImages)
+        {
+            mdImages.getValue(MDL_IMAGE,fnImg,__iter.objId);
+            accumulated.insert(fnImg);
+        }
+        mdAccumulated.unionAll(mdImages);
+    }
+
+    std::vector<size_t> toRemove;
+    FOR_ALL_OBJECTS_IN_METADATA(SF)
+    {
+        SF.getValue(MDL_IMAGE,fnImg,__iter.objId);
+        if (accumulated.find(fnImg)!=accumulated.end())
+            toRemove.push_back(__iter.objId);
+    }
+    for (size_t n=0; n<toRemove.size(); ++n)
+        SF.removeObject(toRemove[n]);
+    if (verbose && !toRemove.empty())
+        std::cout << toRemove.size() << " images are already accumulated and will be skipped" << std::endl;
+}
+
+// The accumulators are stored as raw doubles, so that a resumed or merged
+// reconstruction is identical to the one done in a single run
+template<typename T>
+static void writeAccumulator(const FileName &fn, const MultidimArray<T> &V)
+{
+    std::ofstream fh(fn.c_str(),std::ios::binary);
+    if (!fh)
+        REPORT_ERROR(ERR_IO_NOWRITE,fn);
+    fh.write((const char *)MULTIDIM_ARRAY(V),MULTIDIM_SIZE(V)*sizeof(T));
+    if (!fh)
+        REPORT_ERROR(ERR_IO_NOWRITE,fn);
+}
+
+template<typename T>
+static void addAccumulator(const FileName &fn, MultidimArray<T> &V)
+{
+    std::ifstream fh(fn.c_str(),std::ios::binary);
+    if (!fh)
+        REPORT_ERROR(ERR_IO_NOTEXIST,fn);
+    MultidimArray<T> aux;
+    aux.resizeNoCopy(V);
+    fh.read((char *)MULTIDIM_ARRAY(aux),MULTIDIM_SIZE(aux)*sizeof(T));
+    if (!fh || fh.peek()!=EOF)
+        REPORT_ERROR(ERR_MULTIDIM_SIZE,formatString("Accumulator %s does not have the size of this reconstruction",
+                     fn.c_str()));
+    V+=aux;
+}
+
+void ProgRecFourier::addAccumulators()
+{
+    for (size_t n=0; n<accumulatorsIn.size(); ++n)
+    {
+        const FileName &fnRoot=accumulatorsIn[n];
+        addAccumulator(fnRoot+"_Weights.raw",FourierWeights);
+        addAccumulator(fnRoot+"_Fourier.raw",VoutFourier);
+    }
+}
+
+void ProgRecFourier::saveAccumulator(const FileName &fnRoot, int lastImageIndex)
+{
+    MetaData mdInfo, mdImages(mdAccumulated);
+    std::vector<size_t> objIds;
+    SF.findObjects(objIds);
+    FileName fnImg;
+    for (int i=0; i<=lastImageIndex; ++i)
+    {
+        SF.getValue(MDL_IMAGE,fnImg,objIds[i]);
+        mdImages.setValue(MDL_IMAGE,fnImg,mdImages.addObject());
+    }
+    size_t id=mdInfo.addObject();
+    mdInfo.setValue(MDL_COMMENT,accumulatorSignature(),id);
+    mdInfo.setValue(MDL_XSIZE,(size_t)imgSize,id);
+    mdInfo.setValue(MDL_COUNT,mdImages.size(),id);
+
+    // Write everything to temporary files first, so that an interrupted
+    // save does not corrupt the previous checkpoint
+    writeAccumulator(fnRoot+"_Weights_tmp.raw",FourierWeights);
+    writeAccumulator(fnRoot+"_Fourier_tmp.raw",VoutFourier);
+    mdInfo.write((String)"accumulator@"+fnRoot+"_tmp.xmd");
+    mdImages.write((String)"images@"+fnRoot+"_tmp.xmd",MD_APPEND);
+
+    const char *suffixes[]={"_Weights.raw","_Fourier.raw",".xmd"};
+    const char *tmpSuffixes[]={"_Weights_tmp.raw","_Fourier_tmp.raw","_tmp.xmd"};
+    for (int i=0; i<3; ++i)
+        if (rename((fnRoot+tmpSuffixes[i]).c_str(),(fnRoot+suffixes[i]).c_str())!=0)
+            REPORT_ERROR(ERR_IO_NOWRITE,fnRoot+suffixes[i]);
+}
+
 void ProgRecFourier::correctWeight()
 {
+    XMIPP_PROFILE_SCOPE("correctWeight", PROFILE_COMPUTE);
     // If NiterWeight=0 then set the weights to one
 	forceWeightSymmetry(FourierWeights);
     if (NiterWeight==0)
@@ -1098,6 +1278,7 @@ void ProgRecFourier::correctWeight()
 
 void ProgRecFourier::finishComputations( const FileName &out_name )
 {
+    XMIPP_PROFILE_SCOPE("finishComputations", PROFILE_COMPUTE);
     //#define DEBUG_VOL
 #ifdef DEBUG_VOL
     {
@@ -1138,8 +1319,11 @@ void ProgRecFourier::finishComputations( const FileName &out_name )
     // Threads are working now, wait for them to finish
     barrier_wait( &barrier );
 
-    transformerVol.inverseFourierTransform();
-    CenterFFT(Vout(),false);
+    {
+        XMIPP_PROFILE_SCOPE("inverseFFT", PROFILE_FFT);
+        transformerVol.inverseFourierTransform();
+        CenterFFT(Vout(),false);
+    }
 
     // Correct by the Fourier transform of the blob
     Vout().setXmippOrigin();
@@ -1172,6 +1356,7 @@ void ProgRecFourier::finishComputations( const FileName &out_name )
         FOR_ALL_ELEMENTS_IN_ARRAY3D(mVout)
         A3D_ELEM(mVout,k,i,j) *= meanFactor2;
     }
+    XMIPP_PROFILE_SCOPE("writeVolume", PROFILE_IO);
     Vout.write(out_name);
 }
 
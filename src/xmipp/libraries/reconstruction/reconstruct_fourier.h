@@ -38,6 +38,7 @@
 #include <data/blobs.h>
 #include <core/metadata.h>
 #include <data/ctf.h>
+#include <data/profiler.h>
 
 #include <core/args.h>
 #include <core/xmipp_fft.h>
@@ -155,6 +156,21 @@ public:
     /// How many image rows are processed at a time by a single thread.
     int thrWidth;
 
+    /** Root name of the accumulator checkpoint.
+     * The accumulated Fourier volume and weights are stored in double precision in
+     * root_Fourier.raw and root_Weights.raw, and the list of accumulated images in root.xmd.
+     */
+    FileName fn_checkpoint;
+
+    /// Save the checkpoint every this number of images
+    int checkpointImages;
+
+    /// Whether the checkpoint is saved while processing the images (otherwise only at the end)
+    bool periodicCheckpoint;
+
+    /// Root names of the accumulators of other jobs to be added to this reconstruction
+    StringVector fn_merge;
+
 public: // Internal members
     // Size of the original images
     int imgSize;
@@ -201,6 +217,15 @@ public: // Internal members
     // Output volume
     Image<double> Vout;
 
+    // Accumulators added to this reconstruction (resumed checkpoint or merged jobs)
+    std::vector<FileName> accumulatorsIn;
+
+    // Images already included in those accumulators
+    MetaData mdAccumulated;
+
+    // Index of the first image not included in the last checkpoint
+    int lastCheckpointIndex;
+
 public:
     /// Read arguments from command line
     void readParams();
@@ -225,6 +250,22 @@ public:
     /// Method for the correction of the fourier coefficients
     void correctWeight();
 
+    /** Parameters that must agree between accumulators that are added together */
+    String accumulatorSignature();
+
+    /** Read the list of images of the resumed checkpoint or merged accumulators
+     * and remove them from the input selfile.
+     */
+    void removeAccumulatedImages();
+
+    /** Add the resumed checkpoint or merged accumulators to VoutFourier and FourierWeights */
+    void addAccumulators();
+
+    /** Save VoutFourier and FourierWeights before the weight correction.
+     * The accumulated images are those in mdAccumulated and those in SF up to lastImageIndex.
+     */
+    void saveAccumulator(const FileName &fnRoot, int lastImageIndex);
+
 	/// Force the weights to be symmetrized
     void forceWeightSymmetry(MultidimArray<double> &FourierWeights);
 
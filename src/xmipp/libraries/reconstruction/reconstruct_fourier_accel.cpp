@@ -55,6 +55,7 @@ void ProgRecFourierAccel::defineParams()
     addParamsLine("  [--bufferSize <size=25>]        : Number of projection loaded in memory (will be actually 2x as much.");
     addParamsLine("                                 : This will require up to 4*size*projSize*projSize*16B, e.g.");
     addParamsLine("                                 : 100MB for projection of 256x256 or 400MB for projection of 512x512");
+    Profiler::defineParams(this);
     addExampleLine("For reconstruct enforcing i3 symmetry and using stored weights:", false);
     addExampleLine("   xmipp_reconstruct_fourier_accel  -i reconstruction.sel --sym i3 --weight");
 }
@@ -79,6 +80,7 @@ void ProgRecFourierAccel::readParams()
     if (useCTF)
         iTs = 1 / getDoubleParam("--sampling");
     bufferSize = getIntParam("--bufferSize");
+    Profiler::readParams(this);
 }
 
 // Show ====================================================================
@@ -152,6 +154,7 @@ void ProgRecFourierAccel::cleanLoadingThread() {
 
 void ProgRecFourierAccel::produceSideinfo()
 {
+    XMIPP_PROFILE_SCOPE("produceSideinfo", PROFILE_IO);
     // Translate the maximum resolution to digital frequency
     // maxResolution=sampling_rate/maxResolution;
     maxResolutionSqr=maxResolution*maxResolution;
@@ -298,7 +301,11 @@ void ProgRecFourierAccel::preloadBuffer(LoadThreadParams* threadParams,
 		}
 		//Read projection from selfile, read also angles and shifts if present
 		//but only apply shifts
-		proj.readApplyGeo(*(threadParams->selFile), objId[imgIndex], params);
+		{
+			XMIPP_PROFILE_SCOPE("readImage", PROFILE_IO);
+			proj.readApplyGeo(*(threadParams->selFile), objId[imgIndex], params);
+		}
+		XMIPP_PROFILE_COUNT("images read", 1);
 		rot = proj.rot();
 		tilt = proj.tilt();
 		psi = proj.psi();
@@ -318,9 +325,12 @@ void ProgRecFourierAccel::preloadBuffer(LoadThreadParams* threadParams,
 		CenterFFT(localPaddedImg, true);
 
 		// Fourier transformer for the images
-		localTransformerImg.setReal(localPaddedImg);
-		localTransformerImg.FourierTransform();
-		localTransformerImg.getFourierAlias(localPaddedFourier);
+		{
+			XMIPP_PROFILE_SCOPE("imageFFT", PROFILE_FFT);
+			localTransformerImg.setReal(localPaddedImg);
+			localTransformerImg.FourierTransform();
+			localTransformerImg.getFourierAlias(localPaddedFourier);
+		}
 
 		// Compute the coordinate axes associated to this image
 		Euler_angles2matrix(rot, tilt, psi, localA);
@@ -943,6 +953,7 @@ void ProgRecFourierAccel::forceHermitianSymmetry() {
 }
 
 void ProgRecFourierAccel::processWeights() {
+	XMIPP_PROFILE_SCOPE("correctWeights", PROFILE_COMPUTE);
     // Get a first approximation of the reconstruction
     float corr2D_3D=pow(padding_factor_proj,2.)/
                      (imgSize* pow(padding_factor_vol,3.));
@@ -979,6 +990,7 @@ void ProgRecFourierAccel::swapLoadBuffers() {
 
 void ProgRecFourierAccel::processBuffer(ProjectionData* buffer)
 {
+	XMIPP_PROFILE_SCOPE("interpolate", PROFILE_INTERPOLATION);
 	int repaint = (int)ceil((double)SF.size()/60);
 	for ( int i = 0 ; i < bufferSize; i++ ) {
 		ProjectionData* projData = &buffer[i];
@@ -1022,12 +1034,16 @@ void ProgRecFourierAccel::processImages( int firstImageIndex, int lastImageIndex
     int startLoadIndex = firstImageIndex;
 
     loadImages(startLoadIndex, std::min(lastImageIndex+1, startLoadIndex+bufferSize));
-	barrier_wait( &barrier );
+    {
+        XMIPP_PROFILE_SCOPE("waitLoad", PROFILE_IO);
+        barrier_wait( &barrier );
+    }
     for(int i = 0; i < loops; i++) {
     	swapLoadBuffers();
     	startLoadIndex += bufferSize;
     	loadImages(startLoadIndex, std::min(lastImageIndex+1, startLoadIndex+bufferSize));
     	processBuffer(loadThread.buffer2);
+    	XMIPP_PROFILE_SCOPE("waitLoad", PROFILE_IO);
     	barrier_wait( &barrier );
     }
 	delete[] loadThread.buffer1;
@@ -1042,6 +1058,7 @@ void ProgRecFourierAccel::releaseTempSpaces() {
 
 void ProgRecFourierAccel::finishComputations( const FileName &out_name )
 {
+	XMIPP_PROFILE_SCOPE("finishComputations", PROFILE_COMPUTE);
 	if (useFast) {
 		tempVolume = applyBlob(tempVolume, blob.radius, blobTableSqrt, iDeltaSqrt);
 		tempWeights = applyBlob(tempWeights, blob.radius, blobTableSqrt, iDeltaSqrt);
@@ -1064,9 +1081,12 @@ void ProgRecFourierAccel::finishComputations( const FileName &out_name )
     transformerVol.setFourierAlias(VoutFourier);
     transformerVol.recomputePlanR2C();
 
-    transformerVol.inverseFourierTransform();
-    transformerVol.clear();
-    CenterFFT(Vout(),false);
+    {
+        XMIPP_PROFILE_SCOPE("inverseFFT", PROFILE_FFT);
+        transformerVol.inverseFourierTransform();
+        transformerVol.clear();
+        CenterFFT(Vout(),false);
+    }
 
     // Correct by the Fourier transform of the blob
     Vout().setXmippOrigin();
@@ -1091,6 +1111,7 @@ void ProgRecFourierAccel::finishComputations( const FileName &out_name )
 	meanFactor2/=MULTIDIM_SIZE(mVout);
 	FOR_ALL_ELEMENTS_IN_ARRAY3D(mVout)
 	A3D_ELEM(mVout,k,i,j) *= meanFactor2;
+    XMIPP_PROFILE_SCOPE("writeVolume", PROFILE_IO);
     Vout.write(out_name);
     Vout.clear();
 }
@@ -41,6 +41,7 @@
 #include <core/metadata.h>
 #include <data/ctf.h>
 #include <data/array_2D.h>
+#include <data/profiler.h>
 #include <core/args.h>
 #include <core/xmipp_fft.h>
 #include <sys/time.h>
@@ -25,6 +25,7 @@
 
 #include "reconstruct_significant.h"
 #include <algorithm>
+#include <cstring>
 
 // Define params
 ProgReconstructSignificant::ProgReconstructSignificant()
@@ -33,6 +34,7 @@ ProgReconstructSignificant::ProgReconstructSignificant()
 	Nprocessors=1;
 	randomize_random_generator();
 	deltaAlpha2=0;
+	keepFraction=1;
 }
 
 void ProgReconstructSignificant::defineParams()
@@ -62,6 +64,11 @@ void ProgReconstructSignificant::defineParams()
     addParamsLine("  [--dontReconstruct]          : Do not reconstruct");
     addParamsLine("  [--useForValidation <numOrientationsPerParticle=10>] : Use the program for validation. This number defines the number of possible orientations per particle");
     addParamsLine("  [--dontCheckMirrors]         : Don't check mirrors in the alignment process");
+    addParamsLine("  [--keepDirections <f=1>]     : Fraction of the gallery directions that are aligned to each image.");
+    addParamsLine("                               : The directions are first ranked by a cheap rotationally invariant");
+    addParamsLine("                               : correlation and only the best ones are aligned. If significant");
+    addParamsLine("                               : directions appear among the worst ranked ones, more directions are aligned.");
+    addParamsLine("                               : By default (1), all directions are aligned");
 
 }
 
@@ -90,6 +97,11 @@ void ProgReconstructSignificant::readParams()
     useForValidation=checkParam("--useForValidation");
     numOrientationsPerParticle = getIntParam("--useForValidation");
     dontCheckMirrors = checkParam("--dontCheckMirrors");
+    keepFraction = getDoubleParam("--keepDirections");
+    if (keepFraction<=0 || keepFraction>1)
+    	REPORT_ERROR(ERR_ARG_INCORRECT,"--keepDirections must be in (0,1]");
+    if (keepFraction<1 && keepFraction<=alpha0)
+    	REPORT_ERROR(ERR_ARG_INCORRECT,"--keepDirections must be larger than the significance");
 
     if (!doReconstruct)
     {
@@ -120,6 +132,7 @@ void ProgReconstructSignificant::show()
         std::cout << "Reconstruct                 : "  << doReconstruct << std::endl;
         std::cout << "useForValidation            : "  << useForValidation << std::endl;
         std::cout << "dontCheckMirrors            : "  << dontCheckMirrors << std::endl;
+        std::cout << "Fraction of directions kept : "  << keepFraction << std::endl;
 
 
         if (fnSym != "")
@@ -139,6 +152,74 @@ void ProgReconstructSignificant::show()
     }
 }
 
+// Rotational invariant ===================================================
+RotationalInvariantAux::RotationalInvariantAux()
+{
+	plans=NULL;
+}
+
+RotationalInvariantAux::~RotationalInvariantAux()
+{
+	delete plans;
+}
+
+void rotationalInvariant(const MultidimArray<double> &I, MultidimArray<double> &descriptor,
+		RotationalInvariantAux &aux)
+{
+	// Amplitude of the Fourier transform with the origin at the center.
+	// The missing half of the transform is given by Hermitian symmetry
+	aux.transformer.FourierTransform((MultidimArray<double> &)I, aux.F, false);
+	MultidimArray<double> &A=aux.amplitude;
+	A.resizeNoCopy(YSIZE(I),XSIZE(I));
+	A.setXmippOrigin();
+	int Ydim=(int)YSIZE(I);
+	FOR_ALL_ELEMENTS_IN_ARRAY2D(A)
+	{
+		int ii=i, jj=j;
+		if (jj<0)
+		{
+			ii=-ii;
+			jj=-jj;
+		}
+		if (ii<0)
+			ii+=Ydim;
+		A2D_ELEM(A,i,j)=abs(DIRECT_A2D_ELEM(aux.F,ii,jj));
+	}
+
+	// Amplitudes of the angular Fourier coefficients of its rings
+	polarFourierTransform<true>(A, aux.polarAmplitude, false, 2, XSIZE(I) / 4, aux.plans, 1);
+	const Polar< std::complex<double> > &P=aux.polarAmplitude;
+	size_t L=0;
+	for (int i=0; i<P.getRingNo(); ++i)
+		L+=XSIZE(P.rings[i]);
+	descriptor.resizeNoCopy(L);
+	double *ptr=MULTIDIM_ARRAY(descriptor);
+	for (int i=0; i<P.getRingNo(); ++i)
+	{
+		const MultidimArray< std::complex<double> > &ring=P.rings[i];
+		double w=sqrt(P.ring_radius[i]);
+		for (size_t j=0; j<XSIZE(ring); ++j)
+			*ptr++=w*abs(DIRECT_A1D_ELEM(ring,j));
+	}
+
+	double avg=descriptor.computeAvg();
+	descriptor-=avg;
+	double norm=sqrt(descriptor.sum2());
+	if (norm>0)
+		descriptor*=1.0/norm;
+}
+
+// Sort directions by decreasing prescore
+struct DirectionPrescore
+{
+	double score;
+	size_t idx;
+	bool operator<(const DirectionPrescore &other) const
+	{
+		return score>other.score || (score==other.score && idx<other.idx);
+	}
+};
+
 // Image alignment ========================================================
 //#define DEBUG
 void ProgReconstructSignificant::alignImagesToGallery()
@@ -167,7 +248,21 @@ void ProgReconstructSignificant::alignImagesToGallery()
 	FileName fnImg;
 	size_t nImg=0;
 	Image<double> I;
-	MultidimArray<double> mCurrentImageAligned, mGalleryProjection;
+	MultidimArray<double> mCurrentImageAligned, mGalleryProjection, mAlignedStack;
+	std::vector< Matrix2D<double> > galleryM;
+	std::vector<double> galleryCorr;
+
+	// Prescreening
+	size_t Ntotal=Nvols*Ndirs;
+	size_t Nkeep=std::max((size_t)1,(size_t)ceil(keepFraction*Ntotal));
+	size_t Nsignificant=(size_t)ceil((1-one_alpha)*Ntotal);
+	std::vector<DirectionPrescore> prescore(Ntotal);
+	std::vector<bool> aligned(Ntotal);
+	std::vector<double> allCorr(Ntotal), allImed(Ntotal), sortedCorr;
+	std::vector< std::vector<size_t> > volumeDirs(Nvols);
+	RotationalInvariantAux invariantAux;
+	MultidimArray<double> invariantI;
+	Naligned=Ncompared=0;
 	if (rank==0)
 	{
 		std::cout << "Current significance: " << one_alpha << std::endl;
@@ -189,42 +284,119 @@ void ProgReconstructSignificant::alignImagesToGallery()
 			I.read(fnImg);
 			MultidimArray<double> &mCurrentImage=I();
 			mCurrentImage.setXmippOrigin();
-			allM.clear();
+			allM.resize(Ntotal);
 
 			double bestCorr=-2, bestRot, bestTilt, bestImed=1e38, worstImed=-1e38;
 			Matrix2D<double> bestM;
 			int bestVolume=-1;
 
-			// Compute all correlations
+			// Rank the directions by the rotationally invariant correlation
+			for (size_t idx=0; idx<Ntotal; ++idx)
+			{
+				prescore[idx].idx=idx;
+				prescore[idx].score=0;
+				aligned[idx]=false;
+			}
+			if (Nkeep<Ntotal)
+			{
+				rotationalInvariant(mCurrentImage,invariantI,invariantAux);
+				size_t L=XSIZE(invariantI);
+				for (size_t nVolume=0; nVolume<Nvols; ++nVolume)
+				{
+					const double *ptrGallery=MULTIDIM_ARRAY(galleryInvariants[nVolume]);
+					for (size_t nDir=0; nDir<Ndirs; ++nDir, ptrGallery+=L)
+					{
+						double score=0;
+						for (size_t l=0; l<L; ++l)
+							score+=ptrGallery[l]*DIRECT_A1D_ELEM(invariantI,l);
+						prescore[nVolume*Ndirs+nDir].score=score;
+					}
+				}
+				std::sort(prescore.begin(),prescore.end());
+			}
+
+			// Compute the correlations of the best ranked directions. If any of the
+			// last quarter of them is significant, the next block of directions is also aligned
+			size_t first=0;
+			double minCorr=1e38, maxImed=-1e38;
+			while (first<Ntotal)
+			{
+				size_t last=std::min(first+Nkeep,Ntotal);
+				for (size_t nVolume=0; nVolume<Nvols; ++nVolume)
+					volumeDirs[nVolume].clear();
+				for (size_t k=first; k<last; ++k)
+					volumeDirs[prescore[k].idx/Ndirs].push_back(prescore[k].idx%Ndirs);
+		    	for (size_t nVolume=0; nVolume<Nvols; ++nVolume)
+		    	{
+		    		if (volumeDirs[nVolume].empty())
+		    			continue;
+		    		AlignmentTransforms *transforms=galleryTransforms[nVolume];
+		    		alignImagesToReferences(gallery[nVolume](),transforms,volumeDirs[nVolume],mCurrentImage,
+		    				mAlignedStack,galleryM,galleryCorr,aux,aux2,aux3,DONT_WRAP,!dontCheckMirrors);
+		    		for (size_t k=0; k<volumeDirs[nVolume].size(); ++k)
+		    		{
+		    			size_t nDir=volumeDirs[nVolume][k];
+		    			size_t idx=nVolume*Ndirs+nDir;
+						mCurrentImageAligned.aliasImageInStack(mAlignedStack,k);
+						mCurrentImageAligned.setXmippOrigin();
+						mGalleryProjection.aliasImageInStack(gallery[nVolume](),nDir);
+						mGalleryProjection.setXmippOrigin();
+						double corr=galleryCorr[k];
+						M=galleryM[k].inv();
+						double scale, shiftX, shiftY, anglePsi;
+						bool flip;
+						transformationMatrix2Parameters2D(M,flip,scale,shiftX,shiftY,anglePsi);
+
+						double imed=imedDistance(mGalleryProjection, mCurrentImageAligned);
+						if (maxShift>0 && (fabs(shiftX)>maxShift || fabs(shiftY)>maxShift))
+						{
+							corr/=3;
+							imed*=3;
+						}
+						allCorr[idx]=corr;
+						allImed[idx]=imed;
+						allM[idx]=M;
+						aligned[idx]=true;
+						minCorr=std::min(minCorr,corr);
+						maxImed=std::max(maxImed,imed);
+		    		}
+		    	}
+		    	Naligned+=last-first;
+		    	if (last==Ntotal)
+		    		break;
+
+		    	// Accuracy guard
+		    	sortedCorr.clear();
+		    	for (size_t k=0; k<last; ++k)
+		    		sortedCorr.push_back(allCorr[prescore[k].idx]);
+		    	std::sort(sortedCorr.begin(),sortedCorr.end());
+		    	double significantCorr=sortedCorr[sortedCorr.size()-std::min(std::max(Nsignificant,(size_t)1),sortedCorr.size())];
+		    	bool extend=false;
+		    	for (size_t k=first+3*(last-first)/4; k<last && !extend; ++k)
+		    		extend=allCorr[prescore[k].idx]>=significantCorr;
+		    	if (!extend)
+		    		break;
+		    	first=last;
+			}
+			Ncompared+=Ntotal;
+
+			// Directions that were not aligned get the worst values of this image
 	    	for (size_t nVolume=0; nVolume<Nvols; ++nVolume)
 	    	{
-	    		AlignmentTransforms *transforms=galleryTransforms[nVolume];
 		    	for (size_t nDir=0; nDir<Ndirs; ++nDir)
 				{
-					mCurrentImageAligned=mCurrentImage;
-					mGalleryProjection.aliasImageInStack(gallery[nVolume](),nDir);
-					mGalleryProjection.setXmippOrigin();
-					double corr;
-					if (! dontCheckMirrors)
-						corr=alignImagesConsideringMirrors(mGalleryProjection,transforms[nDir],
-								mCurrentImageAligned,M,aux,aux2,aux3,DONT_WRAP);
-					else
-						corr = alignImages(mGalleryProjection, mCurrentImageAligned,
-						                   M, DONT_WRAP);
-
-//					double corr=alignImagesConsideringMirrors(mGalleryProjection,
-//							mCurrentImageAligned,M,aux,aux2,aux3,DONT_WRAP);
-					M=M.inv();
-					double scale, shiftX, shiftY, anglePsi;
-					bool flip;
-					transformationMatrix2Parameters2D(M,flip,scale,shiftX,shiftY,anglePsi);
-
-					double imed=imedDistance(mGalleryProjection, mCurrentImageAligned);
-					if (maxShift>0 && (fabs(shiftX)>maxShift || fabs(shiftY)>maxShift))
+					size_t idx=nVolume*Ndirs+nDir;
+					if (!aligned[idx])
 					{
-						corr/=3;
-						imed*=3;
+						DIRECT_A3D_ELEM(cc,nImg,nVolume,nDir)=minCorr;
+						DIRECT_A1D_ELEM(imgcc,idx)=minCorr;
+						DIRECT_A1D_ELEM(imgimed,idx)=maxImed;
+						allM[idx].initIdentity(3);
+						continue;
 					}
+					double corr=allCorr[idx];
+					double imed=allImed[idx];
+					M=allM[idx];
 
 //					//if (corr>0.99)
 //					//{
@@ -242,10 +414,8 @@ void ProgReconstructSignificant::alignImagesToGallery()
 
 					DIRECT_A3D_ELEM(cc,nImg,nVolume,nDir)=corr;
 					// For the paper plot: std::cout << corr << " " << imed << std::endl;
-					size_t idx=nVolume*Ndirs+nDir;
 					DIRECT_A1D_ELEM(imgcc,idx)=corr;
 					DIRECT_A1D_ELEM(imgimed,idx)=imed;
-					allM.push_back(M);
 
 					if (corr>bestCorr)
 					{
@@ -317,7 +487,7 @@ void ProgReconstructSignificant::alignImagesToGallery()
 //						std::cout << "Image " << nImg << " " << fnImg << " does not qualify by correlation percentile to " << nDir << " -> " << cdfccthis << " " << one_alpha << std::endl;
 //					if (!condition && cc>ccl)
 //						std::cout << "Image " << nImg << " " << fnImg << " does not qualify by imed percentile to " << nDir << " -> " << cdfimedthis << " " << currentAlpha<< std::endl;
-					bool condition=true;
+					bool condition=aligned[idx];
 					condition=condition && ((applyFisher && cc>=ccl) || !applyFisher);
 					condition=condition && cdfccthis>=one_alpha;
 					if (condition)
@@ -379,7 +549,12 @@ void ProgReconstructSignificant::alignImagesToGallery()
 		nImg++;
 	}
 	if (rank==0)
+	{
 		progress_bar(mdIn.size());
+		if (keepFraction<1 && Ncompared>0)
+			std::cout << "Directions aligned after prescreening: " << Naligned << " of " << Ncompared
+			          << " (" << 100.0*(Ncompared-Naligned)/Ncompared << "% pruned)" << std::endl;
+	}
 }
 #undef DEBUG
 
@@ -655,9 +830,6 @@ void ProgReconstructSignificant::generateProjections()
 	std::vector<GalleryImage> galleryNames;
 	mdGallery.clear();
 
-	CorrelationAux aux;
-	AlignmentAux aux2;
-	MultidimArray<double> mGalleryProjection;
 	for (int n=0; n<Nvolumes; n++)
 	{
 		mdGallery.push_back(galleryNames);
@@ -681,23 +853,53 @@ void ProgReconstructSignificant::generateProjections()
 			mdAux.getValue(MDL_ANGLE_TILT,I.tilt,__iter.objId);
 			mdGallery[n].push_back(I);
 		}
-		gallery[n].read(fnGallery);
+		readGallery(n,fnGallery);
+	}
+}
 
-		// Calculate transforms of this gallery
-		size_t kmax=NSIZE(gallery[n]());
-		if (galleryTransforms[n]==NULL)
-		{
-			delete galleryTransforms[n];
-			galleryTransforms[n]=new AlignmentTransforms[kmax];
-		}
-		AlignmentTransforms *transforms=galleryTransforms[n];
+void ProgReconstructSignificant::readGallery(int n, const FileName &fnGallery)
+{
+	gallery[n].read(fnGallery);
+	computeGalleryTransforms(n);
+}
+
+void ProgReconstructSignificant::computeGalleryTransforms(int n)
+{
+	CorrelationAux aux;
+	AlignmentAux aux2;
+	MultidimArray<double> mGalleryProjection;
+
+	// Calculate transforms of this gallery
+	size_t kmax=NSIZE(gallery[n]());
+	if (galleryTransforms[n]==NULL)
+	{
+		delete galleryTransforms[n];
+		galleryTransforms[n]=new AlignmentTransforms[kmax];
+	}
+	AlignmentTransforms *transforms=galleryTransforms[n];
+	for (size_t k=0; k<kmax; ++k)
+	{
+		mGalleryProjection.aliasImageInStack(gallery[n](),k);
+		mGalleryProjection.setXmippOrigin();
+		aux.transformer1.FourierTransform((MultidimArray<double> &)mGalleryProjection, transforms[k].FFTI, true);
+	    polarFourierTransform<true>(mGalleryProjection, transforms[k].polarFourierI, false,
+	                                    XSIZE(mGalleryProjection) / 5, XSIZE(mGalleryProjection) / 2, aux2.plans, 1);
+	}
+
+	// Rotationally invariant descriptors for the prescreening
+	if (keepFraction<1 && kmax>0)
+	{
+		RotationalInvariantAux invariantAux;
+		MultidimArray<double> descriptor;
 		for (size_t k=0; k<kmax; ++k)
 		{
 			mGalleryProjection.aliasImageInStack(gallery[n](),k);
 			mGalleryProjection.setXmippOrigin();
-			aux.transformer1.FourierTransform((MultidimArray<double> &)mGalleryProjection, transforms[k].FFTI, true);
-		    polarFourierTransform<true>(mGalleryProjection, transforms[k].polarFourierI, false,
-		                                    XSIZE(mGalleryProjection) / 5, XSIZE(mGalleryProjection) / 2, aux2.plans, 1);
+			rotationalInvariant(mGalleryProjection,descriptor,invariantAux);
+			if (k==0)
+				galleryInvariants[n].resizeNoCopy(kmax,XSIZE(descriptor));
+			memcpy(&DIRECT_A2D_ELEM(galleryInvariants[n],k,0),MULTIDIM_ARRAY(descriptor),
+			       XSIZE(descriptor)*sizeof(double));
 		}
 	}
 }
@@ -862,6 +1064,7 @@ void ProgReconstructSignificant::produceSideinfo()
 		}
 		gallery.push_back(galleryDummy);
 		galleryTransforms.push_back(NULL);
+		galleryInvariants.push_back(MultidimArray<double>());
 		mdReconstructionPartial.push_back(mdPartial);
 		mdReconstructionProjectionMatching.push_back(mdProjMatch);
 	}
@@ -94,6 +94,10 @@ public:
 
     bool dontCheckMirrors;
 
+    /** Fraction of the gallery directions that are fully aligned after
+        the rotationally invariant prescreening (1=all of them) */
+    double keepFraction;
+
 
 public: // Internal members
     size_t rank, Nprocessors;
@@ -127,6 +131,12 @@ public: // Internal members
     std::vector< Image<double> > gallery;
     std::vector< AlignmentTransforms* > galleryTransforms;
 
+    // Rotationally invariant descriptors of the gallery images (one row per direction)
+    std::vector< MultidimArray<double> > galleryInvariants;
+
+    // Number of directions fully aligned and total number of directions (prescreening statistics)
+    size_t Naligned, Ncompared;
+
 	// Current iteration
 	int iter;
 
@@ -157,6 +167,12 @@ public:
     /// Generate projections from the current volume
     void generateProjections();
 
+    /// Read the gallery of the n-th volume and compute its transforms
+    virtual void readGallery(int n, const FileName &fnGallery);
+
+    /// Compute the alignment transforms and invariants of the n-th gallery
+    void computeGalleryTransforms(int n);
+
     ///
     void numberOfProjections();
 
@@ -169,5 +185,28 @@ public:
     /// Synchronize with other processors
     virtual void synchronize() {}
 };
+
+/** Auxiliary buffers of the rotationally invariant descriptor. */
+class RotationalInvariantAux
+{
+public:
+    FourierTransformer transformer;
+    MultidimArray< std::complex<double> > F;
+    MultidimArray<double> amplitude;
+    Polar< std::complex<double> > polarAmplitude;
+    Polar_fftw_plans *plans;
+    RotationalInvariantAux();
+    ~RotationalInvariantAux();
+};
+
+/** Rotationally invariant descriptor of an image.
+    Amplitudes of the angular Fourier coefficients of the rings of the
+    Fourier amplitude of the image, weighted by the square root of the ring
+    radius. They do not change with in-plane shifts, rotations or mirrors.
+    The descriptor is normalized to zero mean and unit norm, so that the dot
+    product of two descriptors is a correlation coefficient. The auxiliary
+    buffers can be reused for images of the same size. */
+void rotationalInvariant(const MultidimArray<double> &I, MultidimArray<double> &descriptor,
+                         RotationalInvariantAux &aux);
 //@}
 #endif
@@ -28,11 +28,12 @@
 #include <core/args.h>
 #include <data/filters.h>
 #include <core/xmipp_fftw.h>
+#include <core/xmipp_threads.h>
 #include <core/metadata.h>
 #include <data/numerical_tools.h>
 #include <data/morphology.h>
 #include <fstream>
-#include <queue>
+#include <cstring>
 #include <iostream>
 
 #include <data/fourier_filter.h>
@@ -974,6 +975,7 @@ void ProgTomographAlignment::produceSideInfo()
         avgBackwardPatchCorr.initZeros(Nimg);
         avgForwardPatchCorr.initConstant(1);
         avgBackwardPatchCorr.initConstant(1);
+        PatchCorrelator correlator;
 
         for (int ii=0; ii<Nimg; ++ii)
         {
@@ -990,7 +992,7 @@ void ProgTomographAlignment::produceSideInfo()
                         XX(rii)=rnd_unif(X0,XF);
                         YY(rii)=rnd_unif(Y0,YF);
                         rjj=affineTransformations[ii][ii+1]*rii;
-                        refineLandmark(ii,ii+1,rii,rjj,corrList(i),false);
+                        refineLandmark(ii,ii+1,rii,rjj,corrList(i),false,&correlator);
                     }
                     while (corrList(i)<-0.99);
                 }
@@ -1009,7 +1011,7 @@ void ProgTomographAlignment::produceSideInfo()
                         XX(rii)=rnd_unif(X0,XF);
                         YY(rii)=rnd_unif(Y0,YF);
                         rjj=affineTransformations[ii][ii-1]*rii;
-                        refineLandmark(ii,ii-1,rii,rjj,corrList(i),false);
+                        refineLandmark(ii,ii-1,rii,rjj,corrList(i),false,&correlator);
                     }
                     while (corrList(i)<-0.99);
                 }
@@ -1043,7 +1045,11 @@ struct ThreadGenerateLandmarkSetParams
     int myThreadID;
     ProgTomographAlignment * parent;
 
-    std::vector<LandmarkChain> *chainList;
+    // Tasks (grid points or images) are handed out on demand
+    ThreadTaskDistributor *distributor;
+
+    // Chains found in each task, so that the result does not depend on the scheduling
+    std::vector< std::vector<LandmarkChain> > *chainsPerTask;
 };
 
 void * threadgenerateLandmarkSetGrid( void * args )
@@ -1053,25 +1059,26 @@ void * threadgenerateLandmarkSetGrid( void * args )
     ProgTomographAlignment * parent = master->parent;
     int thread_id = master->myThreadID;
     int Nimg=parent->Nimg;
-    int numThreads=parent->numThreads;
     const std::vector< std::vector< Matrix2D<double> > > &affineTransformations=
         parent->affineTransformations;
     int gridSamples=parent->gridSamples;
 
     int deltaShift=(int)floor(XSIZE(*(parent->img)[0])/gridSamples);
-    master->chainList=new std::vector<LandmarkChain>;
     Matrix1D<double> rii(3), rjj(3);
     ZZ(rii)=1;
     ZZ(rjj)=1;
-    if (thread_id==0)
-        init_progress_bar(gridSamples);
     int includedPoints=0;
     Matrix1D<int> visited(Nimg);
-    for (int nx=thread_id; nx<gridSamples; nx+=numThreads)
+    PatchCorrelator correlator;
+    size_t first, last;
+    while (master->distributor->getTasks(first,last))
     {
-        XX(rii)=STARTINGX(*(parent->img)[0])+ROUND(deltaShift*(0.5+nx));
-        for (int ny=0; ny<gridSamples; ny+=1)
+        for (size_t task=first; task<=last; ++task)
         {
+            int nx=task/gridSamples;
+            int ny=task%gridSamples;
+            std::vector<LandmarkChain> &chainList=(*master->chainsPerTask)[task];
+            XX(rii)=STARTINGX(*(parent->img)[0])+ROUND(deltaShift*(0.5+nx));
             YY(rii)=STARTINGY(*(parent->img)[0])+ROUND(deltaShift*(0.5+ny));
             for (int ii=0; ii<=Nimg-1; ++ii)
             {
@@ -1115,7 +1122,7 @@ void * threadgenerateLandmarkSetGrid( void * args )
                     rjj=Aji*rcurrent;
                     double corr;
                     acceptLandmark=parent->refineLandmark(jj_1,jj,rcurrent,rjj,
-                                                          corr,true);
+                                                          corr,true,&correlator);
                     if (acceptLandmark)
                     {
                         l.x=XX(rjj);
@@ -1152,7 +1159,7 @@ void * threadgenerateLandmarkSetGrid( void * args )
                     rjj=Aij*rcurrent;
                     double corr;
                     acceptLandmark=parent->refineLandmark(jj_1,jj,rcurrent,rjj,
-                                                          corr,true);
+                                                          corr,true,&correlator);
                     if (acceptLandmark)
                     {
                         l.x=XX(rjj);
@@ -1176,7 +1183,7 @@ void * threadgenerateLandmarkSetGrid( void * args )
                 if (chain.size()>parent->seqLength)
                 {
                     double corrChain;
-                    bool accepted=parent->refineChain(chain,corrChain);
+                    bool accepted=parent->refineChain(chain,corrChain,&correlator);
                     if (accepted)
                     {
 #ifdef DEBUG
@@ -1188,7 +1195,7 @@ void * threadgenerateLandmarkSetGrid( void * args )
                             std::cout << chain[i].imgIdx << " ";
 #endif
 
-                        master->chainList->push_back(chain);
+                        chainList.push_back(chain);
                         includedPoints+=chain.size();
                     }
                 }
@@ -1201,17 +1208,13 @@ void * threadgenerateLandmarkSetGrid( void * args )
             std::cout << "Point nx=" << nx << " ny=" << ny
             << " Number of points="
             << includedPoints
-            << " Number of chains=" << master->chainList->size()
-            << " ( " << ((double) includedPoints)/
-            master->chainList->size() << " )\n";
+            << " Number of chains=" << chainList.size() << std::endl;
 #endif
 
+            if (thread_id==0)
+                progress_bar(task);
         }
-        if (thread_id==0)
-            progress_bar(nx);
     }
-    if (thread_id==0)
-        progress_bar(gridSamples);
     return NULL;
 }
 
@@ -1222,25 +1225,26 @@ void * threadgenerateLandmarkSetBlind( void * args )
     ProgTomographAlignment * parent = master->parent;
     int thread_id = master->myThreadID;
     int Nimg=parent->Nimg;
-    int numThreads=parent->numThreads;
     const std::vector< std::vector< Matrix2D<double> > > &affineTransformations=
         parent->affineTransformations;
     int gridSamples=parent->gridSamples;
 
     int deltaShift=(int)floor(XSIZE(*(parent->img)[0])/gridSamples);
-    master->chainList=new std::vector<LandmarkChain>;
     Matrix1D<double> rii(3), rjj(3);
     ZZ(rii)=1;
     ZZ(rjj)=1;
-    if (thread_id==0)
-        init_progress_bar(gridSamples);
     int includedPoints=0;
     int maxSideLength=(parent->blindSeqLength-1)/2;
-    for (int nx=thread_id; nx<gridSamples; nx+=numThreads)
+    PatchCorrelator correlator;
+    size_t first, last;
+    while (master->distributor->getTasks(first,last))
     {
-        XX(rii)=STARTINGX(*(parent->img)[0])+ROUND(deltaShift*(0.5+nx));
-        for (int ny=0; ny<gridSamples; ny+=1)
+        for (size_t task=first; task<=last; ++task)
         {
+            int nx=task/gridSamples;
+            int ny=task%gridSamples;
+            std::vector<LandmarkChain> &chainList=(*master->chainsPerTask)[task];
+            XX(rii)=STARTINGX(*(parent->img)[0])+ROUND(deltaShift*(0.5+nx));
             YY(rii)=STARTINGY(*(parent->img)[0])+ROUND(deltaShift*(0.5+ny));
             for (int ii=0; ii<=Nimg-1; ++ii)
             {
@@ -1348,24 +1352,20 @@ void * threadgenerateLandmarkSetBlind( void * args )
                 << " - " << jjright << "]\n";
 #endif
 
-                master->chainList->push_back(chain);
+                chainList.push_back(chain);
                 includedPoints+=chain.size();
             }
 #ifdef DEBUG
             std::cout << "Point nx=" << nx << " ny=" << ny
             << " Number of points="
             << includedPoints
-            << " Number of chains=" << master->chainList->size()
-            << " ( " << ((double) includedPoints)/
-            master->chainList->size() << " )\n";
+            << " Number of chains=" << chainList.size() << std::endl;
 #endif
 
+            if (thread_id==0)
+                progress_bar(task);
         }
-        if (thread_id==0)
-            progress_bar(nx);
     }
-    if (thread_id==0)
-        progress_bar(gridSamples);
     return NULL;
 }
 
@@ -1377,14 +1377,10 @@ void * threadgenerateLandmarkSetCriticalPoints( void * args )
     ProgTomographAlignment * parent = master->parent;
     int thread_id = master->myThreadID;
     int Nimg=parent->Nimg;
-    int numThreads=parent->numThreads;
     const std::vector< std::vector< Matrix2D<double> > > &affineTransformations=
         parent->affineTransformations;
 
-    master->chainList=new std::vector<LandmarkChain>;
     std::vector<LandmarkChain> candidateChainList;
-    if (thread_id==0)
-        init_progress_bar(Nimg);
     int halfSeqLength=parent->seqLength/2;
 
     // Design a mask for the dilation
@@ -1395,10 +1391,15 @@ void * threadgenerateLandmarkSetCriticalPoints( void * args )
     BinaryCircularMask(mask,4,OUTSIDE_MASK);
 
     Image<double> I;
-    for (int ii=thread_id; ii<=Nimg-1; ii+=numThreads)
+    PatchCorrelator correlator;
+    size_t first, last;
+    while (master->distributor->getTasks(first,last))
+    {
+    for (int ii=first; ii<=(int)last; ii++)
     {
         if (parent->isOutlier(ii))
             continue;
+        std::vector<LandmarkChain> &chainList=(*master->chainsPerTask)[ii];
         I.read(parent->name_list[ii]);
 
         // Generate mask
@@ -1515,7 +1516,7 @@ void * threadgenerateLandmarkSetCriticalPoints( void * args )
                 Aji=affineTransformations[jj_1][jj];
                 rjj=Aji*rcurrent;
                 double corr;
-                parent->refineLandmark(jj_1,jj,rcurrent,rjj, corr,true);
+                parent->refineLandmark(jj_1,jj,rcurrent,rjj,corr,true,&correlator);
                 l.x=XX(rjj);
                 l.y=YY(rjj);
                 l.imgIdx=jj;
@@ -1538,7 +1539,7 @@ void * threadgenerateLandmarkSetCriticalPoints( void * args )
                 Aji=affineTransformations[jj][jj_1];
                 rjj=Aij*rcurrent;
                 double corr;
-                parent->refineLandmark(jj_1,jj,rcurrent,rjj,corr,true);
+                parent->refineLandmark(jj_1,jj,rcurrent,rjj,corr,true,&correlator);
                 l.x=XX(rjj);
                 l.y=YY(rjj);
                 l.imgIdx=jj;
@@ -1547,7 +1548,7 @@ void * threadgenerateLandmarkSetCriticalPoints( void * args )
             }
 
             // Refine chain
-            parent->refineChain(chain,corrQ(q));
+            parent->refineChain(chain,corrQ(q),&correlator);
             candidateChainList.push_back(chain);
         }
         if (thread_id==0)
@@ -1562,7 +1563,7 @@ void * threadgenerateLandmarkSetCriticalPoints( void * args )
             int q=idx(XSIZE(idx)-1-iq)-1;
             if (corrQ(q)>0.5)
             {
-                master->chainList->push_back(candidateChainList[q]);
+                chainList.push_back(candidateChainList[q]);
 #ifdef DEBUG
 
                 std::cout << "Corr " << iq << ": " << corrQ(q) << ":";
@@ -1614,8 +1615,7 @@ void * threadgenerateLandmarkSetCriticalPoints( void * args )
 #endif
 
     }
-    if (thread_id==0)
-        progress_bar(Nimg);
+    }
     return NULL;
 }
 #undef DEBUG
@@ -1643,60 +1643,51 @@ void ProgTomographAlignment::generateLandmarkSet()
     FileName fn_tmp = fnRoot+"_landmarks.txt";
     if (!fn_tmp.exists())
     {
-        pthread_t * th_ids = new pthread_t[numThreads];
-        ThreadGenerateLandmarkSetParams * th_args=
-            new ThreadGenerateLandmarkSetParams[numThreads];
-        for( int nt = 0 ; nt < numThreads ; nt ++ )
-        {
-            th_args[nt].parent = this;
-            th_args[nt].myThreadID = nt;
-            if (useCriticalPoints)
-                pthread_create( (th_ids+nt) , NULL, threadgenerateLandmarkSetCriticalPoints, (void *)(th_args+nt) );
-            else
-                pthread_create( (th_ids+nt) , NULL, threadgenerateLandmarkSetGrid, (void *)(th_args+nt) );
-        }
-
         std::vector<LandmarkChain> chainList;
         int includedPoints=0;
-        for( int nt = 0 ; nt < numThreads ; nt ++ )
+        for (int pass=0; pass<2; pass++)
         {
-            pthread_join(*(th_ids+nt), NULL);
-            int imax=th_args[nt].chainList->size();
-            for (int i=0; i<imax; i++)
-            {
-                chainList.push_back((*th_args[nt].chainList)[i]);
-                includedPoints+=(*th_args[nt].chainList)[i].size();
-            }
-            delete th_args[nt].chainList;
-        }
-        delete[] th_ids;
-        delete[] th_args;
-
-        // Add blind landmarks
-        if (blindSeqLength>0)
-        {
-            th_ids  = new pthread_t[numThreads];
-            th_args = new ThreadGenerateLandmarkSetParams[numThreads];
+            // The second pass adds blind landmarks
+            if (pass==1 && blindSeqLength<=0)
+                break;
+            bool criticalPoints=(pass==0 && useCriticalPoints);
+            size_t Ntasks=criticalPoints ? Nimg:gridSamples*gridSamples;
+            std::vector< std::vector<LandmarkChain> > chainsPerTask(Ntasks);
+            ThreadTaskDistributor distributor(Ntasks,1);
+            init_progress_bar(Ntasks);
+
+            pthread_t * th_ids = new pthread_t[numThreads];
+            ThreadGenerateLandmarkSetParams * th_args=
+                new ThreadGenerateLandmarkSetParams[numThreads];
             for( int nt = 0 ; nt < numThreads ; nt ++ )
             {
                 th_args[nt].parent = this;
                 th_args[nt].myThreadID = nt;
-                pthread_create( (th_ids+nt) , NULL, threadgenerateLandmarkSetBlind, (void *)(th_args+nt) );
+                th_args[nt].distributor = &distributor;
+                th_args[nt].chainsPerTask = &chainsPerTask;
+                if (criticalPoints)
+                    pthread_create( (th_ids+nt) , NULL, threadgenerateLandmarkSetCriticalPoints, (void *)(th_args+nt) );
+                else if (pass==0)
+                    pthread_create( (th_ids+nt) , NULL, threadgenerateLandmarkSetGrid, (void *)(th_args+nt) );
+                else
+                    pthread_create( (th_ids+nt) , NULL, threadgenerateLandmarkSetBlind, (void *)(th_args+nt) );
             }
-
             for( int nt = 0 ; nt < numThreads ; nt ++ )
-            {
                 pthread_join(*(th_ids+nt), NULL);
-                int imax=th_args[nt].chainList->size();
+            progress_bar(Ntasks);
+            delete[] th_ids;
+            delete[] th_args;
+
+            // Gather the chains in task order
+            for (size_t task=0; task<Ntasks; task++)
+            {
+                int imax=chainsPerTask[task].size();
                 for (int i=0; i<imax; i++)
                 {
-                    chainList.push_back((*th_args[nt].chainList)[i]);
-                    includedPoints+=(*th_args[nt].chainList)[i].size();
+                    chainList.push_back(chainsPerTask[task][i]);
+                    includedPoints+=chainsPerTask[task][i].size();
                 }
-                delete th_args[nt].chainList;
             }
-            delete[] th_ids;
-            delete[] th_args;
         }
 
         // Generate the landmark "matrix"
@@ -1733,10 +1724,141 @@ void ProgTomographAlignment::generateLandmarkSet()
 }
 #undef DEBUG
 
+/* Patch correlator -------------------------------------------------------- */
+bool PatchCorrelator::setPatch(const MultidimArray<double> &patch, int _maxShift)
+{
+    // Normalize the pattern
+    double mean=0, stddev=0;
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(patch)
+    {
+        double val=DIRECT_MULTIDIM_ELEM(patch,n);
+        mean+=val;
+        stddev+=val*val;
+    }
+    double N=MULTIDIM_SIZE(patch);
+    mean/=N;
+    stddev=stddev/N-mean*mean;
+    stddev*=N/(N-1);
+    stddev=sqrt(ABS(stddev));
+    if (stddev<=XMIPP_EQUAL_ACCURACY)
+        return false;
+    pattern=patch;
+    double istddev=1.0/stddev;
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(pattern)
+    DIRECT_MULTIDIM_ELEM(pattern,n)=(DIRECT_MULTIDIM_ELEM(pattern,n)-mean)*istddev;
+
+    // Resize the buffers only if needed, so that the FFT plan is kept
+    halfSize=XSIZE(patch)/2;
+    maxShift=_maxShift;
+    int windowSize=2*(halfSize+maxShift)+1;
+    if (XSIZE(window)!=(size_t)windowSize || YSIZE(window)!=(size_t)windowSize)
+    {
+        window.initZeros(windowSize,windowSize);
+        sat.initZeros(windowSize+1,windowSize+1);
+        sat2.initZeros(windowSize+1,windowSize+1);
+    }
+    validPatternFourier[0]=validPatternFourier[1]=false;
+    return true;
+}
+
+double PatchCorrelator::bestShift(const MultidimArray<unsigned char> &I,
+                                  double x, double y, bool reversed, int &shiftX, int &shiftY)
+{
+    int patchSize=2*halfSize+1;
+    int windowSize=XSIZE(window);
+    int r=reversed ? 1:0;
+
+    // Transform the pattern, zero padded to the window size
+    if (!validPatternFourier[r])
+    {
+        window.initZeros();
+        for (int i=0; i<patchSize; ++i)
+        {
+            int ip=reversed ? patchSize-1-i:i;
+            for (int j=0; j<patchSize; ++j)
+                DIRECT_A2D_ELEM(window,i,j)=DIRECT_A2D_ELEM(pattern,ip,j);
+        }
+        transformer.FourierTransform(window,patternFourier[r],true);
+        validPatternFourier[r]=true;
+    }
+
+    // Read the search window (zero outside the image) and its summed-area tables
+    int xb=FLOOR(x), yb=FLOOR(y);
+    int x0=xb-halfSize-maxShift;
+    int y0=yb-halfSize-maxShift;
+    for (int i=0; i<windowSize; ++i)
+    {
+        double *ptrWindow=&DIRECT_A2D_ELEM(window,i,0);
+        int yy=y0+i;
+        if (yy<STARTINGY(I) || yy>FINISHINGY(I))
+            memset(ptrWindow,0,windowSize*sizeof(double));
+        else
+        {
+            const unsigned char *ptrI=&A2D_ELEM(I,yy,STARTINGX(I));
+            for (int j=0; j<windowSize; ++j)
+            {
+                int xx=x0+j;
+                ptrWindow[j]=(xx<STARTINGX(I) || xx>FINISHINGX(I)) ? 0.0 : ptrI[xx-STARTINGX(I)];
+            }
+        }
+        double rowSum=0, rowSum2=0;
+        for (int j=0; j<windowSize; ++j)
+        {
+            double val=ptrWindow[j];
+            rowSum+=val;
+            rowSum2+=val*val;
+            DIRECT_A2D_ELEM(sat,i+1,j+1)=DIRECT_A2D_ELEM(sat,i,j+1)+rowSum;
+            DIRECT_A2D_ELEM(sat2,i+1,j+1)=DIRECT_A2D_ELEM(sat2,i,j+1)+rowSum2;
+        }
+    }
+
+    // Correlate in Fourier space, the result is left in window
+    transformer.FourierTransform(window,windowFourier,false);
+    FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(windowFourier)
+    DIRECT_MULTIDIM_ELEM(windowFourier,n)*=conj(DIRECT_MULTIDIM_ELEM(patternFourier[r],n));
+    transformer.inverseFourierTransform();
+
+    // Normalize by the local statistics and look for the maximum
+    double N=patchSize*patchSize;
+    double K=MULTIDIM_SIZE(window)/N;
+    double maxval=-1;
+    shiftX=shiftY=0;
+    for (int sy=-maxShift; sy<=maxShift; ++sy)
+    {
+        if (yb+sy-halfSize<STARTINGY(I) || yb+sy+halfSize>FINISHINGY(I))
+            continue;
+        int i0=sy+maxShift, i1=i0+patchSize;
+        for (int sx=-maxShift; sx<=maxShift; ++sx)
+        {
+            if (xb+sx-halfSize<STARTINGX(I) || xb+sx+halfSize>FINISHINGX(I))
+                continue;
+            int j0=sx+maxShift, j1=j0+patchSize;
+            double sum=DIRECT_A2D_ELEM(sat,i1,j1)-DIRECT_A2D_ELEM(sat,i0,j1)-
+                       DIRECT_A2D_ELEM(sat,i1,j0)+DIRECT_A2D_ELEM(sat,i0,j0);
+            double sum2=DIRECT_A2D_ELEM(sat2,i1,j1)-DIRECT_A2D_ELEM(sat2,i0,j1)-
+                        DIRECT_A2D_ELEM(sat2,i1,j0)+DIRECT_A2D_ELEM(sat2,i0,j0);
+            double mean=sum/N;
+            double stddev=sum2/N-mean*mean;
+            stddev*=N/(N-1);
+            stddev=sqrt(ABS(stddev));
+            double corr=0;
+            if (stddev>XMIPP_EQUAL_ACCURACY)
+                corr=DIRECT_A2D_ELEM(window,i0,j0)*K/stddev;
+            if (corr>maxval)
+            {
+                maxval=corr;
+                shiftX=sx;
+                shiftY=sy;
+            }
+        }
+    }
+    return maxval;
+}
+
 /* Refine landmark --------------------------------------------------------- */
 bool ProgTomographAlignment::refineLandmark(int ii, int jj,
         const Matrix1D<double> &rii, Matrix1D<double> &rjj, double &maxCorr,
-        bool tryFourier) const
+        bool tryFourier, PatchCorrelator *correlator) const
 {
     maxCorr=-1;
     int halfSize=XMIPP_MAX(ROUND(localSize*XSIZE(*img[ii]))/2,5);
@@ -1849,115 +1971,26 @@ bool ProgTomographAlignment::refineLandmark(int ii, int jj,
     }
 
     bool retval=refineLandmark(pieceii,jj,rjj,actualCorrThreshold,
-                               reversed,maxCorr);
+                               reversed,maxCorr,correlator);
     return retval;
 }
 
 bool ProgTomographAlignment::refineLandmark(const MultidimArray<double> &pieceii,
         int jj, Matrix1D<double> &rjj, double actualCorrThreshold,
-        bool reversed, double &maxCorr) const
+        bool reversed, double &maxCorr, PatchCorrelator *correlator) const
 {
+    PatchCorrelator localCorrelator;
+    if (correlator==NULL)
+        correlator=&localCorrelator;
     int halfSize=XSIZE(pieceii)/2;
 
-    double mean_ii=0, stddev_ii=0;
-    FOR_ALL_ELEMENTS_IN_ARRAY2D(pieceii)
-    {
-        mean_ii+=A2D_ELEM(pieceii,i,j);
-        stddev_ii+=A2D_ELEM(pieceii,i,j)*A2D_ELEM(pieceii,i,j);
-    }
-    mean_ii/=MULTIDIM_SIZE(pieceii);
-    stddev_ii = stddev_ii / MULTIDIM_SIZE(pieceii) - mean_ii * mean_ii;
-    stddev_ii *= MULTIDIM_SIZE(pieceii) / (MULTIDIM_SIZE(pieceii) - 1);
-    stddev_ii = sqrt(static_cast<double>((ABS(stddev_ii))));
-    if (stddev_ii>XMIPP_EQUAL_ACCURACY)
-        FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(pieceii)
-        DIRECT_MULTIDIM_ELEM(pieceii,n)=
-            (DIRECT_MULTIDIM_ELEM(pieceii,n)-mean_ii)/stddev_ii;
-
     // Try all possible shifts
-    MultidimArray<double> corr((int)(1.5*(2*halfSize+1)),(int)(1.5*(2*halfSize+1)));
-    corr.setXmippOrigin();
-    corr.initConstant(-1.1);
     bool accept=false;
     double maxval=-1;
-    MultidimArray<double> piecejj(2*halfSize+1,2*halfSize+1);
-    piecejj.setXmippOrigin();
-    if (stddev_ii>XMIPP_EQUAL_ACCURACY)
+    if (correlator->setPatch(pieceii,(int)(1.5*(2*halfSize+1))/2))
     {
         int imax=0, jmax=0;
-        std::queue< Matrix1D<double> > Q;
-        Q.push(vectorR2(0,0));
-        while (!Q.empty())
-        {
-            // Get the first position to evaluate
-            int shifty=(int)YY(Q.front());
-            int shiftx=(int)XX(Q.front());
-            Q.pop();
-            if (!corr(shifty,shiftx)<-1)
-                continue;
-
-            // Select piece in image jj, compute its statistics and normalize
-            double mean_jj=0, stddev_jj=0;
-            const MultidimArray<unsigned char> &Ijj=(*img[jj]);
-            if (XX(rjj)+shiftx+STARTINGX(piecejj)<STARTINGX(Ijj) ||
-                YY(rjj)+shifty+STARTINGY(piecejj)<STARTINGY(Ijj) ||
-                XX(rjj)+shiftx+FINISHINGX(piecejj)>FINISHINGX(Ijj) ||
-                YY(rjj)+shifty+FINISHINGY(piecejj)>FINISHINGY(Ijj))
-                continue;
-            FOR_ALL_ELEMENTS_IN_ARRAY2D(piecejj)
-            {
-                double pixval=A2D_ELEM(Ijj,
-                                       (int)(YY(rjj)+shifty+i),
-                                       (int)(XX(rjj)+shiftx+j));
-                A2D_ELEM(piecejj,i,j)=pixval;
-                mean_jj+=pixval;
-                stddev_jj+=pixval*pixval;
-            }
-            mean_jj/=MULTIDIM_SIZE(piecejj);
-            stddev_jj = stddev_jj / MULTIDIM_SIZE(piecejj) - mean_jj * mean_jj;
-            stddev_jj *= MULTIDIM_SIZE(piecejj) / (MULTIDIM_SIZE(piecejj) - 1);
-            stddev_jj = sqrt(static_cast<double>((ABS(stddev_jj))));
-            if (reversed)
-                piecejj.selfReverseY();
-
-            // Compute the correlation
-            corr(shifty,shiftx)=0;
-            double &corrRef=corr(shifty,shiftx);
-            if (stddev_jj>XMIPP_EQUAL_ACCURACY)
-            {
-                double istddev_jj=1.0/stddev_jj;
-                FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(piecejj)
-                corrRef+=
-                    DIRECT_MULTIDIM_ELEM(pieceii,n)*
-                    (DIRECT_MULTIDIM_ELEM(piecejj,n)-mean_jj)*istddev_jj;
-                corrRef/=MULTIDIM_SIZE(piecejj);
-            }
-
-            if (corrRef>maxval)
-            {
-                maxval=corrRef;
-                imax=shifty;
-                jmax=shiftx;
-                for (int step=1; step<=5; step+=2)
-                    for (int stepy=-1; stepy<=1; stepy++)
-                        for (int stepx=-1; stepx<=1; stepx++)
-                        {
-                            int newshifty=shifty+stepy*step;
-                            int newshiftx=shiftx+stepx*step;
-                            if (newshifty>=STARTINGY(corr) &&
-                                newshifty<=FINISHINGY(corr) &&
-                                newshiftx>=STARTINGX(corr) &&
-                                newshiftx<=FINISHINGX(corr) &&
-                                (XX(rjj)+newshiftx-halfSize)>=STARTINGX(Ijj) &&
-                                (XX(rjj)+newshiftx+halfSize)<=FINISHINGX(Ijj) &&
-                                (YY(rjj)+newshifty-halfSize)>=STARTINGY(Ijj) &&
-                                (YY(rjj)+newshifty+halfSize)<=FINISHINGY(Ijj))
-                                if (corr(newshifty,newshiftx)<-1)
-                                    Q.push(vectorR2(newshiftx,newshifty));
-                        }
-            }
-        }
-
+        maxval=correlator->bestShift(*img[jj],XX(rjj),YY(rjj),reversed,jmax,imax);
         if (maxval>actualCorrThreshold)
         {
             XX(rjj)+=jmax;
@@ -1970,14 +2003,14 @@ bool ProgTomographAlignment::refineLandmark(const MultidimArray<double> &pieceii
         if (showRefinement)
         {
             Image<double> save;
+            MultidimArray<double> piecejj(2*halfSize+1,2*halfSize+1);
+            piecejj.setXmippOrigin();
             FOR_ALL_ELEMENTS_IN_ARRAY2D(piecejj)
             piecejj(i,j)=(*img[jj])((int)(YY(rjj)+i),(int)(XX(rjj)+j));
             if (reversed)
                 piecejj.selfReverseY();
             save()=piecejj;
             save.write("PPPpiecejj.xmp");
-            save()=corr;
-            save.write("PPPcorr.xmp");
             std::cout << "jj=" << jj << " rjj=" << rjj.transpose() << std::endl;
             std::cout << "imax=" << imax << " jmax=" << jmax << std::endl;
             std::cout << "maxval=" << maxval << std::endl;
@@ -1997,7 +2030,7 @@ bool ProgTomographAlignment::refineLandmark(const MultidimArray<double> &pieceii
 /* Refine chain ------------------------------------------------------------ */
 //#define DEBUG
 bool ProgTomographAlignment::refineChain(LandmarkChain &chain,
-        double &corrChain)
+        double &corrChain, PatchCorrelator *correlator)
 {
 #ifdef DEBUG
     std::cout << "Chain for refinement: ";
@@ -2054,7 +2087,7 @@ bool ProgTomographAlignment::refineChain(LandmarkChain &chain,
                 int jj=chain[j].imgIdx;
                 VECTOR_R2(rjj,chain[j].x,chain[j].y);
                 double corr;
-                bool accepted=refineLandmark(avgPiece,jj,rjj,0,false,corr);
+                bool accepted=refineLandmark(avgPiece,jj,rjj,0,false,corr,correlator);
                 if (accepted)
                 {
                     chain[j].x=XX(rjj);
@@ -2085,7 +2118,7 @@ bool ProgTomographAlignment::refineChain(LandmarkChain &chain,
                     VECTOR_R2(rjj,chain[i+step].x,chain[i+step].y);
                     newrjj=rjj;
                     double corr;
-                    bool accepted=refineLandmark(ii,jj,rii,newrjj,corr,false);
+                    bool accepted=refineLandmark(ii,jj,rii,newrjj,corr,false,correlator);
                     if (((newrjj-rjj).module()<4 && accepted) || useCriticalPoints)
                     {
                         chain[i+step].x=XX(newrjj);
@@ -2109,7 +2142,7 @@ bool ProgTomographAlignment::refineChain(LandmarkChain &chain,
                     VECTOR_R2(rjj,chain[i-1].x,chain[i-1].y);
                     newrjj=rjj;
                     double corr;
-                    bool accepted=refineLandmark(ii,jj,rii,newrjj,corr,false);
+                    bool accepted=refineLandmark(ii,jj,rii,newrjj,corr,false,correlator);
                     corrChain=XMIPP_MIN(corrChain,corr);
                     if (((newrjj-rjj).module()<4 && accepted) || useCriticalPoints)
                     {
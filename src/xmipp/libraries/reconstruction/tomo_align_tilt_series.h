@@ -30,6 +30,7 @@
 #include <core/metadata.h>
 #include <core/metadata_extension.h>
 #include <core/xmipp_program.h>
+#include <core/xmipp_fftw.h>
 #include <pthread.h>
 
 /**@defgroup AngularAssignTiltSeries angular_assign_for_tilt_series
@@ -70,6 +71,59 @@ public:
 /** A landmark chain is simply a vector of landmarks. */
 typedef std::vector<Landmark> LandmarkChain;
 
+/** Patch correlator.
+    Normalized cross-correlation of a square pattern with all the shifts of a
+    search window, computed in Fourier space. The pattern is normalized and
+    transformed once (setPatch) and can then be compared with windows of
+    several images (bestShift). Each window is read once, row by row, and the
+    local means and standard deviations of the image come from summed-area
+    tables, so that the cost does not depend on the number of shifts explored.
+    Objects of this class are not thread-safe, use one per thread. */
+class PatchCorrelator
+{
+public:
+    /** Set the pattern (odd square size, logical origin at its center).
+        maxShift is the largest shift explored in each direction.
+        Returns false if the pattern has no contrast. */
+    bool setPatch(const MultidimArray<double> &patch, int maxShift);
+
+    /** Best shift of the pattern around (x,y) in image I.
+        Only the shifts for which the whole pattern falls inside I are
+        considered. If reversed, the pattern is compared with the image
+        flipped in Y. Returns the maximum correlation and its shift
+        (-1 if no shift is possible). */
+    double bestShift(const MultidimArray<unsigned char> &I, double x, double y,
+                     bool reversed, int &shiftX, int &shiftY);
+
+public:
+    // Half size of the pattern
+    int halfSize;
+
+    // Maximum shift
+    int maxShift;
+
+    // Normalized pattern
+    MultidimArray<double> pattern;
+
+    // Fourier transform of the pattern (direct and flipped in Y)
+    MultidimArray< std::complex<double> > patternFourier[2];
+
+    // Whether patternFourier has been computed for the current pattern
+    bool validPatternFourier[2];
+
+    // Search window and its correlation with the pattern
+    MultidimArray<double> window;
+
+    // Summed-area tables of the window and its square
+    MultidimArray<double> sat, sat2;
+
+    // Fourier transform of the window
+    MultidimArray< std::complex<double> > windowFourier;
+
+    // Transformer for the window
+    FourierTransformer transformer;
+};
+
 /* Forward prototype */
 class Alignment;
 
@@ -191,9 +245,13 @@ public:
         image at which the landmark is being refined. rii and rjj are
         the corresponding landmark positions in both images.
         
-        The function returns whether the landmark is accepted or not. */
+        The function returns whether the landmark is accepted or not.
+        The correlator is used for the shift search; threads should
+        provide their own so that its buffers and plans are reused
+        (if NULL, a temporary one is used). */
     bool refineLandmark(int ii, int jj, const Matrix1D<double> &rii,
-                        Matrix1D<double> &rjj, double &maxCorr, bool tryFourier) const;
+                        Matrix1D<double> &rjj, double &maxCorr, bool tryFourier,
+                        PatchCorrelator *correlator=NULL) const;
 
 
     /** Refine landmark.
@@ -201,10 +259,12 @@ public:
         as pattern (ii) instead of an index and a position. */
     bool refineLandmark(const MultidimArray<double> &pieceii, int jj,
                         Matrix1D<double> &rjj, double actualCorrThreshold,
-                        bool reversed, double &maxCorr) const;
+                        bool reversed, double &maxCorr,
+                        PatchCorrelator *correlator=NULL) const;
 
     /** Refine chain. */
-    bool refineChain(LandmarkChain &chain, double &corrChain);
+    bool refineChain(LandmarkChain &chain, double &corrChain,
+                     PatchCorrelator *correlator=NULL);
 
     /// Generate landmark set using a grid
     void generateLandmarkSet();
@@ -48,6 +48,7 @@ public:
     double width;
     double strength;
     int smallSize;
+    int Nthreads;
 public:
     void defineParams()
     {
@@ -88,12 +89,14 @@ public:
         addParamsLine("     requires --binaryOperation;");
         addParamsLine("[--count+ <c=0>]: Minimum required neighbors with distinct value.");
         addParamsLine("     requires --binaryOperation;");
+        addParamsLine("[--thr <N=1>]: Number of threads for labelling the connected components.");
         addExampleLine("xmipp_transform_morphology -i binaryVolume.vol --binaryOperation dilation");
     }
 
     void readParams()
     {
         XmippMetadataProgram::readParams();
+        Nthreads=getIntParam("--thr");
         binaryOperation=checkParam("--binaryOperation");
         if (binaryOperation)
         {
@@ -220,16 +223,16 @@ public:
             break;
         case KEEPBIGGEST:
         	if (isVolume)
-        		keepBiggestComponent(img(),0,neig3D);
+        		keepBiggestComponent(img(),0,neig3D,Nthreads);
         	else
-        		keepBiggestComponent(img(),0,neig2D);
+        		keepBiggestComponent(img(),0,neig2D,Nthreads);
         	imgOut()=img();
         	break;
         case REMOVESMALL:
         	if (isVolume)
-        		removeSmallComponents(img(),smallSize,neig3D);
+        		removeSmallComponents(img(),smallSize,neig3D,Nthreads);
         	else
-        		removeSmallComponents(img(),smallSize,neig2D);
+        		removeSmallComponents(img(),smallSize,neig2D,Nthreads);
         	imgOut()=img();
         	break;
         }
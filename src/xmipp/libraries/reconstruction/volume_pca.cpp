@@ -36,6 +36,7 @@ void ProgVolumePCA::readParams()
     fnBasis = getParam("--saveBasis");
     fnAvgVol = getParam("--avgVolume");
     fnOutStack = getParam("--opca");
+    Nthreads = getIntParam("--thr");
     if (checkParam("--generatePCAVolumes"))
     	getListParam("--generatePCAVolumes",listOfPercentiles);
     if (checkParam("--mask"))
@@ -52,7 +53,8 @@ void ProgVolumePCA::show() const
     		  << "Number of PCAs: " << NPCA       << std::endl
     		  << "Basis:          " << fnBasis    << std::endl
     		  << "Avg. volume:    " << fnAvgVol   << std::endl
-    		  << "Output PCA vols:" << fnOutStack << std::endl;
+    		  << "Output PCA vols:" << fnOutStack << std::endl
+    		  << "Threads:        " << Nthreads   << std::endl;
     std::cout << "Percentiles:    ";
     for (size_t i=0; i<listOfPercentiles.size(); i++)
     	std::cout << listOfPercentiles[i] << " ";
@@ -72,6 +74,7 @@ void ProgVolumePCA::defineParams()
     addParamsLine("  [--generatePCAVolumes <...>]: List of percentiles (typically, \"10 90\"), to generate volumes along the 1st PCA basis");
     addParamsLine("  [--avgVolume <volume=\"\">] : Volume on which to add the PCA basis");
     addParamsLine("  [--opca <stack=\"\">]     : Stack of generated volumes");
+    addParamsLine("  [--thr <N=1>]             : Number of threads");
     mask.defineParams(this,INT_MASK);
 }
 
@@ -90,6 +93,39 @@ void ProgVolumePCA::produce_side_info()
 		mask.imask.resizeNoCopy(Zdim,Ydim,Xdim);
 		mask.imask.initConstant(1);
 	}
+	Nvoxels=mask.imask.sum();
+	mdVols.findObjects(objId);
+	fnVolumes.resize(objId.size());
+	for (size_t i=0; i<objId.size(); i++)
+		mdVols.getValue(MDL_IMAGE,fnVolumes[i],objId[i]);
+	Vthr.resize(Nthreads);
+}
+
+size_t ProgVolumePCA::getSampleDimension()
+{
+	return Nvoxels;
+}
+
+size_t ProgVolumePCA::getNumberOfItems()
+{
+	return objId.size();
+}
+
+void ProgVolumePCA::getSamples(size_t item, int thread, Matrix2D<double> &samples)
+{
+	Image<double> &Vt=Vthr[thread];
+	Vt.read(fnVolumes[item]);
+
+	// Construct vector
+	const MultidimArray<int> &imask=mask.imask;
+	const MultidimArray<double> &mV=Vt();
+	samples.resizeNoCopy(1,Nvoxels);
+	double *ptrSample=&MAT_ELEM(samples,0,0);
+	FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(mV)
+	{
+		if (DIRECT_MULTIDIM_ELEM(imask,n))
+			*ptrSample++=DIRECT_MULTIDIM_ELEM(mV,n);
+	}
 }
 
 void ProgVolumePCA::run()
@@ -98,44 +134,27 @@ void ProgVolumePCA::run()
     produce_side_info();
 
     const MultidimArray<int> &imask=mask.imask;
-    size_t Nvoxels=imask.sum();
-    MultidimArray<float> v;
-    v.initZeros(Nvoxels);
-
-    // Add all volumes to the analyzer
-    FileName fnVol;
-    FOR_ALL_OBJECTS_IN_METADATA(mdVols)
-    {
-    	mdVols.getValue(MDL_IMAGE,fnVol,__iter.objId);
-    	V.read(fnVol);
-
-    	// Construct vector
-    	const MultidimArray<double> &mV=V();
-    	size_t idx=0;
-    	FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(mV)
-    	{
-    		if (DIRECT_MULTIDIM_ELEM(imask,n))
-    			DIRECT_MULTIDIM_ELEM(v,idx++)=DIRECT_MULTIDIM_ELEM(mV,n);
-    	}
-
-    	analyzer.addVector(v);
-    }
 
-    // Construct PCA basis
-    analyzer.subtractAvg();
-    analyzer.learnPCABasis(NPCA,100);
+    // Construct PCA basis, the volumes are read as needed
+    analyzer.K=NPCA;
+    analyzer.Nthreads=Nthreads;
+    analyzer.verbose=verbose;
+    analyzer.learn(*this);
 
     // Project onto the PCA basis
-    Matrix2D<double> proj;
-    analyzer.projectOnPCABasis(proj);
+    size_t Nvols=objId.size();
+    Matrix2D<double> proj(Nvols,NPCA), v;
+    Matrix1D<double> vi, proji;
     std::vector<double> dimredProj;
     dimredProj.resize(NPCA);
-    int i=0;
-    FOR_ALL_OBJECTS_IN_METADATA(mdVols)
+    for (size_t i=0; i<Nvols; i++)
     {
-        memcpy(&dimredProj[0],&MAT_ELEM(proj,i,0),NPCA*sizeof(double));
-        mdVols.setValue(MDL_DIMRED,dimredProj,__iter.objId);
-        i++;
+    	getSamples(i,0,v);
+    	v.getRow(0,vi);
+    	analyzer.project(vi,proji);
+    	for (int j=0; j<NPCA; j++)
+    		dimredProj[j]=MAT_ELEM(proj,i,j)=VEC_ELEM(proji,j);
+        mdVols.setValue(MDL_DIMRED,dimredProj,objId[i]);
     }
     if (fnVolsOut!="")
     	mdVols.write(fnVolsOut);
@@ -143,16 +162,16 @@ void ProgVolumePCA::run()
     	mdVols.write(fnVols);
 
     // Save the basis
+	V().initZeros(imask);
 	const MultidimArray<double> &mV=V();
 	for (int i=NPCA-1; i>=0; --i)
 	{
 	    V().initZeros();
     	size_t idx=0;
-    	const MultidimArray<double> &mPCA=analyzer.PCAbasis[i];
     	FOR_ALL_DIRECT_ELEMENTS_IN_MULTIDIMARRAY(mV)
     	{
     		if (DIRECT_MULTIDIM_ELEM(imask,n))
-    			DIRECT_MULTIDIM_ELEM(mV,n)=DIRECT_MULTIDIM_ELEM(mPCA,idx++);
+    			DIRECT_MULTIDIM_ELEM(mV,n)=MAT_ELEM(analyzer.eigenvectors,idx++,i);
     	}
     	if (fnBasis!="")
     		V.write(fnBasis,i+1,true,WRITE_OVERWRITE);
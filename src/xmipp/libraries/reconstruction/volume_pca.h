@@ -29,13 +29,16 @@
 #include <core/xmipp_image.h>
 #include <core/xmipp_program.h>
 #include <data/mask.h>
-#include <data/basic_pca.h>
+#include <classification/pca.h>
 
 ///@defgroup VolumePCA Volume PCA
 ///@ingroup ReconsLibrary
 //@{
-/** Volume PCA parameters. */
-class ProgVolumePCA: public XmippProgram
+/** Volume PCA parameters.
+ * The volumes are read by a StreamingPCA one at a time, so that they
+ * need not fit in memory.
+ */
+class ProgVolumePCA: public XmippProgram, public PCASampleSource
 {
 public:
     /// Input set of volumes
@@ -54,16 +57,33 @@ public:
     FileName fnAvgVol;
     /// Output PCA stack
     FileName fnOutStack;
+    /// Number of threads
+    int Nthreads;
 public:
     // Metadata with volumes
     MetaData mdVols;
 
+    // Object ids of the volumes
+    std::vector<size_t> objId;
+
+    // Filenames of the volumes
+    std::vector<FileName> fnVolumes;
+
+    // Number of voxels within the mask
+    size_t Nvoxels;
+
     // Input volume
     Image<double> V;
 
+    // Input volume (one per thread)
+    std::vector< Image<double> > Vthr;
+
     // PCA analyzer
-    PCAMahalanobisAnalyzer analyzer;
+    StreamingPCA analyzer;
 public:
+    /// Constructor
+    ProgVolumePCA(): analyzer(1) {}
+
     /// Read arguments
     void readParams();
 
@@ -76,6 +96,15 @@ public:
     /** Produce side info.*/
     void produce_side_info();
 
+    /// Number of voxels within the mask
+    size_t getSampleDimension();
+
+    /// Number of volumes
+    size_t getNumberOfItems();
+
+    /// Voxels within the mask of a volume
+    void getSamples(size_t item, int thread, Matrix2D<double> &samples);
+
     /** Run */
     void run();
 };
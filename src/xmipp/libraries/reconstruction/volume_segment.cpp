@@ -41,6 +41,7 @@ void ProgVolumeSegment::readParams()
 
     fn_vol = getParam("-i");
     fn_mask = getParam("-o");
+    Nthreads = getIntParam("--thr");
     method=getParam("--method");
     if (method=="voxel_mass")
         voxel_mass = getDoubleParam("--method", 1);
@@ -83,6 +84,7 @@ void ProgVolumeSegment::show() const
     << "Otsu         : " << otsu          << std::endl
     << "Wang radius  : " << wang_radius   << std::endl
     << "Probabilistic: " << do_prob       << std::endl
+    << "Threads      : " << Nthreads      << std::endl
     ;
 }
 
@@ -102,6 +104,7 @@ void ProgVolumeSegment::defineParams()
     addParamsLine("            otsu                      : Otsu's method segmentation");
     addParamsLine("            prob        <radius=-1>   : Probabilistic solvent mask (typical value 3)");
     addParamsLine("                                      : Radius [pix] is used for B.C. Wang cone smoothing");
+    addParamsLine("  [--thr <N=1>]             : Number of threads");
 }
 
 // Produce side information ================================================
@@ -126,7 +129,7 @@ void ProgVolumeSegment::produce_side_info()
 // biggest piece
 //#define DEBUG
 double segment_threshold(const Image<double> *V_in, Image<double> *V_out,
-                         double threshold, bool do_prob)
+                         double threshold, bool do_prob, int Nthreads)
 {
     Image<double> aux;
 
@@ -159,7 +162,7 @@ double segment_threshold(const Image<double> *V_in, Image<double> *V_out,
     }
 
     // Count the number of different objects
-    int no_comp = labelImage3D((*V_out)(), aux());
+    int no_comp = labelImage3D((*V_out)(), aux(), Nthreads);
     Matrix1D<double> count(no_comp + 1);
     const MultidimArray<double> &maux=aux();
     FOR_ALL_ELEMENTS_IN_ARRAY3D(maux)
@@ -307,7 +310,7 @@ void ProgVolumeSegment::segment(Image<double> &mask)
             do
             {
                 double th_med = (th_min + th_max) * 0.5;
-                double mass_med = segment_threshold(&V, &mask, th_med, do_prob);
+                double mass_med = segment_threshold(&V, &mask, th_med, do_prob, Nthreads);
                 std::cout << "Threshold= " << th_med
                 << " mass of the main piece= " << mass_med << std::endl;
                 if (ABS(mass_med - voxel_mass) / voxel_mass < 0.001)
@@ -331,7 +334,7 @@ void ProgVolumeSegment::segment(Image<double> &mask)
         else
         {
             // Perform a single thresholding
-            double mass_med = segment_threshold(&V, &mask, threshold, do_prob);
+            double mass_med = segment_threshold(&V, &mask, threshold, do_prob, Nthreads);
             std::cout << "Threshold= " << threshold
             << " mass of the main piece= " << mass_med << std::endl;
             ok = true;
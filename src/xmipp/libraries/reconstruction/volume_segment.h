@@ -64,6 +64,8 @@ public:
     bool do_prob;
     /// radius for B.C. Wang-like smoothing procedure
     int wang_radius;
+    /// Number of threads for labelling the connected components
+    int Nthreads;
 
 public:
     // Input volume
@@ -427,6 +427,116 @@ class TestXmippPythonInterface(unittest.TestCase):
         #vol.write('/tmp/vol2.vol')
         proj.write('/tmp/kk.spi')
 
+    def test_Image_projectFourierBatch(self):
+        import numpy as np
+        vol = Image(testFile('progVol.vol'))
+        vol.convert2DataType(DT_DOUBLE)
+        fp = FourierProjector(vol, 2, 0.5, 2)
+        angles = np.array([[0., 0., 0.], [30., 20., 10.], [60., 45., 0.]])
+        stack = fp.projectVolumes(angles, numThreads=2)
+        self.assertEqual(stack.dtype, np.float32)
+        self.assertEqual(stack.shape[0], 3)
+        proj = Image()
+        proj.setDataType(DT_DOUBLE)
+        for n in range(3):
+            fp.projectVolume(proj, *angles[n])
+            self.assertTrue(np.allclose(stack[n], proj.getData(), atol=1e-4))
+
+        # An integer shift is a circular shift of the projection
+        shifted = fp.projectVolumes(angles, shifts=[[2., -3.]] * 3)
+        self.assertTrue(np.allclose(shifted, np.roll(np.roll(stack, -3, axis=1), 2, axis=2),
+                                    atol=1e-4))
+
+        ctf = fp.projectVolumes(angles, defocus=[[10000., 12000., 30.]] * 3,
+                                samplingRate=2.)
+        self.assertEqual(ctf.shape, stack.shape)
+        self.assertRaises(ValueError, fp.projectVolumes, angles[:, :2])
+
+    def runInThreads(self, func, args):
+        """ Run func(arg) for each arg in a different thread and
+        return the results in the same order.
+        """
+        import threading
+        results = [None] * len(args)
+        errors = []
+        def worker(i):
+            try:
+                results[i] = func(args[i])
+            except Exception as e:
+                errors.append(e)
+        threads = [threading.Thread(target=worker, args=(i,))
+                   for i in range(len(args))]
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        if errors:
+            raise errors[0]
+        return results
+
+    def test_threads_Image_read_write(self):
+        imgPath = testFile("smallStack.stk")
+        tmpNames = [self.getTmpName('.spi') for i in range(4)]
+        def readWrite(i):
+            img = Image()
+            img.read((i % 3 + 1, imgPath))
+            img.write(tmpNames[i])
+            return Image(tmpNames[i])
+        results = self.runInThreads(readWrite, range(4))
+        for i in range(4):
+            self.assertEqual(results[i], Image("%d@%s" % (i % 3 + 1, imgPath)))
+
+    def test_threads_projectVolumeDouble(self):
+        vol = Image(testFile('progVol.vol'))
+        vol.convert2DataType(DT_DOUBLE)
+        angles = [(0., 0., 0.), (30., 20., 10.), (60., 45., 0.), (90., 90., 45.)]
+        expected = [projectVolumeDouble(vol, *a) for a in angles]
+        results = self.runInThreads(lambda a: projectVolumeDouble(vol, *a), angles)
+        for proj, exp in zip(results, expected):
+            self.assertEqual(proj, exp)
+
+    def test_threads_FourierProjector(self):
+        vol = Image(testFile('progVol.vol'))
+        vol.convert2DataType(DT_DOUBLE)
+        fp = FourierProjector(vol, 2, 0.5, 2)
+        angles = [(0., 0., 0.), (30., 20., 10.), (60., 45., 0.), (90., 90., 45.)]
+        def project(a):
+            proj = Image()
+            proj.setDataType(DT_DOUBLE)
+            fp.projectVolume(proj, *a)
+            return proj
+        expected = [project(a) for a in angles]
+        results = self.runInThreads(project, angles)
+        for proj, exp in zip(results, expected):
+            self.assertEqual(proj, exp)
+
+    def test_threads_MetaData_read_write(self):
+        # The metadata calls keep the GIL, while other threads read images
+        # without it
+        mdPath = testFile("test.xmd")
+        imgPath = testFile("smallStack.stk")
+        tmpNames = [self.getTmpName() for i in range(4)]
+        def readWrite(i):
+            md = MetaData()
+            md.read(mdPath)
+            Image("%d@%s" % (i % 3 + 1, imgPath))
+            md.write(tmpNames[i])
+            return MetaData(tmpNames[i])
+        results = self.runInThreads(readWrite, range(4))
+        expected = MetaData(mdPath)
+        for md in results:
+            self.assertEqual(md, expected)
+
+    def test_threads_bandPassFilter(self):
+        imgPath = testFile("tinyImage.spi")
+        def filter(i):
+            img = Image()
+            bandPassFilter(img, imgPath, 0.05, 0.4, 0.02, 32)
+            return img
+        expected = filter(0)
+        for img in self.runInThreads(filter, range(4)):
+            self.assertEqual(img, expected)
+
     def test_Image_read(self):
         imgPath = testFile("tinyImage.spi")
         img = Image(imgPath)
@@ -540,6 +650,39 @@ class TestXmippPythonInterface(unittest.TestCase):
         ref = mD.getValue(MDL_REF3D, 2L)
         self.assertEqual(ref, 2)
 
+    def test_Metadata_columnArrays(self):
+        '''MetaData_getColumnArray and friends'''
+        import numpy as np
+        mD = MetaData(testFile("test.xmd"))
+        defocus = mD.getColumnArray(MDL_CTF_DEFOCUSU)
+        self.assertEqual(defocus.dtype, np.float64)
+        self.assertEqual(list(defocus), mD.getColumnValues(MDL_CTF_DEFOCUSU))
+        count = mD.getColumnArray(MDL_COUNT)
+        self.assertEqual(list(count), mD.getColumnValues(MDL_COUNT))
+        self.assertRaises(TypeError, mD.getColumnArray, MDL_IMAGE)
+
+        rec = mD.getColumnsArray([MDL_CTF_DEFOCUSU, MDL_REF3D])
+        self.assertEqual(rec.dtype.names, ('ctfDefocusU', 'ref3d'))
+        self.assertEqual(list(rec['ref3d']), mD.getColumnValues(MDL_REF3D))
+
+        # Fill an empty metadata and modify an existing column
+        md2 = MetaData()
+        rot = np.arange(5, dtype=np.float64) * 10.
+        md2.setColumnArray(MDL_ANGLE_ROT, rot)
+        self.assertEqual(md2.size(), 5)
+        md2.setColumnArray(MDL_REF, [1, 2, 3, 4, 5])
+        self.assertEqual(md2.getColumnValues(MDL_REF), [1, 2, 3, 4, 5])
+        self.assertRaises(XmippError, md2.setColumnArray, MDL_REF, [1, 2])
+
+        rec = np.zeros(5, dtype=[('angleTilt', np.float64), ('shiftX', np.float64)])
+        rec['angleTilt'] = 45.
+        rec['shiftX'] = np.arange(5)
+        md2.setColumnsArray(rec)
+        back = md2.getColumnsArray([MDL_ANGLE_ROT, MDL_ANGLE_TILT, MDL_SHIFT_X])
+        self.assertTrue(np.array_equal(back['angleRot'], rot))
+        self.assertTrue(np.array_equal(back['angleTilt'], rec['angleTilt']))
+        self.assertTrue(np.array_equal(back['shiftX'], rec['shiftX']))
+
     def test_Metadata_importObjects(self):
         '''import metadata subset'''
         mdPath = testFile("test.xmd")
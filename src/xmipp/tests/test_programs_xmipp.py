@@ -173,6 +173,32 @@ class AngularRotate(XmippProgramTest):
                 outputs=["newAnglesFewProjections.sel"])
 
 
+class Benchmark(XmippProgramTest):
+    _owner = COSS
+    @classmethod
+    def getProgram(cls):
+        return 'xmipp_benchmark'
+
+    def test_case1(self):
+        # Smoke test of the workload generation: phantom_create and
+        # phantom_project must accept the phantom description
+        self.runCase("-o %o/bench.json --odir %o/work --keepWorkloads --boxSizes 32 --Nimgs 20 "
+                     "--threads 1 --ranks 1 --stages reconstruct_fourier",
+                validate=self.validate_case1)
+
+    def validate_case1(self):
+        import json
+        for fn in ["work/box32/phantom.vol", "work/box32/projections.stk",
+                   "work/box32/particles.xmd", "work/box32/reconstruction.vol"]:
+            self.assertTrue(os.path.exists(os.path.join(self.outputDir, fn)), fn)
+        with open(os.path.join(self.outputDir, "bench.json")) as fh:
+            report = json.load(fh)
+        stages = [r['stage'] for r in report['results'] if r['returncode'] == 0]
+        for stage in ['synth_volume_32', 'synth_projections_32', 'synth_particles_32',
+                      'reconstruct_fourier']:
+            self.assertTrue(stage in stages, stage)
+
+
 class ClassifyAnalyzeCluster(XmippProgramTest):
     _owner = COSS
     @classmethod
@@ -504,6 +530,48 @@ class ImageOperateMpi(ImageOperate):
                 outputs=["column.spi"])
 
 
+class ImagePreprocessPipeline(XmippProgramTest):
+    _owner = COSS
+    @classmethod
+    def getProgram(cls):
+        return 'xmipp_image_preprocess_pipeline'
+
+    def test_case1(self):
+        # Astigmatic CTF and a different alignment per image. Two threads and
+        # batches of 2 images, so that reading, processing and writing overlap
+        self.runCase("-i %o/input.xmd -o %o/pipeline.stk --correct_ctf 2 2 -1 --apply_geo --thr 2 --batch 2",
+                preruns=["xmipp_metadata_selfile_create -p input/smallStack.stk -o %o/input.xmd -s",
+                         "xmipp_metadata_utilities -i %o/input.xmd -o %o/input.xmd --fill shiftX rand_uniform -3 3",
+                         "xmipp_metadata_utilities -i %o/input.xmd -o %o/input.xmd --fill shiftY rand_uniform -3 3",
+                         "xmipp_metadata_utilities -i %o/input.xmd -o %o/input.xmd --fill anglePsi rand_uniform 0 360",
+                         "xmipp_metadata_utilities -i %o/input.xmd -o %o/input.xmd --fill ctfSamplingRate constant 2",
+                         "xmipp_metadata_utilities -i %o/input.xmd -o %o/input.xmd --fill ctfVoltage constant 300",
+                         "xmipp_metadata_utilities -i %o/input.xmd -o %o/input.xmd --fill ctfDefocusU rand_uniform 15000 18000",
+                         "xmipp_metadata_utilities -i %o/input.xmd -o %o/input.xmd --fill ctfDefocusV rand_uniform 12000 14000",
+                         "xmipp_metadata_utilities -i %o/input.xmd -o %o/input.xmd --fill ctfDefocusAngle constant 30",
+                         "xmipp_metadata_utilities -i %o/input.xmd -o %o/input.xmd --fill ctfSphericalAberration constant 2",
+                         "xmipp_metadata_utilities -i %o/input.xmd -o %o/input.xmd --fill ctfQ0 constant 0.1"],
+                postruns=["xmipp_ctf_correct_wiener2d -i %o/input.xmd -o %o/wiener.stk --sampling_rate 2 --pad 2",
+                          "xmipp_transform_geometry -i %o/wiener.xmd -o %o/chain.stk --apply_transform --dont_wrap"],
+                validate=self.validate_case1)
+
+    def validate_case1(self):
+        # Same images as the chained programs, up to the single precision
+        # in which the chain stores the corrected images
+        fnPipeline = os.path.join(self.outputDir, "pipeline.stk")
+        fnChain = os.path.join(self.outputDir, "chain.stk")
+        mdPipeline = xmippLib.MetaData(os.path.join(self.outputDir, "pipeline.xmd"))
+        Nimgs = xmippLib.MetaData(os.path.join(self.outputDir, "input.xmd")).size()
+        self.assertEqual(mdPipeline.size(), Nimgs)
+        self.assertFalse(mdPipeline.containsLabel(xmippLib.MDL_CTF_DEFOCUSU))
+        self.assertFalse(mdPipeline.containsLabel(xmippLib.MDL_CTF_DEFOCUS_ANGLE))
+        for n in range(1, Nimgs + 1):
+            Ichain = xmippLib.Image("%d@%s" % (n, fnChain))
+            Ipipeline = xmippLib.Image("%d@%s" % (n, fnPipeline))
+            stddev = Ichain.computeStats()[1]
+            self.assertTrue(Ichain.equal(Ipipeline, 1e-4 * stddev), "Image %d" % n)
+
+
 class ImageResize(XmippProgramTest):
     _owner = RM
     @classmethod
@@ -896,6 +964,49 @@ class ReconstructFourier(XmippProgramTest):
                 outputs=["recon.vol"])
 
 
+class ReconstructFourierCheckpoint(XmippProgramTest):
+    _owner = COSS
+    @classmethod
+    def getProgram(cls):
+        return 'xmipp_reconstruct_fourier'
+
+    # One thread, so that the images are always added in the same order
+    def test_case2(self):
+        # A run that stopped after the first half, checkpointing every 2 images
+        self.runCase("-i input/aFewProjections.sel -o %o/resumed.vol --thr 1 --checkpoint %o/checkpoint 2",
+                preruns=["xmipp_metadata_split -i input/aFewProjections.sel -n 2 --oroot %o/half:xmd --dont_randomize --dont_sort",
+                         "xmipp_reconstruct_fourier -i input/aFewProjections.sel -o %o/full.vol --thr 1",
+                         "xmipp_reconstruct_fourier -i %o/half000001.xmd -o %o/stopped.vol --thr 1 --checkpoint %o/checkpoint 2"],
+                validate=self.validate_case2)
+
+    def validate_case2(self):
+        fnFull = os.path.join(self.outputDir, "full.vol")
+        fnResumed = os.path.join(self.outputDir, "resumed.vol")
+        self.assertTrue(xmippLib.Image(fnFull).equal(xmippLib.Image(fnResumed), 0.))
+        mdImages = xmippLib.MetaData("images@" + os.path.join(self.outputDir, "checkpoint.xmd"))
+        self.assertEqual(mdImages.size(), xmippLib.MetaData("input/aFewProjections.sel").size())
+
+    def test_case3(self):
+        # New particles added to a previous job, and two independent jobs
+        self.runCase("-i input/aFewProjections.sel -o %o/added.vol --thr 1 --merge %o/half1",
+                preruns=["xmipp_metadata_split -i input/aFewProjections.sel -n 2 --oroot %o/half:xmd --dont_randomize --dont_sort",
+                         "xmipp_reconstruct_fourier -i input/aFewProjections.sel -o %o/full.vol --thr 1",
+                         "xmipp_reconstruct_fourier -i %o/half000001.xmd -o %o/half1.vol --thr 1 --checkpoint %o/half1",
+                         "xmipp_reconstruct_fourier -i %o/half000002.xmd -o %o/half2.vol --thr 1 --checkpoint %o/half2"],
+                postruns=["xmipp_reconstruct_fourier -i input/aFewProjections.sel -o %o/merged.vol --thr 1 --merge %o/half1 %o/half2"],
+                validate=self.validate_case3)
+
+    def validate_case3(self):
+        full = xmippLib.Image(os.path.join(self.outputDir, "full.vol"))
+        added = xmippLib.Image(os.path.join(self.outputDir, "added.vol"))
+        merged = xmippLib.Image(os.path.join(self.outputDir, "merged.vol"))
+        self.assertTrue(full.equal(added, 0.))
+        # The images of the second half are added to an empty volume,
+        # so the sums are only equal up to rounding
+        maxValue = full.computeStats()[3]
+        self.assertTrue(full.equal(merged, 1e-5 * maxValue))
+
+
 class ResolutionFsc(XmippProgramTest):
     _owner = RM
     @classmethod